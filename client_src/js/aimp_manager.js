@@ -39,7 +39,7 @@ function AimpManager() {
                                           'RadioCaptureMode',
                                           'Status', // get/set various aspects of player
                                           'EnqueueTrack', 'RemoveTrackFromPlayQueue', // queue tracks
-                                          'GetPlaylists', 'CreatePlaylist', 'GetPlaylistEntries', 'GetEntryPositionInDataTable', 'GetPlaylistEntriesCount', 'GetFormattedEntryTitle', 'GetPlaylistEntryInfo', 'SetTrackRating', // playlists and tracks utils
+                                          'GetPlaylists', 'CreatePlaylist', 'GetPlaylistEntries', 'GetEntryPositionInDataTable', 'GetPlaylistEntriesCount', 'GetPlaylistEntriesDelta', 'GetFormattedEntryTitle', 'GetPlaylistEntryInfo', 'SetTrackRating', // playlists and tracks utils
                                           'GetCover', // album cover URI getter
                                           'DownloadTrack', // track URI getter
                                           'SubscribeOnAIMPStateUpdateEvent', // subscribe for AIMP player state notifications
@@ -220,6 +220,21 @@ getPlaylistEntriesCount : function(params, callbacks) {
     this.callRpc(this.aimp_service.GetPlaylistEntriesCount, params, callbacks);
 },
 
+/*
+    Returns changes of playlist entries since playlist had specified crc32.
+        Param params.playlist_id - playlist ID.
+        Param params.crc32 - crc32 of playlist known by client.
+        Param callbacks - see description in AimpManager comments.
+    Result is object with following members:
+        crc32 - current crc32 of playlist.
+        full_snapshot - true if changes are unknown. In this case entries member contains ids of all entries in playlist order.
+        removed - ids of removed entries.
+        inserted, moved, updated - [id, index] pairs of changed entries.
+*/
+getPlaylistEntriesDelta : function(params, callbacks) {
+    this.callRpc(this.aimp_service.GetPlaylistEntriesDelta, params, callbacks);
+},
+
 /*
     Returns formatted string for specified track in specified playlist.
         Param params.track_id - track ID.
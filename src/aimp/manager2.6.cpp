@@ -4,6 +4,7 @@
 #include "manager2.6.h"
 #include "manager_impl_common.h"
 #include "playlist_entry.h"
+#include "playlists_entries_indexes.h"
 #include "aimp2_sdk.h"
 #include "plugin/logger.h"
 #include "utils/string_encoding.h"
@@ -139,10 +140,9 @@ void AIMPManager26::loadPlaylist(int playlist_index)
     const int files_count = aimp2_playlist_manager_->AIMP_PLS_GetFilesCount(id);
 
     { // db code
-    sqlite3_stmt* stmt = createStmt(playlists_db_,
-                                    "REPLACE INTO Playlists VALUES (?,?,?,?,?,?,?)"
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(*playlists_stmt_cache_,
+                          "REPLACE INTO Playlists VALUES (?,?,?,?,?,?,?)"
+                          );
 
 #define bind(type, field_index, value)  rc_db = sqlite3_bind_##type(stmt, field_index, value); \
                                         if (SQLITE_OK != rc_db) { \
@@ -314,13 +314,14 @@ void AIMPManager26::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
 
     AIMP2FileInfoHelper file_info_helper; // used for get entries from AIMP conveniently.
     
+    Transaction transaction(playlists_db_); // all rows are written at once, on error previous rows are kept.
+
     deletePlaylistEntriesFromPlaylistDB(playlist_id); // remove old entries before adding new ones.
 
-    sqlite3_stmt* stmt = createStmt(playlists_db_, "INSERT INTO PlaylistsEntries VALUES (?,?,?,?,?,?,"
-                                                                                         "?,?,?,?,?,"
-                                                                                         "?,?,?,?,?)"
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(*playlists_stmt_cache_, "INSERT INTO PlaylistsEntries VALUES (?,?,?,?,?,?,"
+                                                                                        "?,?,?,?,?,"
+                                                                                        "?,?,?,?,?)"
+                          );
 
     //BOOST_LOG_SEV(logger(), debug) << "The statement has "
     //                               << sqlite3_bind_parameter_count(stmt)
@@ -382,6 +383,8 @@ void AIMPManager26::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
     }
 #undef bind
 #undef bindText
+
+    transaction.commit();
 }
 
 #ifdef MANUAL_PLAYLISTS_CONTENT_CHANGES_DETERMINATION
@@ -547,10 +550,9 @@ void AIMPManager26::checkIfPlaylistsChanged()
 
 void AIMPManager26::updatePlaylistCrcInDB(PlaylistID playlist_id, crc32_t crc32)
 {
-    sqlite3_stmt* stmt = createStmt(playlists_db_,
-                                    "UPDATE Playlists SET crc32=? WHERE id=?"
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(*playlists_stmt_cache_,
+                          "UPDATE Playlists SET crc32=? WHERE id=?"
+                          );
 
 #define bind(type, field_index, value)  rc_db = sqlite3_bind_##type(stmt, field_index, value); \
                                         if (SQLITE_OK != rc_db) { \
@@ -611,7 +613,7 @@ bool AIMPManager26::isLoadedPlaylistEqualsAimpPlaylist(PlaylistID playlist_id) c
     const int entries_count = aimp2_playlist_manager_->AIMP_PLS_GetFilesCount(playlist_id);
 
 #if _DEBUG
-    const size_t loaded_entries_count = getEntriesCountDB(playlist_id, playlists_db_);
+    const size_t loaded_entries_count = getEntriesCountDB(playlist_id, *playlists_stmt_cache_);
     assert(entries_count >= 0 && static_cast<size_t>(entries_count) == loaded_entries_count); // function returns correct result only if entries count in loaded and actual playlists are equal.
 #endif
 
@@ -1766,6 +1768,8 @@ void AIMPManager26::initPlaylistDB() // throws std::runtime_error
     THROW_IF_NOT_OK_WITH_MSG( rc, MakeString() << "Playlist database creation failure. Reason: sqlite3_open error "
                                                << rc << ": " << sqlite3_errmsg(playlists_db_) );
 
+    playlists_stmt_cache_.reset( new StmtCache(playlists_db_) );
+
     { // add case-insensitivity support to LIKE operator (used for search tracks) since default LIKE operator since it supports case-insensitive search only on ASCII chars by default).
     rc = sqlite3_unicode_init(playlists_db_);
     THROW_IF_NOT_OK_WITH_MSG( rc, MakeString() << "unicode support enabling failure. Reason: sqlite3_unicode_init() error "
@@ -1802,6 +1806,8 @@ void AIMPManager26::initPlaylistDB() // throws std::runtime_error
                                                << rc << ": " << errmsg );
     }
 
+    createPlaylistsEntriesIndexes(playlists_db_);
+
     { // create table for playlist.
     char* errmsg = nullptr;
     ON_BLOCK_EXIT(&sqlite3_free, errmsg);
@@ -1828,6 +1834,13 @@ void AIMPManager26::initPlaylistDB() // throws std::runtime_error
 
 void AIMPManager26::shutdownPlaylistDB()
 {
+    if (playlists_stmt_cache_) {
+        const StmtCacheStats stats = playlists_stmt_cache_->stats();
+        BOOST_LOG_SEV(logger(), info) << "Playlist database statements cache: hits " << stats.hits << ", misses " << stats.misses
+                                      << ", uncached " << stats.uncached << ", queries " << stats.cached_queries;
+        playlists_stmt_cache_.reset(); // statements must be finalized before database closing.
+    }
+
     const int rc = sqlite3_close(playlists_db_);
     if (SQLITE_OK != rc) {
         BOOST_LOG_SEV(logger(), error) << "sqlite3_close error: " << rc;
@@ -7,6 +7,7 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/asio.hpp>
 #include "utils/util.h"
+#include "utils/sqlite_stmt_cache.h"
 
 struct sqlite3;
 
@@ -115,6 +116,10 @@ public:
     sqlite3* playlists_db() const
         { return playlists_db_; }
 
+    //! Cache of prepared statements of playlists_db().
+    Utilities::StmtCache& playlists_stmt_cache()
+        { return *playlists_stmt_cache_; }
+
 private:
 
     /*!
@@ -199,6 +204,7 @@ private:
     EventsListenerID next_listener_id_; //!< unique ID describes external listener.
 
     sqlite3* playlists_db_;
+    std::unique_ptr<Utilities::StmtCache> playlists_stmt_cache_; //!< created and destroyed with playlists_db_.
 
     PlaylistCRC32& getPlaylistCRC32Object(PlaylistID playlist_id) const; // throws std::runtime_error
     typedef std::map<PlaylistID, PlaylistCRC32> PlaylistCRC32List;
@@ -5,6 +5,8 @@
 #include "manager_impl_common.h"
 #include "aimp3_util.h"
 #include "playlist_entry.h"
+#include "playlist_entries_sync.h"
+#include "playlists_entries_indexes.h"
 #include "utils/iunknown_impl.h"
 #include "plugin/logger.h"
 #include "utils/string_encoding.h"
@@ -173,6 +175,7 @@ AIMPManager30::AIMPManager30(boost::intrusive_ptr<AIMP3SDK::IAIMPCoreUnit> aimp3
     aimp3_core_unit_(aimp3_core_unit),
     next_listener_id_(0),
     playlists_db_(nullptr),
+    playlist_change_log_(kPLAYLIST_CHANGE_LOG_MAX_VERSIONS_COUNT),
     io_service_(io_service)
 {
     try {
@@ -349,7 +352,7 @@ void AIMPManager30::handlePlaylistChange(AIMP3SDK::HPLS handle, DWORD flags)
         )
     {
         BOOST_LOG_SEV(logger(), debug) << "loadEntries";
-        loadEntries(playlist_id); 
+        loadEntries(playlist_id);
         is_playlist_changed = true;
     }
 
@@ -488,10 +491,9 @@ void AIMPManager30::loadPlaylist(AIMP3SDK::HPLS handle, int playlist_index)
     const int entries_count = aimp3_playlist_manager_->StorageGetEntryCount(handle);
 
     { // db code
-    sqlite3_stmt* stmt = createStmt(playlists_db_,
-                                    "REPLACE INTO Playlists VALUES (?,?,?,?,?,?,?)"
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(*playlists_stmt_cache_,
+                          "REPLACE INTO Playlists VALUES (?,?,?,?,?,?,?)"
+                          );
 
 #define bind(type, field_index, value)  rc_db = sqlite3_bind_##type(stmt, field_index, value); \
                                         if (SQLITE_OK != rc_db) { \
@@ -551,10 +553,9 @@ crc32_t AIMPManager30::getPlaylistCRC32(PlaylistID playlist_id) const // throws
 
 void AIMPManager30::updatePlaylistCrcInDB(PlaylistID playlist_id, crc32_t crc32) // throws std::runtime_error
 {
-    sqlite3_stmt* stmt = createStmt(playlists_db_,
-                                    "UPDATE Playlists SET crc32=? WHERE id=?"
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(*playlists_stmt_cache_,
+                          "UPDATE Playlists SET crc32=? WHERE id=?"
+                          );
 
 #define bind(type, field_index, value)  rc_db = sqlite3_bind_##type(stmt, field_index, value); \
                                         if (SQLITE_OK != rc_db) { \
@@ -573,6 +574,8 @@ void AIMPManager30::updatePlaylistCrcInDB(PlaylistID playlist_id, crc32_t crc32)
                                              << rc_db << ": " << sqlite3_errmsg(playlists_db_);
         throw std::runtime_error(msg);
     }
+
+    playlist_change_log_.commitVersion(playlist_id, crc32);
 }
 
 void AIMPManager30::loadEntries(PlaylistID playlist_id) // throws std::runtime_error
@@ -595,13 +598,14 @@ void AIMPManager30::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
     const AIMP3SDK::HPLS playlist_handle = cast<AIMP3SDK::HPLS>(playlist_id);
     const int entries_count = aimp3_playlist_manager_->StorageGetEntryCount(playlist_handle);
 
-    deletePlaylistEntriesFromPlaylistDB(playlist_id); // remove old entries before adding new ones.
+    Transaction transaction(playlists_db_); // all rows are written at once, on error previous rows are kept.
 
-    sqlite3_stmt* stmt = createStmt(playlists_db_, "INSERT INTO PlaylistsEntries VALUES (?,?,?,?,?,?,"
-                                                                                        "?,?,?,?,?,"
-                                                                                        "?,?,?,?,?)"
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    PlaylistEntriesSync entries_sync(playlist_id, *playlists_stmt_cache_); // only new and changed entries are written.
+
+    StmtCache::Lease stmt(*playlists_stmt_cache_, "INSERT OR REPLACE INTO PlaylistsEntries VALUES (?,?,?,?,?,?,"
+                                                                                       "?,?,?,?,?,"
+                                                                                       "?,?,?,?,?)"
+                          );
 
     //BOOST_LOG_SEV(logger(), debug) << "The statement has "
     //                               << sqlite3_bind_parameter_count(stmt)
@@ -623,7 +627,11 @@ void AIMPManager30::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
     
     for (int entry_index = 0; entry_index < entries_count; ++entry_index) {
         const HPLSENTRY entry_handle = aimp3_playlist_manager_->StorageGetEntry(playlist_handle, entry_index);
+        const int entry_id = castToPlaylistEntryID(entry_handle);
 
+        // Fields of each entry are read even if only order of entries has been changed: AIMP3 frees removed entries
+        // and can reuse their handles for new ones in the same notification, so stored row of id can belong to another track.
+        // crc32 of fields tells whether row must be rewritten.
         HRESULT r = aimp3_playlist_manager_->EntryPropertyGetValue( entry_handle, AIMP3SDK::AIMP_PLAYLIST_ENTRY_PROPERTY_INFO,
                                                                     &file_info_helper.getEmptyFileInfo(), sizeof(file_info_helper.getEmptyFileInfo()) );
         if (S_OK != r) {
@@ -633,8 +641,6 @@ void AIMPManager30::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
             throw std::runtime_error(msg);
         }
 
-        const int entry_id = castToPlaylistEntryID(entry_handle);
-
         int rating = 0;
         { // get rating manually, since AIMP3 does not fill TAIMPFileInfo::Rating value.
             r = aimp3_playlist_manager_->EntryPropertyGetValue( entry_handle, AIMP3SDK::AIMP_PLAYLIST_ENTRY_PROPERTY_MARK, &rating, sizeof(rating) );    
@@ -643,13 +649,26 @@ void AIMPManager30::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
             }
         }
 
+        const AIMP3SDK::TAIMPFileInfo& info = file_info_helper.getFileInfoWithCorrectStringLengthsAndNonEmptyTitle();
+
+        crc32_t entry_crc32;
+        { // crc32 of all written fields: it is compared with stored one to skip writing of unchanged entry.
+            const crc32_t fields_crc32_list[] = {
+                crc32(info),
+                Utilities::crc32(rating) // TAIMPFileInfo::Rating is not filled by AIMP3.
+            };
+            entry_crc32 = Utilities::crc32( &fields_crc32_list[0], sizeof(fields_crc32_list) );
+        }
+
+        int row_index;
+        if ( !entries_sync.addEntry(entry_id, entry_crc32, &row_index) ) {
+            continue; // fields are not changed.
+        }
+
         { // special db code
             // bind all values
-            
-
-            const AIMP3SDK::TAIMPFileInfo& info = file_info_helper.getFileInfoWithCorrectStringLengthsAndNonEmptyTitle();
             bind(int,    2, entry_id);
-            bind(int,    3, entry_index);
+            bind(int,    3, row_index);
             bindText(    4, Album);
             bindText(    5, Artist);
             bindText(    6, Date);
@@ -662,7 +681,7 @@ void AIMPManager30::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
             bind(int64, 13, info.FileSize);
             bind(int,   14, rating);
             bind(int,   15, info.SampleRate);
-            bind(int64, 16, crc32(info));
+            bind(int64, 16, entry_crc32);
 
             rc_db = sqlite3_step(stmt);
             if (SQLITE_DONE != rc_db) {
@@ -675,6 +694,18 @@ void AIMPManager30::loadEntries(PlaylistID playlist_id) // throws std::runtime_e
     }
 #undef bind
 #undef bindText
+
+    entries_sync.commit();
+    transaction.commit();
+
+    BOOST_LOG_SEV(logger(), debug) << __FUNCTION__": playlist " << playlist_id << ", entries: " << entries_count
+                                   << ", written: " << entries_sync.writtenRowsCount() << ", renumbered: " << entries_sync.movedRowsCount();
+
+    { // keep changes for clients which sync playlist by delta, see PlaylistChangeLog.
+        PlaylistEntriesState entries_state;
+        entries_sync.takeEntriesState(&entries_state);
+        playlist_change_log_.recordEntriesState(playlist_id, &entries_state);
+    }
 }
 
 void AIMPManager30::startPlayback()
@@ -1689,6 +1720,8 @@ void AIMPManager30::initPlaylistDB() // throws std::runtime_error
     THROW_IF_NOT_OK_WITH_MSG( rc, MakeString() << "Playlist database creation failure. Reason: sqlite3_open error "
                                                << rc << ": " << sqlite3_errmsg(playlists_db_) );
 
+    playlists_stmt_cache_.reset( new StmtCache(playlists_db_) );
+
     { // add case-insensitivity support to LIKE operator (used for search tracks) since default LIKE operator since it supports case-insensitive search only on ASCII chars by default).
     rc = sqlite3_unicode_init(playlists_db_);
     THROW_IF_NOT_OK_WITH_MSG( rc, MakeString() << "unicode support enabling failure. Reason: sqlite3_unicode_init() error "
@@ -1725,6 +1758,8 @@ void AIMPManager30::initPlaylistDB() // throws std::runtime_error
                                                << rc << ": " << errmsg );
     }
 
+    createPlaylistsEntriesIndexes(playlists_db_);
+
     { // create table for playlist.
     char* errmsg = nullptr;
     ON_BLOCK_EXIT(&sqlite3_free, errmsg);
@@ -1750,6 +1785,13 @@ void AIMPManager30::initPlaylistDB() // throws std::runtime_error
 
 void AIMPManager30::shutdownPlaylistDB()
 {
+    if (playlists_stmt_cache_) {
+        const StmtCacheStats stats = playlists_stmt_cache_->stats();
+        BOOST_LOG_SEV(logger(), info) << "Playlist database statements cache: hits " << stats.hits << ", misses " << stats.misses
+                                      << ", uncached " << stats.uncached << ", queries " << stats.cached_queries;
+        playlists_stmt_cache_.reset(); // statements must be finalized before database closing.
+    }
+
     const int rc = sqlite3_close(playlists_db_);
     if (SQLITE_OK != rc) {
         BOOST_LOG_SEV(logger(), error) << "sqlite3_close error: " << rc;
@@ -1784,6 +1826,8 @@ void AIMPManager30::deletePlaylistFromPlaylistDB(PlaylistID playlist_id)
     const std::string query = MakeString() << "DELETE FROM Playlists WHERE id=" << playlist_id;
 
     executeQuery(query, playlists_db_, __FUNCTION__);
+
+    playlist_change_log_.removePlaylist(playlist_id);
 }
 
 void AIMPManager30::deletePlaylistEntriesFromPlaylistDB(PlaylistID playlist_id)
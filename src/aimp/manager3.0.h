@@ -5,9 +5,11 @@
 #include "manager.h"
 #include "aimp3_sdk/aimp3_sdk.h"
 #include "utils/util.h"
+#include "utils/sqlite_stmt_cache.h"
 #include "playlist_entry_rating.h"
 #include "playlist_update_manager.h"
 #include "player_supported_formats_getter.h"
+#include "playlist_change_log.h"
 
 struct sqlite3;
 
@@ -124,6 +126,14 @@ public:
     sqlite3* playlists_db() const
         { return playlists_db_; }
 
+    //! Cache of prepared statements of playlists_db().
+    Utilities::StmtCache& playlists_stmt_cache()
+        { return *playlists_stmt_cache_; }
+
+    //! Returns log of playlists entries changes, see GetPlaylistEntriesDelta RPC method.
+    const PlaylistChangeLog& playlistChangeLog() const
+        { return playlist_change_log_; }
+
 private:
 
     void onAimpCoreMessage(DWORD AMessage, int AParam1, void *AParam2, HRESULT *AResult);
@@ -197,8 +207,11 @@ private:
 
 protected:
     sqlite3* playlists_db_;
+    std::unique_ptr<Utilities::StmtCache> playlists_stmt_cache_; //!< created and destroyed with playlists_db_.
 
 private:
+
+    PlaylistChangeLog playlist_change_log_; //!< maintained by loadEntries() and updatePlaylistCrcInDB().
     
     PlaylistCRC32& getPlaylistCRC32Object(PlaylistID playlist_id) const; // throws std::runtime_error
 
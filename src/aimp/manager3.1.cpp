@@ -68,13 +68,14 @@ void AIMPManager31::reloadQueuedEntries() // throws std::runtime_error
     using namespace AIMP3SDK;
     // PROFILE_EXECUTION_TIME(__FUNCTION__);
 
+    Transaction transaction(playlists_db_); // all rows are written at once, on error previous rows are kept.
+
     deleteQueuedEntriesFromPlaylistDB(); // remove old entries before adding new ones.
 
-    sqlite3_stmt* stmt = createStmt(playlists_db_, "INSERT INTO QueuedEntries VALUES (?,?,?,?,?,"
-                                                                                     "?,?,?,?,?,"
-                                                                                     "?,?,?,?,?)"
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(*playlists_stmt_cache_, "INSERT INTO QueuedEntries VALUES (?,?,?,?,?,"
+                                                                                    "?,?,?,?,?,"
+                                                                                    "?,?,?,?,?)"
+                          );
 
     AIMP3Util::FileInfoHelper file_info_helper; // used for get entries from AIMP conveniently.
 
@@ -151,6 +152,8 @@ void AIMPManager31::reloadQueuedEntries() // throws std::runtime_error
             }
         }
     }
+
+    transaction.commit();
 }
 
 TrackDescription AIMPManager31::getTrackDescOfQueuedEntry(AIMP3SDK::HPLSENTRY entry_handle) const // throws std::runtime_error
@@ -160,15 +163,18 @@ TrackDescription AIMPManager31::getTrackDescOfQueuedEntry(AIMP3SDK::HPLSENTRY en
     const PlaylistEntryID entry_id = castToPlaylistEntryID(entry_handle);
 
     // find playlist id.
-    const std::string& query = MakeString() << "SELECT playlist_id FROM PlaylistsEntries "
-                                            << "WHERE entry_id = " << entry_id;
+    const char * const query = "SELECT playlist_id FROM PlaylistsEntries WHERE entry_id=?";
 
     sqlite3* playlists_db = playlists_db_;
-    sqlite3_stmt* stmt = createStmt( playlists_db, query.c_str() );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(*playlists_stmt_cache_, query); // called for each queued entry, so statement is reused.
+
+    int rc_db = sqlite3_bind_int(stmt, 1, entry_id);
+    if (SQLITE_OK != rc_db) {
+        throw std::runtime_error(MakeString() << "Error sqlite3_bind_int " << rc_db);
+    }
 
     for(;;) {
-		int rc_db = sqlite3_step(stmt);
+		rc_db = sqlite3_step(stmt);
         if (SQLITE_ROW == rc_db) {
             int playlist_id = sqlite3_column_int(stmt, 0);
             return TrackDescription(playlist_id, entry_id);
@@ -11,6 +11,8 @@
 #include "aimp3.60_sdk/Helpers/support.h"
 #include "aimp3.60_sdk/Helpers/AIMPString.h"
 #include "manager_impl_common.h"
+#include "playlist_entries_sync.h"
+#include "playlists_entries_indexes.h"
 #include <boost/algorithm/string.hpp>
 
 namespace {
@@ -127,6 +129,7 @@ private:
 
 AIMPManager36::AIMPManager36(boost::intrusive_ptr<AIMP36SDK::IAIMPCore> aimp36_core, boost::asio::io_service& io_service)
     :   playlists_db_(nullptr),
+        playlist_change_log_(kPLAYLIST_CHANGE_LOG_MAX_VERSIONS_COUNT),
         aimp36_core_(aimp36_core),
         io_service_(io_service)
 {
@@ -237,6 +240,8 @@ void AIMPManager36::initPlaylistDB()
     THROW_IF_NOT_OK_WITH_MSG( rc, MakeString() << "Playlist database creation failure. Reason: sqlite3_open error "
                                                << rc << ": " << sqlite3_errmsg(playlists_db_) );
 
+    playlists_stmt_cache_.reset( new StmtCache(playlists_db_) );
+
     { // add case-insensitivity support to LIKE operator (used for search tracks) since default LIKE operator since it supports case-insensitive search only on ASCII chars by default).
     rc = sqlite3_unicode_init(playlists_db_);
     THROW_IF_NOT_OK_WITH_MSG( rc, MakeString() << "unicode support enabling failure. Reason: sqlite3_unicode_init() error "
@@ -273,6 +278,8 @@ void AIMPManager36::initPlaylistDB()
                                                << rc << ": " << errmsg );
     }
 
+    createPlaylistsEntriesIndexes(playlists_db_);
+
     { // create table for playlist.
     char* errmsg = nullptr;
     ON_BLOCK_EXIT(&sqlite3_free, errmsg);
@@ -327,6 +334,13 @@ void AIMPManager36::initPlaylistDB()
 
 void AIMPManager36::shutdownPlaylistDB()
 {
+    if (playlists_stmt_cache_) {
+        const StmtCacheStats stats = playlists_stmt_cache_->stats();
+        BOOST_LOG_SEV(logger(), info) << "Playlist database statements cache: hits " << stats.hits << ", misses " << stats.misses
+                                      << ", uncached " << stats.uncached << ", queries " << stats.cached_queries;
+        playlists_stmt_cache_.reset(); // statements must be finalized before database closing.
+    }
+
     const int rc = sqlite3_close(playlists_db_);
     if (SQLITE_OK != rc) {
         BOOST_LOG_SEV(logger(), error) << "sqlite3_close error: " << rc;
@@ -336,6 +350,9 @@ void AIMPManager36::shutdownPlaylistDB()
 
 void AIMPManager36::loadPlaylistsContent()
 {
+    // single transaction for all playlists on startup, playlist loaders nest their transactions into it.
+    Transaction transaction(playlists_db_);
+
     aimp_service_playlist_manager_->GetLoadedPlaylistCount();
     for (int i = 0, count = aimp_service_playlist_manager_->GetLoadedPlaylistCount(); i != count; ++i) {
         IAIMPPlaylist* playlist_tmp;
@@ -347,6 +364,8 @@ void AIMPManager36::loadPlaylistsContent()
 
         playlistAdded(playlist.get());
     }
+
+    transaction.commit();
 }
 
 void AIMPManager36::playlistActivated(AIMP36SDK::IAIMPPlaylist* /*playlist*/)
@@ -365,7 +384,7 @@ void AIMPManager36::playlistAdded(IAIMPPlaylist* playlist)
 
         int playlist_index = getPlaylistIndexByHandle(playlist);
         loadPlaylist(playlist, playlist_index);
-        loadEntries(playlist);
+        loadEntries(playlist, true);
         notifyAllExternalListeners(EVENT_PLAYLISTS_CONTENT_CHANGE);
     } catch (std::exception& e) {
         BOOST_LOG_SEV(logger(), error) << "Error in " __FUNCTION__ << " for playlist with handle " << cast<PlaylistID>(playlist) << ". Reason: " << e.what();
@@ -433,7 +452,10 @@ void AIMPManager36::handlePlaylistChange(AIMP36SDK::IAIMPPlaylist* playlist, DWO
     {
         // load entries
         BOOST_LOG_SEV(logger(), debug) << "loadEntries";
-        loadEntries(playlist); 
+        // rating is not file info property, so statistics change forces reading of all fields too.
+        const bool entries_info_changed =    (AIMP_PLAYLIST_NOTIFY_FILEINFO   & flags) != 0
+                                          || (AIMP_PLAYLIST_NOTIFY_STATISTICS & flags) != 0;
+        loadEntries(playlist, entries_info_changed);
         is_playlist_changed = true;
     }
 
@@ -527,6 +549,8 @@ void AIMPManager36::deletePlaylistFromPlaylistDB(PlaylistID playlist_id)
     const std::string query = MakeString() << "DELETE FROM Playlists WHERE id=" << playlist_id;
 
     executeQuery(query, playlists_db_, __FUNCTION__);
+
+    playlist_change_log_.removePlaylist(playlist_id);
 }
 
 void AIMPManager36::deletePlaylistEntriesFromPlaylistDB(PlaylistID playlist_id)
@@ -639,10 +663,9 @@ void AIMPManager36::loadPlaylist(IAIMPPlaylist* playlist, int playlist_index)
     const int entries_count = playlist->GetItemCount();
 
     { // db code
-    sqlite3_stmt* stmt = createStmt(playlists_db_,
-                                    "REPLACE INTO Playlists VALUES (?,?,?,?,?,?,?)"
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(*playlists_stmt_cache_,
+                          "REPLACE INTO Playlists VALUES (?,?,?,?,?,?,?)"
+                          );
 
 #define bind(type, field_index, value)  rc_db = sqlite3_bind_##type(stmt, field_index, value); \
                                         if (SQLITE_OK != rc_db) { \
@@ -879,9 +902,15 @@ double getDouble(IAIMPPlaylistItem* playlist_item, const int property_id, const
     return value;
 }
 
+crc32_t crc32_text(const IAIMPString_ptr& string)
+{
+    return string && string->GetLength() > 0 ? Utilities::crc32( string->GetData(), string->GetLength() * sizeof(WCHAR) )
+                                              : 0;
+}
+
 } // namespace Support
 
-void AIMPManager36::loadEntries(IAIMPPlaylist* playlist)
+void AIMPManager36::loadEntries(IAIMPPlaylist* playlist, bool entries_info_changed)
 {
     using namespace Support;
     PROFILE_EXECUTION_TIME(__FUNCTION__);
@@ -898,17 +927,18 @@ void AIMPManager36::loadEntries(IAIMPPlaylist* playlist)
 
     const int entries_count = playlist->GetItemCount();
 
-    deletePlaylistEntriesFromPlaylistDB(playlist_id); // remove old entries before adding new ones.
+    Transaction transaction(playlists_db_); // all rows are written at once, on error previous rows are kept.
+
+    PlaylistEntriesSync entries_sync(playlist_id, *playlists_stmt_cache_); // only new and changed entries are written.
 
     PlaylistItems& playlist_items = getPlaylistHelper(playlist).items_;
     playlist_items.clear();
     playlist_items.reserve(entries_count);
 
-    sqlite3_stmt* stmt = createStmt(playlists_db_, "INSERT INTO PlaylistsEntries VALUES (?,?,?,?,?,?,"
-                                                                                        "?,?,?,?,?,"
-                                                                                        "?,?,?,?,?)"
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(*playlists_stmt_cache_, "INSERT OR REPLACE INTO PlaylistsEntries VALUES (?,?,?,?,?,?,"
+                                                                                       "?,?,?,?,?,"
+                                                                                       "?,?,?,?,?)"
+                          );
 
     //BOOST_LOG_SEV(logger(), debug) << "The statement has "
     //                               << sqlite3_bind_parameter_count(stmt)
@@ -928,6 +958,22 @@ void AIMPManager36::loadEntries(IAIMPPlaylist* playlist)
         boost::intrusive_ptr<IAIMPPlaylistItem> item(item_tmp, false); 
         item_tmp = nullptr;
 
+        const int entry_id = castToPlaylistEntryID(item.get());
+        playlist_items.push_back(item); // take ownership to access item later by the same ID.
+
+#ifndef NDEBUG
+        //BOOST_LOG_SEV(logger(), debug) << "index: " << item_index << ", entry_id: " << entry_id;
+#endif
+
+        int row_index;
+        crc32_t entry_crc32;
+        if ( !entries_info_changed && entries_sync.getStoredCrc32(entry_id, &entry_crc32) ) {
+            // entry has been moved only, its stored fields are actual.
+            const bool write_row = entries_sync.addEntry(entry_id, entry_crc32, &row_index);
+            assert(!write_row); (void)write_row;
+            continue;
+        }
+
         IAIMPString_ptr album,
                        artist,
                        date,
@@ -997,13 +1043,27 @@ void AIMPManager36::loadEntries(IAIMPPlaylist* playlist)
             //}
         }
 
-        const int entry_id = castToPlaylistEntryID(item.get());
-
-#ifndef NDEBUG
-        //BOOST_LOG_SEV(logger(), debug) << "index: " << item_index << ", entry_id: " << entry_id;
-#endif
-
+        { // crc32 of all written fields: it is compared with stored one to skip writing of unchanged entry.
+            const crc32_t fields_crc32_list[] = {
+                crc32_text(album),
+                crc32_text(artist),
+                crc32_text(date),
+                crc32_text(fileName),
+                crc32_text(genre),
+                crc32_text(title),
+                Utilities::crc32(bitrate),
+                Utilities::crc32(channels),
+                Utilities::crc32(duration_ms),
+                Utilities::crc32(filesize),
+                Utilities::crc32(rating),
+                Utilities::crc32(samplerate)
+            };
+            entry_crc32 = Utilities::crc32( &fields_crc32_list[0], sizeof(fields_crc32_list) );
+        }
 
+        if ( !entries_sync.addEntry(entry_id, entry_crc32, &row_index) ) {
+            continue; // fields are not changed.
+        }
 
         { // special db code
             // bind all values
@@ -1022,7 +1082,7 @@ void AIMPManager36::loadEntries(IAIMPPlaylist* playlist)
             int rc_db;
             bind(int,    1, playlist_id);
             bind(int,    2, entry_id);
-            bind(int,    3, item_index);
+            bind(int,    3, row_index);
 
             if (album)    { bindText(4, album); }
             if (artist)   { bindText(5, artist); }
@@ -1038,7 +1098,7 @@ void AIMPManager36::loadEntries(IAIMPPlaylist* playlist)
             bind(int64, 13, filesize);
             bind(double,14, rating);
             bind(int,   15, samplerate);
-            bind(int64, 16, crc32(info));
+            bind(int64, 16, entry_crc32);
 #undef bind
 
             rc_db = sqlite3_step(stmt);
@@ -1046,15 +1106,26 @@ void AIMPManager36::loadEntries(IAIMPPlaylist* playlist)
                 const std::string msg = MakeString() << "sqlite3_step() error "
                                                      << rc_db << ": " << sqlite3_errmsg(playlists_db_);
                 throw std::runtime_error(msg);
-            } else {
-                playlist_items.push_back(item); // take ownership to access item later by the same ID.
             }
             sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt); // absent strings of next entry must be null.
         }
     }
 
+    entries_sync.commit();
+    transaction.commit();
+
+    BOOST_LOG_SEV(logger(), debug) << __FUNCTION__": playlist " << playlist_id << ", entries: " << entries_count
+                                   << ", written: " << entries_sync.writtenRowsCount() << ", renumbered: " << entries_sync.movedRowsCount();
+
     // sort entry ids to use binary search later
     std::sort(playlist_items.begin(), playlist_items.end());
+
+    { // keep changes for clients which sync playlist by delta, see PlaylistChangeLog.
+        PlaylistEntriesState entries_state;
+        entries_sync.takeEntriesState(&entries_state);
+        playlist_change_log_.recordEntriesState(playlist_id, &entries_state);
+    }
 }
 
 int AIMPManager36::getPlaylistIndexByHandle(IAIMPPlaylist* playlist)
@@ -1915,13 +1986,14 @@ void AIMPManager36::setStatus(AIMPManager::STATUS status, AIMPManager::StatusVal
 void AIMPManager36::reloadQueuedEntries()
 {
     // PROFILE_EXECUTION_TIME(__FUNCTION__);
+    Transaction transaction(playlists_db_); // all rows are written at once, on error previous rows are kept.
+
     deleteQueuedEntriesFromPlaylistDB(); // remove old entries before adding new ones.
 
-    sqlite3_stmt* stmt = createStmt(playlists_db_, "INSERT INTO QueuedEntries VALUES (?,?,?,?,?,"
-                                                                                     "?,?,?,?,?,"
-                                                                                     "?,?,?,?,?)"
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(*playlists_stmt_cache_, "INSERT INTO QueuedEntries VALUES (?,?,?,?,?,"
+                                                                                    "?,?,?,?,?,"
+                                                                                    "?,?,?,?,?)"
+                          );
 
     const char * const error_prefix = "Error occured while extracting playlist queue item data: ";
 
@@ -2032,6 +2104,8 @@ void AIMPManager36::reloadQueuedEntries()
             sqlite3_reset(stmt);
         }
     }
+
+    transaction.commit();
 }
 
 void AIMPManager36::deleteQueuedEntriesFromPlaylistDB()
@@ -2047,15 +2121,18 @@ TrackDescription AIMPManager36::getTrackDescOfQueuedEntry(AIMP36SDK::IAIMPPlayli
     const PlaylistEntryID entry_id = castToPlaylistEntryID(item);
 
     // find playlist id.
-    const std::string& query = MakeString() << "SELECT playlist_id FROM PlaylistsEntries "
-                                            << "WHERE entry_id = " << entry_id;
+    const char * const query = "SELECT playlist_id FROM PlaylistsEntries WHERE entry_id=?";
 
     sqlite3* playlists_db = playlists_db_;
-    sqlite3_stmt* stmt = createStmt( playlists_db, query.c_str() );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(*playlists_stmt_cache_, query); // called for each queued entry, so statement is reused.
+
+    int rc_db = sqlite3_bind_int(stmt, 1, entry_id);
+    if (SQLITE_OK != rc_db) {
+        throw std::runtime_error(MakeString() << "Error sqlite3_bind_int " << rc_db);
+    }
 
     for(;;) {
-		int rc_db = sqlite3_step(stmt);
+		rc_db = sqlite3_step(stmt);
         if (SQLITE_ROW == rc_db) {
             int playlist_id = sqlite3_column_int(stmt, 0);
             return TrackDescription(playlist_id, entry_id);
@@ -2214,10 +2291,9 @@ crc32_t AIMPManager36::getPlaylistCRC32(PlaylistID playlist_id) const
 
 void AIMPManager36::updatePlaylistCrcInDB(PlaylistID playlist_id, crc32_t crc32)
 {
-    sqlite3_stmt* stmt = createStmt(playlists_db_,
-                                    "UPDATE Playlists SET crc32=? WHERE id=?"
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(*playlists_stmt_cache_,
+                          "UPDATE Playlists SET crc32=? WHERE id=?"
+                          );
 
 #define bind(type, field_index, value)  rc_db = sqlite3_bind_##type(stmt, field_index, value); \
                                         if (SQLITE_OK != rc_db) { \
@@ -2236,6 +2312,8 @@ void AIMPManager36::updatePlaylistCrcInDB(PlaylistID playlist_id, crc32_t crc32)
                                              << rc_db << ": " << sqlite3_errmsg(playlists_db_);
         throw std::runtime_error(msg);
     }
+
+    playlist_change_log_.commitVersion(playlist_id, crc32);
 }
 
 AIMPManager::PLAYLIST_ENTRY_SOURCE_TYPE AIMPManager36::getTrackSourceType(TrackDescription track_desc) const
@@ -6,10 +6,12 @@
 #include "aimp3.60_sdk/aimp3_60_sdk.h"
 #include "aimp3.60_sdk/Helpers/typedefs.h"
 #include "utils/util.h"
+#include "utils/sqlite_stmt_cache.h"
 #include "playlist_queue.h"
 #include "playlist_entry_rating.h"
 #include "playlist_update_manager.h"
 #include "player_supported_formats_getter.h"
+#include "playlist_change_log.h"
 
 namespace AimpRpcMethods {
     class EmulationOfWebCtlPlugin;
@@ -247,6 +249,14 @@ public:
     sqlite3* playlists_db() const
         { return playlists_db_; }
 
+    //! Cache of prepared statements of playlists_db().
+    Utilities::StmtCache& playlists_stmt_cache()
+        { return *playlists_stmt_cache_; }
+
+    //! Returns log of playlists entries changes, see GetPlaylistEntriesDelta RPC method.
+    const PlaylistChangeLog& playlistChangeLog() const
+        { return playlist_change_log_; }
+
     // Returns nullptr if item does not exist.
     AIMP36SDK::IAIMPPlaylistItem_ptr getPlaylistItem(PlaylistEntryID id) const;
     AIMP36SDK::IAIMPPlaylistItem_ptr getPlaylistItem(PlaylistEntryID id);
@@ -259,8 +269,11 @@ public:
 protected:
     
     sqlite3* playlists_db_;
+    std::unique_ptr<Utilities::StmtCache> playlists_stmt_cache_; //!< created and destroyed with playlists_db_.
 
 private:
+
+    PlaylistChangeLog playlist_change_log_; //!< maintained by loadEntries() and updatePlaylistCrcInDB().
     
     void initializeAIMPObjects();
     
@@ -274,7 +287,11 @@ private:
     // Returns -1 if handle not found in playlists list.
     int getPlaylistIndexByHandle(AIMP36SDK::IAIMPPlaylist* playlist);
     void loadPlaylist(AIMP36SDK::IAIMPPlaylist* playlist, int playlist_index);
-    void loadEntries(AIMP36SDK::IAIMPPlaylist* playlist); // throws std::runtime_error
+    /*!
+        \brief Synchronizes PlaylistsEntries rows with entries of playlist, see PlaylistEntriesSync.
+        \param entries_info_changed - if false fields of entries which are already stored are not read from AIMP.
+    */
+    void loadEntries(AIMP36SDK::IAIMPPlaylist* playlist, bool entries_info_changed); // throws std::runtime_error
     void handlePlaylistChange(AIMP36SDK::IAIMPPlaylist* playlist, DWORD flags);
     void handlePlaylistUpdateTimer(AIMP36SDK::IAIMPPlaylist_ptr playlist, const boost::system::error_code& e);
 
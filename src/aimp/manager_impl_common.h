@@ -75,26 +75,28 @@ inline const char* asString(AIMPManager::STATUS status)
     return status_string.c_str();
 }
 
-inline size_t getEntriesCountDB(PlaylistID playlist_id, sqlite3* playlists_db)
+inline size_t getEntriesCountDB(PlaylistID playlist_id, Utilities::StmtCache& stmt_cache)
 {
     using namespace Utilities;
 
-    std::ostringstream query;
-    query << "SELECT COUNT(*) FROM PlaylistsEntries WHERE playlist_id=" << playlist_id;
+    const char * const query = "SELECT COUNT(*) FROM PlaylistsEntries WHERE playlist_id=?";
+    StmtCache::Lease stmt(stmt_cache, query);
 
-    sqlite3_stmt* stmt = createStmt( playlists_db, query.str() );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    int rc_db = sqlite3_bind_int(stmt, 1, playlist_id);
+    if (SQLITE_OK != rc_db) {
+        throw std::runtime_error(MakeString() << "Error sqlite3_bind_int " << rc_db);
+    }
 
     size_t total_entries_count = 0;
 
-	const int rc_db = sqlite3_step(stmt);
+	rc_db = sqlite3_step(stmt);
     if (SQLITE_ROW == rc_db) {
         assert(sqlite3_column_count(stmt) > 0);
         total_entries_count = sqlite3_column_int(stmt, 0);
     } else {
         const std::string msg = MakeString() << "sqlite3_step() error "
-                                             << rc_db << ": " << sqlite3_errmsg(playlists_db)
-                                             << ". Query: " << query.str();
+                                             << rc_db << ": " << sqlite3_errmsg( stmt_cache.db() )
+                                             << ". Query: " << query;
         throw std::runtime_error(msg);
     }
 
@@ -115,4 +117,28 @@ inline sqlite3* getPlaylistsDB(const AIMPPlayer::AIMPManager& aimp_manager) {
     }
 }
 
+inline Utilities::StmtCache& getPlaylistsStmtCache(AIMPPlayer::AIMPManager& aimp_manager) {
+    if (       AIMPPlayer::AIMPManager30* mgr3 = dynamic_cast<AIMPPlayer::AIMPManager30*>(&aimp_manager) ) {
+        return mgr3->playlists_stmt_cache();
+    } else if (AIMPPlayer::AIMPManager36* mgr36 = dynamic_cast<AIMPPlayer::AIMPManager36*>(&aimp_manager) ) {
+        return mgr36->playlists_stmt_cache();
+    } else if (AIMPPlayer::AIMPManager26* mgr2 = dynamic_cast<AIMPPlayer::AIMPManager26*>(&aimp_manager) ) {
+        return mgr2->playlists_stmt_cache();
+    } else {
+        using namespace Utilities;
+        const std::string msg = MakeString() << __FUNCTION__ ": invalid AIMPManager object. AIMPManager36, AIMPManager30 and AIMPManager26 are only supported.";
+        throw std::runtime_error(msg);
+    }
+}
+
+//! Returns nullptr if manager does not keep playlist change log(AIMP 2.6).
+inline const PlaylistChangeLog* getPlaylistChangeLog(const AIMPPlayer::AIMPManager& aimp_manager) {
+    if (       const AIMPPlayer::AIMPManager30* mgr3 = dynamic_cast<const AIMPPlayer::AIMPManager30*>(&aimp_manager) ) {
+        return &mgr3->playlistChangeLog();
+    } else if (const AIMPPlayer::AIMPManager36* mgr36 = dynamic_cast<const AIMPPlayer::AIMPManager36*>(&aimp_manager) ) {
+        return &mgr36->playlistChangeLog();
+    }
+    return nullptr;
+}
+
 } // namespace AIMPPlayer
@@ -117,7 +117,7 @@ crc32_t PlaylistCRC32::calc_crc32_entries()
 
 crc32_t crc32_entry(sqlite3_stmt* stmt)
 {
-    assert(sqlite3_column_count(stmt) == 12);
+    assert(sqlite3_column_count(stmt) >= 12); // columns after entry fields are ignored.
 
     using namespace Utilities;
     const crc32_t members_crc32_list [] = {
@@ -0,0 +1,208 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "aimp/playlist_change_log.h"
+#include <algorithm>
+
+namespace AIMPPlayer
+{
+
+void PlaylistEntriesDelta::append(const PlaylistEntriesDelta& next)
+{
+    // removals of next delta precede its insertions since id of removed entry can be reused.
+    for (auto id : next.removed) {
+        updated.erase(id);
+        moved.erase(id);
+        if (inserted.erase(id) == 0) {
+            removed.insert(id);
+        }
+    }
+
+    // entry which was removed and inserted again stays in both sets: client removes old entry before inserting new one.
+    inserted.insert( next.inserted.begin(), next.inserted.end() );
+
+    // changes of inserted entries are not interesting for client, it will get their current state anyway.
+    for (auto id : next.updated) {
+        if ( inserted.find(id) == inserted.end() ) {
+            updated.insert(id);
+        }
+    }
+    for (auto id : next.moved) {
+        if ( inserted.find(id) == inserted.end() ) {
+            moved.insert(id);
+        }
+    }
+}
+
+namespace
+{
+
+/*!
+    Returns indices of elements of sequence which form its longest increasing subsequence.
+    Patience sorting, O(N*log(N)).
+*/
+std::vector<std::size_t> longestIncreasingSubsequence(const std::vector<std::size_t>& sequence)
+{
+    std::vector<std::size_t> tails; // tails[k] - index of the smallest tail of increasing subsequences with length k+1.
+    std::vector<std::size_t> predecessors( sequence.size() );
+
+    for (std::size_t i = 0, size = sequence.size(); i != size; ++i) {
+        // binary search of the first tail which is not less than current element.
+        std::size_t low = 0,
+                    high = tails.size();
+        while (low < high) {
+            const std::size_t middle = (low + high) / 2;
+            if (sequence[ tails[middle] ] < sequence[i]) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        predecessors[i] = low > 0 ? tails[low - 1] : i;
+        if ( low == tails.size() ) {
+            tails.push_back(i);
+        } else {
+            tails[low] = i;
+        }
+    }
+
+    std::vector<std::size_t> result( tails.size() );
+    if ( !tails.empty() ) {
+        std::size_t i = tails.back();
+        for (std::size_t k = tails.size(); k != 0; --k) {
+            result[k - 1] = i;
+            i = predecessors[i];
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+PlaylistEntriesDelta PlaylistEntriesDelta::diff(const PlaylistEntriesState& old_state, const PlaylistEntriesState& new_state)
+{
+    typedef std::map<PlaylistEntryID, std::size_t> EntryIndices;
+    EntryIndices old_indices;
+    for (std::size_t i = 0, size = old_state.size(); i != size; ++i) {
+        old_indices[ old_state[i].id ] = i;
+    }
+
+    PlaylistEntriesDelta delta;
+
+    // old indices of entries which exist in both states, in order of new state.
+    std::vector<std::size_t> kept_old_indices;
+    kept_old_indices.reserve( std::min( old_state.size(), new_state.size() ) );
+
+    for (const auto& entry : new_state) {
+        EntryIndices::iterator it = old_indices.find(entry.id);
+        if ( it == old_indices.end() ) {
+            delta.inserted.insert(entry.id);
+        } else {
+            const PlaylistEntryState& old_entry = old_state[it->second];
+            if (old_entry.crc32 != entry.crc32) {
+                delta.updated.insert(entry.id);
+            }
+            kept_old_indices.push_back(it->second);
+            old_indices.erase(it);
+        }
+    }
+
+    for (const auto& removed_entry : old_indices) {
+        delta.removed.insert(removed_entry.first);
+    }
+
+    // entries out of the longest increasing subsequence of old indices are moved.
+    const std::vector<std::size_t> not_moved = longestIncreasingSubsequence(kept_old_indices);
+    std::vector<std::size_t>::const_iterator not_moved_it = not_moved.begin();
+    for (std::size_t i = 0, size = kept_old_indices.size(); i != size; ++i) {
+        if ( not_moved_it != not_moved.end() && *not_moved_it == i ) {
+            ++not_moved_it;
+        } else {
+            delta.moved.insert( old_state[ kept_old_indices[i] ].id );
+        }
+    }
+
+    return delta;
+}
+
+PlaylistChangeLog::PlaylistChangeLog(std::size_t max_versions_count)
+    :
+    max_versions_count_(max_versions_count)
+{
+    assert(max_versions_count_ > 0);
+}
+
+void PlaylistChangeLog::recordEntriesState(PlaylistID playlist_id, PlaylistEntriesState* state)
+{
+    assert(state);
+
+    PlaylistLog& log = logs_[playlist_id];
+    if (log.entries_state_known) {
+        log.uncommitted_delta.append( PlaylistEntriesDelta::diff(log.entries_state, *state) );
+    }
+    log.entries_state.swap(*state);
+    log.entries_state_known = true;
+}
+
+void PlaylistChangeLog::commitVersion(PlaylistID playlist_id, crc32_t crc32)
+{
+    PlaylistLog& log = logs_[playlist_id];
+    if ( !log.versions.empty() && log.versions.back().crc32 == crc32 && log.uncommitted_delta.empty() ) {
+        return; // nothing changed.
+    }
+
+    log.versions.push_back( Version() );
+    Version& version = log.versions.back();
+    version.crc32 = crc32;
+    std::swap(version.delta, log.uncommitted_delta);
+
+    while (log.versions.size() > max_versions_count_) {
+        log.versions.pop_front();
+    }
+}
+
+void PlaylistChangeLog::removePlaylist(PlaylistID playlist_id)
+{
+    logs_.erase(playlist_id);
+}
+
+bool PlaylistChangeLog::getDelta(PlaylistID playlist_id, crc32_t since_crc32, PlaylistEntriesDelta* delta) const
+{
+    assert(delta);
+
+    PlaylistLogs::const_iterator log_it = logs_.find(playlist_id);
+    if ( log_it == logs_.end() ) {
+        return false;
+    }
+
+    const PlaylistLog& log = log_it->second;
+    if ( !log.uncommitted_delta.empty() ) {
+        return false; // current state is not visible to clients yet.
+    }
+
+    // crc32 does not depend on entry ids, so the same crc32 of different versions can't identify client's state.
+    const Versions& versions = log.versions;
+    Versions::const_iterator since_it = versions.end();
+    for (Versions::const_iterator it = versions.begin(), end = versions.end(); it != end; ++it) {
+        if (it->crc32 == since_crc32) {
+            if ( since_it != versions.end() ) {
+                return false;
+            }
+            since_it = it;
+        }
+    }
+
+    if ( since_it == versions.end() ) {
+        return false;
+    }
+
+    PlaylistEntriesDelta result;
+    for (Versions::const_iterator it = since_it + 1, end = versions.end(); it != end; ++it) {
+        result.append(it->delta);
+    }
+    std::swap(*delta, result);
+    return true;
+}
+
+} // namespace AIMPPlayer
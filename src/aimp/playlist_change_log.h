@@ -0,0 +1,119 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include "common_types.h"
+#include "utils/util.h"
+#include <deque>
+#include <set>
+#include <boost/noncopyable.hpp>
+
+namespace AIMPPlayer
+{
+
+//! Entry of playlist as change log sees it: id and checksum of entry fields.
+struct PlaylistEntryState
+{
+    PlaylistEntryState(PlaylistEntryID id, crc32_t crc32)
+        : id(id), crc32(crc32)
+    {}
+
+    PlaylistEntryID id;
+    crc32_t crc32;
+};
+
+//! Entries of playlist in order of their indices. See PlaylistEntriesSync.
+typedef std::vector<PlaylistEntryState> PlaylistEntriesState;
+
+typedef std::set<PlaylistEntryID> PlaylistEntryIDs;
+
+//! Count of playlist versions change log keeps by default.
+const std::size_t kPLAYLIST_CHANGE_LOG_MAX_VERSIONS_COUNT = 32;
+
+/*!
+    \brief Changes of playlist entries between two states.
+           Client applies delta this way: drops removed entries, drops and reinserts moved entries at their current indices,
+           inserts inserted entries at their current indices and refreshes fields of updated ones.
+           Entries which are not mentioned in delta keep their relative order.
+*/
+struct PlaylistEntriesDelta
+{
+    PlaylistEntryIDs inserted,
+                     removed,
+                     updated, //!< entries whose fields have been changed.
+                     moved;   //!< entries whose relative order with other entries has been changed.
+
+    bool empty() const
+        { return inserted.empty() && removed.empty() && updated.empty() && moved.empty(); }
+
+    //! Extends delta by changes which occurred after it.
+    void append(const PlaylistEntriesDelta& next);
+
+    /*!
+        \brief Returns changes between two entries states.
+               Set of moved entries is minimal: entries which form the longest common subsequence of old and new states are not moved.
+    */
+    static PlaylistEntriesDelta diff(const PlaylistEntriesState& old_state, const PlaylistEntriesState& new_state);
+};
+
+/*!
+    \brief Per playlist log of entries changes.
+           Playlist loaders record entries state after each reload, managers commit version of playlist when its new crc32 becomes visible to clients.
+           Client which knows crc32 of playlist gets delta between its version and current one instead of whole playlist.
+           Count of versions kept per playlist is limited, oldest versions are dropped first.
+           Not thread safe: it is used in player thread only.
+*/
+class PlaylistChangeLog : boost::noncopyable
+{
+public:
+
+    explicit PlaylistChangeLog(std::size_t max_versions_count);
+
+    /*!
+        \brief Stores current entries state of playlist and accumulates difference with previous one until commitVersion() call.
+               State is taken by swap.
+    */
+    void recordEntriesState(PlaylistID playlist_id, PlaylistEntriesState* state);
+
+    //! Marks current state of playlist by crc32 which clients see.
+    void commitVersion(PlaylistID playlist_id, crc32_t crc32);
+
+    //! Forgets all versions of playlist. Called when playlist is removed.
+    void removePlaylist(PlaylistID playlist_id);
+
+    /*!
+        \brief Fills delta between version of playlist marked by since_crc32 and current state.
+        \return false if delta is unknown: version has been dropped from log, was never committed or crc32 is ambiguous.
+                Client should reload whole playlist in this case.
+    */
+    bool getDelta(PlaylistID playlist_id, crc32_t since_crc32, PlaylistEntriesDelta* delta) const;
+
+private:
+
+    struct Version
+    {
+        crc32_t crc32;
+        PlaylistEntriesDelta delta; //!< changes since previous version.
+    };
+
+    typedef std::deque<Version> Versions;
+
+    struct PlaylistLog
+    {
+        PlaylistLog()
+            : entries_state_known(false)
+        {}
+
+        PlaylistEntriesState entries_state;
+        bool entries_state_known;
+        PlaylistEntriesDelta uncommitted_delta; //!< changes since last committed version.
+        Versions versions; //!< committed versions, latest at back.
+    };
+
+    typedef std::map<PlaylistID, PlaylistLog> PlaylistLogs;
+
+    const std::size_t max_versions_count_;
+    PlaylistLogs logs_;
+};
+
+} // namespace AIMPPlayer
@@ -0,0 +1,201 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "aimp/playlist_entries_sync.h"
+#include "utils/sqlite_util.h"
+#include "utils/sqlite_stmt_cache.h"
+#include <algorithm>
+
+namespace AIMPPlayer
+{
+
+using namespace Utilities;
+
+namespace
+{
+
+//! Executes statement which does not return rows and resets it for next use.
+void stepStmt(sqlite3_stmt* stmt, sqlite3* db, const char* log_tag)
+{
+    const int rc_db = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (SQLITE_DONE != rc_db) {
+        const std::string msg = MakeString() << log_tag << ": sqlite3_step() error "
+                                             << rc_db << ": " << sqlite3_errmsg(db);
+        throw std::runtime_error(msg);
+    }
+}
+
+void bindInt(sqlite3_stmt* stmt, int index, int value)
+{
+    const int rc_db = sqlite3_bind_int(stmt, index, value);
+    if (SQLITE_OK != rc_db) {
+        throw std::runtime_error(MakeString() << "Error sqlite3_bind_int " << rc_db);
+    }
+}
+
+} // namespace
+
+PlaylistEntriesSync::PlaylistEntriesSync(PlaylistID playlist_id, StmtCache& stmt_cache)
+    :
+    playlist_id_(playlist_id),
+    stmt_cache_(stmt_cache),
+    playlists_db_( stmt_cache.db() ),
+    kept_rows_count_(0),
+    written_rows_count_(0),
+    moved_rows_count_(0)
+{
+    const char * const query = "SELECT entry_id, entry_index, crc32 FROM PlaylistsEntries WHERE playlist_id=? ORDER BY entry_id";
+
+    StmtCache::Lease stmt(stmt_cache_, query);
+    bindInt(stmt, 1, playlist_id_);
+
+    for(;;) {
+        const int rc_db = sqlite3_step(stmt);
+        if (SQLITE_ROW == rc_db) {
+            const StoredEntry entry = { sqlite3_column_int(stmt, 0),
+                                        sqlite3_column_int(stmt, 1),
+                                        static_cast<crc32_t>( sqlite3_column_int64(stmt, 2) ),
+                                        false
+                                      };
+            stored_entries_.push_back(entry);
+        } else if (SQLITE_DONE == rc_db) {
+            break;
+        } else {
+            const std::string msg = MakeString() << "sqlite3_step() error "
+                                                 << rc_db << ": " << sqlite3_errmsg(playlists_db_)
+                                                 << ". Query: " << query;
+            throw std::runtime_error(msg);
+        }
+    }
+
+    kept_rows_.reserve( stored_entries_.size() );
+    entries_state_.reserve( stored_entries_.size() );
+}
+
+PlaylistEntriesSync::StoredEntries::iterator PlaylistEntriesSync::findStoredEntry(PlaylistEntryID entry_id)
+{
+    const StoredEntries::iterator it = std::lower_bound(stored_entries_.begin(), stored_entries_.end(), entry_id,
+                                                        [](const StoredEntry& entry, PlaylistEntryID id) { return entry.id < id; }
+                                                        );
+    return it != stored_entries_.end() && it->id == entry_id ? it
+                                                             : stored_entries_.end();
+}
+
+PlaylistEntriesSync::StoredEntries::const_iterator PlaylistEntriesSync::findStoredEntry(PlaylistEntryID entry_id) const
+{
+    return const_cast<PlaylistEntriesSync*>(this)->findStoredEntry(entry_id);
+}
+
+bool PlaylistEntriesSync::getStoredCrc32(PlaylistEntryID entry_id, crc32_t* crc32) const
+{
+    assert(crc32);
+
+    const StoredEntries::const_iterator it = findStoredEntry(entry_id);
+    if ( it == stored_entries_.end() ) {
+        return false;
+    }
+    *crc32 = it->crc32;
+    return true;
+}
+
+bool PlaylistEntriesSync::addEntry(PlaylistEntryID entry_id, crc32_t crc32, int* row_index)
+{
+    assert(row_index);
+
+    const int index = static_cast<int>( entries_state_.size() );
+    entries_state_.push_back( PlaylistEntryState(entry_id, crc32) );
+
+    const StoredEntries::iterator it = findStoredEntry(entry_id);
+    if ( it != stored_entries_.end() ) {
+        assert(!it->kept && "entry is added twice");
+        it->kept = true;
+        ++kept_rows_count_;
+        if (it->crc32 == crc32) {
+            kept_rows_.push_back( Move(it->index, index) );
+            return false;
+        }
+    }
+
+    *row_index = -1 - index; // see commit().
+    ++written_rows_count_;
+    return true;
+}
+
+void PlaylistEntriesSync::commit()
+{
+    deleteRemovedRows();
+    renumberKeptRows();
+}
+
+void PlaylistEntriesSync::deleteRemovedRows()
+{
+    if (kept_rows_count_ == stored_entries_.size()) {
+        return;
+    }
+
+    if (kept_rows_count_ == 0) {
+        // whole playlist has been replaced: remove all old rows at once, written rows have negative indices.
+        StmtCache::Lease stmt(stmt_cache_, "DELETE FROM PlaylistsEntries WHERE playlist_id=? AND entry_index>=0");
+        bindInt(stmt, 1, playlist_id_);
+        stepStmt(stmt, playlists_db_, __FUNCTION__);
+        return;
+    }
+
+    StmtCache::Lease stmt(stmt_cache_, "DELETE FROM PlaylistsEntries WHERE playlist_id=? AND entry_id=?");
+
+    bindInt(stmt, 1, playlist_id_);
+    for (auto it = stored_entries_.begin(), end = stored_entries_.end(); it != end; ++it) {
+        if (!it->kept) {
+            bindInt(stmt, 2, it->id);
+            stepStmt(stmt, playlists_db_, __FUNCTION__);
+        }
+    }
+}
+
+void PlaylistEntriesSync::renumberKeptRows()
+{
+    // Unchanged rows form runs of consecutive old indices which are shifted by the same offset.
+    // Each run is moved by single query to negative index space first: -1 - new index,
+    // so moved rows are not matched by queries of other runs which select rows by old indices.
+    StmtCache::Lease stmt(stmt_cache_, "UPDATE PlaylistsEntries SET entry_index=?-entry_index WHERE playlist_id=? AND entry_index BETWEEN ? AND ?");
+    bindInt(stmt, 2, playlist_id_);
+
+    bool negative_indices_exist = written_rows_count_ != 0;
+    for (Moves::const_iterator run_begin = kept_rows_.begin(), end = kept_rows_.end(); run_begin != end; ) {
+        const int offset = run_begin->new_index - run_begin->old_index;
+        Moves::const_iterator run_end = run_begin + 1;
+        while (   run_end != end
+               && run_end->old_index == (run_end - 1)->old_index + 1
+               && run_end->new_index - run_end->old_index == offset
+               )
+        {
+            ++run_end;
+        }
+
+        if (offset != 0) {
+            bindInt(stmt, 1, -1 - offset); // -1 - (old index + offset)
+            bindInt(stmt, 3, run_begin->old_index);
+            bindInt(stmt, 4, (run_end - 1)->old_index);
+            stepStmt(stmt, playlists_db_, __FUNCTION__);
+
+            moved_rows_count_ += run_end - run_begin;
+            negative_indices_exist = true;
+        }
+        run_begin = run_end;
+    }
+
+    if (negative_indices_exist) {
+        StmtCache::Lease finish_stmt(stmt_cache_, "UPDATE PlaylistsEntries SET entry_index=-1-entry_index WHERE playlist_id=? AND entry_index<0");
+        bindInt(finish_stmt, 1, playlist_id_);
+        stepStmt(finish_stmt, playlists_db_, __FUNCTION__);
+    }
+}
+
+void PlaylistEntriesSync::takeEntriesState(PlaylistEntriesState* state)
+{
+    assert(state);
+    state->swap(entries_state_);
+}
+
+} // namespace AIMPPlayer
@@ -0,0 +1,108 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include "aimp/playlist_change_log.h"
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+struct sqlite3;
+namespace Utilities { class StmtCache; }
+
+namespace AIMPPlayer
+{
+
+/*!
+    \brief Synchronizes PlaylistsEntries rows of playlist with entries list of player instead of rewriting all rows.
+           Loader walks through entries of playlist in order and passes id and crc32 of fields of each entry to addEntry().
+           Only rows of new and changed entries are written by loader, rows of removed entries are deleted
+           and indices of kept rows are renumbered by ranges in commit(): entries which keep their relative order are shifted by single query.
+
+           Written rows get temporary negative index returned by addEntry(), so they are not touched by renumbering of kept rows.
+           commit() sets actual indices of all rows.
+
+           crc32 of entry is stored in crc32 column. Loader calculates it from fields it writes,
+           so the same value is produced for unchanged entry on each load.
+*/
+class PlaylistEntriesSync : boost::noncopyable
+{
+public:
+
+    //! Loads ids, indices and crc32 of stored entries of playlist. Statements are taken from cache of playlists database.
+    PlaylistEntriesSync(PlaylistID playlist_id, Utilities::StmtCache& stmt_cache); // throws std::runtime_error
+
+    /*!
+        \brief Returns stored crc32 of entry.
+               Loader uses it to skip reading fields of known entries when player reports that only list of entries has been changed.
+               It is valid only if id of removed entry can't be given to another track: AIMP 3.6 loader holds references to entries,
+               AIMP 3.0 handles can be reused, so its loader always reads fields.
+        \return false if entry is not stored.
+    */
+    bool getStoredCrc32(PlaylistEntryID entry_id, crc32_t* crc32) const;
+
+    /*!
+        \brief Registers entry which follows previously added one.
+        \param row_index - entry_index value to write, valid if method returns true.
+        \return true if row of entry must be written(INSERT OR REPLACE): entry is new or its fields have been changed.
+    */
+    bool addEntry(PlaylistEntryID entry_id, crc32_t crc32, int* row_index);
+
+    /*!
+        \brief Deletes rows of removed entries and sets actual indices of all rows. Called after all entries are added.
+        \throw std::runtime_error if query fails.
+    */
+    void commit();
+
+    //! Returns entries state of playlist for PlaylistChangeLog. State is taken by swap.
+    void takeEntriesState(PlaylistEntriesState* state);
+
+    //! Returns count of rows which have been written by loader and which have been renumbered by commit(). Used for profiling.
+    std::size_t writtenRowsCount() const
+        { return written_rows_count_; }
+    std::size_t movedRowsCount() const
+        { return moved_rows_count_; }
+
+private:
+
+    struct StoredEntry
+    {
+        PlaylistEntryID id;
+        int index;
+        crc32_t crc32;
+        bool kept;
+    };
+
+    typedef std::vector<StoredEntry> StoredEntries;
+
+    //! Kept row with unchanged fields: its old and new indices.
+    struct Move
+    {
+        Move(int old_index, int new_index)
+            : old_index(old_index), new_index(new_index)
+        {}
+
+        int old_index;
+        int new_index;
+    };
+
+    typedef std::vector<Move> Moves;
+
+    StoredEntries::iterator findStoredEntry(PlaylistEntryID entry_id);
+    StoredEntries::const_iterator findStoredEntry(PlaylistEntryID entry_id) const;
+
+    void deleteRemovedRows();
+    void renumberKeptRows();
+
+    const PlaylistID playlist_id_;
+    Utilities::StmtCache& stmt_cache_;
+    sqlite3* const playlists_db_;
+
+    StoredEntries stored_entries_; //!< sorted by id.
+    Moves kept_rows_; //!< in order of new indices.
+    PlaylistEntriesState entries_state_;
+    std::size_t kept_rows_count_;
+    std::size_t written_rows_count_;
+    std::size_t moved_rows_count_;
+};
+
+} // namespace AIMPPlayer
@@ -0,0 +1,146 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "aimp/playlists_entries_indexes.h"
+#include "utils/sqlite_util.h"
+#include <algorithm>
+#include <iterator>
+
+namespace AIMPPlayer
+{
+
+using namespace Utilities;
+
+namespace
+{
+
+//! Fields of PlaylistsEntries available for ordering in GetPlaylistEntries, except id.
+const char * const kORDER_FIELDS[] = { "title", "artist", "album", "date", "genre",
+                                       "bitrate", "duration", "filesize", "rating"
+                                     };
+
+void executeQuery(sqlite3* db, const std::string& query) // throws std::runtime_error
+{
+    char* errmsg = nullptr;
+    ON_BLOCK_EXIT( &sqlite3_free, ByRef(errmsg) );
+    const int rc_db = sqlite3_exec(db, query.c_str(), nullptr, nullptr, &errmsg);
+    if (SQLITE_OK != rc_db) {
+        throw std::runtime_error(MakeString() << "sqlite3_exec() error " << rc_db << ": " << (errmsg ? errmsg : "")
+                                              << ". Query: " << query);
+    }
+}
+
+//! Fields of PlaylistsEntries which are searched by GetPlaylistEntries.
+const char * const kSEARCH_FIELDS = "title, artist, album, date, genre";
+
+const std::size_t kMIN_SEARCH_PREFIX_LENGTH = 3;
+
+//! Returns count of characters in UTF-8 string.
+std::size_t utf8Length(const std::string& str)
+{
+    std::size_t length = 0;
+    for (auto c : str) {
+        if ((c & 0xC0) != 0x80) { // skip continuation bytes.
+            ++length;
+        }
+    }
+    return length;
+}
+
+} // namespace
+
+void createPlaylistsEntriesIndexes(sqlite3* playlists_db)
+{
+    executeQuery(playlists_db, "CREATE INDEX PlaylistsEntries_playlist_id_entry_index ON PlaylistsEntries (playlist_id, entry_index)");
+}
+
+bool preparePlaylistsEntriesOrderIndex(sqlite3* playlists_db, const std::string& field)
+{
+    if ( std::find( std::begin(kORDER_FIELDS), std::end(kORDER_FIELDS), field ) == std::end(kORDER_FIELDS) ) {
+        return false;
+    }
+
+    const std::string index_name = "PlaylistsEntries_playlist_id_" + field;
+    if (getRowsCount(playlists_db, MakeString() << "SELECT 1 FROM sqlite_master WHERE type='index' AND name='" << index_name << "'") != 0) {
+        return true;
+    }
+
+    executeQuery(playlists_db, MakeString() << "CREATE INDEX " << index_name << " ON PlaylistsEntries (playlist_id, " << field << ")");
+    return true;
+}
+
+bool preparePlaylistsEntriesSearchIndex(sqlite3* playlists_db)
+{
+    if (getRowsCount(playlists_db, "SELECT 1 FROM sqlite_master WHERE type='table' AND name='PlaylistsEntriesSearch'") != 0) {
+        return true;
+    }
+
+    Transaction transaction(playlists_db);
+
+    try {
+        executeQuery(playlists_db, MakeString() << "CREATE VIRTUAL TABLE PlaylistsEntriesSearch USING fts4(" << kSEARCH_FIELDS << ", tokenize=unicode61)");
+    } catch (std::runtime_error&) {
+        return false; // FTS4 or unicode61 tokenizer is not compiled in.
+    }
+
+    executeQuery(playlists_db, MakeString() << "INSERT INTO PlaylistsEntriesSearch (docid, " << kSEARCH_FIELDS << ") "
+                                               "SELECT entry_id, " << kSEARCH_FIELDS << " FROM PlaylistsEntries"
+                 );
+
+    // INSERT OR REPLACE of PlaylistsEntries row does not fire delete trigger for replaced row, so insert trigger removes old index row itself.
+    executeQuery(playlists_db, MakeString() << "CREATE TRIGGER PlaylistsEntriesSearch_insert AFTER INSERT ON PlaylistsEntries BEGIN "
+                                                   "DELETE FROM PlaylistsEntriesSearch WHERE docid=new.entry_id; "
+                                                   "INSERT INTO PlaylistsEntriesSearch (docid, " << kSEARCH_FIELDS << ") "
+                                                   "VALUES (new.entry_id, new.title, new.artist, new.album, new.date, new.genre); "
+                                               "END"
+                 );
+    executeQuery(playlists_db, MakeString() << "CREATE TRIGGER PlaylistsEntriesSearch_update AFTER UPDATE OF " << kSEARCH_FIELDS << " ON PlaylistsEntries BEGIN "
+                                                   "UPDATE PlaylistsEntriesSearch SET title=new.title, artist=new.artist, album=new.album, date=new.date, genre=new.genre "
+                                                   "WHERE docid=new.entry_id; "
+                                               "END"
+                 );
+    executeQuery(playlists_db, "CREATE TRIGGER PlaylistsEntriesSearch_delete AFTER DELETE ON PlaylistsEntries BEGIN "
+                                   "DELETE FROM PlaylistsEntriesSearch WHERE docid=old.entry_id; "
+                               "END"
+                 );
+
+    transaction.commit();
+    return true;
+}
+
+std::string makePlaylistsEntriesSearchMatchQuery(const std::string& search_string)
+{
+    std::string query;
+    std::size_t word_begin = 0;
+    for (;;) {
+        word_begin = search_string.find_first_not_of(" \t", word_begin);
+        if (word_begin == std::string::npos) {
+            break;
+        }
+        std::size_t word_end = search_string.find_first_of(" \t", word_begin);
+        if (word_end == std::string::npos) {
+            word_end = search_string.size();
+        }
+
+        const std::string word = search_string.substr(word_begin, word_end - word_begin);
+        if (word.find_first_of("\"*") != std::string::npos) {
+            return std::string(); // can't be quoted in phrase.
+        }
+        if (utf8Length(word) < kMIN_SEARCH_PREFIX_LENGTH) {
+            return std::string(); // short prefix is found in large part of entries, LIKE scan of playlist is faster than merging of index lists.
+        }
+
+        if ( !query.empty() ) {
+            query += ' ';
+        }
+        // word is quoted as phrase, so punctuation and FTS operators inside it are handled by tokenizer: "ac/dc" matches "AC/DC".
+        query += '"';
+        query += word;
+        query += "*\"";
+
+        word_begin = word_end;
+    }
+    return query;
+}
+
+} // namespace AIMPPlayer
@@ -0,0 +1,44 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <string>
+
+struct sqlite3;
+
+namespace AIMPPlayer
+{
+
+/*!
+    \brief Creates indexes of PlaylistsEntries table. Called by initPlaylistDB() of all managers after table creation.
+           All queries of entries filter rows by playlist_id, so each index starts with it.
+           Index (playlist_id, entry_index) serves counting of entries, reading in playlist order and renumbering by PlaylistEntriesSync.
+    \throw std::runtime_error if index creation fails.
+*/
+void createPlaylistsEntriesIndexes(sqlite3* playlists_db);
+
+/*!
+    \brief Creates index (playlist_id, field) if it does not exist yet, so ordered page of entries is read without sorting of whole playlist.
+           Called by GetPlaylistEntries for the first field of ORDER BY clause. Each index slows down writing of entries,
+           so it is created on first request ordered by field, not on startup.
+    \return false if field is not supported for ordering by index.
+    \throw std::runtime_error if index creation fails.
+*/
+bool preparePlaylistsEntriesOrderIndex(sqlite3* playlists_db, const std::string& field);
+
+/*!
+    \brief Creates full-text index PlaylistsEntriesSearch(FTS4 with unicode61 tokenizer) of fields used by search in GetPlaylistEntries
+           if it does not exist yet. Index is built on first search to not slow down loading of playlists for users who never search.
+           After that index is kept in sync with PlaylistsEntries by triggers, so all loaders maintain it implicitly. docid of index row is entry_id.
+    \return false if sqlite library of player does not support FTS4 or unicode61 tokenizer. Search uses LIKE operator in this case.
+    \throw std::runtime_error if filling of index fails.
+*/
+bool preparePlaylistsEntriesSearchIndex(sqlite3* playlists_db);
+
+/*!
+    \brief Converts search string to MATCH argument: each word of search string becomes prefix phrase query, all words are required.
+    \return empty string if search string can't be expressed by MATCH query or contains words which are too short for index search.
+*/
+std::string makePlaylistsEntriesSearchMatchQuery(const std::string& search_string);
+
+} // namespace AIMPPlayer
@@ -7,6 +7,8 @@
 #include "../http_server/reply.h"
 #include "../http_server/request.h"
 #include "../http_server/mime_types.h"
+#include "../http_server/request_parser.h"
+#include "../http_server/static_file_cache.h"
 
 #include "utils/string_encoding.h"
 #include "utils/util.h"
@@ -77,6 +79,93 @@ std::wstring RequestHandler::getTrackSourcePath(const std::string& request_uri)
     return entry_filename;
 }
 
+void addHeader(Http::Reply& rep, const std::string& name, const std::string& value)
+{
+    rep.headers.push_back(Http::header());
+    rep.headers.back().name = name;
+    rep.headers.back().value = value;
+}
+
+bool isDecimalNumber(const std::string& s)
+{
+    return !s.empty() && boost::all(s, boost::is_digit());
+}
+
+RangeRequestType getRequestedRange(const std::vector<Http::header>& request_headers,
+                                   const std::string& etag,
+                                   const std::string& last_modified,
+                                   boost::uint64_t file_size,
+                                   boost::uint64_t* first,
+                                   boost::uint64_t* length)
+{
+    const std::string* range;
+    if ( !Http::get_header_value(request_headers, "Range", range) ) {
+        return NO_RANGE;
+    }
+
+    const std::string* if_range;
+    if (   Http::get_header_value(request_headers, "If-Range", if_range)
+        && *if_range != etag
+        && *if_range != last_modified
+        )
+    {
+        return NO_RANGE; // file was changed since client got its part, so whole file must be sent.
+    }
+
+    static const std::string kBytesUnit("bytes=");
+    if ( !boost::starts_with(*range, kBytesUnit) ) {
+        return NO_RANGE; // unknown range unit, ignore header.
+    }
+
+    const std::string range_set = range->substr( kBytesUnit.size() );
+    if (range_set.find(',') != string::npos) {
+        return NOT_SATISFIABLE_RANGE; // multiple ranges require multipart/byteranges reply which is not supported.
+    }
+
+    const size_t dash = range_set.find('-');
+    if (dash == string::npos) {
+        return NO_RANGE;
+    }
+    const std::string first_pos = boost::trim_copy( range_set.substr(0, dash) ),
+                      last_pos  = boost::trim_copy( range_set.substr(dash + 1) );
+    try {
+        if ( first_pos.empty() ) {
+            // "-N": last N bytes of file.
+            if ( !isDecimalNumber(last_pos) ) {
+                return NO_RANGE;
+            }
+            const boost::uint64_t suffix_length = boost::lexical_cast<boost::uint64_t>(last_pos);
+            if (suffix_length == 0 || file_size == 0) {
+                return NOT_SATISFIABLE_RANGE;
+            }
+            *length = std::min(suffix_length, file_size);
+            *first = file_size - *length;
+            return SATISFIABLE_RANGE;
+        }
+
+        // "first-last" or "first-".
+        if ( !isDecimalNumber(first_pos) || !( last_pos.empty() || isDecimalNumber(last_pos) ) ) {
+            return NO_RANGE;
+        }
+        const boost::uint64_t first_byte = boost::lexical_cast<boost::uint64_t>(first_pos);
+        boost::uint64_t last_byte = last_pos.empty() ? file_size - 1
+                                                     : boost::lexical_cast<boost::uint64_t>(last_pos);
+        if (last_byte < first_byte) {
+            return NO_RANGE; // invalid range, ignore header.
+        }
+        if (first_byte >= file_size) {
+            return NOT_SATISFIABLE_RANGE;
+        }
+        last_byte = std::min(last_byte, file_size - 1);
+
+        *first = first_byte;
+        *length = last_byte - first_byte + 1;
+        return SATISFIABLE_RANGE;
+    } catch (boost::bad_lexical_cast&) { // too big number.
+        return NO_RANGE;
+    }
+}
+
 bool RequestHandler::handle_request(const Http::Request& req, Http::Reply& rep)
 {
     using namespace Http;
@@ -86,17 +175,36 @@ bool RequestHandler::handle_request(const Http::Request& req, Http::Reply& rep)
         rep.filename = getTrackSourcePath(req.uri);
         const fs::wpath path(rep.filename);
         
-        const uintmax_t file_size = fs::file_size(path);
+        const boost::uint64_t file_size = fs::file_size(path);
+        const std::time_t last_modified = fs::last_write_time(path);
+        const std::string last_modified_http_date = formatHttpDate(last_modified);
+        const std::string etag = Utilities::MakeString() << '"' << std::hex << last_modified << '-' << file_size << '"';
+
+        boost::uint64_t first_byte = 0,
+                        length = file_size;
+        switch ( getRequestedRange(req.headers, etag, last_modified_http_date, file_size, &first_byte, &length) ) {
+        case SATISFIABLE_RANGE:
+            rep.status = Reply::partial_content;
+            addHeader(rep, "Content-Range", Utilities::MakeString() << "bytes " << first_byte << '-' << (first_byte + length - 1) << '/' << file_size);
+            break;
+        case NOT_SATISFIABLE_RANGE:
+            rep = Reply::stock_reply(Reply::requested_range_not_satisfiable);
+            addHeader(rep, "Content-Range", Utilities::MakeString() << "bytes */" << file_size);
+            return true;
+        default:
+            rep.status = Reply::ok;
+            break;
+        }
+        rep.file_offset = first_byte;
+        rep.file_length = length;
 
         // fill http headers.
-        rep.status = Reply::ok;
-        rep.headers.resize(3);
-        rep.headers[0].name = "Content-Length";
-        rep.headers[0].value = boost::lexical_cast<std::string>(file_size);
-        rep.headers[1].name = "Content-Type";
-        rep.headers[1].value = mime_types::extension_to_type( path.extension().string().c_str() );
-        rep.headers[2].name = "Content-Disposition";
-        rep.headers[2].value = Utilities::MakeString() << "attachment; filename=\"" << StringEncoding::utf16_to_utf8( path.filename().native() ) << "\"";
+        addHeader( rep, "Content-Length", boost::lexical_cast<std::string>(length) );
+        addHeader( rep, "Content-Type", mime_types::extension_to_type( path.extension().string().c_str() ) );
+        addHeader( rep, "Content-Disposition", Utilities::MakeString() << "attachment; filename=\"" << StringEncoding::utf16_to_utf8( path.filename().native() ) << "\"" );
+        addHeader(rep, "Accept-Ranges", "bytes");
+        addHeader(rep, "ETag", etag);
+        addHeader(rep, "Last-Modified", last_modified_http_date);
     } catch (std::exception&) {
         rep.filename.clear();
         rep = Reply::stock_reply(Reply::not_found);
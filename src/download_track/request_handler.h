@@ -6,11 +6,30 @@ namespace AIMPPlayer { class AIMPManager; }
 namespace Http {
     struct Request; 
     struct Reply;
+    struct header;
 }
 
 namespace DownloadTrack
 {
 
+enum RangeRequestType {
+    NO_RANGE,              //!< Range header is missing, invalid or outdated by If-Range: whole file must be sent.
+    SATISFIABLE_RANGE,
+    NOT_SATISFIABLE_RANGE  //!< range is out of file or multiple ranges are requested.
+};
+
+/*!
+    \brief Parses Range and If-Range headers. Supports single range only: "bytes=first-last", "bytes=first-" or "bytes=-suffix_length".
+    \param etag, last_modified - validators of file which are compared with If-Range value.
+    \param first, length - range of file to send if SATISFIABLE_RANGE is returned.
+*/
+RangeRequestType getRequestedRange(const std::vector<Http::header>& request_headers,
+                                   const std::string& etag,
+                                   const std::string& last_modified,
+                                   boost::uint64_t file_size,
+                                   boost::uint64_t* first,
+                                   boost::uint64_t* length);
+
 class RequestHandler : boost::noncopyable
 {
 public:
@@ -7,8 +7,13 @@
 #include <vector>
 #include <boost/bind.hpp>
 #include "connection.h"
+#include "http_server/file_sender.h"
+#include "http_server/websocket_connection.h"
 #include "http_server/request_handler.h"
+#include "http_server/header.h"
 #include "plugin/logger.h"
+#include "plugin/control_plugin.h"
+#include "utils/util.h"
 
 //#include <ctime>
 //#include <iostream>
@@ -16,118 +21,25 @@
 
 namespace Http {
 
-namespace TransmitFile {
-
-#if defined(BOOST_ASIO_HAS_WINDOWS_OVERLAPPED_PTR)
-
-using boost::asio::ip::tcp;
-using boost::asio::windows::overlapped_ptr;
-using boost::asio::windows::random_access_handle;
-
-// A wrapper for the TransmitFile overlapped I/O operation.
-template <typename SocketT, typename Handler>
-void transmit_file(SocketT& socket,
-    random_access_handle& file, Handler handler)
-{
-  // Construct an OVERLAPPED-derived object to contain the handler.
-  overlapped_ptr overlapped(socket.get_io_service(), handler);
-
-  // Initiate the TransmitFile operation.
-  BOOL ok = ::TransmitFile(socket.native_handle(),
-      file.native_handle(), 0, 0, overlapped.get(), 0, 0);
-  DWORD last_error = ::GetLastError();
-
-  // Check if the operation completed immediately.
-  if (!ok && last_error != ERROR_IO_PENDING)
-  {
-    // The operation completed immediately, so a completion notification needs
-    // to be posted. When complete() is called, ownership of the OVERLAPPED-
-    // derived object passes to the io_service.
-    boost::system::error_code ec(last_error,
-        boost::asio::error::get_system_category());
-    overlapped.complete(ec, 0);
-  }
-  else
-  {
-    // The operation was successfully initiated, so ownership of the
-    // OVERLAPPED-derived object has passed to the io_service.
-    overlapped.release();
-  }
-}
+//! Max capacity of reply content buffer which is reused by the next request on the same connection.
+const std::size_t kMAX_REUSED_REPLY_CONTENT_CAPACITY = 1024 * 1024;
 
 template <typename SocketT>
-class connection
-  : public boost::enable_shared_from_this< connection<SocketT> >,
-	private boost::noncopyable
-{
-public:
-  typedef boost::shared_ptr< connection<SocketT> > pointer;
-
-  static pointer create(boost::asio::io_service& io_service,
-						std::unique_ptr<SocketT> socket,
-                        const std::wstring& filename)
-  {
-    return pointer(new connection(io_service, std::move(socket), filename));
-  }
-
-  SocketT& socket()
-  {
-    assert(socket_);
-    return *socket_;
-  }
-
-  void start()
-  {
-    boost::system::error_code ec;
-    HANDLE h = ::CreateFile(filename_.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
-                            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, 0);
-    if (h == INVALID_HANDLE_VALUE) {
-        BOOST_LOG_SEV(logger(), error) << "TransmitFile. CreateFile error: " << GetLastError();
-    }
-
-    file_.assign(h, ec);
-    if (file_.is_open())
-    {
-      transmit_file(socket(), file_,
-          boost::bind(&connection::handle_write, shared_from_this(),
-            boost::asio::placeholders::error,
-            boost::asio::placeholders::bytes_transferred));
-    }
-  }
-
-private:
-  connection(boost::asio::io_service& io_service, std::unique_ptr<SocketT> socket, const std::wstring& filename)
-    : socket_(std::move(socket)),
-      filename_(filename),
-      file_(io_service)
-  {
-	assert(socket_);
-  }
-
-  void handle_write(const boost::system::error_code& /*error*/,
-                    size_t /*bytes_transferred*/)
-  {
-    boost::system::error_code ignored_ec;
-    socket_->shutdown(SocketT::shutdown_both, ignored_ec);
-  }
-
-  std::unique_ptr<SocketT> socket_;
-  std::wstring filename_;
-  random_access_handle file_;
-};
-
-#else // defined(BOOST_ASIO_HAS_WINDOWS_OVERLAPPED_PTR)
-# error Overlapped I/O not available on this platform
-#endif // defined(BOOST_ASIO_HAS_WINDOWS_OVERLAPPED_PTR)
-
-} // namespace TransmitFile
-
-template <typename SocketT>
-Connection<SocketT>::Connection(boost::asio::io_service& io_service, RequestHandler& handler)
+Connection<SocketT>::Connection(boost::asio::io_service& io_service,
+                                RequestHandler& handler,
+                                RequestHandlingDispatcher request_handling_dispatcher)
     :
     strand_(io_service),
     socket_(std::unique_ptr<SocketT>(new SocketT(io_service))),
-    request_handler_(handler)
+    request_handler_(handler),
+    request_handling_dispatcher_(request_handling_dispatcher),
+    buffer_data_begin_(buffer_.data()),
+    buffer_data_end_(buffer_.data()),
+    idle_timer_(io_service),
+    keep_alive_timeout_(ControlPlugin::AIMPControlPlugin::settings().http_server.keep_alive_timeout),
+    max_keep_alive_requests_(ControlPlugin::AIMPControlPlugin::settings().http_server.max_keep_alive_requests),
+    requests_handled_(0),
+    keep_alive_(false)
 {
     try {
         BOOST_LOG_SEV(logger(), info) << "Creating connection to host " << socket().remote_endpoint();
@@ -167,6 +79,16 @@ void Connection<SocketT>::start()
 template <typename SocketT>
 void Connection<SocketT>::read_some_to_buffer()
 {
+    if (keep_alive_timeout_ != 0) {
+        idle_timer_.expires_from_now( boost::posix_time::seconds(keep_alive_timeout_) );
+        idle_timer_.async_wait( strand_.wrap(boost::bind(&Connection<SocketT>::handle_idle_timeout,
+                                                         shared_from_this(),
+                                                         boost::asio::placeholders::error
+                                                         )
+                                             )
+                               );
+    }
+
     socket().async_read_some(boost::asio::buffer(buffer_),
                             strand_.wrap(boost::bind(&Connection<SocketT>::handle_read,
                                                      shared_from_this(),
@@ -180,7 +102,22 @@ void Connection<SocketT>::read_some_to_buffer()
 template <typename SocketT>
 void Connection<SocketT>::write_reply_content()
 {
-    if ( !reply_.filename.empty() ) {
+    prepare_reply_headers(reply_);
+
+    if (reply_.status == Reply::switching_protocols) {
+        // WebSocket handshake.
+        boost::asio::async_write(socket(),
+                                 reply_.to_buffers_headers_only(),
+                                 strand_.wrap(boost::bind(&Connection<SocketT>::handle_write_websocket_handshake,
+                                                          shared_from_this(),
+                                                          boost::asio::placeholders::error
+                                                          )
+                                              )
+                                 );
+    } else if (reply_.content_producer) {
+        // send content of unknown length part by part.
+        write_chunk(true);
+    } else if ( !reply_.filename.empty() ) {
         // send large file.
         boost::asio::async_write(socket(),
                                  reply_.to_buffers_headers_only(),
@@ -203,28 +140,139 @@ void Connection<SocketT>::write_reply_content()
     }
 }
 
+template <typename SocketT>
+void Connection<SocketT>::prepare_reply_headers(Reply& reply)
+{
+    if (reply.status == Reply::switching_protocols) {
+        return; // handshake reply already contains Connection header, there is no content.
+    }
+
+    const std::string* value;
+    if ( reply.filename.empty() && !reply.content_producer && !get_header_value(reply.headers, "Content-Length", value) ) {
+        // client needs message length to find beginning of the next reply on persistent connection.
+        reply.headers.push_back(header());
+        reply.headers.back().name = "Content-Length";
+        reply.headers.back().value = boost::lexical_cast<std::string>( reply.content.size() );
+    }
+
+    reply.headers.push_back(header());
+    reply.headers.back().name = "Connection";
+    reply.headers.back().value = keep_alive_ ? "keep-alive" : "close";
+
+    if (keep_alive_ && keep_alive_timeout_ != 0) {
+        reply.headers.push_back(header());
+        reply.headers.back().name = "Keep-Alive";
+        reply.headers.back().value = Utilities::MakeString() << "timeout=" << keep_alive_timeout_
+                                                             << ", max=" << (max_keep_alive_requests_ - requests_handled_);
+    }
+}
+
+template <typename SocketT>
+bool Connection<SocketT>::keep_alive_requested() const
+{
+    if (requests_handled_ >= max_keep_alive_requests_) {
+        return false;
+    }
+
+    if ( !request_parser_.content_framed() ) {
+        return false; // beginning of next request is unknown, so bytes after this request can't be trusted.
+    }
+
+    const std::string* connection_value = nullptr;
+    const bool has_connection_header = get_header_value(request_.headers, "Connection", connection_value);
+
+    if ( request_.http_version_major > 1 || (request_.http_version_major == 1 && request_.http_version_minor >= 1) ) {
+        // HTTP/1.1: connection is persistent by default.
+        return !has_connection_header || !boost::icontains(*connection_value, "close");
+    }
+
+    // HTTP/1.0: connection is persistent only by explicit client request.
+    return has_connection_header && boost::icontains(*connection_value, "keep-alive");
+}
+
+template <typename SocketT>
+void Connection<SocketT>::start_next_request()
+{
+    request_ = Request();
+
+    // keep content buffer of previous reply: responses on the same connection are usually of similar size,
+    // so RPC response serializer writes into already allocated memory. Too large buffer is not worth keeping.
+    std::string content;
+    if (reply_.content.capacity() <= kMAX_REUSED_REPLY_CONTENT_CAPACITY) {
+        content.swap(reply_.content);
+        content.clear();
+    }
+    reply_ = Reply();
+    reply_.content.swap(content);
+
+    request_parser_.reset();
+
+    if (buffer_data_begin_ != buffer_data_end_) {
+        // client has sent next request without waiting reply on previous one.
+        parse_buffered_data();
+    } else {
+        read_some_to_buffer();
+    }
+}
+
+template <typename SocketT>
+void Connection<SocketT>::handle_idle_timeout(const boost::system::error_code& e)
+{
+    // handler can be queued already when timer is cancelled or rearmed, so check expiry time itself.
+    const bool expired = idle_timer_.expires_at() <= boost::asio::deadline_timer::traits_type::now();
+    if (e != boost::asio::error::operation_aborted && expired && socket_) {
+        BOOST_LOG_SEV(logger(), debug) << "Connection is closed by idle timeout.";
+        // pending read operation will be completed with error, so connection will be destroyed.
+        boost::system::error_code ignored_ec;
+        socket().close(ignored_ec);
+    }
+}
+
+template <typename SocketT>
+void Connection<SocketT>::handle_request()
+{
+    if (request_handling_dispatcher_) {
+        // Request handler works with AIMP player, so pass request to player thread.
+        // Connection does not start any I/O until reply is ready, so request_ and reply_ are not accessed concurrently.
+        const bool accepted = request_handling_dispatcher_( boost::bind(&Connection<SocketT>::handle_request_in_handler_thread,
+                                                                        shared_from_this()
+                                                                        )
+                                                           );
+        if (!accepted) {
+            BOOST_LOG_SEV(logger(), warning) << "Request handling queue is full, request " << request_.uri << " is rejected.";
+            reply_ = Reply::stock_reply(Reply::service_unavailable);
+            write_reply_content();
+        }
+    } else {
+        handle_request_in_handler_thread();
+    }
+}
+
+template <typename SocketT>
+void Connection<SocketT>::handle_request_in_handler_thread()
+{
+    ICometDelayedConnection_ptr comet_connection( new CometDelayedConnection<SocketT>( shared_from_this() ) );
+    bool reply_immediately = request_handler_.handle_request(request_, reply_, comet_connection);
+    if (reply_immediately) {
+        // return to connection's strand: it is the current one if request is handled in I/O thread.
+        strand_.dispatch( boost::bind(&Connection<SocketT>::write_reply_content,
+                                      shared_from_this()
+                                      )
+                         );
+    }
+}
+
 template <typename SocketT>
 void Connection<SocketT>::handle_read(const boost::system::error_code& e,
                                       std::size_t bytes_transferred)
 {
+    // cancels pending wait. Expiry time is reset too, so handler which is already queued sees that timer has been disarmed.
+    idle_timer_.expires_at(boost::posix_time::pos_infin);
+
     if (!e) {
-        boost::tribool result;
-        boost::tie(result, boost::tuples::ignore) = request_parser_.parse(request_,
-                                                                          buffer_.data(),
-                                                                          buffer_.data() + bytes_transferred
-                                                                          );
-        if (result) {
-            ICometDelayedConnection_ptr comet_connection( new CometDelayedConnection<SocketT>( shared_from_this() ) );
-            bool reply_immediately = request_handler_.handle_request(request_, reply_, comet_connection);
-            if (reply_immediately) {
-                write_reply_content();
-            }
-        } else if (!result) {
-            reply_ = Reply::stock_reply(Reply::bad_request);
-            write_reply_content();
-        } else {
-            read_some_to_buffer();
-        }
+        buffer_data_begin_ = buffer_.data();
+        buffer_data_end_ = buffer_.data() + bytes_transferred;
+        parse_buffered_data();
     } else {
         // BOOST_LOG_SEV(logger(), debug) << "Connection<SocketT>::handle_read(): failed to read data. Reason: " << e.message();
     }
@@ -235,9 +283,37 @@ void Connection<SocketT>::handle_read(const boost::system::error_code& e,
     // handler returns. The Connection class's destructor closes the socket.
 }
 
+template <typename SocketT>
+void Connection<SocketT>::parse_buffered_data()
+{
+    boost::tribool result;
+    boost::tie(result, buffer_data_begin_) = request_parser_.parse(request_,
+                                                                   buffer_data_begin_,
+                                                                   buffer_data_end_
+                                                                   );
+    if (result) {
+        ++requests_handled_;
+        keep_alive_ = keep_alive_requested();
+        handle_request();
+    } else if (!result) {
+        keep_alive_ = false; // request framing is broken, so we can't find beginning of next request.
+        reply_ = Reply::stock_reply(request_parser_.transfer_coding_unsupported() ? Reply::not_implemented
+                                                                                  : Reply::bad_request);
+        write_reply_content();
+    } else {
+        // all buffered data has been consumed, wait for the rest of request.
+        read_some_to_buffer();
+    }
+}
+
 template <typename SocketT>
 void Connection<SocketT>::handle_write(const boost::system::error_code& e)
 {
+    if (!e && keep_alive_) {
+        start_next_request();
+        return;
+    }
+
     if (!e) {
         // Initiate graceful connection closure.
         boost::system::error_code ignored_ec;
@@ -254,26 +330,139 @@ template <typename SocketT>
 void Connection<SocketT>::handle_write_headers_on_file_sending(const boost::system::error_code& e)
 {
     if (!e) {
-        // http headers were sent successfully, now send file content.
-        typedef TransmitFile::connection<SocketT> TransmitFileConnection;
-        TransmitFileConnection::pointer tfc = TransmitFileConnection::create(strand_.get_io_service(),
-                                                                             std::move(socket_), // this object is not socket owner anymore.
-																		     reply_.filename);
+        // http headers were sent successfully, now send file content. Connection is kept alive by completion handler.
+        FileSending::asyncSendFile(socket(),
+                                   reply_.filename,
+                                   reply_.file_offset,
+                                   reply_.file_length,
+                                   strand_.wrap(boost::bind(&Connection<SocketT>::handle_write_file,
+                                                            shared_from_this(),
+                                                            boost::asio::placeholders::error
+                                                            )
+                                                )
+                                   );
+    }
+
+    // If an error occurs then no new asynchronous operations are started,
+    // so connection will be destroyed automatically after this handler returns.
+}
+
+template <typename SocketT>
+void Connection<SocketT>::write_chunk(bool with_headers)
+{
+    std::vector<boost::asio::const_buffer> buffers;
+    if (with_headers) {
+        buffers = reply_.to_buffers_headers_only();
+    }
+    const std::vector<boost::asio::const_buffer> chunk_buffers = reply_.to_buffers_chunk(chunk_size_line_);
+    buffers.insert( buffers.end(), chunk_buffers.begin(), chunk_buffers.end() );
+
+    boost::asio::async_write(socket(),
+                             buffers,
+                             strand_.wrap(boost::bind(&Connection<SocketT>::handle_write_chunk,
+                                                      shared_from_this(),
+                                                      boost::asio::placeholders::error
+                                                      )
+                                          )
+                             );
+}
+
+template <typename SocketT>
+void Connection<SocketT>::handle_write_chunk(const boost::system::error_code& e)
+{
+    if (e || !reply_.content_producer) {
+        // the last chunk has been sent: continue work with persistent connection or close it.
+        handle_write(e);
+        return;
+    }
+
+    // Next part is produced only when previous one has been sent, so slow client does not make us buffer whole content.
+    if (request_handling_dispatcher_) {
+        const bool accepted = request_handling_dispatcher_( boost::bind(&Connection<SocketT>::produce_chunk_in_handler_thread,
+                                                                        shared_from_this()
+                                                                        )
+                                                           );
+        if (!accepted) {
+            // headers have been sent already, so just close connection: client sees that content is not complete.
+            BOOST_LOG_SEV(logger(), warning) << "Request handling queue is full, sending of reply on request " << request_.uri << " is aborted.";
+            boost::system::error_code ignored_ec;
+            socket().close(ignored_ec);
+        }
+    } else {
+        produce_chunk_in_handler_thread();
+    }
+}
+
+template <typename SocketT>
+void Connection<SocketT>::produce_chunk_in_handler_thread()
+{
+    // Connection does not start any I/O until part is ready, so reply_ is not accessed concurrently.
+    try {
+        if ( !reply_.content_producer(&reply_.content) ) {
+            reply_.content_producer.clear(); // release producer in handler's thread since it can use handler's data.
+        }
+    } catch (std::exception& e) {
+        BOOST_LOG_SEV(logger(), error) << "Sending of reply on request " << request_.uri << " is aborted. Reason: " << e.what();
+        reply_.content_producer.clear();
+        // No new asynchronous operations are started, so connection will be destroyed and client sees that content is not complete.
+        return;
+    }
+
+    strand_.dispatch( boost::bind(&Connection<SocketT>::write_chunk,
+                                  shared_from_this(),
+                                  false
+                                  )
+                     );
+}
+
+template <typename SocketT>
+void Connection<SocketT>::handle_write_file(const boost::system::error_code& e)
+{
+    if (e) {
+        BOOST_LOG_SEV(logger(), debug) << "File sending failed. Reason: " << e.message();
+    }
+
+    // continue work with persistent connection or close it.
+    handle_write(e);
+}
+
+template <typename SocketT>
+void Connection<SocketT>::handle_write_websocket_handshake(const boost::system::error_code& e)
+{
+    if (!e) {
+        BOOST_LOG_SEV(logger(), debug) << "Switching connection to WebSocket protocol.";
+        typedef WebSocketConnection<SocketT> WebSocketConnectionType;
+        boost::shared_ptr<WebSocketConnectionType> websocket_connection( new WebSocketConnectionType(strand_.get_io_service(),
+                                                                                                     std::move(socket_), // this object is not socket owner anymore.
+                                                                                                     request_handler_,
+                                                                                                     request_handling_dispatcher_
+                                                                                                     )
+                                                                        );
         assert(!socket_);
-        
-        tfc->start();
+        websocket_connection->start(buffer_data_begin_, buffer_data_end_); // client could send frames right after handshake request.
     }
 
     // No new asynchronous operations are started. This means that all shared_ptr
     // references to the connection object will disappear and the object will be
     // destroyed automatically after this handler returns.
-    // All file transferring work will do TransmitFileConnection.
 }
 
 template <typename SocketT>
 void CometDelayedConnection<SocketT>::sendResponse(DelayedResponseSender_ptr comet_http_response_sender)
+{
+    // Response is prepared in player thread, socket must be used in connection's strand only.
+    connection_->strand_.dispatch( boost::bind(&CometDelayedConnection<SocketT>::write_response,
+                                               shared_from_this(),
+                                               comet_http_response_sender
+                                               )
+                                  );
+}
+
+template <typename SocketT>
+void CometDelayedConnection<SocketT>::write_response(DelayedResponseSender_ptr comet_http_response_sender)
 {
     BOOST_LOG_SEV(logger(), debug) << "CometDelayedConnection::sendResponse to " << connection_->socket().remote_endpoint();
+    connection_->prepare_reply_headers( comet_http_response_sender->get_reply() );
     boost::asio::async_write( connection_->socket(),
                               comet_http_response_sender->get_reply().to_buffers(),
                               connection_->strand_.wrap(boost::bind(&CometDelayedConnection<SocketT>::handle_write,
@@ -290,10 +479,12 @@ void CometDelayedConnection<SocketT>::handle_write(DelayedResponseSender_ptr com
 {
     if (!e) {
         BOOST_LOG_SEV(logger(), debug) << "CometDelayedConnection::success sending response to " << connection_->socket().remote_endpoint();
-        // Initiate graceful connection closure.
-        boost::system::error_code ignored_ec;
-        connection_->socket().shutdown(SocketT::shutdown_both, ignored_ec);
-    } else {
+    }
+
+    // continue work with persistent connection or close it.
+    connection_->handle_write(e);
+
+    if (e) {
         BOOST_LOG_SEV(logger(), debug) << "CometDelayedConnection::fail to send response to "
                                        << connection_->socket().remote_endpoint()
                                        << ". Reason: " << e.message();
@@ -11,6 +11,7 @@
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
 #include "reply.h"
 #include "request.h"
 #include "request_parser.h"
@@ -19,6 +20,13 @@ namespace Http {
 
 class RequestHandler;
 
+/*!
+    Passes request handling task to thread where RequestHandler must work (AIMP player thread).
+    Returns false if task was not accepted, for example if queue of tasks is full.
+    Empty functor means that request is handled directly in connection's I/O thread.
+*/
+typedef boost::function<bool (boost::function<void ()>)> RequestHandlingDispatcher;
+
 /// Represents a single tcp-ip connection from a client.
 template <typename SocketT>
 class Connection : /*public Connection, */public boost::enable_shared_from_this< Connection<SocketT> >, private boost::noncopyable
@@ -30,7 +38,8 @@ public:
 
     /// Construct a connection with the given io_service.
     Connection(boost::asio::io_service& io_service,
-               RequestHandler& handler);
+               RequestHandler& handler,
+               RequestHandlingDispatcher request_handling_dispatcher = RequestHandlingDispatcher());
 
     ~Connection();
     
@@ -44,8 +53,29 @@ private:
 
     void read_some_to_buffer();
 
+    /// Parses data which is stored in buffer but was not consumed by parser yet. Used for pipelined requests.
+    void parse_buffered_data();
+
     void write_reply_content();
 
+    /// Adds Content-Length header if it is missed and Connection header according to keep-alive state.
+    void prepare_reply_headers(Reply& reply);
+
+    /// Determines if connection should be kept alive after reply on current request.
+    bool keep_alive_requested() const;
+
+    /// Resets request state and starts processing of the next request on the same connection.
+    void start_next_request();
+
+    /// Closes connection which has been idle for too long.
+    void handle_idle_timeout(const boost::system::error_code& e);
+
+    /// Passes parsed request to request handler directly or through request handling dispatcher.
+    void handle_request();
+
+    /// Calls request handler. Executed in request handler's thread.
+    void handle_request_in_handler_thread();
+
     /// Handle completion of a read operation.
     void handle_read(const boost::system::error_code& e, std::size_t bytes_transferred);
 
@@ -55,6 +85,21 @@ private:
     /// Handle completion of a header write operation.
     void handle_write_headers_on_file_sending(const boost::system::error_code& e);
 
+    /// Writes reply_.content as chunk of chunked reply. Headers are written along with the first chunk.
+    void write_chunk(bool with_headers);
+
+    /// Handle completion of a chunk write: requests the next part of content or finishes reply.
+    void handle_write_chunk(const boost::system::error_code& e);
+
+    /// Produces the next part of chunked reply content. Executed in request handler's thread.
+    void produce_chunk_in_handler_thread();
+
+    /// Handle completion of file content sending.
+    void handle_write_file(const boost::system::error_code& e);
+
+    /// Handle completion of WebSocket handshake reply write: socket is passed to WebSocketConnection.
+    void handle_write_websocket_handshake(const boost::system::error_code& e);
+
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
 
@@ -64,9 +109,31 @@ private:
     /// The handler used to process the incoming request.
     RequestHandler& request_handler_;
 
+    /// Passes request handling to request handler's thread. Can be empty.
+    RequestHandlingDispatcher request_handling_dispatcher_;
+
     /// Buffer for incoming data.
     boost::array<char, 8192> buffer_;
 
+    /// Range of buffer_ which contains data that is not consumed by parser yet(beginning of pipelined request).
+    const char* buffer_data_begin_;
+    const char* buffer_data_end_;
+
+    /// Closes connection if client does not send next request in time.
+    boost::asio::deadline_timer idle_timer_;
+
+    /// Idle timeout in seconds. Zero disables timeout.
+    const unsigned int keep_alive_timeout_;
+
+    /// Max count of requests handled by one connection. Zero disables keep-alive.
+    const unsigned int max_keep_alive_requests_;
+
+    /// Count of requests handled by this connection.
+    std::size_t requests_handled_;
+
+    /// Set if connection should not be closed after sending reply on current request.
+    bool keep_alive_;
+
     /// The incoming request.
     Request request_;
 
@@ -75,6 +142,9 @@ private:
 
     /// The reply to be sent back to the client.
     Reply reply_;
+
+    /// Size line of chunk which is being sent. See Reply::content_producer.
+    std::string chunk_size_line_;
 };
 
 
@@ -86,6 +156,14 @@ public:
     virtual ~ICometDelayedConnection() {}
 
     virtual void sendResponse(boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender) = 0;
+
+    //! Returns true if connection can send many delayed responses(WebSocket). HTTP connection sends only one.
+    virtual bool isPersistent() const
+        { return false; }
+
+    //! Returns true if client has gone and responses can't be delivered anymore.
+    virtual bool isClosed() const
+        { return false; }
 };
 
 typedef boost::shared_ptr<ICometDelayedConnection> ICometDelayedConnection_ptr;
@@ -106,6 +184,8 @@ public:
 
 private:
 
+    void write_response(boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender);
+
     void handle_write(boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender, const boost::system::error_code& e);
 
     ConnectionType_ptr connection_;
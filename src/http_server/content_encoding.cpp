@@ -0,0 +1,177 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "content_encoding.h"
+#include "http_server/header.h"
+#include "http_server/reply.h"
+#include "http_server/request_parser.h"
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/lexical_cast.hpp>
+
+namespace Http
+{
+
+namespace ContentEncoding
+{
+
+namespace {
+
+//! Parses "coding;q=0.5" item of Accept-Encoding header. Quality is 1 if it is not specified.
+void parseCoding(const std::string& item, std::string* coding, double* quality)
+{
+    const std::size_t params_begin = item.find(';');
+    *coding = boost::to_lower_copy( boost::trim_copy( item.substr(0, params_begin) ) );
+    *quality = 1.0;
+
+    if (params_begin != std::string::npos) {
+        std::string params = item.substr(params_begin + 1);
+        boost::erase_all(params, " ");
+        if ( boost::istarts_with(params, "q=") ) {
+            try {
+                *quality = boost::lexical_cast<double>( params.substr(2) );
+            } catch (boost::bad_lexical_cast&) {
+                // ignore malformed quality value.
+            }
+        }
+    }
+}
+
+} // namespace
+
+Type selectEncoding(const std::vector<header>& request_headers)
+{
+    const std::string* accept_encoding;
+    if ( !get_header_value(request_headers, "Accept-Encoding", accept_encoding) ) {
+        return IDENTITY;
+    }
+
+    // negative value means that coding is not mentioned in header.
+    double gzip_quality = -1, deflate_quality = -1, any_quality = -1;
+
+    std::vector<std::string> items;
+    boost::split( items, *accept_encoding, boost::is_any_of(",") );
+    for (const auto& item : items) {
+        std::string coding;
+        double quality;
+        parseCoding(item, &coding, &quality);
+        if (coding == "gzip" || coding == "x-gzip") {
+            gzip_quality = quality;
+        } else if (coding == "deflate") {
+            deflate_quality = quality;
+        } else if (coding == "*") {
+            any_quality = quality;
+        }
+    }
+
+    if (gzip_quality < 0) {
+        gzip_quality = any_quality;
+    }
+    if (deflate_quality < 0) {
+        deflate_quality = any_quality;
+    }
+
+    if (gzip_quality > 0 && gzip_quality >= deflate_quality) {
+        return GZIP;
+    } else if (deflate_quality > 0) {
+        return DEFLATE;
+    }
+    return IDENTITY;
+}
+
+const char* name(Type encoding)
+{
+    switch (encoding) {
+    case GZIP:
+        return "gzip";
+    case DEFLATE:
+        return "deflate";
+    default:
+        return "identity";
+    }
+}
+
+bool isCompressible(const std::string& content_type)
+{
+    return boost::starts_with(content_type, "text/")
+           || boost::starts_with(content_type, "application/json")
+           || boost::starts_with(content_type, "application/javascript")
+           || boost::starts_with(content_type, "application/x-javascript")
+           || boost::starts_with(content_type, "application/xml")
+           || boost::starts_with(content_type, "image/svg+xml");
+}
+
+void compress(const std::string& data, Type encoding, std::string* compressed)
+{
+    assert(compressed);
+    assert(encoding != IDENTITY);
+
+    namespace io = boost::iostreams;
+
+    compressed->clear();
+    compressed->reserve(data.size() / 4); // repetitive JSON and scripts are compressed at least 4 times.
+
+    io::filtering_ostream os;
+    if (encoding == GZIP) {
+        os.push( io::gzip_compressor() );
+    } else {
+        os.push( io::zlib_compressor() );
+    }
+    os.push( io::back_inserter(*compressed) );
+    os.write( data.data(), data.size() );
+    os.reset(); // flush compressor and write stream trailer.
+}
+
+void compressReply(Type encoding, Reply& rep)
+{
+    if (rep.status != Reply::ok || !rep.filename.empty()) {
+        return;
+    }
+
+    const auto content_type_it = std::find_if(rep.headers.begin(), rep.headers.end(),
+                                              [](const header& h) { return h.name == "Content-Type"; }
+                                              );
+    if ( content_type_it == rep.headers.end() || !isCompressible(content_type_it->value) ) {
+        return;
+    }
+
+    addVaryHeader(rep);
+
+    if (encoding == IDENTITY || rep.content.size() < kMinSizeToCompress) {
+        return;
+    }
+
+    std::string compressed;
+    compress(rep.content, encoding, &compressed);
+    if ( compressed.size() >= rep.content.size() ) {
+        return;
+    }
+    rep.content.swap(compressed);
+
+    for (auto& h : rep.headers) {
+        if (h.name == "Content-Length") {
+            h.value = boost::lexical_cast<std::string>( rep.content.size() );
+        }
+    }
+    addContentEncodingHeader(encoding, rep);
+}
+
+void addContentEncodingHeader(Type encoding, Reply& rep)
+{
+    rep.headers.push_back(header());
+    rep.headers.back().name = "Content-Encoding";
+    rep.headers.back().value = name(encoding);
+}
+
+void addVaryHeader(Reply& rep)
+{
+    rep.headers.push_back(header());
+    rep.headers.back().name = "Vary";
+    rep.headers.back().value = "Accept-Encoding";
+}
+
+} // namespace ContentEncoding
+
+} // namespace Http
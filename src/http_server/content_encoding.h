@@ -0,0 +1,55 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Http
+{
+
+struct header;
+struct Reply;
+
+namespace ContentEncoding
+{
+
+enum Type {
+    IDENTITY,
+    GZIP,
+    DEFLATE //!< zlib format as required by HTTP "deflate" coding.
+};
+
+//! Content smaller than this size is sent as is: compression overhead is bigger than profit.
+const std::size_t kMinSizeToCompress = 1024;
+
+/*!
+    \brief Selects best encoding supported by client using Accept-Encoding header.
+           gzip is preferred over deflate when both have the same quality value.
+*/
+Type selectEncoding(const std::vector<header>& request_headers);
+
+//! \return token used in Content-Encoding header.
+const char* name(Type encoding);
+
+//! \return true for text formats(html, css, js, json, xml). Images and media are compressed already.
+bool isCompressible(const std::string& content_type);
+
+//! Compresses data by streaming it through deflate compressor.
+void compress(const std::string& data, Type encoding, std::string* compressed);
+
+/*!
+    \brief Compresses content of reply filled by RequestHandler::fillReplyWithContent() if it is worth it.
+           Content-Length is updated, Content-Encoding and Vary headers are added.
+*/
+void compressReply(Type encoding, Reply& rep);
+
+//! Adds Content-Encoding header.
+void addContentEncodingHeader(Type encoding, Reply& rep);
+
+//! Adds "Vary: Accept-Encoding" header: caches must not send compressed content to client that does not support it.
+void addVaryHeader(Reply& rep);
+
+} // namespace ContentEncoding
+
+} // namespace Http
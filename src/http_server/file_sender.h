@@ -0,0 +1,340 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#if defined(BOOST_ASIO_HAS_WINDOWS_OVERLAPPED_PTR)
+    // TransmitFile is used.
+#elif defined(__linux__)
+#   include <fcntl.h>
+#   include <sys/sendfile.h>
+#   include <unistd.h>
+#   include <boost/filesystem/path.hpp>
+#else
+#   include <boost/array.hpp>
+#   include <boost/filesystem/fstream.hpp>
+#endif
+
+namespace Http {
+
+namespace FileSending {
+
+typedef boost::function<void (const boost::system::error_code&)> CompletionHandler;
+
+/*!
+    \brief Sends range of file to socket.
+           Implementation depends on platform:
+               Windows - zero-copy TransmitFile,
+               Linux - zero-copy sendfile(2),
+               others - file is read by chunks which are sent by async_write.
+           Socket must exist until handler is called. Handler is always called through socket's io_service.
+*/
+template <typename SocketT>
+void asyncSendFile(SocketT& socket,
+                   const std::wstring& filename,
+                   boost::uint64_t offset,
+                   boost::uint64_t length,
+                   CompletionHandler handler);
+
+#if defined(BOOST_ASIO_HAS_WINDOWS_OVERLAPPED_PTR)
+
+template <typename SocketT>
+class FileSender : public boost::enable_shared_from_this< FileSender<SocketT> >, private boost::noncopyable
+{
+public:
+    FileSender(SocketT& socket, CompletionHandler handler)
+        :
+        socket_(socket),
+        file_( socket.get_io_service() ),
+        handler_(handler),
+        offset_(0),
+        remaining_(0)
+    {}
+
+    void start(const std::wstring& filename, boost::uint64_t offset, boost::uint64_t length)
+    {
+        HANDLE h = ::CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+                                 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+        if (h == INVALID_HANDLE_VALUE) {
+            complete( boost::system::error_code(::GetLastError(), boost::asio::error::get_system_category()) );
+            return;
+        }
+
+        boost::system::error_code ec;
+        file_.assign(h, ec);
+        if (ec) {
+            ::CloseHandle(h);
+            complete(ec);
+            return;
+        }
+
+        offset_ = offset;
+        remaining_ = length;
+        transmitNextChunk();
+    }
+
+private:
+
+    // TransmitFile can't send more than 2^31 - 1 bytes per call.
+    static const boost::uint64_t kMaxChunkSize = 1024 * 1024 * 1024;
+
+    void transmitNextChunk()
+    {
+        if (remaining_ == 0) {
+            complete( boost::system::error_code() );
+            return;
+        }
+
+        // Construct an OVERLAPPED-derived object to contain the handler.
+        boost::asio::windows::overlapped_ptr overlapped( socket_.get_io_service(),
+                                                         boost::bind(&FileSender::handleTransmit,
+                                                                     this->shared_from_this(),
+                                                                     boost::asio::placeholders::error,
+                                                                     boost::asio::placeholders::bytes_transferred
+                                                                     )
+                                                        );
+        // TransmitFile starts reading file from offset stored in OVERLAPPED.
+        overlapped.get()->Offset = static_cast<DWORD>(offset_);
+        overlapped.get()->OffsetHigh = static_cast<DWORD>(offset_ >> 32);
+
+        const DWORD chunk_size = static_cast<DWORD>( std::min( remaining_, static_cast<boost::uint64_t>(kMaxChunkSize) ) );
+        const BOOL ok = ::TransmitFile(socket_.native_handle(), file_.native_handle(), chunk_size, 0, overlapped.get(), 0, 0);
+        const DWORD last_error = ::GetLastError();
+
+        // Check if the operation completed immediately.
+        if (!ok && last_error != ERROR_IO_PENDING) {
+            // The operation completed immediately, so a completion notification needs
+            // to be posted. When complete() is called, ownership of the OVERLAPPED-
+            // derived object passes to the io_service.
+            overlapped.complete(boost::system::error_code(last_error, boost::asio::error::get_system_category()), 0);
+        } else {
+            // The operation was successfully initiated, so ownership of the
+            // OVERLAPPED-derived object has passed to the io_service.
+            overlapped.release();
+        }
+    }
+
+    void handleTransmit(const boost::system::error_code& e, std::size_t bytes_transferred)
+    {
+        if (e) {
+            complete(e);
+            return;
+        }
+        if (bytes_transferred == 0) {
+            complete(boost::asio::error::eof); // file was truncated while sending.
+            return;
+        }
+
+        offset_ += bytes_transferred;
+        remaining_ -= std::min<boost::uint64_t>(bytes_transferred, remaining_);
+        transmitNextChunk();
+    }
+
+    void complete(const boost::system::error_code& e)
+    {
+        socket_.get_io_service().post( boost::bind(handler_, e) );
+    }
+
+    SocketT& socket_;
+    boost::asio::windows::random_access_handle file_;
+    CompletionHandler handler_;
+    boost::uint64_t offset_;
+    boost::uint64_t remaining_;
+};
+
+#elif defined(__linux__)
+
+template <typename SocketT>
+class FileSender : public boost::enable_shared_from_this< FileSender<SocketT> >, private boost::noncopyable
+{
+public:
+    FileSender(SocketT& socket, CompletionHandler handler)
+        :
+        socket_(socket),
+        handler_(handler),
+        fd_(-1),
+        offset_(0),
+        remaining_(0)
+    {}
+
+    ~FileSender()
+    {
+        if (fd_ != -1) {
+            ::close(fd_);
+        }
+    }
+
+    void start(const std::wstring& filename, boost::uint64_t offset, boost::uint64_t length)
+    {
+        fd_ = ::open(boost::filesystem::path(filename).string().c_str(), O_RDONLY);
+        if (fd_ == -1) {
+            complete( boost::system::error_code(errno, boost::system::system_category()) );
+            return;
+        }
+        ::posix_fadvise(fd_, offset, length, POSIX_FADV_SEQUENTIAL);
+
+        // sendfile must not block I/O thread: wait socket readiness through io_service instead.
+        boost::system::error_code ec;
+        socket_.native_non_blocking(true, ec);
+        if (ec) {
+            complete(ec);
+            return;
+        }
+
+        offset_ = offset;
+        remaining_ = length;
+        sendSome( boost::system::error_code() );
+    }
+
+private:
+
+    // limit size of one sendfile call to give other connections of I/O thread a chance.
+    static const boost::uint64_t kMaxChunkSize = 16 * 1024 * 1024;
+
+    void sendSome(const boost::system::error_code& e)
+    {
+        if (e) {
+            complete(e);
+            return;
+        }
+
+        while (remaining_ > 0) {
+            off_t offset = static_cast<off_t>(offset_);
+            const ssize_t sent = ::sendfile(socket_.native_handle(), fd_, &offset,
+                                            static_cast<std::size_t>( std::min( remaining_, static_cast<boost::uint64_t>(kMaxChunkSize) ) )
+                                            );
+            if (sent > 0) {
+                offset_ += sent;
+                remaining_ -= sent;
+            } else if (sent == 0) {
+                complete(boost::asio::error::eof); // file was truncated while sending.
+                return;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // socket buffer is full, continue when socket becomes writable.
+                socket_.async_write_some( boost::asio::null_buffers(),
+                                          boost::bind(&FileSender::sendSome,
+                                                      this->shared_from_this(),
+                                                      boost::asio::placeholders::error
+                                                      )
+                                         );
+                return;
+            } else if (errno != EINTR) {
+                complete( boost::system::error_code(errno, boost::system::system_category()) );
+                return;
+            }
+        }
+
+        complete( boost::system::error_code() );
+    }
+
+    void complete(const boost::system::error_code& e)
+    {
+        socket_.get_io_service().post( boost::bind(handler_, e) );
+    }
+
+    SocketT& socket_;
+    CompletionHandler handler_;
+    int fd_;
+    boost::uint64_t offset_;
+    boost::uint64_t remaining_;
+};
+
+#else // portable fallback
+
+template <typename SocketT>
+class FileSender : public boost::enable_shared_from_this< FileSender<SocketT> >, private boost::noncopyable
+{
+public:
+    FileSender(SocketT& socket, CompletionHandler handler)
+        :
+        socket_(socket),
+        handler_(handler),
+        remaining_(0)
+    {}
+
+    void start(const std::wstring& filename, boost::uint64_t offset, boost::uint64_t length)
+    {
+        file_.open(boost::filesystem::path(filename), std::ios::in | std::ios::binary);
+        file_.seekg(offset);
+        if (!file_) {
+            complete(boost::asio::error::not_found);
+            return;
+        }
+
+        remaining_ = length;
+        sendNextChunk();
+    }
+
+private:
+
+    void sendNextChunk()
+    {
+        if (remaining_ == 0) {
+            complete( boost::system::error_code() );
+            return;
+        }
+
+        file_.read( buffer_.data(), static_cast<std::streamsize>( std::min<boost::uint64_t>(remaining_, buffer_.size()) ) );
+        const std::size_t chunk_size = static_cast<std::size_t>( file_.gcount() );
+        if (chunk_size == 0) {
+            complete(boost::asio::error::eof); // file was truncated while sending.
+            return;
+        }
+        remaining_ -= chunk_size;
+
+        boost::asio::async_write( socket_,
+                                  boost::asio::buffer(buffer_.data(), chunk_size),
+                                  boost::bind(&FileSender::handleWrite,
+                                              this->shared_from_this(),
+                                              boost::asio::placeholders::error
+                                              )
+                                 );
+    }
+
+    void handleWrite(const boost::system::error_code& e)
+    {
+        if (e) {
+            complete(e);
+            return;
+        }
+        sendNextChunk();
+    }
+
+    void complete(const boost::system::error_code& e)
+    {
+        socket_.get_io_service().post( boost::bind(handler_, e) );
+    }
+
+    SocketT& socket_;
+    CompletionHandler handler_;
+    boost::filesystem::ifstream file_;
+    boost::array<char, 64 * 1024> buffer_;
+    boost::uint64_t remaining_;
+};
+
+#endif
+
+template <typename SocketT>
+void asyncSendFile(SocketT& socket,
+                   const std::wstring& filename,
+                   boost::uint64_t offset,
+                   boost::uint64_t length,
+                   CompletionHandler handler)
+{
+    // sender keeps itself alive by binding shared pointer to its pending operations.
+    boost::shared_ptr< FileSender<SocketT> > sender( new FileSender<SocketT>(socket, handler) );
+    sender->start(filename, offset, length);
+}
+
+} // namespace FileSending
+
+} // namespace Http
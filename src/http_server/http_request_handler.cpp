@@ -12,10 +12,12 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
 #include "reply.h"
 #include "request.h"
 #include "mime_types.h"
+#include "websocket.h"
 #include "rpc/request_handler.h"
 #include "utils/util.h"
 #include "plugin/settings.h"
@@ -34,6 +36,9 @@ const std::string kDOWNLOAD_TRACK_TAG("/downloadTrack/"),
                   kUPLOAD_TRACK_TAG("/uploadTrack"),
                   kCookieHeaderName("Cookie");
 
+//! Size of parts of streamed RPC response: client gets data early, memory usage does not depend on response size.
+const std::size_t kSTREAMED_RESPONSE_PART_SIZE = 64 * 1024;
+
 void RequestHandler::trySendInitCookies(const Request& req, Reply& rep)
 {
     const std::vector<header>& headers = req.headers;
@@ -72,17 +77,43 @@ bool RequestHandler::handle_request(const Request& req, Reply& rep, ICometDelaye
         }
     }
 
+    if ( WebSocket::isUpgradeRequest(req) ) { // switch connection to WebSocket channel.
+        WebSocket::fillHandshakeReply(req, rep);
+        return true;
+    }
+
     if ( Rpc::Frontend* frontend = rpc_request_handler_.getFrontEnd(req.uri) ) { // handle RPC call.        
         std::string response_content_type;
-        DelayedResponseSender_ptr comet_delayed_response_sender( new DelayedResponseSender(connection, *this) );
+        DelayedResponseSender_ptr comet_delayed_response_sender( new DelayedResponseSender(connection, *this, ContentEncoding::selectEncoding(req.headers)) );
+
+        // HTTP/1.0 clients do not support chunked transfer coding, so they always get whole response at once.
+        const bool chunked_reply_supported = req.http_version_major > 1 || (req.http_version_major == 1 && req.http_version_minor >= 1);
+        Rpc::StreamedResponse_ptr streamed_response;
 
         boost::tribool result = rpc_request_handler_.handleRequest(req.uri,
                                                                    req.content,
                                                                    comet_delayed_response_sender,
                                                                    *frontend,
                                                                    &rep.content,
-                                                                   &response_content_type
+                                                                   &response_content_type,
+                                                                   chunked_reply_supported ? &streamed_response : nullptr
                                                                    );
+        if (streamed_response) {
+            try {
+                if ( streamed_response->readPart(kSTREAMED_RESPONSE_PART_SIZE, &rep.content) ) {
+                    // the rest of response is produced when the first part has been sent.
+                    fillReplyWithChunkedContent(response_content_type, rep);
+                    rep.content_producer = boost::bind(&Rpc::StreamedResponse::readPart, streamed_response, kSTREAMED_RESPONSE_PART_SIZE, _1);
+                    return true;
+                }
+                // whole response fits in one part, send it as usual.
+            } catch (std::exception& e) {
+                BOOST_LOG_SEV(logger(), error) << "Streamed response on request " << req.uri << " failed. Reason: " << e.what();
+                rep = Reply::stock_reply(Reply::internal_server_error);
+                return true;
+            }
+        }
+
         if (result || !result) {
             if ( Utilities::stringStartsWith(rep.content, kDOWNLOAD_TRACK_TAG) ) { // handle special download track response.
                 Request req_download_track(req);
@@ -91,6 +122,7 @@ bool RequestHandler::handle_request(const Request& req, Reply& rep, ICometDelaye
                 return download_track_request_handler_.handle_request(req_download_track, rep);
             } else { // usual RPC response.
                 fillReplyWithContent(response_content_type, rep);
+                ContentEncoding::compressReply(ContentEncoding::selectEncoding(req.headers), rep);
             }
             return true; // response will be sent immediately.
         }
@@ -107,6 +139,27 @@ bool RequestHandler::handle_request(const Request& req, Reply& rep, ICometDelaye
     return true;
 }
 
+bool RequestHandler::handle_websocket_message(const std::string& message, ICometDelayedConnection_ptr connection, std::string* response)
+{
+    assert(response);
+
+    // Client is authenticated on handshake, so message is passed to JSON-RPC frontend directly.
+    static const std::string kWEBSOCKET_RPC_URI("/RPC_JSON");
+    Rpc::Frontend* frontend = rpc_request_handler_.getFrontEnd(kWEBSOCKET_RPC_URI);
+    assert(frontend);
+
+    std::string response_content_type;
+    DelayedResponseSender_ptr delayed_response_sender( new DelayedResponseSender(connection, *this, ContentEncoding::IDENTITY) );
+    const boost::tribool result = rpc_request_handler_.handleRequest(kWEBSOCKET_RPC_URI,
+                                                                     message,
+                                                                     delayed_response_sender,
+                                                                     *frontend,
+                                                                     response,
+                                                                     &response_content_type
+                                                                     );
+    return result || !result;
+}
+
 void RequestHandler::handle_file_request(const Request& req, Reply& rep)
 {
     // Decode url to path.
@@ -137,21 +190,66 @@ void RequestHandler::handle_file_request(const Request& req, Reply& rep)
         extension = request_path.substr(last_dot_pos);
     }
 
-    // Open the file to send back.
-    std::string full_path = document_root_ + request_path;
-    std::ifstream is(full_path.c_str(), std::ios::in | std::ios::binary);
-    if (!is) {
+    // Get the file to send back.
+    const std::string full_path = document_root_ + request_path;
+    const std::string& content_type = mime_types::extension_to_type(extension);
+    const bool compressible = ContentEncoding::isCompressible(content_type);
+    StaticFileCache::EntryPtr file = static_file_cache_.getFile(full_path, compressible);
+    if (!file) {
         rep = Reply::stock_reply(Reply::not_found);
         return;
     }
 
+    const ContentEncoding::Type encoding = ContentEncoding::selectEncoding(req.headers);
+
+    if ( isNotModified(req.headers, *file) ) {
+        rep.status = Reply::not_modified;
+        // ETag of variant which full reply would contain: content is compressed only if it is big enough.
+        const bool compressed =    compressible
+                                && encoding != ContentEncoding::IDENTITY
+                                && file->content.size() >= ContentEncoding::kMinSizeToCompress;
+        addCacheValidators(*file, compressed ? encoding : ContentEncoding::IDENTITY, rep);
+        if (compressible) {
+            ContentEncoding::addVaryHeader(rep);
+        }
+        return;
+    }
+
     // Fill out the reply to be sent to the client.
-    char buf[512];
-    while (is.read( buf, sizeof(buf) ).gcount() > 0) {
-        rep.content.append( buf, static_cast<std::size_t>( is.gcount() ) ); // cast from int64 to uint32 is safe here since we have maximum 512 bytes.
+    ContentEncoding::Type sent_encoding = ContentEncoding::IDENTITY;
+    if ( encoding == ContentEncoding::GZIP && !file->gzip_content.empty() ) {
+        rep.content = file->gzip_content; // use precompressed variant.
+        fillReplyWithContent(content_type, rep);
+        ContentEncoding::addContentEncodingHeader(encoding, rep);
+        ContentEncoding::addVaryHeader(rep);
+        sent_encoding = encoding;
+    } else {
+        rep.content = file->content;
+        fillReplyWithContent(content_type, rep);
+        ContentEncoding::compressReply(encoding, rep);
+        // compressReply() sends content as is if compression is not worth it.
+        const std::string* content_encoding;
+        if ( get_header_value(rep.headers, "Content-Encoding", content_encoding) ) {
+            sent_encoding = encoding;
+        }
     }
+    addCacheValidators(*file, sent_encoding, rep);
+}
 
-    fillReplyWithContent(mime_types::extension_to_type(extension), rep);
+void RequestHandler::addCacheValidators(const StaticFileCache::Entry& file, ContentEncoding::Type encoding, Reply& rep)
+{
+    rep.headers.push_back(header());
+    rep.headers.back().name = "ETag";
+    rep.headers.back().value = etagOfEncoding(file, encoding);
+
+    rep.headers.push_back(header());
+    rep.headers.back().name = "Last-Modified";
+    rep.headers.back().value = file.last_modified_http_date;
+
+    // ask browser to revalidate file on each use: it is cheap since server replies 304 from memory.
+    rep.headers.push_back(header());
+    rep.headers.back().name = "Cache-Control";
+    rep.headers.back().value = "no-cache";
 }
 
 void RequestHandler::fillReplyWithContent(const std::string& content_type, Reply& rep)
@@ -168,6 +266,19 @@ void RequestHandler::fillReplyWithContent(const std::string& content_type, Reply
     rep.headers.back().value = content_type;
 }
 
+void RequestHandler::fillReplyWithChunkedContent(const std::string& content_type, Reply& rep)
+{
+    rep.status = Reply::ok;
+
+    rep.headers.push_back(header());
+    rep.headers.back().name = "Transfer-Encoding";
+    rep.headers.back().value = "chunked";
+
+    rep.headers.push_back(header());
+    rep.headers.back().name = "Content-Type";
+    rep.headers.back().value = content_type;
+}
+
 void RequestHandler::fillAuthFailReply(Reply& rep)
 {
     rep.status = Reply::unauthorized;
@@ -211,10 +322,17 @@ const Reply& DelayedResponseSender::get_reply() const
     return reply_;
 }
 
+Reply& DelayedResponseSender::get_reply()
+{ 
+    return reply_;
+}
+
 void DelayedResponseSender::send(const std::string& response, const std::string& response_content_type)
 {
+    reply_ = Reply(); // sender of persistent connection is used many times.
     reply_.content = response;
     http_request_handler_.fillReplyWithContent(response_content_type, reply_);
+    ContentEncoding::compressReply(content_encoding_, reply_);
     comet_connection_->sendResponse( shared_from_this() );
 }
 
@@ -5,6 +5,7 @@
 
 #include "stdafx.h"
 #include <ctype.h>
+#include <cstring>
 #include "request_parser.h"
 #include "request.h"
 #include <boost/lexical_cast.hpp>
@@ -16,263 +17,323 @@ namespace Http {
 request_parser::request_parser()
     :
     content_length_(0),
-    state_(method_start),
-    content_consumed_(0)
+    state_(head),
+    content_consumed_(0),
+    transfer_coding_unsupported_(false),
+    content_framed_(false)
 {
 }
 
 void request_parser::reset()
 {
-    state_ = method_start;
+    state_ = head;
+    head_.clear();
+    content_length_ = 0;
     content_consumed_ = 0;
+    transfer_coding_unsupported_ = false;
+    content_framed_ = false;
 }
 
 std::string request_parser::content_length_name_ = "Content-Length";
 const std::string content_type_name = "Content-Type";
+const std::string transfer_encoding_name = "Transfer-Encoding";
 
-boost::tribool request_parser::consume(Request& req, char input)
+bool headers_equal(const std::string& a, const std::string& b);
+
+boost::tuple<boost::tribool, const char*> request_parser::parse(Request& req,
+                                                                const char* begin,
+                                                                const char* end)
 {
-    switch (state_)
-    {
-    case method_start:
-        req.method.clear();
-        req.uri.clear();
-        req.http_version_major = 0;
-        req.http_version_minor = 0;
-        req.headers.clear();
-        req.content.clear();
-        content_length_ = 0;
-
-        if ( !is_char(input) || is_ctl(input) || is_tspecial(input) ) {
-            return false;
-        } else {
-            state_ = method;
-            req.method.push_back(input);
-            return boost::indeterminate;
-        }
-    case method:
-        if (input == ' ') {
-            state_ = uri;
-            return boost::indeterminate;
-        } else if ( !is_char(input) || is_ctl(input) || is_tspecial(input) ) {
-            return false;
-        } else {
-            req.method.push_back(input);
-            return boost::indeterminate;
-        }
-    case uri_start:
-        if ( is_ctl(input) ) {
-            return false;
-        } else {
-            state_ = uri;
-            req.uri.push_back(input);
-            return boost::indeterminate;
-        }
-    case uri:
-        if (input == ' ') {
-            state_ = http_version_h;
-            return boost::indeterminate;
-        } else if ( is_ctl(input) ) {
-            return false;
-        } else {
-            req.uri.push_back(input);
-            return boost::indeterminate;
-        }
-    case http_version_h:
-        if (input == 'H') {
-            state_ = http_version_t_1;
-            return boost::indeterminate;
-        } else {
-            return false;
-        }
-    case http_version_t_1:
-        if (input == 'T') {
-            state_ = http_version_t_2;
-            return boost::indeterminate;
-        } else {
-            return false;
-        }
-    case http_version_t_2:
-        if (input == 'T') {
-            state_ = http_version_p;
-            return boost::indeterminate;
-        } else {
-            return false;
-        }
-    case http_version_p:
-        if (input == 'P') {
-            state_ = http_version_slash;
-            return boost::indeterminate;
-        } else {
-            return false;
+    switch (state_) {
+    case head: {
+        boost::tribool result;
+        boost::tie(result, begin) = parse_head(req, begin, end);
+        if (result || !result) {
+            return boost::make_tuple(result, begin);
         }
-    case http_version_slash:
-        if (input == '/') {
-            req.http_version_major = 0;
-            req.http_version_minor = 0;
-            state_ = http_version_major_start;
-            return boost::indeterminate;
-        } else {
-            return false;
-        }
-    case http_version_major_start:
-        if ( is_digit(input) ) {
-            req.http_version_major = req.http_version_major * 10 + input - '0';
-            state_ = http_version_major;
-            return boost::indeterminate;
-        } else {
-            return false;
-        }
-    case http_version_major:
-        if (input == '.') {
-            state_ = http_version_minor_start;
-            return boost::indeterminate;
-        } else if ( is_digit(input) ) {
-            req.http_version_major = req.http_version_major * 10 + input - '0';
-            return boost::indeterminate;
-        } else {
-            return false;
-        }
-    case http_version_minor_start:
-        if ( is_digit(input) ) {
-            req.http_version_minor = req.http_version_minor * 10 + input - '0';
-            state_ = http_version_minor;
-            return boost::indeterminate;
-        } else {
-            return false;
+
+        switch (state_) {
+        case content:
+            return parse_content(req, begin, end);
+        case content_multipart_formdata:
+            return parse_mpfd(req, begin, end);
+        default:
+            return boost::make_tuple(result, begin); // head is not complete yet.
         }
-    case http_version_minor:
-        if (input == '\r') {
-            state_ = expecting_newline_1;
-            return boost::indeterminate;
-        } else if ( is_digit(input) ) {
-            req.http_version_minor = req.http_version_minor * 10 + input - '0';
-            return boost::indeterminate;
-        } else {
-            return false;
+    }
+    case content:
+        return parse_content(req, begin, end);
+    case content_multipart_formdata:
+        return parse_mpfd(req, begin, end);
+    default:
+        assert(!"unexpected parser state");
+        return boost::make_tuple(false, begin);
+    }
+}
+
+std::size_t request_parser::find_head_end(const std::string& data, std::size_t search_from)
+{
+    // memchr is vectorized by CRT, so scan for LF and check preceding bytes only at found positions.
+    const char* const first = data.data();
+    const char* const last = first + data.size();
+    const char* lf = first + search_from;
+    while ( lf != last
+            && ( lf = static_cast<const char*>( std::memchr(lf, '\n', last - lf) ) ) != nullptr
+           )
+    {
+        if (lf - first >= 3 && lf[-1] == '\r' && lf[-2] == '\n' && lf[-3] == '\r') {
+            return lf + 1 - first;
         }
-    case expecting_newline_1:
-        if (input == '\n') {
-            state_ = header_line_start;
-            return boost::indeterminate;
-        } else {
-            return false;
+        ++lf;
+    }
+    return std::string::npos;
+}
+
+boost::tuple<boost::tribool, const char*> request_parser::parse_head(Request& req, const char* begin, const char* end)
+{
+    const std::size_t old_size = head_.size();
+    head_.append(begin, end);
+
+    const std::size_t head_end = find_head_end(head_, old_size);
+    if (head_end == std::string::npos) {
+        if (head_.size() > kMaxHeadSize) {
+            return boost::make_tuple(false, end);
         }
-    case header_line_start:
-        if (input == '\r') {
-            state_ = expecting_newline_3;
-            return boost::indeterminate;
-        } else if ( !req.headers.empty() && (input == ' ' || input == '\t') ) {
-            state_ = header_lws;
-            return boost::indeterminate;
-        } else if ( !is_char(input) || is_ctl(input) || is_tspecial(input) ) {
-            return false;
-        } else {
-            req.headers.push_back(header());
-            req.headers.back().name.push_back(input);
-            state_ = header_name;
-            return boost::indeterminate;
+        boost::tribool result = boost::indeterminate;
+        return boost::make_tuple(result, end); // all data has been consumed, wait for the rest of headers.
+    }
+
+    // data after empty line belongs to content or next request, return it to caller.
+    head_.resize(head_end);
+    const char* const head_data_end = begin + (head_end - old_size);
+    return boost::make_tuple(process_head(req), head_data_end);
+}
+
+boost::tribool request_parser::process_head(Request& req)
+{
+    req.method.clear();
+    req.uri.clear();
+    req.http_version_major = 0;
+    req.http_version_minor = 0;
+    req.headers.clear();
+    req.content.clear();
+    content_length_ = 0;
+    content_framed_ = false;
+
+    const char* line_begin = head_.data();
+    const char* const head_end = line_begin + head_.size();
+    bool request_line = true;
+    while (line_begin != head_end) {
+        const char* const lf = static_cast<const char*>( std::memchr(line_begin, '\n', head_end - line_begin) );
+        assert(lf); // head always ends with CRLFCRLF.
+        if (lf == line_begin || lf[-1] != '\r') {
+            return false; // line must end with CRLF.
         }
-    case header_lws:
-        if (input == '\r') {
-            state_ = expecting_newline_2;
-            return boost::indeterminate;
-        } else if (input == ' ' || input == '\t') {
-            return boost::indeterminate;
-        } else if ( is_ctl(input) ) {
-            return false;
-        } else {
-            state_ = header_value;
-            req.headers.back().value.push_back(input);
-            return boost::indeterminate;
+        const char* const line_end = lf - 1;
+
+        if (line_begin == line_end) {
+            break; // empty line: end of headers.
         }
-    case header_name:
-        if (input == ':') {
-            state_ = space_before_header_value;
-            return boost::indeterminate;
-        } else if ( !is_char(input) || is_ctl(input) || is_tspecial(input) ) {
+
+        if (request_line) {
+            if ( !parse_request_line(req, line_begin, line_end) ) {
+                return false;
+            }
+            request_line = false;
+        } else if ( !parse_header_line(req, line_begin, line_end) ) {
             return false;
-        } else {
-            req.headers.back().name.push_back(input);
-            return boost::indeterminate;
         }
-    case space_before_header_value:
-        if (input == ' ') {
-            state_ = header_value;
-            return boost::indeterminate;
-        } else {
-            return false;
+
+        line_begin = lf + 1;
+    }
+
+    if (request_line) {
+        return false; // no request line.
+    }
+
+    // Only Content-Length frames content. Content in transfer coding(chunked) would be taken as next pipelined request, so it is rejected.
+    const std::string* content_length_value;
+    const bool has_content_length = get_header_value(req.headers, content_length_name_, content_length_value);
+    const std::string* transfer_encoding_value;
+    if ( get_header_value(req.headers, transfer_encoding_name, transfer_encoding_value) ) {
+        transfer_coding_unsupported_ = !has_content_length; // message with both headers is malformed.
+        return false;
+    }
+
+    if (!has_content_length) {
+        content_framed_ = true;
+        return true; // no Content-Length header, stop parsing.
+    }
+
+    const std::size_t content_length_headers_count = std::count_if(req.headers.begin(), req.headers.end(),
+                                                                   [](const header& h) { return headers_equal(h.name, content_length_name_); }
+                                                                   );
+    if (content_length_headers_count != 1) {
+        return false; // ambiguous content length.
+    }
+
+    if ( content_length_value->empty() || std::find_if_not(content_length_value->begin(), content_length_value->end(), &request_parser::is_digit) != content_length_value->end() ) {
+        return false; // lexical_cast accepts sign.
+    }
+
+    try {
+        content_length_ = boost::lexical_cast<std::size_t>(*content_length_value);
+    } catch (boost::bad_lexical_cast&) {
+        return false;
+    }
+    content_framed_ = true;
+
+    if (content_length_ == 0) {
+        return true; // empty content, stop parsing. Next byte belongs to next pipelined request.
+    }
+
+    const std::string* content_type_value;
+    if ( get_header_value(req.headers, content_type_name, content_type_value) ) {
+        if ( boost::starts_with(*content_type_value, "multipart/form-data;") ) {
+            using namespace MPFD;
+            if ( ParserFactory::instance() ) {
+                req.mpfd_parser = ParserFactory::instance()->createParser(*content_type_value);
+                state_ = content_multipart_formdata;
+                return boost::indeterminate;
+            } else {
+                return false;
+            }
         }
-    case header_value:
-        if (input == '\r') {
-            state_ = expecting_newline_2;
-            return boost::indeterminate;
-        } else if ( is_ctl(input) ) {
+    }
+
+    if (content_length_ > kMaxContentLength) {
+        return false;
+    }
+
+    req.content.reserve(content_length_);
+    state_ = content;
+    return boost::indeterminate;
+}
+
+bool request_parser::parse_request_line(Request& req, const char* begin, const char* end)
+{
+    // method
+    const char* p = begin;
+    while (p != end && *p != ' ') {
+        if ( !is_token_char(*p) ) {
             return false;
-        } else {
-            req.headers.back().value.push_back(input);
-            return boost::indeterminate;
         }
-    case expecting_newline_2:
-        if (input == '\n') {
-            state_ = header_line_start;
-            return boost::indeterminate;
-        } else {
+        ++p;
+    }
+    if (p == begin || p == end) {
+        return false;
+    }
+    req.method.assign(begin, p);
+
+    // uri
+    const char* const uri_begin = ++p;
+    p = static_cast<const char*>( std::memchr(uri_begin, ' ', end - uri_begin) );
+    if (!p || p == uri_begin) {
+        return false;
+    }
+    if ( std::find_if(uri_begin, p, &request_parser::is_ctl) != p ) {
+        return false;
+    }
+    req.uri.assign(uri_begin, p);
+
+    // version
+    ++p;
+    static const char kHTTP[] = "HTTP/";
+    const std::size_t kHTTPLength = sizeof(kHTTP) - 1;
+    if ( static_cast<std::size_t>(end - p) < kHTTPLength || std::memcmp(p, kHTTP, kHTTPLength) != 0 ) {
+        return false;
+    }
+    p += kHTTPLength;
+
+    const char* const major_begin = p;
+    while ( p != end && is_digit(*p) ) {
+        req.http_version_major = req.http_version_major * 10 + *p++ - '0';
+    }
+    if (p == major_begin || p == end || *p != '.') {
+        return false;
+    }
+
+    const char* const minor_begin = ++p;
+    while ( p != end && is_digit(*p) ) {
+        req.http_version_minor = req.http_version_minor * 10 + *p++ - '0';
+    }
+    return p != minor_begin && p == end;
+}
+
+bool request_parser::parse_header_line(Request& req, const char* begin, const char* end)
+{
+    const auto is_lws = [](char c) { return c == ' ' || c == '\t'; };
+    const auto is_invalid_value_char = [](char c) { return c != '\t' && is_ctl(c); };
+
+    if ( is_lws(*begin) ) {
+        // continuation of previous header value.
+        if ( req.headers.empty() ) {
             return false;
         }
-    case expecting_newline_3:
-        if (input == '\n') {
-            // Check for optional Content-Length header.
-            const std::string* content_length_value;
-            if (get_header_value(req.headers, content_length_name_, content_length_value)) {
-                try {
-                    content_length_ = boost::lexical_cast<std::size_t>(*content_length_value);
-                    state_ = select_content_parser;
-                    return boost::indeterminate;
-                } catch (boost::bad_lexical_cast&) {
-                    return false;
-                }
-            }
-            
-            return true; // no Content-Length header, stop parsing.           
-        } else {
+        const char* const value_begin = std::find_if_not(begin, end, is_lws);
+        if (std::find_if(value_begin, end, is_invalid_value_char) != end) {
             return false;
         }
-    case select_content_parser: {
-        state_ = content;
-
-        const std::string* content_type_value;
-        if (get_header_value(req.headers, content_type_name, content_type_value)) {
-            if (boost::starts_with(*content_type_value, "multipart/form-data;")) {
-                using namespace MPFD;
-                if (ParserFactory::instance()) {
-                    req.mpfd_parser = ParserFactory::instance()->createParser(*content_type_value);
-                    state_ = content_multipart_formdata;
-                    return boost::indeterminate;
-                } else {
-                    return false;
-                }
-            }
-        }
+        req.headers.back().value.append(value_begin, end);
+        return true;
+    }
 
-        return consume(req, input);
-                                }
-    case content:
-        // Content.
-        if (req.content.size() < content_length_) {
-            req.content.push_back(input);
-            if (req.content.size() == content_length_) {
-                return true;  // all content has been consumed, stop parsing.
-            }
-            return boost::indeterminate;
-        }
+    const char* const colon = static_cast<const char*>( std::memchr(begin, ':', end - begin) );
+    if (!colon || colon == begin) {
         return false;
-    case content_multipart_formdata:
-        assert(!"mpfd must not be processed by one char");
+    }
+    if ( std::find_if_not(begin, colon, &request_parser::is_token_char) != colon ) {
         return false;
-    default:
+    }
+
+    const char* const value_begin = std::find_if_not(colon + 1, end, is_lws);
+    if (std::find_if(value_begin, end, is_invalid_value_char) != end) {
         return false;
     }
+
+    req.headers.push_back(header());
+    header& h = req.headers.back();
+    h.name.assign(begin, colon);
+    h.value.assign(value_begin, end);
+    return true;
+}
+
+boost::tuple<boost::tribool, const char*> request_parser::parse_content(Request& req, const char* begin, const char* end)
+{
+    assert(state_ == content);
+    assert(req.content.size() < content_length_);
+
+    const std::size_t length = std::min<std::size_t>(end - begin, content_length_ - req.content.size());
+    req.content.append(begin, length);
+
+    boost::tribool result = boost::indeterminate;
+    if (req.content.size() == content_length_) {
+        result = true; // all content has been consumed, stop parsing.
+    }
+    return boost::make_tuple(result, begin + length);
+}
+
+boost::tuple<boost::tribool, const char*> request_parser::parse_mpfd(Request& req, const char* begin, const char* end)
+{
+    assert(state_ == content_multipart_formdata);
+
+    if (content_consumed_ < content_length_) {
+        assert(begin <= end);
+        const std::size_t length = std::min<std::size_t>(end - begin, content_length_ - content_consumed_);
+        assert(req.mpfd_parser);
+        try {
+            req.mpfd_parser->AcceptSomeData(begin, length);
+        } catch (::MPFD::Exception&) {
+            return boost::make_tuple(false, begin); // malformed multipart content or file writing error.
+        }
+        content_consumed_ += length;
+        boost::tribool result = boost::indeterminate;
+        if (content_consumed_ == content_length_) {
+            result = true; // all content has been consumed, stop parsing.
+        }
+        return boost::make_tuple(result, begin + length);
+    }
+    return boost::make_tuple(false, begin);
 }
 
 bool request_parser::is_char(int c)
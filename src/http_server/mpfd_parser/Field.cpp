@@ -7,6 +7,8 @@
 
 #include "Field.h"
 #include "Parser.h"
+#include "utils/string_encoding.h"
+#include <boost/filesystem/operations.hpp>
 
 MPFD::Field::Field() {
     type = 0;
@@ -14,16 +16,25 @@ MPFD::Field::Field() {
 
     FieldContentLength = 0;
 
+    Ignored = false;
 }
 
 MPFD::Field::~Field() {
 
     if (FieldContent) {
-	delete FieldContent;
+	free(FieldContent); // allocated by malloc/realloc.
     }
 
     if (type == FileType) {
-	if (file.is_open()) {
+	if (WhereToStoreUploadedFiles == Parser::StoreUploadedFilesInDestinationDir) {
+	    if (file.is_open()) {
+		file.close();
+	    }
+	    if (!TempFilePath.empty()) { // upload was interrupted or not accepted by handler. Only own temporary file is removed, never existing file with client's name.
+		boost::system::error_code ignored_ec;
+		boost::filesystem::remove(TempFilePath, ignored_ec);
+	    }
+	} else if (file.is_open()) {
 	    file.close();
 	    remove((TempDir + "/" + TempFile).c_str());
 	}
@@ -52,15 +63,27 @@ int MPFD::Field::GetType() {
 void MPFD::Field::AcceptSomeData(char *data, long length) {
     if (type == TextType) {
 	if (FieldContent == NULL) {
-	    FieldContent = new char[length + 1];
+	    FieldContent = (char*) malloc(length + 1);
 	} else {
 	    FieldContent = (char*) realloc(FieldContent, FieldContentLength + length + 1);
 	}
 
 	memcpy(FieldContent + FieldContentLength, data, length);
-	FieldContent[FieldContentLength + length] = 0;
+	FieldContentLength += length;
+	FieldContent[FieldContentLength] = 0;
     } else if (type == FileType) {
-	if (WhereToStoreUploadedFiles == Parser::StoreUploadedFilesInFilesystem) {
+	if (Ignored) {
+	    return; // content is skipped.
+	}
+	if (WhereToStoreUploadedFiles == Parser::StoreUploadedFilesInDestinationDir) {
+	    if (!file.is_open()) {
+		OpenDestinationFile();
+	    }
+	    file.write(data, length);
+	    if (!file) {
+		throw Exception(std::string("Cannot write to file ") + TempFilePath.string());
+	    }
+	} else if (WhereToStoreUploadedFiles == Parser::StoreUploadedFilesInFilesystem) {
 	    if (TempDir.length() > 0) {
 		if (!file.is_open()) {
 		    int i = 1;
@@ -86,7 +109,6 @@ void MPFD::Field::AcceptSomeData(char *data, long length) {
 
 		if (file.is_open()) {
 		    file.write(data, length);
-		    file.flush();
 		} else {
 		    throw Exception(std::string("Cannot write to file ") + TempDir + "/" + TempFile);
 		}
@@ -95,7 +117,7 @@ void MPFD::Field::AcceptSomeData(char *data, long length) {
 	    }
 	} else { // If files are stored in memory
 	    if (FieldContent == NULL) {
-		FieldContent = new char[length];
+		FieldContent = (char*) malloc(length);
 	    } else {
 		FieldContent = (char*) realloc(FieldContent, FieldContentLength + length);
 	    }
@@ -107,6 +129,102 @@ void MPFD::Field::AcceptSomeData(char *data, long length) {
     }
 }
 
+boost::filesystem::path MPFD::Field::GetDestinationFileName() {
+    // Use only name part: some browsers send full path of file on client side.
+    const boost::filesystem::path filename = boost::filesystem::path(StringEncoding::utf8_to_utf16(FileName)).filename();
+    if (filename.empty() || filename == "." || filename == "..") {
+	throw MPFD::Exception(std::string("Invalid file name: ") + FileName);
+    }
+    return filename;
+}
+
+void MPFD::Field::OpenDestinationFile() {
+    if (TempDir.empty()) {
+	throw MPFD::Exception("Trying to AcceptSomeData for a file but no TempDir is set.");
+    }
+
+    // Content is written under unique name in the same dir: concurrent uploads of files with the same name do not mix,
+    // and file is moved to its final name without copying when upload is accepted by handler.
+    GetDestinationFileName(); // reject invalid name before content is received.
+    TempFilePath = boost::filesystem::path(TempDir) / boost::filesystem::unique_path(L"upload-%%%%-%%%%-%%%%-%%%%.tmp");
+    file.open(TempFilePath, std::ios::out | std::ios::binary | std::ios_base::trunc);
+    if (!file.is_open()) {
+	const std::string path = TempFilePath.string();
+	TempFilePath.clear(); // it is not our file.
+	throw Exception(std::string("Cannot open file ") + path);
+    }
+}
+
+void MPFD::Field::MoveToDestinationFile() {
+    if (type != FileType || WhereToStoreUploadedFiles != Parser::StoreUploadedFilesInDestinationDir || Ignored) {
+	throw MPFD::Exception("Trying to move file to destination dir, but the field is not file stored in destination dir.");
+    }
+    if (TempFilePath.empty()) {
+	throw MPFD::Exception("Trying to move file to destination dir, but file has been moved already or was not received.");
+    }
+
+    const boost::filesystem::path filename = GetDestinationFileName();
+    const boost::filesystem::path stem = filename.stem(),
+                                  extension = filename.extension();
+    // MoveFile never replaces existing file: it can be used by player already. Free name is searched then.
+    for (int index = 0; ; ++index) {
+	boost::filesystem::path destination_filename = filename;
+	if (index > 0) {
+	    destination_filename = stem.native() + L" (" + boost::lexical_cast<std::wstring>(index) + L")" + extension.native();
+	}
+	const boost::filesystem::path destination = boost::filesystem::path(TempDir) / destination_filename;
+	if (::MoveFileW(TempFilePath.c_str(), destination.c_str())) {
+	    FilePath = destination;
+	    TempFilePath.clear();
+	    return;
+	}
+
+	const DWORD error = ::GetLastError();
+	if (error != ERROR_ALREADY_EXISTS && error != ERROR_FILE_EXISTS) {
+	    throw Exception(std::string("Cannot move file ") + TempFilePath.string() + " to " + destination.string()
+			    + ". Error " + boost::lexical_cast<std::string>(error));
+	}
+    }
+}
+
+void MPFD::Field::Finish() {
+    if (type == FileType && Ignored) {
+	return;
+    }
+    if (type == FileType && WhereToStoreUploadedFiles == Parser::StoreUploadedFilesInDestinationDir) {
+	if (!file.is_open()) {
+	    OpenDestinationFile(); // empty file.
+	}
+	file.close();
+	if (file.fail()) {
+	    throw Exception(std::string("Cannot write to file ") + TempFilePath.string());
+	}
+    } else if (file.is_open()) {
+	file.flush();
+    }
+}
+
+boost::filesystem::path MPFD::Field::GetFilePath() {
+    if (type != FileType || WhereToStoreUploadedFiles != Parser::StoreUploadedFilesInDestinationDir) {
+	throw MPFD::Exception("Trying to get file path, but the field is not file stored in destination dir.");
+    }
+    if (FilePath.empty()) {
+	throw MPFD::Exception("Trying to get file path, but file has not been moved to destination dir.");
+    }
+    return FilePath;
+}
+
+void MPFD::Field::Ignore() {
+    if (type != FileType) {
+	throw MPFD::Exception("Trying to ignore content of the field, but the type is not file.");
+    }
+    Ignored = true;
+}
+
+bool MPFD::Field::IsIgnored() const {
+    return Ignored;
+}
+
 void MPFD::Field::SetTempDir(std::string dir) {
     TempDir = dir;
 }
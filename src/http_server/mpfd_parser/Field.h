@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sstream>
+#include <boost/filesystem/fstream.hpp>
 
 namespace MPFD {
 
@@ -28,6 +29,18 @@ namespace MPFD {
 
         void AcceptSomeData(char *data, long length);
 
+        // Called by parser when all content of field has been received.
+        // File stored in destination dir is closed. It stays under temporary name and is removed in destructor until MoveToDestinationFile() is called.
+        void Finish();
+
+        // Renames received file from temporary name to client's file name. Called by handler when upload is accepted.
+        // Existing file is never replaced, " (N)" is appended to name instead. File will not be removed in destructor.
+        void MoveToDestinationFile();
+
+        // Content of file field is skipped, nothing is written. Used for files of unsupported types.
+        void Ignore();
+        bool IsIgnored() const;
+
 
         // File functions
         void SetUploadedFilesStorage(int where);
@@ -36,6 +49,9 @@ namespace MPFD {
         void SetFileName(std::string name);
         std::string GetFileName();
 
+        // Name part of file name sent by client. Throws Exception if name is invalid.
+        boost::filesystem::path GetDestinationFileName();
+
         void SetFileContentType(std::string type);
         std::string GetFileMimeType();
 
@@ -44,6 +60,9 @@ namespace MPFD {
 
         std::string GetTempFileName();
 
+        // Path of file moved to destination dir. It differs from client file name if file with that name already exists.
+        boost::filesystem::path GetFilePath();
+
         // Text field operations
         std::string GetTextTypeContent();
 
@@ -58,9 +77,15 @@ namespace MPFD {
         std::string TempDir, TempFile;
         std::string FileContentType, FileName;
 
+        boost::filesystem::path FilePath, TempFilePath;
+
         int type;
         char * FieldContent;
-        std::ofstream file;
+        boost::filesystem::ofstream file;
+
+        bool Ignored;
+
+        void OpenDestinationFile();
 
     };
 }
@@ -17,12 +17,13 @@ const std::map<std::string, MPFD::Field *> MPFD::Parser::GetFieldsMap() const {
 }
 
 MPFD::Parser::Parser() {
-    DataCollector = NULL;
-    DataCollectorLength = 0;
-    _HeadersOfTheFieldAreProcessed = false;
+    ProcessingField = NULL;
+    BufferStart = 0;
+    BufferLength = 0;
+    HeadersEndSearchFrom = 0;
     CurrentStatus = Status_LookingForStartingBoundary;
 
-    MaxDataCollectorLength = 16 * 1024 * 1024; // 16 Mb default data collector size.
+    Buffer.resize(DefaultBufferSize);
 
     SetUploadedFilesStorage(StoreUploadedFilesInFilesystem);
 }
@@ -32,10 +33,6 @@ MPFD::Parser::~Parser() {
     for (it = Fields.begin(); it != Fields.end(); it++) {
         delete it->second;
     }
-
-    if (DataCollector) {
-        delete DataCollector;
-    }
 }
 
 void MPFD::Parser::SetContentType(const std::string type) {
@@ -51,32 +48,86 @@ void MPFD::Parser::SetContentType(const std::string type) {
     }
 
     Boundary = std::string("--") + type.substr(bp + 9, type.length() - bp);
+    Delimiter = std::string("\r\n") + Boundary;
+    if (Delimiter.length() * 2 > Buffer.size()) {
+        throw MPFD::Exception("Boundary is too long.");
+    }
+
+    const long m = Delimiter.length();
+    for (int c = 0; c < 256; c++) {
+        DelimiterSkipTable[c] = m;
+    }
+    for (long k = 0; k < m - 1; k++) {
+        DelimiterSkipTable[static_cast<unsigned char>(Delimiter[k])] = m - 1 - k;
+    }
+
+    // Starting boundary is not preceded by CRLF. Put CRLF into buffer, so the same delimiter search is used for it.
+    WriteToBuffer("\r\n", 2);
 }
 
 void MPFD::Parser::AcceptSomeData(const char *data, const long length) {
     if (Boundary.length() > 0) {
-        // Append data to existing accumulator
-        if (DataCollector == NULL) {
-            DataCollector = new char[length];
-            memcpy(DataCollector, data, length);
-            DataCollectorLength = length;
-        } else {
-            DataCollector = (char*) realloc(DataCollector, DataCollectorLength + length);
-            memcpy(DataCollector + DataCollectorLength, data, length);
-            DataCollectorLength += length;
-        }
+        long offset = 0;
+        while (offset < length) {
+            // Copy as much data as fits to ring buffer and process it to free space for the rest.
+            const long free_space = static_cast<long>(Buffer.size()) - BufferLength;
+            if (free_space == 0) {
+                throw Exception("Headers of the field are too long.");
+            }
+            const long chunk_length = std::min(free_space, length - offset);
+            WriteToBuffer(data + offset, chunk_length);
+            offset += chunk_length;
 
-        if (DataCollectorLength > MaxDataCollectorLength) {
-            throw Exception("Maximum data collector length reached.");
+            _ProcessData();
         }
-
-        _ProcessData();
     } else {
         throw MPFD::Exception("Accepting data, but content type was not set.");
     }
 
 }
 
+void MPFD::Parser::WriteToBuffer(const char *data, long length) {
+    const long capacity = Buffer.size();
+    const long end = (BufferStart + BufferLength) & (capacity - 1);
+    const long first_part_length = std::min(length, capacity - end);
+    memcpy(&Buffer[end], data, first_part_length);
+    memcpy(&Buffer[0], data + first_part_length, length - first_part_length);
+    BufferLength += length;
+}
+
+void MPFD::Parser::Consume(long n) {
+    BufferStart = (BufferStart + n) & (Buffer.size() - 1);
+    BufferLength -= n;
+}
+
+void MPFD::Parser::PassToField(long n) {
+    // Data can wrap around the end of buffer, so it is passed by two parts at most.
+    const long first_part_length = std::min(n, static_cast<long>(Buffer.size()) - BufferStart);
+    if (first_part_length > 0) {
+        ProcessingField->AcceptSomeData(&Buffer[BufferStart], first_part_length);
+    }
+    if (n > first_part_length) {
+        ProcessingField->AcceptSomeData(&Buffer[0], n - first_part_length);
+    }
+    Consume(n);
+}
+
+long MPFD::Parser::FindDelimiter() const {
+    const long m = Delimiter.length();
+    const char *pattern = Delimiter.data();
+    for (long i = 0; i + m <= BufferLength; ) {
+        long j = m - 1;
+        while (j >= 0 && At(i + j) == pattern[j]) {
+            j--;
+        }
+        if (j < 0) {
+            return i;
+        }
+        i += DelimiterSkipTable[static_cast<unsigned char>(At(i + m - 1))];
+    }
+    return -1;
+}
+
 void MPFD::Parser::_ProcessData() {
     // If some data left after truncate, process it right now.
     // Do not wait for AcceptSomeData called again
@@ -86,12 +137,16 @@ void MPFD::Parser::_ProcessData() {
         NeedToRepeat = false;
         switch (CurrentStatus) {
             case Status_LookingForStartingBoundary:
-                if (FindStartingBoundaryAndTruncData()) {
-                    CurrentStatus = Status_ProcessingHeaders;
+                if (FindStartingBoundary()) {
+                    CurrentStatus = Status_ProcessingBoundaryEnding;
                     NeedToRepeat = true;
                 }
                 break;
 
+            case Status_ProcessingBoundaryEnding:
+                NeedToRepeat = ProcessBoundaryEnding();
+                break;
+
             case Status_ProcessingHeaders:
                 if (WaitForHeadersEndAndParseThem()) {
                     CurrentStatus = Status_ProcessingContentOfTheField;
@@ -101,55 +156,80 @@ void MPFD::Parser::_ProcessData() {
 
             case Status_ProcessingContentOfTheField:
                 if (ProcessContentOfTheField()) {
-                    CurrentStatus = Status_LookingForStartingBoundary;
+                    CurrentStatus = Status_ProcessingBoundaryEnding;
                     NeedToRepeat = true;
                 }
                 break;
+
+            case Status_Finished:
+                Consume(BufferLength); // ignore epilogue.
+                break;
         }
     } while (NeedToRepeat);
 }
 
-bool MPFD::Parser::ProcessContentOfTheField() {
-    long BoundaryPosition = BoundaryPositionInDataCollector();
-    long DataLengthToSendToField;
-    if (BoundaryPosition >= 0) {
-        // 2 is the \r\n before boundary we do not need them
-        DataLengthToSendToField = BoundaryPosition - 2;
-    } else {
-        // We need to save +2 chars for \r\n chars before boundary
-        DataLengthToSendToField = DataCollectorLength - (Boundary.length() + 2);
+bool MPFD::Parser::FindStartingBoundary() {
+    const long DelimiterPosition = FindDelimiter();
+    if (DelimiterPosition >= 0) {
+        Consume(DelimiterPosition + Delimiter.length());
+        return true;
     }
 
-    if (DataLengthToSendToField > 0) {
-        Fields[ProcessingFieldName]->AcceptSomeData(DataCollector, DataLengthToSendToField);
-        TruncateDataCollectorFromTheBeginning(DataLengthToSendToField);
+    // Preamble is ignored, keep only bytes which can be beginning of delimiter.
+    Consume(std::max(0L, BufferLength - static_cast<long>(Delimiter.length() - 1)));
+    return false;
+}
+
+bool MPFD::Parser::ProcessBoundaryEnding() {
+    if (BufferLength < 2) {
+        return false;
     }
 
-    if (BoundaryPosition >= 0) {
-        CurrentStatus = Status_LookingForStartingBoundary;
-        return true;
+    if (At(0) == '-' && At(1) == '-') {
+        CurrentStatus = Status_Finished; // it was the last boundary.
+    } else if (At(0) == '\r' && At(1) == '\n') {
+        CurrentStatus = Status_ProcessingHeaders;
+        HeadersEndSearchFrom = 0;
     } else {
-        return false;
+        throw Exception("Boundary is not followed by CRLF.");
     }
+    Consume(2);
+    return true;
 }
 
 bool MPFD::Parser::WaitForHeadersEndAndParseThem() {
-    for (int i = 0; i < DataCollectorLength - 3; i++) {
-        if ((DataCollector[i] == 13) && (DataCollector[i + 1] == 10) && (DataCollector[i + 2] == 13) && (DataCollector[i + 3] == 10)) {
-            long headers_length = i;
-            char *headers = new char[headers_length + 1];
-            memset(headers, 0, headers_length + 1);
-            memcpy(headers, DataCollector, headers_length);
-
-            _ParseHeaders(std::string(headers));
-
-            TruncateDataCollectorFromTheBeginning(i + 4);
+    for (long i = HeadersEndSearchFrom; i < BufferLength - 3; i++) {
+        if ((At(i) == 13) && (At(i + 1) == 10) && (At(i + 2) == 13) && (At(i + 3) == 10)) {
+            std::string headers(i, '\0');
+            for (long k = 0; k < i; k++) {
+                headers[k] = At(k);
+            }
 
-            delete headers;
+            _ParseHeaders(headers);
 
+            Consume(i + 4);
             return true;
         }
     }
+    HeadersEndSearchFrom = std::max(0L, BufferLength - 3); // do not scan the same data again.
+    return false;
+}
+
+bool MPFD::Parser::ProcessContentOfTheField() {
+    const long DelimiterPosition = FindDelimiter();
+    if (DelimiterPosition >= 0) {
+        PassToField(DelimiterPosition);
+        Consume(Delimiter.length());
+        ProcessingField->Finish();
+        ProcessingField = NULL;
+        return true;
+    }
+
+    // Keep bytes which can be beginning of delimiter, pass the rest.
+    const long DataLengthToSendToField = BufferLength - static_cast<long>(Delimiter.length() - 1);
+    if (DataLengthToSendToField > 0) {
+        PassToField(DataLengthToSendToField);
+    }
     return false;
 }
 
@@ -161,6 +241,10 @@ void MPFD::Parser::SetTempDirForFileUpload(std::string dir) {
     TempDirForFileUpload = dir;
 }
 
+void MPFD::Parser::SetFileNameFilter(FileNameFilter filter) {
+    FileNameFilter_ = filter;
+}
+
 void MPFD::Parser::_ParseHeaders(std::string headers) {
     // Check if it is form data
     if (headers.find("Content-Disposition: form-data;") == std::string::npos) {
@@ -172,6 +256,7 @@ void MPFD::Parser::_ParseHeaders(std::string headers) {
     if (name_pos == std::string::npos) {
         throw Exception(std::string("Accepted headers of field does not contain \"name=\".\nThe headers are: \"") + headers + std::string("\""));
     } else {
+        std::string ProcessingFieldName;
         size_t name_end_pos = headers.find("\"", name_pos + 6);
         if (name_end_pos == std::string::npos) {
             throw Exception(std::string("Cannot find closing quote of \"name=\" attribute.\nThe headers are: \"") + headers + std::string("\""));
@@ -183,7 +268,7 @@ void MPFD::Parser::_ParseHeaders(std::string headers) {
                 ProcessingFieldName = original + boost::lexical_cast<std::string>(index);
             }
             }
-            Fields[ProcessingFieldName] = new Field();
+            Fields[ProcessingFieldName] = ProcessingField = new Field();
         }
 
 
@@ -202,6 +287,9 @@ void MPFD::Parser::_ParseHeaders(std::string headers) {
             } else {
                 std::string filename = headers.substr(filename_pos + 10, filename_end_pos - (filename_pos + 10));
                 Fields[ProcessingFieldName]->SetFileName(filename);
+                if (FileNameFilter_ && !FileNameFilter_(Fields[ProcessingFieldName]->GetDestinationFileName())) {
+                    Fields[ProcessingFieldName]->Ignore(); // nothing is written to disk, other fields are processed as usual.
+                }
             }
 
             // find Content-Type if exists
@@ -226,51 +314,23 @@ void MPFD::Parser::_ParseHeaders(std::string headers) {
 }
 
 void MPFD::Parser::SetMaxCollectedDataLength(long max) {
-    MaxDataCollectorLength = max;
-}
-
-void MPFD::Parser::TruncateDataCollectorFromTheBeginning(long n) {
-    long TruncatedDataCollectorLength = DataCollectorLength - n;
-
-    char *tmp = DataCollector;
-
-    DataCollector = new char[TruncatedDataCollectorLength];
-    memcpy(DataCollector, tmp + n, TruncatedDataCollectorLength);
-
-    DataCollectorLength = TruncatedDataCollectorLength;
-
-    delete tmp;
-
-}
-
-long MPFD::Parser::BoundaryPositionInDataCollector() {
-    const char *b = Boundary.c_str();
-    int bl = Boundary.length();
-    if (DataCollectorLength >= bl) {
-        bool found = false;
-        for (int i = 0; (i <= DataCollectorLength - bl) && (!found); i++) {
-            found = true;
-            for (int j = 0; (j < bl) && (found); j++) {
-                if (DataCollector[i + j] != b[j]) {
-                    found = false;
-                }
-            }
-
-            if (found) {
-                return i;
-            }
-        }
+    if (CurrentStatus != Status_LookingForStartingBoundary || BufferLength > 2) {
+        throw Exception("Buffer size can't be changed after data was accepted.");
     }
-    return -1;
 
-}
+    long capacity = 1;
+    while (capacity < max) {
+        capacity <<= 1;
+    }
+    if (static_cast<long>(Delimiter.length()) * 2 > capacity) {
+        throw Exception("Buffer size is too small for boundary.");
+    }
 
-bool MPFD::Parser::FindStartingBoundaryAndTruncData() {
-    long n = BoundaryPositionInDataCollector();
-    if (n >= 0) {
-        TruncateDataCollectorFromTheBeginning(n + Boundary.length());
-        return true;
-    } else {
-        return false;
+    const bool content_type_is_set = BufferLength > 0; // buffer contains only CRLF written by SetContentType.
+    Buffer.assign(capacity, 0);
+    BufferStart = 0;
+    BufferLength = 0;
+    if (content_type_is_set) {
+        WriteToBuffer("\r\n", 2);
     }
-}
\ No newline at end of file
+}
@@ -11,16 +11,24 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <vector>
 #include "Exception.h"
 #include "Field.h"
 #include <string.h>
 #include <stdlib.h>
+#include <boost/function.hpp>
 
 namespace MPFD {
 
+    /*
+        Streaming parser: incoming data goes through fixed size ring buffer, so memory usage does not depend on upload size.
+        Boundaries are searched by Boyer-Moore-Horspool algorithm, field content is passed to fields directly from ring buffer.
+    */
     class Parser {
     public:
-        static const int StoreUploadedFilesInFilesystem = 1, StoreUploadedFilesInMemory = 2;
+        // StoreUploadedFilesInDestinationDir: files are written to upload dir under unique temporary names. Handler renames accepted files
+        // to their original names by Field::MoveToDestinationFile(), the rest are removed on parser destruction. Existing files are never overwritten.
+        static const int StoreUploadedFilesInFilesystem = 1, StoreUploadedFilesInMemory = 2, StoreUploadedFilesInDestinationDir = 3;
 
 
         Parser();
@@ -32,10 +40,15 @@ namespace MPFD {
 
 
 
+        // Sets size of ring buffer, it limits size of field headers. Must be called before accepting data.
         void SetMaxCollectedDataLength(long max);
         void SetTempDirForFileUpload(std::string dir);
         void SetUploadedFilesStorage(int where);
 
+        // Content of files whose names are not accepted by filter is skipped(see Field::Ignore()), it is decided as soon as headers are parsed.
+        typedef boost::function<bool (const boost::filesystem::path& filename)> FileNameFilter;
+        void SetFileNameFilter(FileNameFilter filter);
+
         std::map<std::string, Field *> GetFieldsMap();
 
         const std::map<std::string, Field *> GetFieldsMap() const;
@@ -46,28 +59,43 @@ namespace MPFD {
         std::map<std::string, Field *> Fields;
 
         std::string TempDirForFileUpload;
+        FileNameFilter FileNameFilter_;
         int CurrentStatus;
 
         // Work statuses
         static int const Status_LookingForStartingBoundary = 1;
         static int const Status_ProcessingHeaders = 2;
         static int const Status_ProcessingContentOfTheField = 3;
+        static int const Status_ProcessingBoundaryEnding = 4; // CRLF before headers of next field or "--" after last boundary.
+        static int const Status_Finished = 5;
+
+        static long const DefaultBufferSize = 64 * 1024;
 
         std::string Boundary;
-        std::string ProcessingFieldName;
-        bool _HeadersOfTheFieldAreProcessed;
-        long ContentLength;
-        char *DataCollector;
-        long DataCollectorLength, MaxDataCollectorLength;
-        bool FindStartingBoundaryAndTruncData();
+        std::string Delimiter; // CRLF + Boundary: separates field content from next boundary.
+        long DelimiterSkipTable[256]; // Boyer-Moore-Horspool bad character shifts for Delimiter.
+        Field *ProcessingField;
+
+        // Ring buffer. Capacity is power of 2, so index is wrapped by mask.
+        std::vector<char> Buffer;
+        long BufferStart, BufferLength;
+        long HeadersEndSearchFrom;
+
+        char At(long i) const {
+            return Buffer[(BufferStart + i) & (Buffer.size() - 1)];
+        }
+        void WriteToBuffer(const char *data, long length);
+        void Consume(long n);
+        void PassToField(long n);
+        long FindDelimiter() const;
+
         void _ProcessData();
         void _ParseHeaders(std::string headers);
+        bool FindStartingBoundary();
         bool WaitForHeadersEndAndParseThem();
-        void TruncateDataCollectorFromTheBeginning(long n);
-        long BoundaryPositionInDataCollector();
         bool ProcessContentOfTheField();
+        bool ProcessBoundaryEnding();
     };
 }
 
 #endif	/* _PARSER_H */
-
@@ -12,8 +12,13 @@ ParserFactory::ParserFactoryPtr ParserFactory::s_instance;
 std::unique_ptr<::MPFD::Parser> ParserFactoryImpl::createParser(const std::string& content_type)
 {
     std::unique_ptr<::MPFD::Parser> parser(new ::MPFD::Parser);
-    parser->SetUploadedFilesStorage(::MPFD::Parser::StoreUploadedFilesInFilesystem);
+    parser->SetUploadedFilesStorage(::MPFD::Parser::StoreUploadedFilesInDestinationDir); // files are written directly to dir where AIMP will read them.
     parser->SetTempDirForFileUpload(StringEncoding::utf16_to_system_ansi_encoding(temp_dir_.native()));
+    const std::shared_ptr<const std::vector<std::wstring> > track_extensions = track_extensions_;
+    parser->SetFileNameFilter([track_extensions](const boost::filesystem::path& filename) {
+                                  return std::find(track_extensions->begin(), track_extensions->end(), filename.extension().native()) != track_extensions->end();
+                              }
+                              );
     parser->SetContentType(content_type);
 
     return parser;
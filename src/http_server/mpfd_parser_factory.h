@@ -28,9 +28,11 @@ private:
 class ParserFactoryImpl : public ParserFactory, private boost::noncopyable
 {
 public:
-    ParserFactoryImpl(boost::filesystem::wpath temp_dir)
+    //! \param track_extensions - extensions of files which can be uploaded, like ".mp3". Other files are rejected by parser.
+    ParserFactoryImpl(boost::filesystem::wpath temp_dir, const std::vector<std::wstring>& track_extensions)
         :
-        temp_dir_(temp_dir)
+        temp_dir_(temp_dir),
+        track_extensions_( std::make_shared<const std::vector<std::wstring> >(track_extensions) )
     {}
 
     virtual std::unique_ptr<::MPFD::Parser> createParser(const std::string& content_type);
@@ -38,6 +40,7 @@ public:
 private:
 
     boost::filesystem::wpath temp_dir_; 
+    std::shared_ptr<const std::vector<std::wstring> > track_extensions_; //!< shared with filters of created parsers.
 }; 
 
 } // namespace MPFD
@@ -9,6 +9,8 @@
 #include <string>
 #include <vector>
 #include <boost/asio.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
 #include "http_server/header.h"
 
 namespace Http {
@@ -19,10 +21,12 @@ struct Reply
     /// The status of the reply.
     enum status_type
     {
+        switching_protocols = 101,
         ok = 200,
         created = 201,
         accepted = 202,
         no_content = 204,
+        partial_content = 206,
         multiple_choices = 300,
         moved_permanently = 301,
         moved_temporarily = 302,
@@ -31,6 +35,7 @@ struct Reply
         unauthorized = 401,
         forbidden = 403,
         not_found = 404,
+        requested_range_not_satisfiable = 416,
         internal_server_error = 500,
         not_implemented = 501,
         bad_gateway = 502,
@@ -46,12 +51,33 @@ struct Reply
     /// The name of file to be sent in the reply instead 'content'. Used for effective sending large files.
     std::wstring filename;
 
+    /// Range of file to be sent: offset of first byte and count of bytes. Used only if filename is not empty.
+    boost::uint64_t file_offset;
+    boost::uint64_t file_length;
+
+    /// Replaces its argument with the next part of content. Returns false if part is the last one.
+    typedef boost::function<bool (std::string* part)> ContentProducer;
+
+    /// If set, content is produced part by part in request handler's thread and sent with chunked transfer coding.
+    /// 'content' holds the first part. Next part is produced only when previous one has been sent.
+    ContentProducer content_producer;
+
+    Reply()
+        :
+        file_offset(0),
+        file_length(0)
+    {}
+
     /// Convert the reply into a vector of buffers. The buffers do not own the
     /// underlying memory blocks, therefore the reply object must remain valid and
     /// not be changed until the write operation has completed.
     std::vector<boost::asio::const_buffer> to_buffers() const;
     std::vector<boost::asio::const_buffer> to_buffers_headers_only() const;
 
+    /// Convert 'content' into chunk of chunked transfer coding. Last chunk is appended if content_producer is empty.
+    /// chunk_size_line is storage for chunk size line, it must not be changed until the write operation has completed.
+    std::vector<boost::asio::const_buffer> to_buffers_chunk(std::string& chunk_size_line) const;
+
     /// Get a stock reply.
     static Reply stock_reply(status_type status);
 };
@@ -16,6 +16,8 @@
 // headers for DelayedResponseSender class
 #include <boost/enable_shared_from_this.hpp>
 #include "http_server/auth_manager.h"
+#include "http_server/content_encoding.h"
+#include "http_server/static_file_cache.h"
 
 namespace Rpc           { class RequestHandler; }
 namespace DownloadTrack { class RequestHandler; }
@@ -43,7 +45,9 @@ public:
         document_root_(document_root),
         rpc_request_handler_(rpc_request_handler),
         download_track_request_handler_(download_track_request_handler),
-        upload_track_request_handler_(upload_track_request_handler)
+        upload_track_request_handler_(upload_track_request_handler),
+        static_file_cache_(16 * 1024 * 1024, // memory budget: 16 Mb is enough for all web interface files.
+                           2) // revalidate cached files not more often than once per 2 seconds.
     {}
 
     /*
@@ -52,6 +56,16 @@ public:
     */
     bool handle_request(const Request& req, Reply& rep, ICometDelayedConnection_ptr connection);
 
+    /*
+        Handle JSON-RPC request received through WebSocket channel.
+        Return true if response should be sent immediately, false if response sending must be delayed.
+    */
+    bool handle_websocket_message(const std::string& message, ICometDelayedConnection_ptr connection, std::string* response);
+
+    //! Cache is used in request handler thread, so its stats can be read by RPC methods.
+    const StaticFileCache& staticFileCache() const
+        { return static_file_cache_; }
+
 private:
 
     void handle_file_request(const Request& req, Reply& rep);
@@ -65,8 +79,17 @@ private:
     */
     static void fillReplyWithContent(const std::string& content_type, Reply& rep);
 
+    /*
+        Fill headers of reply whose content is produced part by part(see Reply::content_producer).
+        Content is sent with chunked transfer coding without compression.
+    */
+    static void fillReplyWithChunkedContent(const std::string& content_type, Reply& rep);
+
     void fillAuthFailReply(Reply& rep);
 
+    //! Adds ETag, Last-Modified and Cache-Control headers of static file. ETag depends on content coding of reply.
+    static void addCacheValidators(const StaticFileCache::Entry& file, ContentEncoding::Type encoding, Reply& rep);
+
     void trySendInitCookies(const Request& req, Reply& rep);
 
     // The directory containing the files to be served.
@@ -77,6 +100,8 @@ private:
     Rpc::RequestHandler& rpc_request_handler_;
     DownloadTrack::RequestHandler& download_track_request_handler_;
     UploadTrack::RequestHandler& upload_track_request_handler_;
+
+    StaticFileCache static_file_cache_;
 };
 
 
@@ -86,20 +111,32 @@ class DelayedResponseSender : public boost::enable_shared_from_this<DelayedRespo
 {
 public:
     DelayedResponseSender(ICometDelayedConnection_ptr comet_connection,
-                          RequestHandler& http_request_handler)
+                          RequestHandler& http_request_handler,
+                          ContentEncoding::Type content_encoding)
         :
         comet_connection_(comet_connection),
-        http_request_handler_(http_request_handler)
+        http_request_handler_(http_request_handler),
+        content_encoding_(content_encoding)
     {}
 
     void send(const std::string& response, const std::string& response_content_type);
 
     const Reply& get_reply() const;
+    Reply& get_reply();
+
+    //! Returns true if sender can be used for many responses(WebSocket channel).
+    bool persistent() const
+        { return comet_connection_->isPersistent(); }
+
+    //! Returns true if client has gone.
+    bool closed() const
+        { return comet_connection_->isClosed(); }
 
 private:
 
     ICometDelayedConnection_ptr comet_connection_;
     RequestHandler& http_request_handler_;
+    ContentEncoding::Type content_encoding_; //!< encoding accepted by client, request object does not exist when response is sent.
     Reply reply_; // Reply object is member since it should exist till connection send it to client.
 };
 
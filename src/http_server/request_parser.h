@@ -7,6 +7,7 @@
 #define HTTP_REQUEST_PARSER_H
 
 #include <string>
+#include <vector>
 #include <boost/logic/tribool.hpp>
 #include <boost/tuple/tuple.hpp>
 
@@ -15,7 +16,11 @@ namespace Http {
 struct Request;
 struct header;
 
-/// Parser for incoming requests.
+/*!
+    Parser for incoming requests.
+    Works with buffers instead of single chars: request line and headers are collected until empty line is found
+    and then are parsed at once, content is copied by bulk appends.
+*/
 class request_parser
 {
 public:
@@ -27,66 +32,58 @@ public:
 
     /// Parse some data. The tribool return value is true when a complete request
     /// has been parsed, false if the data is invalid, indeterminate when more
-    /// data is required. The InputIterator return value indicates how much of the
-    /// input has been consumed.
-    template <typename InputIterator>
-    boost::tuple<boost::tribool, InputIterator> parse(Request& req,
-                                                      InputIterator begin,
-                                                      InputIterator end)
-    {
-        switch (state_) {
-        case content_multipart_formdata:
-            return parse_mpfd(req, begin, end);
-        default:
-            while (begin != end) {
-                boost::tribool result = consume(req, *begin++);
-                if (result || !result) {
-                    return boost::make_tuple(result, begin);
-                }
-
-                if (state_ == content_multipart_formdata) {
-                    return parse_mpfd(req, --begin, end);
-                }
-            }
-            break;
-        }
-
-        boost::tribool result = boost::indeterminate;
-        return boost::make_tuple(result, begin);
-    }
+    /// data is required. The returned pointer indicates how much of the
+    /// input has been consumed: the rest belongs to the next pipelined request.
+    boost::tuple<boost::tribool, const char*> parse(Request& req,
+                                                    const char* begin,
+                                                    const char* end);
+
+    /// True if request has been rejected since its content is sent in transfer coding, which is not supported(Not Implemented reply is expected).
+    bool transfer_coding_unsupported() const
+        { return transfer_coding_unsupported_; }
+
+    /// True if end of content of the current request is known: request has no content or it has valid Content-Length.
+    /// Only then next request on the same connection can be found.
+    bool content_framed() const
+        { return content_framed_; }
 
 private:
 
-    template <typename InputIterator>
-    boost::tuple<boost::tribool, InputIterator> parse_mpfd(Request& req,
-                                                           InputIterator begin,
-                                                           InputIterator end)
-    {
-        assert (state_ == content_multipart_formdata);
-
-        if (content_consumed_ < content_length_) {   
-            assert(begin <= end);
-            const std::size_t length = std::distance(begin, end);
-            assert(req.mpfd_parser);
-            req.mpfd_parser->AcceptSomeData(begin, length);
-            content_consumed_ += length;
-            boost::tribool result = boost::indeterminate;
-            if (content_consumed_ == content_length_) {
-                result = true; // all content has been consumed, stop parsing.
-            }
-            return boost::make_tuple(result, end);
-        }
-        return boost::make_tuple(false, begin);
-    }
+    /// Collects request line and headers until empty line.
+    boost::tuple<boost::tribool, const char*> parse_head(Request& req, const char* begin, const char* end);
+
+    /// Copies content by one append.
+    boost::tuple<boost::tribool, const char*> parse_content(Request& req, const char* begin, const char* end);
+
+    /// Passes content to multipart form data parser.
+    boost::tuple<boost::tribool, const char*> parse_mpfd(Request& req, const char* begin, const char* end);
+
+    /// Parses collected request line and headers, selects content parser.
+    boost::tribool process_head(Request& req);
+
+    /// Parses "METHOD URI HTTP/x.y" line. Range does not include CRLF.
+    static bool parse_request_line(Request& req, const char* begin, const char* end);
+
+    /// Parses "Name: value" line or continuation of previous header value. Range does not include CRLF.
+    static bool parse_header_line(Request& req, const char* begin, const char* end);
+
+    /// \return position after CRLFCRLF which terminates headers or std::string::npos. Search starts from specified position.
+    static std::size_t find_head_end(const std::string& data, std::size_t search_from);
 
     /// The name of the content length header.
     static std::string content_length_name_;
 
+    /// Max size of request line and headers. Larger requests are considered invalid.
+    static const std::size_t kMaxHeadSize = 64 * 1024;
+
+    /// Max size of content which is stored in memory(multipart form data is not limited).
+    static const std::size_t kMaxContentLength = 64 * 1024 * 1024;
+
     /// Content length as decoded from headers. Defaults to 0.
     std::size_t content_length_;
 
-    /// Handle the next character of input.
-    boost::tribool consume(Request& req, char input);
+    /// Request line and headers collected so far.
+    std::string head_;
 
     /// Check if a byte is an HTTP character.
     static bool is_char(int c);
@@ -100,36 +97,23 @@ private:
     /// Check if a byte is a digit.
     static bool is_digit(int c);
 
+    /// Check if a byte is allowed in token(method, header name).
+    static bool is_token_char(int c)
+        { return is_char(c) && !is_ctl(c) && !is_tspecial(c); }
+
     /// The current state of the parser.
     enum state
     {
-        method_start,
-        method,
-        uri_start,
-        uri,
-        http_version_h,
-        http_version_t_1,
-        http_version_t_2,
-        http_version_p,
-        http_version_slash,
-        http_version_major_start,
-        http_version_major,
-        http_version_minor_start,
-        http_version_minor,
-        expecting_newline_1,
-        header_line_start,
-        header_lws,
-        header_name,
-        space_before_header_value,
-        header_value,
-        expecting_newline_2,
-        expecting_newline_3,
-        select_content_parser,
+        head,
         content,
         content_multipart_formdata
     } state_;
 
     std::size_t content_consumed_;
+
+    bool transfer_coding_unsupported_;
+
+    bool content_framed_;
 };
 
 bool get_header_value(const std::vector<header>& headers, const std::string& header_name, const std::string*& header_value);
@@ -15,6 +15,7 @@
 #include <iterator>
 
 #include "connection.cpp"
+#include "websocket_connection.cpp"
 
 #include <winsock2.h>
 #include <iphlpapi.h>
@@ -56,10 +57,13 @@ struct Endpoint
 
 std::set<Endpoint> getEndpointsFromSettings();
 
-Server::Server( boost::asio::io_service& io_service, RequestHandler& request_handler)
+Server::Server(boost::asio::io_service& io_service,
+               RequestHandler& request_handler,
+               RequestHandlingDispatcher request_handling_dispatcher)
     :
     io_service_(io_service),
-    request_handler_(request_handler)
+    request_handler_(request_handler),
+    request_handling_dispatcher_(request_handling_dispatcher)
 {
     std::set<Endpoint> endpoints = getEndpointsFromSettings();
     for (auto endpoint : endpoints) {
@@ -140,7 +144,7 @@ void Server::start_accept_connections_on(boost::asio::ip::tcp::endpoint endpoint
     acceptor->listen();
 
     // The next connection to be accepted.
-    ConnectionIpTcp_ptr next_connection( new ConnectionIpTcp(io_service_, request_handler_) );
+    ConnectionIpTcp_ptr next_connection( new ConnectionIpTcp(io_service_, request_handler_, request_handling_dispatcher_) );
     acceptor->async_accept( next_connection->socket(),
                             boost::bind(&Server::handle_accept,
                                         this,
@@ -160,7 +164,7 @@ void Server::handle_accept(IpTcpConnectionAcceptor_ptr acceptor,
     if (!e) {
         accepted_connection->start();
         //BOOST_LOG_SEV(logger(), debug) << "Client connection started";
-        ConnectionIpTcp_ptr new_connection( new ConnectionIpTcp(io_service_, request_handler_) );
+        ConnectionIpTcp_ptr new_connection( new ConnectionIpTcp(io_service_, request_handler_, request_handling_dispatcher_) );
         acceptor->async_accept(new_connection->socket(),
                                boost::bind(&Server::handle_accept,
                                            this,
@@ -326,7 +330,7 @@ void Server::open_bluetooth_socket()
     acceptor->bind(endpoint);
     acceptor->listen();
     
-    ConnectionBluetoothRfcomm_ptr new_connection( new ConnectionBluetoothRfcomm(io_service_, request_handler_) );
+    ConnectionBluetoothRfcomm_ptr new_connection( new ConnectionBluetoothRfcomm(io_service_, request_handler_, request_handling_dispatcher_) );
     acceptor->async_accept( new_connection->socket(),
                             boost::bind(&Server::handle_accept_bluetooth,
                                         this,
@@ -348,7 +352,7 @@ void Server::handle_accept_bluetooth(BluetoothConnectionAcceptor_ptr acceptor,
     if (!e) {
         accepted_connection->start();
         BOOST_LOG_SEV(logger(), debug) << "Client connection started";
-        ConnectionBluetoothRfcomm_ptr new_connection( new ConnectionBluetoothRfcomm(io_service_, request_handler_) );
+        ConnectionBluetoothRfcomm_ptr new_connection( new ConnectionBluetoothRfcomm(io_service_, request_handler_, request_handling_dispatcher_) );
         acceptor->async_accept( new_connection->socket(),
                                 boost::bind(&Server::handle_accept_bluetooth,
                                             this,
@@ -36,8 +36,12 @@ class Server : private boost::noncopyable
 public:
     /*
         Construct the server to listen on the specified TCP address and port.
+        If request_handling_dispatcher is not empty, connections pass requests to request_handler through it,
+        so io_service can be run by threads other than request_handler's one.
     */
-    Server(boost::asio::io_service& io_service, RequestHandler& request_handler); // throws std::runtime_error.
+    Server(boost::asio::io_service& io_service,
+           RequestHandler& request_handler,
+           RequestHandlingDispatcher request_handling_dispatcher = RequestHandlingDispatcher()); // throws std::runtime_error.
 
     ~Server();
 
@@ -66,6 +70,9 @@ private:
 
     // The handler for all incoming requests.
     RequestHandler& request_handler_;
+
+    // Passes request handling to request_handler_'s thread.
+    RequestHandlingDispatcher request_handling_dispatcher_;
 };
 
 } // namespace Http
@@ -0,0 +1,244 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "static_file_cache.h"
+#include "http_server/content_encoding.h"
+#include "http_server/header.h"
+#include "http_server/request_parser.h"
+#include "plugin/logger.h"
+#include "utils/util.h"
+#include <fstream>
+
+namespace {
+using namespace ControlPlugin::PluginLogger;
+ModuleLoggerType& logger()
+    { return getLogManager().getModuleLogger<Http::Server>(); }
+}
+
+namespace Http
+{
+
+namespace fs = boost::filesystem;
+
+StaticFileCache::StaticFileCache(std::size_t max_size, unsigned int revalidation_interval)
+    :
+    max_size_(max_size),
+    revalidation_interval_(revalidation_interval)
+{
+    Stats empty_stats = { 0 };
+    stats_ = empty_stats;
+}
+
+StaticFileCache::EntryPtr StaticFileCache::getFile(const std::string& path, bool precompress)
+{
+    const std::time_t now = std::time(nullptr);
+    boost::system::error_code ec;
+
+    Items::iterator it = items_.find(path);
+    if ( it != items_.end() ) {
+        Item& item = it->second;
+        if ( now - item.last_validation < static_cast<std::time_t>(revalidation_interval_) ) {
+            ++stats_.hits;
+            touch(item);
+            return item.entry;
+        }
+
+        const std::time_t last_modified = fs::last_write_time(path, ec);
+        if (!ec && last_modified == item.entry->last_modified) {
+            ++stats_.hits;
+            item.last_validation = now;
+            touch(item);
+            return item.entry;
+        }
+
+        // file was modified or removed.
+        erase(it);
+    }
+
+    ++stats_.misses;
+
+    const std::time_t last_modified = fs::last_write_time(path, ec);
+    if (ec) {
+        return EntryPtr();
+    }
+
+    EntryPtr entry = loadFile(path, last_modified, precompress);
+    if ( entry && entrySize(*entry) <= max_size_ ) {
+        insert(path, entry, now);
+    }
+
+    BOOST_LOG_SEV(logger(), debug) << "Static file cache miss: " << path
+                                   << ". Hits " << stats_.hits << ", misses " << stats_.misses
+                                   << ", evictions " << stats_.evictions
+                                   << ", size " << stats_.size << " bytes in " << stats_.entries_count << " files.";
+    return entry;
+}
+
+StaticFileCache::EntryPtr StaticFileCache::loadFile(const std::string& path, std::time_t last_modified, bool precompress) const
+{
+    std::ifstream is(path.c_str(), std::ios::in | std::ios::binary);
+    if (!is) {
+        return EntryPtr();
+    }
+
+    boost::shared_ptr<Entry> entry = boost::make_shared<Entry>();
+
+    is.seekg(0, std::ios::end);
+    const std::streamoff file_size = is.tellg();
+    is.seekg(0, std::ios::beg);
+    if (file_size > 0) {
+        entry->content.resize( static_cast<std::size_t>(file_size) );
+        is.read( &entry->content[0], file_size );
+        entry->content.resize( static_cast<std::size_t>( is.gcount() ) );
+    }
+
+    boost::crc_32_type crc32_calculator;
+    crc32_calculator.process_bytes( entry->content.data(), entry->content.size() );
+    entry->etag = Utilities::MakeString() << '"' << std::hex << crc32_calculator.checksum() << '-' << std::dec << entry->content.size() << '"';
+
+    if (precompress && entry->content.size() >= ContentEncoding::kMinSizeToCompress) {
+        ContentEncoding::compress(entry->content, ContentEncoding::GZIP, &entry->gzip_content);
+        if ( entry->gzip_content.size() >= entry->content.size() ) {
+            entry->gzip_content.clear();
+        }
+    }
+
+    entry->last_modified = last_modified;
+    entry->last_modified_http_date = formatHttpDate(last_modified);
+    return entry;
+}
+
+void StaticFileCache::insert(const std::string& path, EntryPtr entry, std::time_t now)
+{
+    // free space for new file.
+    while ( !lru_.empty() && stats_.size + entrySize(*entry) > max_size_ ) {
+        ++stats_.evictions;
+        erase( items_.find( lru_.back() ) );
+    }
+
+    lru_.push_front(path);
+    Item item = { entry, now, lru_.begin() };
+    items_.insert( std::make_pair(path, item) );
+
+    stats_.size += entrySize(*entry);
+    ++stats_.entries_count;
+}
+
+void StaticFileCache::erase(Items::iterator it)
+{
+    assert( it != items_.end() );
+    stats_.size -= entrySize(*it->second.entry);
+    --stats_.entries_count;
+    lru_.erase(it->second.lru_position);
+    items_.erase(it);
+}
+
+void StaticFileCache::touch(Item& item)
+{
+    lru_.splice(lru_.begin(), lru_, item.lru_position);
+}
+
+std::string etagOfEncoding(const StaticFileCache::Entry& entry, ContentEncoding::Type encoding)
+{
+    if (encoding == ContentEncoding::IDENTITY || entry.etag.empty()) {
+        return entry.etag;
+    }
+
+    std::string etag(entry.etag, 0, entry.etag.size() - 1); // without closing quote.
+    etag += '-';
+    etag += ContentEncoding::name(encoding);
+    etag += '"';
+    return etag;
+}
+
+namespace
+{
+
+bool etagMatches(const std::string& if_none_match, const StaticFileCache::Entry& entry)
+{
+    std::vector<std::string> etags;
+    boost::split( etags, if_none_match, boost::is_any_of(",") );
+    for (auto& candidate : etags) {
+        boost::trim(candidate);
+        if ( boost::starts_with(candidate, "W/") ) { // weak comparison is enough for GET.
+            candidate.erase(0, 2);
+        }
+        if (   candidate == "*"
+            || candidate == entry.etag
+            || candidate == etagOfEncoding(entry, ContentEncoding::GZIP)
+            || candidate == etagOfEncoding(entry, ContentEncoding::DEFLATE)
+            )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool isNotModified(const std::vector<header>& request_headers, const StaticFileCache::Entry& entry)
+{
+    const std::string* value;
+    if ( get_header_value(request_headers, "If-None-Match", value) ) {
+        return etagMatches(*value, entry);
+    }
+
+    if ( get_header_value(request_headers, "If-Modified-Since", value) ) {
+        std::time_t if_modified_since;
+        if ( parseHttpDate(*value, &if_modified_since) ) {
+            return entry.last_modified <= if_modified_since;
+        }
+    }
+
+    return false;
+}
+
+namespace {
+const char * const kDAYS[]   = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+const char * const kMONTHS[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+}
+
+std::string formatHttpDate(std::time_t time)
+{
+    std::tm tm;
+    gmtime_s(&tm, &time);
+
+    char buffer[32];
+    sprintf_s(buffer, "%s, %02d %s %04d %02d:%02d:%02d GMT",
+              kDAYS[tm.tm_wday], tm.tm_mday, kMONTHS[tm.tm_mon], tm.tm_year + 1900,
+              tm.tm_hour, tm.tm_min, tm.tm_sec);
+    return buffer;
+}
+
+bool parseHttpDate(const std::string& date, std::time_t* time)
+{
+    assert(time);
+
+    char day[4] = { 0 }, month[4] = { 0 };
+    std::tm tm = { 0 };
+    if (sscanf_s(date.c_str(), "%3s, %d %3s %d %d:%d:%d GMT",
+                 day, static_cast<unsigned>(sizeof(day)),
+                 &tm.tm_mday,
+                 month, static_cast<unsigned>(sizeof(month)),
+                 &tm.tm_year, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 7
+        )
+    {
+        return false;
+    }
+
+    const char * const * const months_end = kMONTHS + sizeof(kMONTHS) / sizeof(*kMONTHS);
+    const char * const * const month_it = std::find_if(kMONTHS, months_end,
+                                                       [&month](const char* m) { return std::strcmp(m, month) == 0; }
+                                                       );
+    if (month_it == months_end) {
+        return false;
+    }
+
+    tm.tm_mon = month_it - kMONTHS;
+    tm.tm_year -= 1900;
+    *time = _mkgmtime(&tm);
+    return *time != -1;
+}
+
+} // namespace Http
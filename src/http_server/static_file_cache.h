@@ -0,0 +1,122 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "http_server/content_encoding.h"
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace Http
+{
+
+struct header;
+
+/*!
+    \brief In-memory cache of static files from document root.
+           Files are revalidated by modification time not more often than once per revalidation interval,
+           so conditional requests for hot files are answered without touching disk.
+           Text files are precompressed by gzip once on loading.
+           Total size of cached files(including compressed variants) is limited, least recently used files are evicted first.
+           Not thread safe: it is used in request handler thread only.
+*/
+class StaticFileCache : boost::noncopyable
+{
+public:
+
+    struct Entry
+    {
+        std::string content;
+        std::string gzip_content; //!< precompressed content. Empty if file is not compressible or too small.
+        std::string etag; //!< quoted hash of content, ready to be sent in ETag header of identity coded reply. See etagOfEncoding().
+        std::time_t last_modified;
+        std::string last_modified_http_date; //!< last_modified in RFC 1123 format, ready to be sent in Last-Modified header.
+    };
+
+    typedef boost::shared_ptr<const Entry> EntryPtr;
+
+    struct Stats
+    {
+        std::size_t hits;
+        std::size_t misses;
+        std::size_t evictions;
+        std::size_t size; //!< total size of cached files and their compressed variants in bytes.
+        std::size_t entries_count;
+    };
+
+    /*!
+        \param max_size - memory budget in bytes. Files larger than budget are not cached.
+        \param revalidation_interval - time in seconds while cached file is considered fresh without mtime check.
+    */
+    StaticFileCache(std::size_t max_size, unsigned int revalidation_interval);
+
+    /*!
+        \brief Returns file content and validators. Loads file if it is not cached yet or was modified since caching.
+        \param path - full path to file.
+        \param precompress - prepare gzip variant of content. Used for text files.
+        \return null if file does not exist or can't be read.
+    */
+    EntryPtr getFile(const std::string& path, bool precompress);
+
+    const Stats& stats() const
+        { return stats_; }
+
+    std::size_t maxSize() const
+        { return max_size_; }
+
+private:
+
+    typedef std::list<std::string> LruList; //!< paths of cached files, most recently used at front.
+
+    struct Item
+    {
+        EntryPtr entry;
+        std::time_t last_validation;
+        LruList::iterator lru_position;
+    };
+
+    typedef std::map<std::string, Item> Items;
+
+    EntryPtr loadFile(const std::string& path, std::time_t last_modified, bool precompress) const;
+
+    static std::size_t entrySize(const Entry& entry)
+        { return entry.content.size() + entry.gzip_content.size(); }
+
+    void insert(const std::string& path, EntryPtr entry, std::time_t now);
+
+    void erase(Items::iterator it);
+
+    void touch(Item& item);
+
+    const std::size_t max_size_;
+    const unsigned int revalidation_interval_;
+
+    Items items_;
+    LruList lru_;
+    Stats stats_;
+};
+
+/*!
+    \brief Returns ETag of file content sent with given content coding.
+           Strong ETag must differ between codings of the same resource(RFC 7232), so coding name is appended to hash: "<hash>-gzip".
+*/
+std::string etagOfEncoding(const StaticFileCache::Entry& entry, ContentEncoding::Type encoding);
+
+/*!
+    \brief Checks conditional request headers (If-None-Match has priority over If-Modified-Since).
+           ETag of any content coding of file is accepted: all of them identify the same file version.
+    \return true if client's copy of file is up to date and 304 Not Modified reply can be sent.
+*/
+bool isNotModified(const std::vector<header>& request_headers, const StaticFileCache::Entry& entry);
+
+//! Formats time in RFC 1123 format used by HTTP: "Sun, 06 Nov 1994 08:49:37 GMT".
+std::string formatHttpDate(std::time_t time);
+
+//! Parses date in RFC 1123 format. \return false if date has another format.
+bool parseHttpDate(const std::string& date, std::time_t* time);
+
+} // namespace Http
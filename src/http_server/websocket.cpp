@@ -0,0 +1,179 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "websocket.h"
+#include "http_server/reply.h"
+#include "http_server/request.h"
+#include "http_server/request_parser.h"
+#include <boost/uuid/sha1.hpp>
+#include <boost/archive/iterators/base64_from_binary.hpp>
+#include <boost/archive/iterators/transform_width.hpp>
+
+namespace Http
+{
+
+namespace WebSocket
+{
+
+const std::string kURI("/websocket");
+
+namespace {
+
+const char kHANDSHAKE_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+bool headerContains(const Request& req, const std::string& name, const std::string& token)
+{
+    const std::string* value;
+    return get_header_value(req.headers, name, value) && boost::icontains(*value, token);
+}
+
+void addHeader(Reply& rep, const std::string& name, const std::string& value)
+{
+    rep.headers.push_back(header());
+    rep.headers.back().name = name;
+    rep.headers.back().value = value;
+}
+
+} // namespace
+
+bool isUpgradeRequest(const Request& req)
+{
+    const std::string* value;
+    return req.method == "GET"
+           && req.uri == kURI
+           && headerContains(req, "Upgrade", "websocket")
+           && headerContains(req, "Connection", "upgrade")
+           && get_header_value(req.headers, "Sec-WebSocket-Key", value)
+           && get_header_value(req.headers, "Sec-WebSocket-Version", value) && *value == "13";
+}
+
+void fillHandshakeReply(const Request& req, Reply& rep)
+{
+    const std::string* key;
+    get_header_value(req.headers, "Sec-WebSocket-Key", key);
+
+    rep.status = Reply::switching_protocols;
+    addHeader(rep, "Upgrade", "websocket");
+    addHeader(rep, "Connection", "Upgrade");
+    addHeader( rep, "Sec-WebSocket-Accept", computeAcceptKey( boost::trim_copy(*key) ) );
+}
+
+std::string computeAcceptKey(const std::string& key)
+{
+    boost::uuids::detail::sha1 sha1;
+    const std::string data = key + kHANDSHAKE_GUID;
+    sha1.process_bytes( data.data(), data.size() );
+    unsigned int digest_words[5];
+    sha1.get_digest(digest_words);
+
+    unsigned char digest[20];
+    for (int i = 0; i < 5; ++i) { // words to big-endian bytes.
+        digest[i * 4]     = static_cast<unsigned char>(digest_words[i] >> 24);
+        digest[i * 4 + 1] = static_cast<unsigned char>(digest_words[i] >> 16);
+        digest[i * 4 + 2] = static_cast<unsigned char>(digest_words[i] >> 8);
+        digest[i * 4 + 3] = static_cast<unsigned char>(digest_words[i]);
+    }
+
+    using namespace boost::archive::iterators;
+    typedef base64_from_binary< transform_width<const unsigned char*, 6, 8> > Base64Iterator;
+    std::string accept_key( Base64Iterator(digest), Base64Iterator(digest + sizeof(digest)) );
+    accept_key.append( (3 - sizeof(digest) % 3) % 3, '=' );
+    return accept_key;
+}
+
+DecodeResult decodeFrame(const char* data, std::size_t size, Frame* frame, std::size_t* consumed)
+{
+    assert(frame && consumed);
+
+    const unsigned char* const bytes = reinterpret_cast<const unsigned char*>(data);
+    if (size < 2) {
+        return FRAME_INCOMPLETE;
+    }
+
+    const bool fin = (bytes[0] & 0x80) != 0;
+    const unsigned int opcode = bytes[0] & 0x0F;
+    const bool masked = (bytes[1] & 0x80) != 0;
+    const bool control_frame = (opcode & 0x08) != 0;
+    if ( (bytes[0] & 0x70) != 0 // no extensions are negotiated, so reserved bits must be zero.
+        || !masked               // client must mask all frames.
+        || (control_frame && !fin)
+        || (opcode > OPCODE_BINARY && !control_frame)
+        )
+    {
+        return FRAME_INVALID;
+    }
+
+    std::size_t header_size = 2;
+    boost::uint64_t payload_size = bytes[1] & 0x7F;
+    if (payload_size == 126) {
+        header_size += 2;
+        if (size < header_size) {
+            return FRAME_INCOMPLETE;
+        }
+        payload_size = (bytes[2] << 8) | bytes[3];
+    } else if (payload_size == 127) {
+        header_size += 8;
+        if (size < header_size) {
+            return FRAME_INCOMPLETE;
+        }
+        payload_size = 0;
+        for (int i = 2; i < 10; ++i) {
+            payload_size = (payload_size << 8) | bytes[i];
+        }
+    }
+
+    if (control_frame && payload_size > 125) {
+        return FRAME_INVALID;
+    }
+    if (payload_size > kMaxMessageSize) {
+        return FRAME_TOO_BIG;
+    }
+
+    const unsigned char* const mask = bytes + header_size;
+    header_size += 4;
+    if (size < header_size + payload_size) {
+        return FRAME_INCOMPLETE;
+    }
+
+    frame->fin = fin;
+    frame->opcode = static_cast<Opcode>(opcode);
+    frame->payload.assign(data + header_size, static_cast<std::size_t>(payload_size));
+    for (std::size_t i = 0; i < frame->payload.size(); ++i) {
+        frame->payload[i] ^= mask[i % 4];
+    }
+
+    *consumed = header_size + static_cast<std::size_t>(payload_size);
+    return FRAME_DECODED;
+}
+
+void encodeFrame(Opcode opcode, const char* payload, std::size_t payload_size, std::string* out)
+{
+    assert(out);
+
+    out->reserve(out->size() + payload_size + 10);
+    out->push_back( static_cast<char>(0x80 | opcode) );
+    if (payload_size < 126) {
+        out->push_back( static_cast<char>(payload_size) );
+    } else if (payload_size <= 0xFFFF) {
+        out->push_back( static_cast<char>(126) );
+        out->push_back( static_cast<char>(payload_size >> 8) );
+        out->push_back( static_cast<char>(payload_size) );
+    } else {
+        out->push_back( static_cast<char>(127) );
+        const boost::uint64_t size = payload_size;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out->push_back( static_cast<char>(size >> shift) );
+        }
+    }
+    out->append(payload, payload_size);
+}
+
+void encodeCloseFrame(CloseStatus status, std::string* out)
+{
+    const char payload[2] = { static_cast<char>(status >> 8), static_cast<char>(status) };
+    encodeFrame(OPCODE_CLOSE, payload, sizeof(payload), out);
+}
+
+} // namespace WebSocket
+
+} // namespace Http
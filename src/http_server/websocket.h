@@ -0,0 +1,79 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <string>
+#include <boost/cstdint.hpp>
+
+namespace Http
+{
+
+struct Request;
+struct Reply;
+
+//! WebSocket protocol(RFC 6455) primitives: handshake and framing.
+namespace WebSocket
+{
+
+//! URI of WebSocket channel. Text messages are JSON-RPC requests, responses and event notifications are sent back as text messages.
+extern const std::string kURI;
+
+enum Opcode {
+    OPCODE_CONTINUATION = 0x0,
+    OPCODE_TEXT         = 0x1,
+    OPCODE_BINARY       = 0x2,
+    OPCODE_CLOSE        = 0x8,
+    OPCODE_PING         = 0x9,
+    OPCODE_PONG         = 0xA
+};
+
+enum CloseStatus {
+    CLOSE_NORMAL            = 1000,
+    CLOSE_GOING_AWAY        = 1001,
+    CLOSE_PROTOCOL_ERROR    = 1002,
+    CLOSE_UNSUPPORTED_DATA  = 1003,
+    CLOSE_MESSAGE_TOO_BIG   = 1009,
+    CLOSE_TRY_AGAIN_LATER   = 1013
+};
+
+//! Max size of message(all fragments) accepted from client.
+const std::size_t kMaxMessageSize = 1024 * 1024;
+
+//! \return true if request is valid handshake of WebSocket protocol version 13.
+bool isUpgradeRequest(const Request& req);
+
+//! Fills 101 Switching Protocols reply on handshake request.
+void fillHandshakeReply(const Request& req, Reply& rep);
+
+//! \return value of Sec-WebSocket-Accept header for specified Sec-WebSocket-Key.
+std::string computeAcceptKey(const std::string& key);
+
+struct Frame
+{
+    bool fin;
+    Opcode opcode;
+    std::string payload; //!< unmasked payload.
+};
+
+enum DecodeResult {
+    FRAME_INCOMPLETE,
+    FRAME_DECODED,
+    FRAME_INVALID,  //!< protocol violation: unmasked client frame, reserved bits, fragmented control frame.
+    FRAME_TOO_BIG
+};
+
+/*!
+    \brief Decodes one client frame from beginning of data.
+    \param consumed - size of decoded frame. Set only if FRAME_DECODED is returned.
+*/
+DecodeResult decodeFrame(const char* data, std::size_t size, Frame* frame, std::size_t* consumed);
+
+//! Encodes unmasked server frame with FIN bit set and appends it to out.
+void encodeFrame(Opcode opcode, const char* payload, std::size_t payload_size, std::string* out);
+
+//! Encodes close frame with status code.
+void encodeCloseFrame(CloseStatus status, std::string* out);
+
+} // namespace WebSocket
+
+} // namespace Http
@@ -0,0 +1,255 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+// Definitions of WebSocketConnection template. This file is included in server.cpp where templates are instantiated.
+
+#include "stdafx.h"
+#include "websocket_connection.h"
+#include "http_server/request_handler.h"
+#include "plugin/logger.h"
+
+namespace Http {
+
+template <typename SocketT>
+WebSocketConnection<SocketT>::WebSocketConnection(boost::asio::io_service& io_service,
+                                                  std::unique_ptr<SocketT> socket,
+                                                  RequestHandler& handler,
+                                                  RequestHandlingDispatcher request_handling_dispatcher)
+    :
+    strand_(io_service),
+    socket_( std::move(socket) ),
+    request_handler_(handler),
+    request_handling_dispatcher_(request_handling_dispatcher),
+    message_fragmented_(false),
+    close_sent_(false),
+    closed_(false)
+{
+    assert(socket_);
+}
+
+template <typename SocketT>
+WebSocketConnection<SocketT>::~WebSocketConnection()
+{
+    BOOST_LOG_SEV(logger(), info) << "Destroying WebSocket connection.";
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::start(const char* received_data_begin, const char* received_data_end)
+{
+    incoming_.assign(received_data_begin, received_data_end);
+    strand_.dispatch( boost::bind(&WebSocketConnection<SocketT>::process_incoming_data,
+                                  shared_from_this()
+                                  )
+                     );
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::read_some()
+{
+    socket_->async_read_some(boost::asio::buffer(buffer_),
+                             strand_.wrap(boost::bind(&WebSocketConnection<SocketT>::handle_read,
+                                                      shared_from_this(),
+                                                      boost::asio::placeholders::error,
+                                                      boost::asio::placeholders::bytes_transferred
+                                                      )
+                                          )
+                             );
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::handle_read(const boost::system::error_code& e, std::size_t bytes_transferred)
+{
+    if (e) {
+        closed_ = true;
+        return; // no new operations are started, connection will be destroyed.
+    }
+
+    incoming_.append(buffer_.data(), bytes_transferred);
+    process_incoming_data();
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::process_incoming_data()
+{
+    using namespace WebSocket;
+
+    std::size_t offset = 0;
+    while (!close_sent_) {
+        Frame frame;
+        std::size_t frame_size = 0;
+        const DecodeResult result = decodeFrame(incoming_.data() + offset, incoming_.size() - offset, &frame, &frame_size);
+        if (result == FRAME_INCOMPLETE) {
+            break;
+        } else if (result == FRAME_INVALID) {
+            close(CLOSE_PROTOCOL_ERROR);
+        } else if (result == FRAME_TOO_BIG) {
+            close(CLOSE_MESSAGE_TOO_BIG);
+        } else {
+            offset += frame_size;
+            handle_frame(frame);
+        }
+    }
+    incoming_.erase(0, offset);
+
+    if (!close_sent_) {
+        read_some();
+    }
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::handle_frame(const WebSocket::Frame& frame)
+{
+    using namespace WebSocket;
+
+    switch (frame.opcode) {
+    case OPCODE_TEXT:
+    case OPCODE_CONTINUATION:
+        if ( (frame.opcode == OPCODE_CONTINUATION) != message_fragmented_ ) {
+            close(CLOSE_PROTOCOL_ERROR); // continuation without first fragment or new message inside fragmented one.
+            return;
+        }
+        if (message_.size() + frame.payload.size() > kMaxMessageSize) {
+            close(CLOSE_MESSAGE_TOO_BIG);
+            return;
+        }
+        message_ += frame.payload;
+        message_fragmented_ = !frame.fin;
+        if (frame.fin) {
+            handle_message(message_);
+            message_.clear();
+        }
+        break;
+    case OPCODE_BINARY:
+        close(CLOSE_UNSUPPORTED_DATA);
+        break;
+    case OPCODE_PING: {
+        std::string pong;
+        encodeFrame(OPCODE_PONG, frame.payload.data(), frame.payload.size(), &pong);
+        send_frame(pong);
+        break;
+    }
+    case OPCODE_PONG:
+        break;
+    case OPCODE_CLOSE:
+        close(CLOSE_NORMAL);
+        break;
+    default:
+        close(CLOSE_PROTOCOL_ERROR);
+        break;
+    }
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::handle_message(const std::string& message)
+{
+    if (request_handling_dispatcher_) {
+        const bool accepted = request_handling_dispatcher_( boost::bind(&WebSocketConnection<SocketT>::handle_message_in_handler_thread,
+                                                                        shared_from_this(),
+                                                                        message
+                                                                        )
+                                                           );
+        if (!accepted) {
+            BOOST_LOG_SEV(logger(), warning) << "Request handling queue is full, WebSocket connection is closed.";
+            close(WebSocket::CLOSE_TRY_AGAIN_LATER);
+        }
+    } else {
+        handle_message_in_handler_thread(message);
+    }
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::handle_message_in_handler_thread(const std::string& message)
+{
+    std::string response;
+    if (   request_handler_.handle_websocket_message(message, shared_from_this(), &response)
+        && !response.empty() // batch of notifications has no response.
+        )
+    {
+        std::string frame;
+        WebSocket::encodeFrame( WebSocket::OPCODE_TEXT, response.data(), response.size(), &frame );
+        strand_.dispatch( boost::bind(&WebSocketConnection<SocketT>::send_frame,
+                                      shared_from_this(),
+                                      frame
+                                      )
+                         );
+    }
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::sendResponse(DelayedResponseSender_ptr comet_http_response_sender)
+{
+    // Encode frame now: sender's reply is reused for next notifications.
+    const std::string& content = comet_http_response_sender->get_reply().content;
+    std::string frame;
+    WebSocket::encodeFrame( WebSocket::OPCODE_TEXT, content.data(), content.size(), &frame );
+    strand_.dispatch( boost::bind(&WebSocketConnection<SocketT>::send_frame,
+                                  shared_from_this(),
+                                  frame
+                                  )
+                     );
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::send_frame(const std::string& frame)
+{
+    if (close_sent_ || closed_) {
+        return;
+    }
+
+    outgoing_.push_back(frame);
+    if (outgoing_.size() == 1) { // no write operation is in progress.
+        write_next_frame();
+    }
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::write_next_frame()
+{
+    boost::asio::async_write(*socket_,
+                             boost::asio::buffer( outgoing_.front() ),
+                             strand_.wrap(boost::bind(&WebSocketConnection<SocketT>::handle_write,
+                                                      shared_from_this(),
+                                                      boost::asio::placeholders::error
+                                                      )
+                                          )
+                             );
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::handle_write(const boost::system::error_code& e)
+{
+    if (e) {
+        closed_ = true;
+        outgoing_.clear();
+        return;
+    }
+
+    outgoing_.pop_front();
+    if ( !outgoing_.empty() ) {
+        write_next_frame();
+    } else if (close_sent_) {
+        shutdown();
+    }
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::close(WebSocket::CloseStatus status)
+{
+    if (close_sent_) {
+        return;
+    }
+
+    std::string frame;
+    WebSocket::encodeCloseFrame(status, &frame);
+    send_frame(frame);
+    close_sent_ = true;
+    closed_ = true; // do not accept notifications anymore.
+}
+
+template <typename SocketT>
+void WebSocketConnection<SocketT>::shutdown()
+{
+    boost::system::error_code ignored_ec;
+    socket_->shutdown(SocketT::shutdown_both, ignored_ec);
+}
+
+} // namespace Http
@@ -0,0 +1,100 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include "connection.h"
+#include "websocket.h"
+
+namespace Http {
+
+/*!
+    \brief WebSocket channel: connection is switched to it after successful handshake.
+           Text messages are passed to RequestHandler as JSON-RPC requests, responses are sent back as text messages.
+           Delayed responses(event notifications of comet methods) can be sent many times through the same channel.
+*/
+template <typename SocketT>
+class WebSocketConnection : public ICometDelayedConnection,
+                            public boost::enable_shared_from_this< WebSocketConnection<SocketT> >,
+                            private boost::noncopyable
+{
+public:
+
+    WebSocketConnection(boost::asio::io_service& io_service,
+                        std::unique_ptr<SocketT> socket,
+                        RequestHandler& handler,
+                        RequestHandlingDispatcher request_handling_dispatcher);
+
+    ~WebSocketConnection();
+
+    //! Starts reading of frames. Data is received by HTTP connection after handshake request.
+    void start(const char* received_data_begin, const char* received_data_end);
+
+    //! Sends delayed response as text message. Can be called from any thread.
+    virtual void sendResponse(boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender);
+
+    virtual bool isPersistent() const
+        { return true; }
+
+    virtual bool isClosed() const
+        { return closed_; }
+
+private:
+
+    void read_some();
+
+    void handle_read(const boost::system::error_code& e, std::size_t bytes_transferred);
+
+    //! Decodes all complete frames from incoming_ buffer.
+    void process_incoming_data();
+
+    void handle_frame(const WebSocket::Frame& frame);
+
+    //! Passes text message to request handler directly or through request handling dispatcher.
+    void handle_message(const std::string& message);
+
+    //! Calls request handler. Executed in request handler's thread.
+    void handle_message_in_handler_thread(const std::string& message);
+
+    //! Queues encoded frame for sending. Executed in connection's strand.
+    void send_frame(const std::string& frame);
+
+    void write_next_frame();
+
+    void handle_write(const boost::system::error_code& e);
+
+    //! Sends close frame, connection is closed after it is written.
+    void close(WebSocket::CloseStatus status);
+
+    void shutdown();
+
+    /// Strand to ensure the connection's handlers are not called concurrently.
+    boost::asio::io_service::strand strand_;
+
+    std::unique_ptr<SocketT> socket_;
+
+    RequestHandler& request_handler_;
+
+    RequestHandlingDispatcher request_handling_dispatcher_;
+
+    boost::array<char, 8192> buffer_;
+
+    /// Received data which does not form complete frame yet.
+    std::string incoming_;
+
+    /// Payload of fragmented message collected so far.
+    std::string message_;
+    bool message_fragmented_;
+
+    /// Encoded frames waiting for sending. Front frame is being written.
+    std::deque<std::string> outgoing_;
+
+    /// Set when close frame is queued: nothing is sent after it.
+    bool close_sent_;
+
+    /// Set when connection can't be used anymore. Read by request handler's thread.
+    std::atomic<bool> closed_;
+};
+
+} // namespace Http
@@ -2,10 +2,8 @@
 
 #include "stdafx.h"
 #include "jsonrpc/response_serializer.h"
-#include "jsonrpc/value.h"
-#include "jsonrpc/writer.h"
+#include "jsonrpc/rpc_value_codec.h"
 #include "rpc/value.h"
-#include "rpc/exception.h"
 #include <cassert>
 
 namespace JsonRpc
@@ -13,99 +11,129 @@ namespace JsonRpc
 
 const std::string kMIME_TYPE = "application/json";
 
-struct ResponseSerializerImpl {
-    Json::FastWriter writer;
-};
-
-ResponseSerializer::ResponseSerializer()
-    :
-    impl_(new ResponseSerializerImpl)
-{}
-
-ResponseSerializer::~ResponseSerializer()
-{
-    delete impl_;
-}
-
-void convertRpcValueToJsonRpcValue(const Rpc::Value& rpc_value, Json::Value* json_rpc_value); // throws Rpc::Exception
-
 void ResponseSerializer::serializeSuccess(const Rpc::Value& root_response, std::string* response) const
 {
-    Json::Value jsonrpc_response;
-    convertRpcValueToJsonRpcValue(root_response, &jsonrpc_response);
-    jsonrpc_response["jsonrpc"] = "2.0";
-
-    *response = impl_->writer.write(jsonrpc_response);
+    assert(response);
+    response->clear();
+    writeResponse(root_response, response);
+    response->push_back('\n');
 }
 
 void ResponseSerializer::serializeFault(const Rpc::Value& root_request, const std::string& error_msg, int error_code, std::string* response) const
 {
-    Json::Value response_value;
+    assert(response);
 
+    Rpc::Value root_response;
     if ( root_request.isMember("id") ) {
-        convertRpcValueToJsonRpcValue(root_request["id"], &response_value["id"]);
+        root_response["id"] = root_request["id"];
     } else {
-        response_value["id"] = Json::Value::null;
+        root_response["id"] = Rpc::Value::Null();
     }
 
-    response_value["jsonrpc"] = "2.0";
-
-    Json::Value& error = response_value["error"];
+    Rpc::Value& error = root_response["error"];
     error["message"] = error_msg;
     error["code"] = error_code;
 
-    *response = impl_->writer.write(response_value);
+    response->clear();
+    writeResponse(root_response, response);
+    response->push_back('\n');
 }
 
-const std::string& ResponseSerializer::mimeType() const
+void ResponseSerializer::serializeBatch(const Rpc::Value& root_responses, std::string* response) const
 {
-    return kMIME_TYPE;
+    assert(response);
+    response->clear();
+    response->push_back('[');
+    for (auto begin = root_responses.getArrayItemsBegin(), end = root_responses.getArrayItemsEnd(),
+              it = begin;
+              it != end;
+              ++it
+         )
+    {
+        if (it != begin) {
+            response->push_back(',');
+        }
+        writeResponse(*it, response);
+    }
+    response->append("]\n", 2);
 }
 
-void convertRpcValueToJsonRpcValue(const Rpc::Value& rpc_value, Json::Value* json_rpc_value) // throws Rpc::Exception
+bool ResponseSerializer::serializeSuccessTemplate(const Rpc::Value& root_response, std::string* response, std::size_t* id_offset) const
 {
-    assert(json_rpc_value);
-
-    switch ( rpc_value.type() ) {
-    case Rpc::Value::TYPE_NONE:
-        // treat none rpc value as null json value. ///???
-    case Rpc::Value::TYPE_NULL:
-        Json::Value().swap(*json_rpc_value);
-        break;
-    case Rpc::Value::TYPE_BOOL:
-        *json_rpc_value = bool(rpc_value);
-        break;
-    case Rpc::Value::TYPE_INT:
-        *json_rpc_value = int(rpc_value);
-        break;
-    case Rpc::Value::TYPE_UINT:
-        *json_rpc_value = unsigned int(rpc_value);
-        break;
-    case Rpc::Value::TYPE_DOUBLE:
-        *json_rpc_value = double(rpc_value);
-        break;
-    case Rpc::Value::TYPE_STRING:
-        *json_rpc_value = static_cast<const std::string&>(rpc_value);
-        break;
-    case Rpc::Value::TYPE_ARRAY:
-        json_rpc_value->resize( rpc_value.size() );
-        for (size_t i = 0, size = json_rpc_value->size(); i != size; ++i) {
-            convertRpcValueToJsonRpcValue(rpc_value[i], &((*json_rpc_value)[i]));
-        }
-        break;
-    case Rpc::Value::TYPE_OBJECT:
-        {
-        *json_rpc_value = Json::Value();
-        auto member_it = rpc_value.getObjectMembersBegin(),
-             end       = rpc_value.getObjectMembersEnd();
-        for (; member_it != end; ++member_it) {
-            convertRpcValueToJsonRpcValue( member_it->second, &((*json_rpc_value)[member_it->first]) );
-        }
-        }
-        break;
-    default:
-        throw Rpc::Exception("unknown type", Rpc::TYPE_ERROR);
+    assert(response);
+    assert(id_offset);
+
+    serializeSuccess(root_response, response);
+
+    // members are sorted, so "id" goes first in success response: cut its value out.
+    static const char kID_MEMBER_START[] = "{\"id\":";
+    const std::size_t kID_MEMBER_START_LENGTH = sizeof(kID_MEMBER_START) - 1;
+    std::string id;
+    writeValue(root_response["id"], &id);
+    if (   response->compare(0, kID_MEMBER_START_LENGTH, kID_MEMBER_START) != 0
+        || response->compare(kID_MEMBER_START_LENGTH, id.size(), id) != 0
+        )
+    {
+        return false;
+    }
+    response->erase(kID_MEMBER_START_LENGTH, id.size());
+    *id_offset = kID_MEMBER_START_LENGTH;
+    return true;
+}
+
+void ResponseSerializer::serializeId(const Rpc::Value& id, std::string* response) const
+{
+    assert(response);
+    writeValue(id, response);
+}
+
+void ResponseSerializer::serializeStreamedSuccess(const Rpc::Value& root_response, const std::string& array_name,
+                                                  std::string* head, std::string* tail) const
+{
+    assert(head);
+    assert(tail);
+
+    // produce the same text as serializeSuccess() does: members are sorted, so array goes before the first member with greater name.
+    static const char kID_MEMBER_START[] = "{\"id\":";
+    static const char kRESULT_MEMBER_START[] = ",\"jsonrpc\":\"2.0\",\"result\":{";
+    head->assign( kID_MEMBER_START, sizeof(kID_MEMBER_START) - 1 );
+    writeValue(root_response["id"], head);
+    head->append( kRESULT_MEMBER_START, sizeof(kRESULT_MEMBER_START) - 1 );
+
+    const Rpc::Value& result = root_response["result"];
+    auto it = result.getObjectMembersBegin();
+    const auto end = result.getObjectMembersEnd();
+    for (; it != end && it->first < array_name; ++it) {
+        writeValue(Rpc::Value(it->first), head);
+        head->push_back(':');
+        writeValue(it->second, head);
+        head->push_back(',');
+    }
+    writeValue(Rpc::Value(array_name), head);
+    head->append(":[", 2);
+
+    tail->assign(1, ']');
+    for (; it != end; ++it) {
+        tail->push_back(',');
+        writeValue(Rpc::Value(it->first), tail);
+        tail->push_back(':');
+        writeValue(it->second, tail);
+    }
+    tail->append("}}\n", 3);
+}
+
+void ResponseSerializer::serializeStreamedItem(const Rpc::Value& item, std::size_t index, std::string* response) const
+{
+    assert(response);
+    if (index != 0) {
+        response->push_back(',');
     }
+    writeValue(item, response);
+}
+
+const std::string& ResponseSerializer::mimeType() const
+{
+    return kMIME_TYPE;
 }
 
 } // namespace JsonRpc
@@ -0,0 +1,705 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "jsonrpc/rpc_value_codec.h"
+#include "rpc/value.h"
+#include "rpc/exception.h"
+#include "utils/util.h"
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <boost/cstdint.hpp>
+
+namespace JsonRpc
+{
+
+using Utilities::MakeString;
+
+namespace {
+
+bool isWhitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool isNumberChar(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+void appendUtf8(unsigned int code_point, std::string* out)
+{
+    if (code_point <= 0x7F) {
+        out->push_back( static_cast<char>(code_point) );
+    } else if (code_point <= 0x7FF) {
+        out->push_back( static_cast<char>( 0xC0 | (0x1F & (code_point >> 6)) ) );
+        out->push_back( static_cast<char>( 0x80 | (0x3F & code_point) ) );
+    } else if (code_point <= 0xFFFF) {
+        out->push_back( static_cast<char>( 0xE0 | (0x0F & (code_point >> 12)) ) );
+        out->push_back( static_cast<char>( 0x80 | (0x3F & (code_point >> 6)) ) );
+        out->push_back( static_cast<char>( 0x80 | (0x3F & code_point) ) );
+    } else if (code_point <= 0x10FFFF) {
+        out->push_back( static_cast<char>( 0xF0 | (0x07 & (code_point >> 18)) ) );
+        out->push_back( static_cast<char>( 0x80 | (0x3F & (code_point >> 12)) ) );
+        out->push_back( static_cast<char>( 0x80 | (0x3F & (code_point >> 6)) ) );
+        out->push_back( static_cast<char>( 0x80 | (0x3F & code_point) ) );
+    }
+}
+
+int hexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+} // namespace anonymous
+
+bool RpcValueReader::parse(const char* begin, const char* end, Rpc::Value* root)
+{
+    assert(root);
+
+    begin_ = current_ = begin;
+    end_ = end;
+    error_message_.clear();
+
+    if ( !skipWhitespaceAndComments() || !parseValue(root, 0) || !skipWhitespaceAndComments() ) {
+        return false;
+    }
+
+    if (current_ != end_) {
+        return fail("Extra data after document end");
+    }
+    return true;
+}
+
+bool RpcValueReader::fail(const char* message)
+{
+    error_message_ = MakeString() << message << " at offset " << (current_ - begin_);
+    return false;
+}
+
+bool RpcValueReader::skipWhitespaceAndComments()
+{
+    for (;;) {
+        while ( current_ != end_ && isWhitespace(*current_) ) {
+            ++current_;
+        }
+
+        if (current_ == end_ || *current_ != '/') {
+            return true;
+        }
+
+        if (end_ - current_ < 2) {
+            return fail("Syntax error: unexpected '/'");
+        }
+
+        if (current_[1] == '/') { // C++ style comment lasts till end of line.
+            current_ += 2;
+            while (current_ != end_ && *current_ != '\r' && *current_ != '\n') {
+                ++current_;
+            }
+        } else if (current_[1] == '*') { // C style comment.
+            const char* c = current_ + 2;
+            while ( c != end_ && !(*c == '*' && c + 1 != end_ && c[1] == '/') ) {
+                ++c;
+            }
+            if (c == end_) {
+                return fail("Comment is not terminated");
+            }
+            current_ = c + 2;
+        } else {
+            return fail("Syntax error: unexpected '/'");
+        }
+    }
+}
+
+bool RpcValueReader::parseValue(Rpc::Value* value, unsigned int depth)
+{
+    if (depth > kMaxDepth) {
+        return fail("Nesting is too deep");
+    }
+
+    if (current_ == end_) {
+        return fail("Unexpected end of document");
+    }
+
+    switch (*current_) {
+    case '{':
+        return parseObject(value, depth + 1);
+    case '[':
+        return parseArray(value, depth + 1);
+    case '"':
+        {
+        std::string string;
+        if ( !parseString(&string) ) {
+            return false;
+        }
+        *value = std::move(string);
+        return true;
+        }
+    case 't':
+        if ( !parseLiteral("true") ) {
+            return false;
+        }
+        *value = true;
+        return true;
+    case 'f':
+        if ( !parseLiteral("false") ) {
+            return false;
+        }
+        *value = false;
+        return true;
+    case 'n':
+        if ( !parseLiteral("null") ) {
+            return false;
+        }
+        *value = Rpc::Value::Null();
+        return true;
+    case '-':
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        return parseNumber(value);
+    default:
+        return fail("Syntax error: value expected");
+    }
+}
+
+bool RpcValueReader::parseLiteral(const char* literal)
+{
+    const std::size_t length = std::strlen(literal);
+    if ( static_cast<std::size_t>(end_ - current_) < length || std::memcmp(current_, literal, length) != 0 ) {
+        return fail("Syntax error: value expected");
+    }
+    current_ += length;
+    return true;
+}
+
+bool RpcValueReader::parseObject(Rpc::Value* value, unsigned int depth)
+{
+    assert(*current_ == '{');
+    ++current_;
+
+    Rpc::Value::Object object;
+    if ( !skipWhitespaceAndComments() ) {
+        return false;
+    }
+
+    if (current_ != end_ && *current_ == '}') {
+        ++current_;
+        *value = std::move(object);
+        return true;
+    }
+
+    for (;;) {
+        if (current_ == end_ || *current_ != '"') {
+            return fail("Missing member name");
+        }
+
+        std::string name;
+        if ( !parseString(&name) || !skipWhitespaceAndComments() ) {
+            return false;
+        }
+
+        if (current_ == end_ || *current_ != ':') {
+            return fail("Missing ':' after member name");
+        }
+        ++current_;
+
+        Rpc::Value& member = object[ std::move(name) ];
+        if ( !skipWhitespaceAndComments() || !parseValue(&member, depth) || !skipWhitespaceAndComments() ) {
+            return false;
+        }
+
+        if (current_ == end_) {
+            return fail("Missing '}' at object end");
+        }
+
+        const char c = *current_++;
+        if (c == '}') {
+            break;
+        } else if (c != ',') {
+            --current_;
+            return fail("Missing ',' or '}' in object");
+        }
+
+        if ( !skipWhitespaceAndComments() ) {
+            return false;
+        }
+    }
+
+    *value = std::move(object);
+    return true;
+}
+
+bool RpcValueReader::parseArray(Rpc::Value* value, unsigned int depth)
+{
+    assert(*current_ == '[');
+    ++current_;
+
+    Rpc::Value::Array array;
+    array.reserve(8); // arrays are mostly short(entry fields), avoid reallocations on first items.
+    if ( !skipWhitespaceAndComments() ) {
+        return false;
+    }
+
+    if (current_ != end_ && *current_ == ']') {
+        ++current_;
+        *value = std::move(array);
+        return true;
+    }
+
+    for (;;) {
+        array.push_back( Rpc::Value() );
+        if ( !parseValue(&array.back(), depth) || !skipWhitespaceAndComments() ) {
+            return false;
+        }
+
+        if (current_ == end_) {
+            return fail("Missing ']' at array end");
+        }
+
+        const char c = *current_++;
+        if (c == ']') {
+            break;
+        } else if (c != ',') {
+            --current_;
+            return fail("Missing ',' or ']' in array");
+        }
+
+        if ( !skipWhitespaceAndComments() ) {
+            return false;
+        }
+    }
+
+    *value = std::move(array);
+    return true;
+}
+
+bool RpcValueReader::parseString(std::string* string)
+{
+    assert(*current_ == '"');
+    ++current_;
+
+    string->clear();
+    for (;;) {
+        // copy unescaped characters by chunks.
+        const char* const chunk_begin = current_;
+        while (current_ != end_ && *current_ != '"' && *current_ != '\\') {
+            ++current_;
+        }
+        string->append(chunk_begin, current_);
+
+        if (current_ == end_) {
+            return fail("Missing '\"' at string end");
+        }
+
+        if (*current_++ == '"') {
+            return true;
+        }
+
+        if (current_ == end_) {
+            return fail("Bad escape sequence in string");
+        }
+
+        const char escape = *current_++;
+        switch (escape) {
+        case '"':
+        case '/':
+        case '\\':
+            string->push_back(escape);
+            break;
+        case 'b':
+            string->push_back('\b');
+            break;
+        case 'f':
+            string->push_back('\f');
+            break;
+        case 'n':
+            string->push_back('\n');
+            break;
+        case 'r':
+            string->push_back('\r');
+            break;
+        case 't':
+            string->push_back('\t');
+            break;
+        case 'u':
+            {
+            unsigned int code_point;
+            if ( !parseUnicodeEscape(&code_point) ) {
+                return false;
+            }
+            appendUtf8(code_point, string);
+            }
+            break;
+        default:
+            --current_;
+            return fail("Bad escape sequence in string");
+        }
+    }
+}
+
+bool RpcValueReader::parseUnicodeEscape(unsigned int* code_point)
+{
+    // reads 4 hex digits after "\u".
+    const auto readCodeUnit = [this](unsigned int* code_unit) -> bool {
+        if (end_ - current_ < 4) {
+            return false;
+        }
+        *code_unit = 0;
+        for (int i = 0; i != 4; ++i) {
+            const int digit = hexDigitValue(*current_++);
+            if (digit < 0) {
+                return false;
+            }
+            *code_unit = (*code_unit << 4) | digit;
+        }
+        return true;
+    };
+
+    if ( !readCodeUnit(code_point) ) {
+        return fail("Bad unicode escape sequence in string");
+    }
+
+    if (*code_point >= 0xD800 && *code_point <= 0xDBFF) { // surrogate pair.
+        unsigned int low_surrogate;
+        if (   end_ - current_ < 2 || current_[0] != '\\' || current_[1] != 'u'
+            || (current_ += 2, !readCodeUnit(&low_surrogate))
+            || low_surrogate < 0xDC00 || low_surrogate > 0xDFFF
+            )
+        {
+            return fail("Bad unicode surrogate pair in string");
+        }
+        *code_point = 0x10000 + ( ((*code_point & 0x3FF) << 10) | (low_surrogate & 0x3FF) );
+    }
+    return true;
+}
+
+bool RpcValueReader::parseNumber(Rpc::Value* value)
+{
+    const char* const number_begin = current_;
+    bool is_double = false;
+    while ( current_ != end_ && isNumberChar(*current_) ) {
+        is_double = is_double || (*current_ != '-' && (*current_ < '0' || *current_ > '9')) || (*current_ == '-' && current_ != number_begin);
+        ++current_;
+    }
+
+    const bool is_negative = *number_begin == '-';
+    const char* digit = is_negative ? number_begin + 1 : number_begin;
+    if (digit == current_) {
+        return fail("Bad number");
+    }
+
+    if (!is_double) {
+        const int kMaxDigits = 10; // enough for any int and unsigned int value.
+        if (current_ - digit <= kMaxDigits) {
+            unsigned long long number = 0;
+            for (; digit != current_; ++digit) {
+                number = number * 10 + (*digit - '0');
+            }
+
+            if (is_negative) {
+                if ( number <= static_cast<unsigned long long>(INT_MAX) + 1 ) {
+                    *value = static_cast<int>( 0 - number );
+                    return true;
+                }
+            } else if (number <= INT_MAX) {
+                *value = static_cast<int>(number);
+                return true;
+            } else if (number <= UINT_MAX) {
+                *value = static_cast<unsigned int>(number);
+                return true;
+            }
+        }
+        // number is too large for integer types, store it as double.
+    }
+
+    // strtod needs null terminated string.
+    char buffer[64];
+    const std::size_t length = current_ - number_begin;
+    std::string long_number;
+    const char* number_string = buffer;
+    if ( length < sizeof(buffer) ) {
+        std::memcpy(buffer, number_begin, length);
+        buffer[length] = '\0';
+    } else {
+        long_number.assign(number_begin, current_);
+        number_string = long_number.c_str();
+    }
+
+    char* number_end;
+    const double number = std::strtod(number_string, &number_end);
+    if (number_end != number_string + length) {
+        return fail("Bad number");
+    }
+    *value = number;
+    return true;
+}
+
+namespace {
+
+template<typename UnsignedT>
+void writeUnsigned(UnsignedT value, std::string* out)
+{
+    char buffer[24];
+    char* const end = buffer + sizeof(buffer);
+    char* begin = end;
+    do {
+        *--begin = static_cast<char>( '0' + value % 10 );
+        value /= 10;
+    } while (value != 0);
+    out->append(begin, end);
+}
+
+void writeUInt(unsigned int value, std::string* out)
+{
+    writeUnsigned(value, out);
+}
+
+void writeInt(int value, std::string* out)
+{
+    if (value < 0) {
+        out->push_back('-');
+        writeUInt(0u - static_cast<unsigned int>(value), out);
+    } else {
+        writeUInt(static_cast<unsigned int>(value), out);
+    }
+}
+
+//! Uses the same format as Json::FastWriter: 16 significant digits, trailing zeros are truncated but one is kept after point.
+void writeDouble(double value, std::string* out)
+{
+    // integral values of less than 16 digits are formatted as "<integer>.0", write them without sprintf.
+    const double kMAX_INTEGRAL_FAST_PATH = 1e15;
+    if ( std::fabs(value) < kMAX_INTEGRAL_FAST_PATH && std::floor(value) == value ) {
+        if ( std::signbit(value) ) { // keep sign of negative zero as sprintf does.
+            out->push_back('-');
+        }
+        writeUnsigned( static_cast<unsigned long long>( std::fabs(value) ), out );
+        out->append(".0", 2);
+        return;
+    }
+
+    char buffer[32];
+    sprintf_s(buffer, "%#.16g", value);
+
+    char* ch = buffer + std::strlen(buffer) - 1;
+    if (*ch == '0') {
+        while (ch > buffer && *ch == '0') {
+            --ch;
+        }
+        char* const last_nonzero = ch;
+        while (ch >= buffer && *ch >= '0' && *ch <= '9') {
+            --ch;
+        }
+        if (ch >= buffer && *ch == '.') {
+            *(last_nonzero + 2) = '\0';
+        }
+    }
+    out->append(buffer);
+}
+
+/*!
+    Returns true if any of 8 bytes starting from c is control character, '"' or '\\'.
+    Bytes are checked all at once in 64-bit word(SWAR), so long strings without special characters are scanned 8 bytes per step.
+*/
+bool wordNeedsEscaping(const char* c)
+{
+    const boost::uint64_t kONES = 0x0101010101010101ull,
+                          kHIGH_BITS = 0x8080808080808080ull;
+
+    boost::uint64_t word;
+    std::memcpy(&word, c, sizeof(word));
+
+    // byte is less than 0x20. Bytes with high bit set(UTF-8 sequences) are excluded by ~word.
+    const boost::uint64_t control = (word - kONES * 0x20) & ~word & kHIGH_BITS;
+    // byte is equal to '"' or '\\': xor zeroes it.
+    const boost::uint64_t quote = word ^ (kONES * '"'),
+                          backslash = word ^ (kONES * '\\');
+    const boost::uint64_t special = ( ( (quote - kONES) & ~quote ) | ( (backslash - kONES) & ~backslash ) ) & kHIGH_BITS;
+    return (control | special) != 0;
+}
+
+void writeString(const std::string& string, std::string* out)
+{
+    static const char kHEX_DIGITS[] = "0123456789ABCDEF";
+
+    out->push_back('"');
+    const char* chunk_begin = string.data();
+    const char* const end = chunk_begin + string.size();
+    for (const char* c = chunk_begin; c != end; ++c) {
+        // skip words without special characters.
+        while ( end - c >= 8 && !wordNeedsEscaping(c) ) {
+            c += 8;
+        }
+        if (c == end) {
+            break;
+        }
+
+        const unsigned char ch = static_cast<unsigned char>(*c);
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            continue;
+        }
+
+        // write unescaped chunk and escape sequence for current char.
+        out->append(chunk_begin, c);
+        chunk_begin = c + 1;
+        switch (ch) {
+        case '"':
+            out->append("\\\"", 2);
+            break;
+        case '\\':
+            out->append("\\\\", 2);
+            break;
+        case '\b':
+            out->append("\\b", 2);
+            break;
+        case '\f':
+            out->append("\\f", 2);
+            break;
+        case '\n':
+            out->append("\\n", 2);
+            break;
+        case '\r':
+            out->append("\\r", 2);
+            break;
+        case '\t':
+            out->append("\\t", 2);
+            break;
+        default:
+            {
+            const char escape[] = { '\\', 'u', '0', '0', kHEX_DIGITS[ch >> 4], kHEX_DIGITS[ch & 0xF] };
+            out->append( escape, sizeof(escape) );
+            }
+            break;
+        }
+    }
+    out->append(chunk_begin, end);
+    out->push_back('"');
+}
+
+} // namespace anonymous
+
+void writeValue(const Rpc::Value& value, std::string* out)
+{
+    assert(out);
+
+    switch ( value.type() ) {
+    case Rpc::Value::TYPE_NONE:
+        // treat none rpc value as null json value.
+    case Rpc::Value::TYPE_NULL:
+        out->append("null", 4);
+        break;
+    case Rpc::Value::TYPE_BOOL:
+        if ( static_cast<bool>(value) ) {
+            out->append("true", 4);
+        } else {
+            out->append("false", 5);
+        }
+        break;
+    case Rpc::Value::TYPE_INT:
+        writeInt(static_cast<int>(value), out);
+        break;
+    case Rpc::Value::TYPE_UINT:
+        writeUInt(static_cast<unsigned int>(value), out);
+        break;
+    case Rpc::Value::TYPE_DOUBLE:
+        writeDouble(static_cast<double>(value), out);
+        break;
+    case Rpc::Value::TYPE_STRING:
+        writeString(static_cast<const std::string&>(value), out);
+        break;
+    case Rpc::Value::TYPE_ARRAY:
+        {
+        out->push_back('[');
+        for (auto begin = value.getArrayItemsBegin(), end = value.getArrayItemsEnd(),
+                  it = begin;
+                  it != end;
+                  ++it
+             )
+        {
+            if (it != begin) {
+                out->push_back(',');
+            }
+            writeValue(*it, out);
+        }
+        out->push_back(']');
+        }
+        break;
+    case Rpc::Value::TYPE_OBJECT:
+        {
+        out->push_back('{');
+        for (auto begin = value.getObjectMembersBegin(), end = value.getObjectMembersEnd(),
+                  it = begin;
+                  it != end;
+                  ++it
+             )
+        {
+            if (it != begin) {
+                out->push_back(',');
+            }
+            writeString(it->first, out);
+            out->push_back(':');
+            writeValue(it->second, out);
+        }
+        out->push_back('}');
+        }
+        break;
+    default:
+        throw Rpc::Exception("unknown type", Rpc::TYPE_ERROR);
+    }
+}
+
+void writeResponse(const Rpc::Value& root_response, std::string* out)
+{
+    assert(out);
+
+    // members are sorted by name as Json::FastWriter did, so put "jsonrpc" member at its place.
+    static const std::string kJSONRPC = "jsonrpc";
+    static const char kJSONRPC_MEMBER[] = "\"jsonrpc\":\"2.0\"";
+
+    out->push_back('{');
+    bool first_member = true;
+    bool jsonrpc_written = false;
+    for (auto it = root_response.getObjectMembersBegin(), end = root_response.getObjectMembersEnd(); it != end; ++it) {
+        if (!jsonrpc_written && kJSONRPC <= it->first) {
+            if (!first_member) {
+                out->push_back(',');
+            }
+            out->append( kJSONRPC_MEMBER, sizeof(kJSONRPC_MEMBER) - 1 );
+            jsonrpc_written = true;
+            first_member = false;
+        }
+
+        if (it->first == kJSONRPC) {
+            continue;
+        }
+
+        if (!first_member) {
+            out->push_back(',');
+        }
+        writeString(it->first, out);
+        out->push_back(':');
+        writeValue(it->second, out);
+        first_member = false;
+    }
+
+    if (!jsonrpc_written) {
+        if (!first_member) {
+            out->push_back(',');
+        }
+        out->append( kJSONRPC_MEMBER, sizeof(kJSONRPC_MEMBER) - 1 );
+    }
+    out->push_back('}');
+}
+
+} // namespace JsonRpc
@@ -8,25 +8,35 @@
 namespace JsonRpc
 {
 
-struct ResponseSerializerImpl;
-
+//! Writes responses directly from Rpc::Value to JSON text.
 class ResponseSerializer : public Rpc::ResponseSerializer
 {
 public:
 
-    ResponseSerializer();
-    ~ResponseSerializer();
+    ResponseSerializer() {}
 
     virtual void serializeSuccess(const Rpc::Value& root_response, std::string* response) const;
 
     virtual void serializeFault(const Rpc::Value& root_request, const std::string& error_msg, int error_code, std::string* response) const;
 
+    virtual void serializeBatch(const Rpc::Value& root_responses, std::string* response) const;
+
+    virtual bool serializeSuccessTemplate(const Rpc::Value& root_response, std::string* response, std::size_t* id_offset) const;
+
+    virtual void serializeId(const Rpc::Value& id, std::string* response) const;
+
+    virtual bool streamingSupported() const
+        { return true; }
+
+    virtual void serializeStreamedSuccess(const Rpc::Value& root_response, const std::string& array_name,
+                                          std::string* head, std::string* tail) const;
+
+    virtual void serializeStreamedItem(const Rpc::Value& item, std::size_t index, std::string* response) const;
+
     virtual const std::string& mimeType() const;
 
 private:
 
-    ResponseSerializerImpl* impl_;
-
     ResponseSerializer(const ResponseSerializer&);
     ResponseSerializer& operator=(const ResponseSerializer&);
 };
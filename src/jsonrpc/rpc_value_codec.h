@@ -0,0 +1,65 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <string>
+
+namespace Rpc { class Value; }
+
+namespace JsonRpc
+{
+
+/*!
+    \brief Parses JSON text directly into Rpc::Value without intermediate Json::Value tree.
+           Strings and member names are decoded once and moved into result.
+           C and C++ style comments are skipped as Json::Reader does in default mode, data after the root value is an error.
+*/
+class RpcValueReader
+{
+public:
+
+    /*!
+        \brief Parses document.
+        \return false if document is not valid JSON. See errorMessage() for details.
+    */
+    bool parse(const char* begin, const char* end, Rpc::Value* root);
+
+    const std::string& errorMessage() const
+        { return error_message_; }
+
+private:
+
+    bool parseValue(Rpc::Value* value, unsigned int depth);
+    bool parseObject(Rpc::Value* value, unsigned int depth);
+    bool parseArray(Rpc::Value* value, unsigned int depth);
+    bool parseString(std::string* string);
+    bool parseNumber(Rpc::Value* value);
+    bool parseUnicodeEscape(unsigned int* code_point);
+    bool parseLiteral(const char* literal);
+
+    //! \return false if comment is not terminated.
+    bool skipWhitespaceAndComments();
+
+    bool fail(const char* message);
+
+    //! Nesting limit protects stack from malicious requests.
+    static const unsigned int kMaxDepth = 256;
+
+    const char* begin_;
+    const char* current_;
+    const char* end_;
+    std::string error_message_;
+};
+
+/*!
+    \brief Appends compact JSON representation of value to output.
+           Output is the same as Json::FastWriter produces without trailing new line. TYPE_NONE values are written as null.
+*/
+void writeValue(const Rpc::Value& value, std::string* out);
+
+/*!
+    \brief Appends JSON-RPC 2.0 response object: members of root_response(id, result or error) and "jsonrpc" member.
+*/
+void writeResponse(const Rpc::Value& root_response, std::string* out);
+
+} // namespace JsonRpc
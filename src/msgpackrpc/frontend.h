@@ -0,0 +1,32 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include "rpc/frontend.h"
+#include "msgpackrpc/request_parser.h"
+#include "msgpackrpc/response_serializer.h"
+
+namespace MsgPackRpc
+{
+
+//! Binary frontend for native clients: JSON-RPC like requests and responses encoded by MessagePack.
+class Frontend : public Rpc::Frontend
+{
+public:
+
+    virtual bool canHandleRequest(const std::string& uri) const
+        { return uri == "/RPC_MSGPACK"; }
+
+    virtual Rpc::RequestParser& requestParser()
+        { return request_parser_; }
+
+    virtual Rpc::ResponseSerializer& responseSerializer()
+        { return response_serializer_; }
+
+private:
+
+    RequestParser request_parser_;
+    ResponseSerializer response_serializer_;
+};
+
+} // namespace MsgPackRpc
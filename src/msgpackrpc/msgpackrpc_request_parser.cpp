@@ -0,0 +1,18 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "msgpackrpc/request_parser.h"
+#include "rpc/value.h"
+
+namespace MsgPackRpc
+{
+
+bool RequestParser::parse_(const std::string& /*request_uri*/,
+                           const std::string& request_content,
+                           Rpc::Value* root)
+{
+    const char* const begin = request_content.data();
+    return reader_.parse(begin, begin + request_content.size(), root);
+}
+
+} // namespace MsgPackRpc
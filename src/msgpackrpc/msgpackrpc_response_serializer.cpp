@@ -0,0 +1,81 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "msgpackrpc/response_serializer.h"
+#include "msgpackrpc/rpc_value_codec.h"
+#include "rpc/value.h"
+#include <cassert>
+
+namespace MsgPackRpc
+{
+
+const std::string kMIME_TYPE = "application/x-msgpack";
+
+void ResponseSerializer::serializeSuccess(const Rpc::Value& root_response, std::string* response) const
+{
+    assert(response);
+    response->clear();
+    writeValue(root_response, response);
+}
+
+void ResponseSerializer::serializeFault(const Rpc::Value& root_request, const std::string& error_msg, int error_code, std::string* response) const
+{
+    assert(response);
+
+    Rpc::Value root_response;
+    if ( root_request.isMember("id") ) {
+        root_response["id"] = root_request["id"];
+    } else {
+        root_response["id"] = Rpc::Value::Null();
+    }
+
+    Rpc::Value& error = root_response["error"];
+    error["message"] = error_msg;
+    error["code"] = error_code;
+
+    response->clear();
+    writeValue(root_response, response);
+}
+
+void ResponseSerializer::serializeBatch(const Rpc::Value& root_responses, std::string* response) const
+{
+    assert(response);
+    response->clear();
+    writeValue(root_responses, response);
+}
+
+bool ResponseSerializer::serializeSuccessTemplate(const Rpc::Value& root_response, std::string* response, std::size_t* id_offset) const
+{
+    assert(response);
+    assert(id_offset);
+
+    serializeSuccess(root_response, response);
+
+    // success response is map of two members sorted by name: "id" goes first, cut its value out.
+    static const char kID_MEMBER_START[] = "\x82\xA2" "id";
+    const std::size_t kID_MEMBER_START_LENGTH = sizeof(kID_MEMBER_START) - 1;
+    std::string id;
+    writeValue(root_response["id"], &id);
+    if (   response->compare(0, kID_MEMBER_START_LENGTH, kID_MEMBER_START) != 0
+        || response->compare(kID_MEMBER_START_LENGTH, id.size(), id) != 0
+        )
+    {
+        return false;
+    }
+    response->erase(kID_MEMBER_START_LENGTH, id.size());
+    *id_offset = kID_MEMBER_START_LENGTH;
+    return true;
+}
+
+void ResponseSerializer::serializeId(const Rpc::Value& id, std::string* response) const
+{
+    assert(response);
+    writeValue(id, response);
+}
+
+const std::string& ResponseSerializer::mimeType() const
+{
+    return kMIME_TYPE;
+}
+
+} // namespace MsgPackRpc
@@ -0,0 +1,397 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "msgpackrpc/rpc_value_codec.h"
+#include "rpc/value.h"
+#include "utils/util.h"
+#include <cassert>
+#include <climits>
+#include <cstring>
+
+namespace MsgPackRpc
+{
+
+using Utilities::MakeString;
+
+namespace {
+
+// format bytes, see https://github.com/msgpack/msgpack/blob/master/spec.md
+enum FORMAT {
+    POSITIVE_FIXINT_MAX = 0x7F,
+    FIXMAP       = 0x80,
+    FIXARRAY     = 0x90,
+    FIXSTR       = 0xA0,
+    NIL          = 0xC0,
+    FALSE_VALUE  = 0xC2,
+    TRUE_VALUE   = 0xC3,
+    BIN8         = 0xC4,
+    BIN16        = 0xC5,
+    BIN32        = 0xC6,
+    FLOAT32      = 0xCA,
+    FLOAT64      = 0xCB,
+    UINT8        = 0xCC,
+    UINT16       = 0xCD,
+    UINT32       = 0xCE,
+    UINT64       = 0xCF,
+    INT8         = 0xD0,
+    INT16        = 0xD1,
+    INT32        = 0xD2,
+    INT64        = 0xD3,
+    STR8         = 0xD9,
+    STR16        = 0xDA,
+    STR32        = 0xDB,
+    ARRAY16      = 0xDC,
+    ARRAY32      = 0xDD,
+    MAP16        = 0xDE,
+    MAP32        = 0xDF,
+    NEGATIVE_FIXINT_MIN = 0xE0
+};
+
+void setUnsigned(unsigned long long number, Rpc::Value* value)
+{
+    if (number <= INT_MAX) {
+        *value = static_cast<int>(number);
+    } else if (number <= UINT_MAX) {
+        *value = static_cast<unsigned int>(number);
+    } else {
+        *value = static_cast<double>(number); // number is too large for integer types, store it as double as JSON reader does.
+    }
+}
+
+void setSigned(long long number, Rpc::Value* value)
+{
+    if (number >= 0) {
+        setUnsigned(static_cast<unsigned long long>(number), value);
+    } else if (number >= INT_MIN) {
+        *value = static_cast<int>(number);
+    } else {
+        *value = static_cast<double>(number);
+    }
+}
+
+} // namespace anonymous
+
+bool RpcValueReader::parse(const char* begin, const char* end, Rpc::Value* root)
+{
+    assert(root);
+
+    begin_ = current_ = begin;
+    end_ = end;
+    error_message_.clear();
+
+    if ( !parseValue(root, 0) ) {
+        return false;
+    }
+
+    if (current_ != end_) {
+        return fail("Extra data after document end");
+    }
+    return true;
+}
+
+bool RpcValueReader::fail(const char* message)
+{
+    error_message_ = MakeString() << message << " at offset " << (current_ - begin_);
+    return false;
+}
+
+bool RpcValueReader::readBigEndian(std::size_t bytes, unsigned long long* number)
+{
+    if (static_cast<std::size_t>(end_ - current_) < bytes) {
+        return fail("Unexpected end of document");
+    }
+
+    *number = 0;
+    for (std::size_t i = 0; i != bytes; ++i) {
+        *number = (*number << 8) | static_cast<unsigned char>(*current_++);
+    }
+    return true;
+}
+
+bool RpcValueReader::parseValue(Rpc::Value* value, unsigned int depth)
+{
+    if (depth > kMaxDepth) {
+        return fail("Nesting is too deep");
+    }
+
+    if (current_ == end_) {
+        return fail("Unexpected end of document");
+    }
+
+    const unsigned char format = static_cast<unsigned char>(*current_++);
+    if (format <= POSITIVE_FIXINT_MAX) {
+        *value = static_cast<int>(format);
+        return true;
+    } else if (format >= NEGATIVE_FIXINT_MIN) {
+        *value = static_cast<int>( static_cast<signed char>(format) );
+        return true;
+    } else if ( (format & 0xF0) == FIXMAP ) {
+        return parseMap(value, format & 0x0F, depth + 1);
+    } else if ( (format & 0xF0) == FIXARRAY ) {
+        return parseArray(value, format & 0x0F, depth + 1);
+    } else if ( (format & 0xE0) == FIXSTR ) {
+        return parseString(value, format & 0x1F);
+    }
+
+    unsigned long long number;
+    switch (format) {
+    case NIL:
+        *value = Rpc::Value::Null();
+        return true;
+    case FALSE_VALUE:
+        *value = false;
+        return true;
+    case TRUE_VALUE:
+        *value = true;
+        return true;
+    case BIN8:
+    case STR8:
+        return readBigEndian(1, &number) && parseString(value, static_cast<std::size_t>(number));
+    case BIN16:
+    case STR16:
+        return readBigEndian(2, &number) && parseString(value, static_cast<std::size_t>(number));
+    case BIN32:
+    case STR32:
+        return readBigEndian(4, &number) && parseString(value, static_cast<std::size_t>(number));
+    case FLOAT32:
+        {
+        if ( !readBigEndian(4, &number) ) {
+            return false;
+        }
+        const unsigned int bits = static_cast<unsigned int>(number);
+        float float_value;
+        std::memcpy( &float_value, &bits, sizeof(float_value) );
+        *value = static_cast<double>(float_value);
+        return true;
+        }
+    case FLOAT64:
+        {
+        if ( !readBigEndian(8, &number) ) {
+            return false;
+        }
+        double double_value;
+        std::memcpy( &double_value, &number, sizeof(double_value) );
+        *value = double_value;
+        return true;
+        }
+    case UINT8:
+    case UINT16:
+    case UINT32:
+    case UINT64:
+        if ( !readBigEndian(std::size_t(1) << (format - UINT8), &number) ) {
+            return false;
+        }
+        setUnsigned(number, value);
+        return true;
+    case INT8:
+    case INT16:
+    case INT32:
+    case INT64:
+        {
+        const std::size_t bytes = std::size_t(1) << (format - INT8);
+        if ( !readBigEndian(bytes, &number) ) {
+            return false;
+        }
+        // sign extension of two's complement number.
+        const unsigned int shift = static_cast<unsigned int>(64 - bytes * 8);
+        setSigned(static_cast<long long>(number << shift) >> shift, value);
+        return true;
+        }
+    case ARRAY16:
+        return readBigEndian(2, &number) && parseArray(value, static_cast<std::size_t>(number), depth + 1);
+    case ARRAY32:
+        return readBigEndian(4, &number) && parseArray(value, static_cast<std::size_t>(number), depth + 1);
+    case MAP16:
+        return readBigEndian(2, &number) && parseMap(value, static_cast<std::size_t>(number), depth + 1);
+    case MAP32:
+        return readBigEndian(4, &number) && parseMap(value, static_cast<std::size_t>(number), depth + 1);
+    default:
+        --current_;
+        return fail("Unsupported format");
+    }
+}
+
+bool RpcValueReader::parseString(Rpc::Value* value, std::size_t length)
+{
+    if (static_cast<std::size_t>(end_ - current_) < length) {
+        return fail("Unexpected end of document in string");
+    }
+    *value = std::string(current_, length);
+    current_ += length;
+    return true;
+}
+
+bool RpcValueReader::parseArray(Rpc::Value* value, std::size_t size, unsigned int depth)
+{
+    if (static_cast<std::size_t>(end_ - current_) < size) { // each item takes at least one byte, do not reserve memory for malicious size.
+        return fail("Unexpected end of document in array");
+    }
+
+    Rpc::Value::Array array(size);
+    for (std::size_t i = 0; i != size; ++i) {
+        if ( !parseValue(&array[i], depth) ) {
+            return false;
+        }
+    }
+
+    *value = std::move(array);
+    return true;
+}
+
+bool RpcValueReader::parseMap(Rpc::Value* value, std::size_t size, unsigned int depth)
+{
+    if (static_cast<std::size_t>(end_ - current_) / 2 < size) { // each member takes at least two bytes.
+        return fail("Unexpected end of document in map");
+    }
+
+    Rpc::Value::Object object;
+    object.reserve(size);
+    for (std::size_t i = 0; i != size; ++i) {
+        Rpc::Value name;
+        if ( !parseValue(&name, depth) ) {
+            return false;
+        }
+        if (name.type() != Rpc::Value::TYPE_STRING) {
+            return fail("Map key is not a string");
+        }
+
+        Rpc::Value& member = object[ std::move( static_cast<std::string&>(name) ) ];
+        if ( !parseValue(&member, depth) ) {
+            return false;
+        }
+    }
+
+    *value = std::move(object);
+    return true;
+}
+
+namespace {
+
+void writeByte(unsigned char byte, std::string* out)
+{
+    out->push_back( static_cast<char>(byte) );
+}
+
+void writeBigEndian(unsigned long long number, std::size_t bytes, std::string* out)
+{
+    char buffer[8];
+    for (std::size_t i = bytes; i != 0; --i) {
+        buffer[i - 1] = static_cast<char>(number & 0xFF);
+        number >>= 8;
+    }
+    out->append(buffer, bytes);
+}
+
+void writeUInt(unsigned int value, std::string* out)
+{
+    if (value <= POSITIVE_FIXINT_MAX) {
+        writeByte(static_cast<unsigned char>(value), out);
+    } else if (value <= 0xFF) {
+        writeByte(UINT8, out);
+        writeBigEndian(value, 1, out);
+    } else if (value <= 0xFFFF) {
+        writeByte(UINT16, out);
+        writeBigEndian(value, 2, out);
+    } else {
+        writeByte(UINT32, out);
+        writeBigEndian(value, 4, out);
+    }
+}
+
+void writeInt(int value, std::string* out)
+{
+    if (value >= 0) {
+        writeUInt(static_cast<unsigned int>(value), out);
+    } else if (value >= -32) {
+        writeByte(static_cast<unsigned char>(value), out); // negative fixint.
+    } else if (value >= SCHAR_MIN) {
+        writeByte(INT8, out);
+        writeBigEndian(static_cast<unsigned char>(value), 1, out);
+    } else if (value >= SHRT_MIN) {
+        writeByte(INT16, out);
+        writeBigEndian(static_cast<unsigned short>(value), 2, out);
+    } else {
+        writeByte(INT32, out);
+        writeBigEndian(static_cast<unsigned int>(value), 4, out);
+    }
+}
+
+void writeDouble(double value, std::string* out)
+{
+    unsigned long long bits;
+    std::memcpy( &bits, &value, sizeof(bits) );
+    writeByte(FLOAT64, out);
+    writeBigEndian(bits, 8, out);
+}
+
+//! Writes header of str, array or map: fix format if size fits in it, otherwise 16 or 32 bits size.
+void writeHeader(std::size_t size, unsigned char fix_format, std::size_t fix_max_size, unsigned char format8, unsigned char format16, std::string* out)
+{
+    if (size <= fix_max_size) {
+        writeByte(static_cast<unsigned char>(fix_format | size), out);
+    } else if (format8 != 0 && size <= 0xFF) {
+        writeByte(format8, out);
+        writeBigEndian(size, 1, out);
+    } else if (size <= 0xFFFF) {
+        writeByte(format16, out);
+        writeBigEndian(size, 2, out);
+    } else {
+        writeByte(static_cast<unsigned char>(format16 + 1), out); // 32 bits format follows 16 bits one.
+        writeBigEndian(size, 4, out);
+    }
+}
+
+void writeString(const std::string& string, std::string* out)
+{
+    writeHeader(string.size(), FIXSTR, 0x1F, STR8, STR16, out);
+    out->append(string);
+}
+
+} // namespace anonymous
+
+void writeValue(const Rpc::Value& value, std::string* out)
+{
+    assert(out);
+
+    switch ( value.type() ) {
+    case Rpc::Value::TYPE_NONE:
+        // treat none rpc value as nil.
+    case Rpc::Value::TYPE_NULL:
+        writeByte(NIL, out);
+        break;
+    case Rpc::Value::TYPE_BOOL:
+        writeByte(static_cast<bool>(value) ? TRUE_VALUE : FALSE_VALUE, out);
+        break;
+    case Rpc::Value::TYPE_INT:
+        writeInt(static_cast<int>(value), out);
+        break;
+    case Rpc::Value::TYPE_UINT:
+        writeUInt(static_cast<unsigned int>(value), out);
+        break;
+    case Rpc::Value::TYPE_DOUBLE:
+        writeDouble(static_cast<double>(value), out);
+        break;
+    case Rpc::Value::TYPE_STRING:
+        writeString(static_cast<const std::string&>(value), out);
+        break;
+    case Rpc::Value::TYPE_ARRAY:
+        writeHeader(value.size(), FIXARRAY, 0x0F, 0, ARRAY16, out);
+        for (auto it = value.getArrayItemsBegin(), end = value.getArrayItemsEnd(); it != end; ++it) {
+            writeValue(*it, out);
+        }
+        break;
+    case Rpc::Value::TYPE_OBJECT:
+        writeHeader(value.size(), FIXMAP, 0x0F, 0, MAP16, out);
+        for (auto it = value.getObjectMembersBegin(), end = value.getObjectMembersEnd(); it != end; ++it) {
+            writeString(it->first, out);
+            writeValue(it->second, out);
+        }
+        break;
+    default:
+        assert(!"unknown Rpc::Value type");
+        writeByte(NIL, out);
+        break;
+    }
+}
+
+} // namespace MsgPackRpc
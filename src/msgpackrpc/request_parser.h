@@ -0,0 +1,27 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include "rpc/request_parser.h"
+#include "msgpackrpc/rpc_value_codec.h"
+
+namespace MsgPackRpc
+{
+
+/*!
+    \brief Parses request encoded by MessagePack.
+           Request is map with the same members as JSON-RPC request has: "method", "params" and optional "id".
+           Array of such maps is a batch.
+*/
+class RequestParser : public Rpc::RequestParser
+{
+private:
+
+    virtual bool parse_(const std::string& /*request_uri*/,
+                        const std::string& request_content,
+                        Rpc::Value* root);
+
+    RpcValueReader reader_;
+};
+
+} // namespace MsgPackRpc
@@ -0,0 +1,32 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include "rpc/response_serializer.h"
+
+namespace MsgPackRpc
+{
+
+/*!
+    \brief Writes responses encoded by MessagePack.
+           Response is map with "id" and "result" members, or "id" and "error" members where error is map with "code" and "message".
+           Batch response is array of such maps.
+*/
+class ResponseSerializer : public Rpc::ResponseSerializer
+{
+public:
+
+    virtual void serializeSuccess(const Rpc::Value& root_response, std::string* response) const;
+
+    virtual void serializeFault(const Rpc::Value& root_request, const std::string& error_msg, int error_code, std::string* response) const;
+
+    virtual void serializeBatch(const Rpc::Value& root_responses, std::string* response) const;
+
+    virtual bool serializeSuccessTemplate(const Rpc::Value& root_response, std::string* response, std::size_t* id_offset) const;
+
+    virtual void serializeId(const Rpc::Value& id, std::string* response) const;
+
+    virtual const std::string& mimeType() const;
+};
+
+} // namespace MsgPackRpc
@@ -0,0 +1,60 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <string>
+
+namespace Rpc { class Value; }
+
+//! MessagePack(http://msgpack.org) encoding of Rpc::Value.
+namespace MsgPackRpc
+{
+
+/*!
+    \brief Parses MessagePack document into Rpc::Value.
+           Types are mapped one-to-one: nil -> null, integers -> int or unsigned int(double if value does not fit 32 bits),
+           float 32/64 -> double, str and bin -> string, array -> array, map with string keys -> object.
+           Extension types are not supported, data after the root value is an error.
+*/
+class RpcValueReader
+{
+public:
+
+    /*!
+        \brief Parses document.
+        \return false if document is not valid MessagePack. See errorMessage() for details.
+    */
+    bool parse(const char* begin, const char* end, Rpc::Value* root);
+
+    const std::string& errorMessage() const
+        { return error_message_; }
+
+private:
+
+    bool parseValue(Rpc::Value* value, unsigned int depth);
+    bool parseMap(Rpc::Value* value, std::size_t size, unsigned int depth);
+    bool parseArray(Rpc::Value* value, std::size_t size, unsigned int depth);
+    bool parseString(Rpc::Value* value, std::size_t length);
+
+    //! Reads big-endian unsigned integer of specified size in bytes.
+    bool readBigEndian(std::size_t bytes, unsigned long long* number);
+
+    bool fail(const char* message);
+
+    //! Nesting limit protects stack from malicious requests.
+    static const unsigned int kMaxDepth = 256;
+
+    const char* begin_;
+    const char* current_;
+    const char* end_;
+    std::string error_message_;
+};
+
+/*!
+    \brief Appends MessagePack representation of value to output.
+           Integers are written in the shortest format, doubles as float 64, objects as maps with members sorted by name.
+           TYPE_NONE values are written as nil.
+*/
+void writeValue(const Rpc::Value& value, std::string* out);
+
+} // namespace MsgPackRpc
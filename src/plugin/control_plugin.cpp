@@ -8,6 +8,7 @@
 #include "aimp/manager3.6.h"
 #include "logger.h"
 #include "settings.h"
+#include "player_thread_dispatcher.h"
 #include "rpc/methods.h"
 #include "rpc/compatibility/webctrl_plugin.h"
 #include "rpc/frontend.h"
@@ -15,6 +16,7 @@
 #include "xmlrpc/frontend.h"
 #include "jsonrpc/frontend.h"
 #include "webctlrpc/frontend.h"
+#include "msgpackrpc/frontend.h"
 #include "http_server/request_handler.h"
 #include "http_server/request_handler.h"
 #include "http_server/server.h"
@@ -90,6 +92,7 @@ const std::wstring AIMPControlPlugin::kPLUGIN_SETTINGS_FILENAME = L"settings.dat
 
 const UINT_PTR kTickTimerEventID = 0x01020304;
 const UINT     kTickTimerElapse = 100; // 100 ms.
+const std::size_t kPlayerThreadCommandQueueCapacity = 256; // max count of HTTP requests which are waiting for handling in player thread.
 
 namespace PluginLogger
 {
@@ -463,6 +466,7 @@ HRESULT AIMPControlPlugin::initialize()
 
         // create RPC request handler.
         rpc_request_handler_.reset( new Rpc::RequestHandler() );
+        response_cache_invalidator_.reset( new AimpRpcMethods::ResponseCacheInvalidator(*aimp_manager_, rpc_request_handler_->responseCache()) );
         createRpcFrontends();
         createRpcMethods();
 
@@ -475,7 +479,11 @@ HRESULT AIMPControlPlugin::initialize()
             
                 fs::create_directories(temp_dir_to_store_tracks_being_added);
 
-                Http::MPFD::ParserFactory::instance(Http::MPFD::ParserFactory::ParserFactoryPtr(new Http::MPFD::ParserFactoryImpl(temp_dir_to_store_tracks_being_added))
+                // extensions are got here since parsers check file names in connection threads.
+                const std::vector<std::wstring> track_extensions = UploadTrack::getSupportedTrackExtensions(*aimp_manager_);
+                Http::MPFD::ParserFactory::instance(Http::MPFD::ParserFactory::ParserFactoryPtr(new Http::MPFD::ParserFactoryImpl(temp_dir_to_store_tracks_being_added,
+                                                                                                                                       track_extensions)
+                                                                                                )
                                                     );
             }
 
@@ -493,11 +501,16 @@ HRESULT AIMPControlPlugin::initialize()
                                                                *upload_track_request_handler_
                                                               )
                                     );
+        // registered here since static file cache is owned by HTTP request handler.
+        rpc_request_handler_->addMethod( std::auto_ptr<Rpc::Method>(
+                                                new AimpRpcMethods::GetStaticFileCacheStats(*aimp_manager_,
+                                                                                            *rpc_request_handler_,
+                                                                                            http_request_handler_->staticFileCache()
+                                                                                            )
+                                                                    )
+                                        );
         // create XMLRPC server.
-        server_.reset(new Http::Server( *server_io_service_,
-                                        *http_request_handler_
-                                       )
-                      );
+        createHttpServer();
 
         startTickTimer();
     } catch (boost::thread_resource_error& e) {
@@ -522,7 +535,12 @@ HRESULT AIMPControlPlugin::Finalize()
 
     stopTickTimer();
 
+    stopHttpIoThreads();
+
     server_io_service_->stop();
+
+    // drop requests which are waiting for handling in player thread.
+    player_thread_dispatcher_.reset();
     
     if (server_) {
         // stop the server.
@@ -532,12 +550,16 @@ HRESULT AIMPControlPlugin::Finalize()
         server_.reset();
     }
 
+    http_io_service_.reset();
+
     http_request_handler_.reset();
 
     download_track_request_handler_.reset();
 
     upload_track_request_handler_.reset();
 
+    response_cache_invalidator_.reset();
+
     rpc_request_handler_.reset();
 
     aimp_manager_.reset();
@@ -556,6 +578,71 @@ HRESULT AIMPControlPlugin::Finalize()
     return S_OK;
 }
 
+void AIMPControlPlugin::createHttpServer()
+{
+    const unsigned int io_threads_count = settings().http_server.io_threads;
+    if (io_threads_count == 0) {
+        // all network I/O is done in player thread on timer tick.
+        server_.reset(new Http::Server( *server_io_service_,
+                                        *http_request_handler_
+                                       )
+                      );
+        return;
+    }
+
+    // player thread io_service is polled right after requests handling to send replies and notifications without delay.
+    auto poll_player_io_service = [this]() {
+        try {
+            server_io_service_->poll();
+        } catch (std::exception& e) {
+            BOOST_LOG_SEV(logger(), critical) << "Unhandled exception on player thread io_service polling: " << e.what();
+        }
+    };
+    player_thread_dispatcher_.reset( new PlayerThreadDispatcher(kPlayerThreadCommandQueueCapacity,
+                                                                poll_player_io_service
+                                                                )
+                                    );
+
+    http_io_service_ = boost::make_shared<boost::asio::io_service>();
+    http_io_work_ = boost::make_shared<boost::asio::io_service::work>(*http_io_service_);
+
+    server_.reset(new Http::Server( *http_io_service_,
+                                    *http_request_handler_,
+                                    boost::bind(&PlayerThreadDispatcher::post, player_thread_dispatcher_.get(), _1)
+                                   )
+                  );
+
+    for (unsigned int i = 0; i != io_threads_count; ++i) {
+        http_io_threads_.create_thread( boost::bind(&AIMPControlPlugin::runHttpIoService, this) );
+    }
+
+    BOOST_LOG_SEV(logger(), info) << "HTTP server works in " << io_threads_count << " I/O thread(s)";
+}
+
+void AIMPControlPlugin::runHttpIoService()
+{
+    for (;;) {
+        try {
+            http_io_service_->run();
+            break; // normal exit: io_service was stopped.
+        } catch (std::exception& e) {
+            BOOST_LOG_SEV(logger(), error) << "Unhandled exception in HTTP I/O thread: " << e.what();
+        } catch (...) {
+            BOOST_LOG_SEV(logger(), error) << "Unhandled unknown exception in HTTP I/O thread.";
+        }
+    }
+}
+
+void AIMPControlPlugin::stopHttpIoThreads()
+{
+    if (http_io_service_) {
+        BOOST_LOG_SEV(logger(), info) << "Stopping HTTP I/O threads.";
+        http_io_work_.reset();
+        http_io_service_->stop();
+        http_io_threads_.join_all();
+    }
+}
+
 HRESULT AIMPControlPlugin::ShowSettingsDialog(HWND AParentWindow)
 {
     STARTUPINFO si = { 0 };
@@ -603,6 +690,7 @@ void AIMPControlPlugin::createRpcFrontends()
     REGISTER_RPC_FRONTEND(XmlRpc);
     REGISTER_RPC_FRONTEND(JsonRpc);
     REGISTER_RPC_FRONTEND(WebCtlRpc);
+    REGISTER_RPC_FRONTEND(MsgPackRpc);
 #undef REGISTER_RPC_FRONTEND
 }
 
@@ -675,6 +763,7 @@ void AIMPControlPlugin::createRpcMethods()
     }
 
     REGISTER_AIMP_RPC_METHOD(GetPlaylistEntriesCount);
+    REGISTER_AIMP_RPC_METHOD(GetPlaylistEntriesDelta);
     REGISTER_AIMP_RPC_METHOD(GetFormattedEntryTitle);
     REGISTER_AIMP_RPC_METHOD(GetPlaylistEntryInfo);
 
@@ -713,6 +802,8 @@ void AIMPControlPlugin::createRpcMethods()
                                     );
     REGISTER_AIMP_RPC_METHOD(Version);
     REGISTER_AIMP_RPC_METHOD(PluginCapabilities);
+    REGISTER_AIMP_RPC_METHOD(GetResponseCacheStats);
+    REGISTER_AIMP_RPC_METHOD(GetStmtCacheStats);
     REGISTER_AIMP_RPC_METHOD(AddURLToPlaylist);
 
     {
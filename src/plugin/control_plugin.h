@@ -16,6 +16,8 @@ namespace Rpc           { class RequestHandler; }
 namespace DownloadTrack { class RequestHandler; }
 namespace UploadTrack   { class RequestHandler; }
 namespace AIMP2SDK { class IAIMP2Controller; }
+namespace AimpRpcMethods { class ResponseCacheInvalidator; }
+namespace ControlPlugin { class PlayerThreadDispatcher; }
 
 //! contains class which implements AIMP SDK interfaces and interacts with AIMP player.
 namespace ControlPlugin
@@ -66,9 +68,22 @@ private:
 
     HRESULT initialize();
 
-    // Runs the server's io_service loop.
+    // Runs the player thread's io_service loop.
     void onTick();
 
+    //! Runs io_service loop of HTTP server in I/O thread. Used if settings().http_server.io_threads is non zero.
+    void runHttpIoService();
+
+    /*!
+        \brief Creates HTTP server.
+               Server uses player thread io_service if I/O threads are disabled in settings,
+               otherwise it works in own I/O threads and passes requests to player thread through PlayerThreadDispatcher.
+    */
+    void createHttpServer(); // throws std::runtime_error
+
+    //! Stops HTTP I/O threads if they were started.
+    void stopHttpIoThreads();
+
     static void CALLBACK onTickTimerProc(HWND hwnd,
                                          UINT uMsg,
                                          UINT_PTR idEvent,
@@ -163,10 +178,15 @@ private:
     boost::filesystem::wpath plugin_settings_filepath_;
 
     boost::shared_ptr<Rpc::RequestHandler> rpc_request_handler_; //!< XML/Json RPC request handler. Used by Http::RequestHandler object.
+    boost::shared_ptr<AimpRpcMethods::ResponseCacheInvalidator> response_cache_invalidator_; //!< drops cached RPC responses on playlists change.
     boost::shared_ptr<DownloadTrack::RequestHandler> download_track_request_handler_; //!< Download track request handler. Used by Http::RequestHandler object.
     boost::shared_ptr<UploadTrack::RequestHandler> upload_track_request_handler_; //!< Upload track request handler. Used by Http::RequestHandler object.
     boost::shared_ptr<Http::RequestHandler> http_request_handler_; //!< Http request handler, used by Http::Server object.
-    boost::shared_ptr<boost::asio::io_service> server_io_service_;
+    boost::shared_ptr<boost::asio::io_service> server_io_service_; //!< io_service which is run in player thread. AIMP manager and RPC methods work through it.
+    boost::shared_ptr<boost::asio::io_service> http_io_service_; //!< io_service of HTTP server I/O threads. Null if I/O threads are disabled.
+    boost::shared_ptr<boost::asio::io_service::work> http_io_work_; //!< keeps I/O threads running while server has no work.
+    boost::thread_group http_io_threads_;
+    boost::shared_ptr<PlayerThreadDispatcher> player_thread_dispatcher_; //!< passes HTTP requests from I/O threads to player thread.
     boost::shared_ptr<Http::Server> server_; //!< Simple Http server.
 
     static const std::wstring kPLUGIN_SETTINGS_FILENAME; //<! default plugin settings filename.
@@ -36,8 +36,9 @@ namespace fs = boost::filesystem;
 
 /*! logger source type for using by entire application.
     Add severity and module(or channel in terms of Boost.Log) name attributes.
+    Thread safe version is used since HTTP server can work in own I/O threads.
 */
-typedef log::sources::severity_channel_logger<SEVERITY_LEVELS> ModuleLoggerType;
+typedef log::sources::severity_channel_logger_mt<SEVERITY_LEVELS> ModuleLoggerType;
 
 /*!
     \brief Provides log output functionality for entire application.
@@ -0,0 +1,134 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "player_thread_dispatcher.h"
+#include "plugin/logger.h"
+#include "utils/util.h"
+
+namespace {
+using namespace ControlPlugin::PluginLogger;
+ModuleLoggerType& logger()
+    { return getLogManager().getModuleLogger<ControlPlugin::AIMPControlPlugin>(); }
+}
+
+namespace ControlPlugin
+{
+
+const wchar_t * const kWINDOW_CLASS_NAME = L"AIMPControlPluginPlayerThreadDispatcher";
+const UINT kWM_EXECUTE_COMMANDS = WM_APP + 1;
+
+HINSTANCE getModuleInstance()
+{
+    // get handle of plugin DLL itself, not of AIMP executable.
+    HMODULE module = nullptr;
+    GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                      reinterpret_cast<LPCWSTR>(&getModuleInstance),
+                      &module);
+    return module;
+}
+
+PlayerThreadDispatcher::PlayerThreadDispatcher(std::size_t capacity, Command on_commands_executed)
+    :
+    capacity_(capacity),
+    on_commands_executed_(on_commands_executed),
+    window_(nullptr),
+    wakeup_posted_(false)
+{
+    const HINSTANCE instance = getModuleInstance();
+
+    WNDCLASSEX wc = { 0 };
+    wc.cbSize = sizeof(wc);
+    wc.lpfnWndProc = &PlayerThreadDispatcher::windowProc;
+    wc.hInstance = instance;
+    wc.lpszClassName = kWINDOW_CLASS_NAME;
+    if ( !RegisterClassEx(&wc) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS ) {
+        using namespace Utilities;
+        throw std::runtime_error(MakeString() << "Error in " __FUNCTION__ ": RegisterClassEx failed. Error " << GetLastError());
+    }
+
+    window_ = CreateWindowEx(0, kWINDOW_CLASS_NAME, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, instance, nullptr);
+    if (!window_) {
+        using namespace Utilities;
+        throw std::runtime_error(MakeString() << "Error in " __FUNCTION__ ": CreateWindowEx failed. Error " << GetLastError());
+    }
+
+    SetWindowLongPtr( window_, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this) );
+}
+
+PlayerThreadDispatcher::~PlayerThreadDispatcher()
+{
+    SetWindowLongPtr(window_, GWLP_USERDATA, 0);
+    DestroyWindow(window_);
+    UnregisterClass( kWINDOW_CLASS_NAME, getModuleInstance() );
+
+    boost::mutex::scoped_lock lock(mutex_);
+    if ( !commands_.empty() ) {
+        BOOST_LOG_SEV(logger(), debug) << commands_.size() << " player thread commands were dropped on dispatcher destruction.";
+    }
+}
+
+bool PlayerThreadDispatcher::post(Command command)
+{
+    bool need_wakeup = false;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (commands_.size() >= capacity_) {
+            return false;
+        }
+        commands_.push_back(command);
+        need_wakeup = !wakeup_posted_;
+        wakeup_posted_ = true;
+    }
+
+    if (need_wakeup) {
+        if ( !PostMessage(window_, kWM_EXECUTE_COMMANDS, 0, 0) ) {
+            BOOST_LOG_SEV(logger(), error) << "Error in " __FUNCTION__ ": PostMessage failed. Error " << GetLastError();
+            boost::mutex::scoped_lock lock(mutex_);
+            wakeup_posted_ = false;
+        }
+    }
+    return true;
+}
+
+void PlayerThreadDispatcher::executePendingCommands()
+{
+    std::deque<Command> commands;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        commands.swap(commands_);
+        wakeup_posted_ = false;
+    }
+
+    for (auto& command : commands) {
+        try {
+            command();
+        } catch (std::exception& e) {
+            BOOST_LOG_SEV(logger(), error) << "Error in " __FUNCTION__ ": player thread command failed. Reason: " << e.what();
+        } catch (...) {
+            BOOST_LOG_SEV(logger(), error) << "Error in " __FUNCTION__ ": player thread command failed. Reason is unknown.";
+        }
+    }
+
+    if (on_commands_executed_) {
+        on_commands_executed_();
+    }
+}
+
+std::size_t PlayerThreadDispatcher::pendingCommandsCount() const
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    return commands_.size();
+}
+
+LRESULT CALLBACK PlayerThreadDispatcher::windowProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
+{
+    if (msg == kWM_EXECUTE_COMMANDS) {
+        if ( PlayerThreadDispatcher* dispatcher = reinterpret_cast<PlayerThreadDispatcher*>( GetWindowLongPtr(hwnd, GWLP_USERDATA) ) ) {
+            dispatcher->executePendingCommands();
+        }
+        return 0;
+    }
+    return DefWindowProc(hwnd, msg, wparam, lparam);
+}
+
+} // namespace ControlPlugin
@@ -0,0 +1,60 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <deque>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace ControlPlugin
+{
+
+/*!
+    \brief Bounded queue of commands which must be executed in player(GUI) thread.
+           Commands can be posted from any thread. Player thread is woken up by message which is posted
+           to hidden message-only window, so commands are executed as soon as player's message loop gets control,
+           without waiting for timer tick.
+           Object must be created and destroyed in player thread.
+*/
+class PlayerThreadDispatcher : boost::noncopyable
+{
+public:
+
+    typedef boost::function<void ()> Command;
+
+    /*!
+        \param capacity - max count of pending commands.
+        \param on_commands_executed - functor which is called in player thread after each batch of commands. Can be empty.
+        \throw std::runtime_error if message window creation fails.
+    */
+    PlayerThreadDispatcher(std::size_t capacity, Command on_commands_executed); // throws std::runtime_error
+
+    ~PlayerThreadDispatcher();
+
+    /*!
+        \brief Posts command for execution in player thread. Thread safe.
+        \return false if queue is full. Command is not posted in this case.
+    */
+    bool post(Command command);
+
+    //! Executes all pending commands. Must be called from player thread.
+    void executePendingCommands();
+
+    //! \return count of commands which are waiting for execution.
+    std::size_t pendingCommandsCount() const;
+
+private:
+
+    static LRESULT CALLBACK windowProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam);
+
+    const std::size_t capacity_;
+    Command on_commands_executed_;
+    HWND window_;
+
+    mutable boost::mutex mutex_;
+    std::deque<Command> commands_;
+    bool wakeup_posted_; //!< set if wake up message is posted but not handled yet. Used to avoid message flood.
+};
+
+} // namespace ControlPlugin
@@ -18,6 +18,8 @@ using boost::property_tree::wptree;
 
 static std::wstring kDEFAULT_REALM = L"AIMP Control plugin";
 static std::wstring kDEFAULT_PORT = L"3333";
+static const unsigned int kDEFAULT_KEEP_ALIVE_TIMEOUT = 15; // seconds.
+static const unsigned int kDEFAULT_MAX_KEEP_ALIVE_REQUESTS = 100;
 
 Manager::Manager()
 {
@@ -50,6 +52,9 @@ void Manager::setDefaultHttpServerSettings()
     s.interfaces.insert(Settings::HttpServer::NetworkInterface("", "localhost", StringEncoding::utf16_to_system_ansi_encoding_safe(kDEFAULT_PORT)));
     s.document_root = L"htdocs";
     s.realm = kDEFAULT_REALM;
+    s.io_threads = 0;
+    s.keep_alive_timeout = kDEFAULT_KEEP_ALIVE_TIMEOUT;
+    s.max_keep_alive_requests = kDEFAULT_MAX_KEEP_ALIVE_REQUESTS;
 }
 
 void loadPropertyTreeFromFile(wptree& pt, const boost::filesystem::wpath& filename) // throws std::exception
@@ -140,6 +145,10 @@ void loadSettingsFromPropertyTree(Settings& settings, const wptree& pt) // throw
     
     std::wstring realm = pt.get<std::wstring>(L"settings.httpserver.realm", kDEFAULT_REALM);
 
+    const unsigned int io_threads = pt.get<unsigned int>(L"settings.httpserver.io_threads", 0);
+    const unsigned int keep_alive_timeout = pt.get<unsigned int>(L"settings.httpserver.keep_alive_timeout", kDEFAULT_KEEP_ALIVE_TIMEOUT);
+    const unsigned int max_keep_alive_requests = pt.get<unsigned int>(L"settings.httpserver.max_keep_alive_requests", kDEFAULT_MAX_KEEP_ALIVE_REQUESTS);
+
     std::set<std::string> init_cookies;
     try {
         for ( const auto& v : pt.get_child(L"settings.httpserver.init_cookies") ) {
@@ -169,6 +178,9 @@ void loadSettingsFromPropertyTree(Settings& settings, const wptree& pt) // throw
     settings.http_server.document_root.swap(server_document_root);
     settings.http_server.init_cookies.swap(init_cookies);
     settings.http_server.realm.swap(realm);
+    settings.http_server.io_threads = io_threads;
+    settings.http_server.keep_alive_timeout = keep_alive_timeout;
+    settings.http_server.max_keep_alive_requests = max_keep_alive_requests;
 
     settings.logger.severity_level = log_severity_level;
     settings.logger.directory.swap(log_directory);
@@ -237,6 +249,9 @@ void saveSettingsToPropertyTree(const Settings& settings, wptree& pt) // throws
 
     pt.put( L"settings.httpserver.document_root", settings.http_server.document_root );
     pt.put( L"settings.httpserver.realm", settings.http_server.realm );
+    pt.put( L"settings.httpserver.io_threads", settings.http_server.io_threads );
+    pt.put( L"settings.httpserver.keep_alive_timeout", settings.http_server.keep_alive_timeout );
+    pt.put( L"settings.httpserver.max_keep_alive_requests", settings.http_server.max_keep_alive_requests );
 
     pt.put(L"settings.misc.enable_track_upload", settings.misc.enable_track_upload);
     pt.put(L"settings.misc.enable_physical_track_deletion", settings.misc.enable_physical_track_deletion);
@@ -39,6 +39,10 @@ struct Settings
         };
 
         std::set<NetworkInterface> interfaces;
+
+        unsigned int io_threads; //!< Count of threads which serve network I/O. Zero means network I/O is served in player thread on timer tick.
+        unsigned int keep_alive_timeout; //!< Time in seconds after which idle persistent connection is closed. Zero disables timeout.
+        unsigned int max_keep_alive_requests; //!< Max count of requests served by one persistent connection. Zero disables persistent connections.
     } http_server;
 
     struct Logger {
@@ -1,5 +1,8 @@
 // Copyright (c) 2014, Alexey Ivanov
 
+#pragma once
+
+#include "rpc/response_cache.h"
 #include <string>
 #include <boost/noncopyable.hpp>
 
@@ -35,6 +38,14 @@ public:
     virtual std::string help() const
         { return std::string(); }
 
+    /*!
+        \brief Reports if response can be taken from ResponseCache: result depends only on params and on data described by tags.
+               Subclasses override this method if they are idempotent and know versions of data they read.
+        \return false if method must be executed on each call. Default implementation always returns false.
+    */
+    virtual bool getCacheTags(const Value& /*root_request*/, CacheTags* /*tags*/) const
+        { return false; }
+
     const std::string& name() const
         { return name_; }
 
@@ -4,12 +4,15 @@
 #include "methods.h"
 #include "aimp/manager.h"
 #include "aimp/manager_impl_common.h"
+#include "aimp/playlists_entries_indexes.h"
+#include "http_server/static_file_cache.h"
 #include "plugin/logger.h"
 #include "plugin/control_plugin.h"
 #include "plugin/settings.h"
 #include "rpc/exception.h"
 #include "rpc/value.h"
 #include "rpc/request_handler.h"
+#include "rpc/streamed_response.h"
 #include "utils/util.h"
 #include "utils/scope_guard.h"
 #include "utils/string_encoding.h"
@@ -20,6 +23,7 @@
 #include <boost/bind.hpp>
 #include <boost/assign/std.hpp>
 #include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/assign/std/vector.hpp>
 #include <string.h>
 
@@ -50,6 +54,38 @@ Rpc::Value::Object emptyResult()
     return Rpc::Value::Object();
 }
 
+const int kPlaylistsListCacheTagID = kPlaylistIdNotUsed; // tag of results which depend on all playlists.
+
+//! Returns false if value is absent or is special ID -1: playing playlist/track can be switched without playlists content change.
+bool getExplicitIdParam(const Rpc::Value& params, const char* name, int* id)
+{
+    if (   params.type() != Rpc::Value::TYPE_OBJECT
+        || !params.isMember(name)
+        || params[name].type() != Rpc::Value::TYPE_INT
+        )
+    {
+        return false;
+    }
+    *id = params[name];
+    return *id != -1;
+}
+
+//! Adds tag of playlist specified in params. Returns false if playlist is not specified explicitly or does not exist.
+bool addPlaylistCacheTag(const AIMPManager& aimp_manager, const Rpc::Value& params, Rpc::CacheTags* tags)
+{
+    int playlist_id;
+    if ( !getExplicitIdParam(params, "playlist_id", &playlist_id) ) {
+        return false;
+    }
+
+    try {
+        tags->push_back( CacheTag( playlist_id, aimp_manager.getPlaylistCRC32(playlist_id) ) );
+    } catch (std::runtime_error&) {
+        return false; // let method report error.
+    }
+    return true;
+}
+
 ResponseType Play::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
     const Rpc::Value& params = root_request["params"];
@@ -305,6 +341,12 @@ ResponseType RemoveTrackFromPlayQueue::execute(const Rpc::Value& root_request, R
     return RESPONSE_IMMEDIATE;
 }
 
+bool GetPlaylists::getCacheTags(const Rpc::Value& /*root_request*/, Rpc::CacheTags* tags) const
+{
+    tags->push_back( CacheTag(kPlaylistsListCacheTagID, 0) );
+    return true;
+}
+
 std::string GetPlaylists::getColumnsString() const
 {
     std::string result;
@@ -403,6 +445,269 @@ struct Formatter {
     }
 };
 
+/*!
+    \brief Produces entries of GetPlaylistEntries result while response is being sent.
+           Source owns query description and copies of field setters, so GetPlaylistEntries can handle other requests meanwhile.
+           Each part of response is read by its own statement which is finalized by suspend(), so no statement is kept open
+           while client receives data: slow client does not block schema changes and source can be destroyed in any thread.
+           Next statement continues after the last sent entry(keyset pagination): values of order fields of that entry are bound as lower bound.
+           Sending is aborted if playlist is changed: client must not get mix of old and new entries.
+*/
+class PlaylistEntriesSource : public Rpc::ResultItemsSource
+{
+public:
+
+    typedef RpcValueSetHelpers::HelperFillRpcFields<PlaylistEntry>::RpcValueSetter RpcValueSetter;
+
+    /*!
+        \param columns - columns of result entries.
+        \param where - WHERE clause of query, its args are bound by where_arg_setters.
+        \param start_index - count of entries to skip.
+        \param entries_count - max count of entries to read, -1 means all entries.
+    */
+    PlaylistEntriesSource(const AIMPManager& aimp_manager, PlaylistID playlist_id, sqlite3* playlists_db,
+                          const std::string& columns, const std::string& where, const Utilities::QueryArgSetters& where_arg_setters,
+                          const PlaylistEntries::OrderFields& order_fields, int start_index, int entries_count)
+        :
+        aimp_manager_(aimp_manager),
+        playlist_id_(playlist_id),
+        playlist_crc32_( aimp_manager.getPlaylistCRC32(playlist_id) ),
+        playlists_db_(playlists_db),
+        columns_(columns),
+        where_(where),
+        where_arg_setters_(where_arg_setters),
+        key_fields_(order_fields),
+        start_index_(start_index),
+        entries_count_(entries_count),
+        entries_read_(0),
+        stmt_(nullptr)
+    {
+        assert(!key_fields_.empty());
+        // entry_index and entry_id are unique inside playlist, other fields need entry_id to identify entry.
+        if (key_fields_.back().name != "entry_index" && key_fields_.back().name != "entry_id") {
+            key_fields_.push_back( PlaylistEntries::OrderField("entry_id", key_fields_.back().descending) );
+        }
+    }
+
+    // statement exists only while part of response is produced in player thread.
+    ~PlaylistEntriesSource()
+        { suspend(); }
+
+    void addSetter(const RpcValueSetter& setter)
+        { setters_.push_back(setter); }
+
+    //! Entry will be presented as string formatted by format_string.
+    void setFormatString(const std::string& format_string)
+    {
+        format_string_ = format_string;
+        setters_.assign( 1, boost::bind<void>(Formatter(&aimp_manager_, &format_string_), _1, _2, _3) );
+    }
+
+    virtual bool nextItem(Rpc::Value* entry)
+    {
+        using namespace Utilities;
+
+        if (!stmt_) {
+            if (entries_count_ >= 0 && entries_read_ >= entries_count_) {
+                return false;
+            }
+            prepareStmt();
+        }
+
+        const int rc_db = sqlite3_step(stmt_);
+        if (SQLITE_DONE == rc_db) {
+            return false;
+        } else if (SQLITE_ROW != rc_db) {
+            const std::string msg = MakeString() << "sqlite3_step() error "
+                                                 << rc_db << ": " << sqlite3_errmsg(playlists_db_)
+                                                 << ". Query: " << query_;
+            throw std::runtime_error(msg);
+        }
+
+        entry->setSize( setters_.size() );
+        for (size_t index = 0, count = setters_.size(); index != count; ++index) {
+            Rpc::Value& field = (*entry)[index];
+            try {
+                setters_[index](stmt_, static_cast<int>(index), field);
+            } catch (std::exception& e) {
+                BOOST_LOG_SEV(logger(), error) << "Error occured while filling AIMP entry field index " << index << ". Reason: " << e.what();
+                field = std::string();
+            }
+        }
+
+        saveKeyValues();
+        ++entries_read_;
+        return true;
+    }
+
+    virtual void resume()
+    {
+        if (aimp_manager_.getPlaylistCRC32(playlist_id_) != playlist_crc32_) {
+            throw std::runtime_error(Utilities::MakeString() << "Playlist " << playlist_id_ << " has been changed while its entries were being sent.");
+        }
+    }
+
+    virtual void suspend()
+    {
+        if (stmt_) {
+            sqlite3_finalize(stmt_);
+            stmt_ = nullptr;
+        }
+    }
+
+private:
+
+    //! Value of order field of the last read entry.
+    struct KeyValue
+    {
+        KeyValue()
+            : type(SQLITE_NULL), int_value(0), double_value(0)
+        {}
+
+        int type;
+        sqlite3_int64 int_value;
+        double double_value;
+        std::string text_value;
+    };
+
+    typedef std::vector<KeyValue> KeyValues;
+
+    void prepareStmt() // throws std::runtime_error
+    {
+        using namespace Utilities;
+
+        const int first_key_param_index = static_cast<int>( where_arg_setters_.size() ) + 1;
+
+        std::ostringstream query;
+        query << "SELECT " << columns_;
+        BOOST_FOREACH(const auto& field, key_fields_) {
+            query << ',' << field.name;
+        }
+        query << " FROM PlaylistsEntries " << where_;
+        if ( !key_values_.empty() ) {
+            query << " AND " << afterLastEntryCondition(0, first_key_param_index);
+        }
+        query << ' ' << GetPlaylistEntries::getOrderString(key_fields_)
+              << " LIMIT " << (entries_count_ >= 0 ? entries_count_ - entries_read_ : -1);
+        if (key_values_.empty() && start_index_ > 0) {
+            query << " OFFSET " << start_index_;
+        }
+        query_ = query.str();
+
+        stmt_ = createStmt(playlists_db_, query_);
+
+        int bind_index = 1;
+        BOOST_FOREACH(auto& setter, where_arg_setters_) {
+            setter(stmt_, bind_index++);
+        }
+        for (size_t i = 0, size = key_values_.size(); i != size; ++i) {
+            bindKeyValue(first_key_param_index + static_cast<int>(i), key_values_[i]);
+        }
+    }
+
+    /*!
+        Returns condition which selects entries after the last read one in order of key fields starting from key_index:
+            key > value OR (key = value AND <condition for next key>), written as key >= value AND (key > value OR <...>),
+        so sqlite can seek in index by the first key. NULL is less than any value as in ORDER BY.
+    */
+    std::string afterLastEntryCondition(size_t key_index, int first_key_param_index) const
+    {
+        const PlaylistEntries::OrderField& field = key_fields_[key_index];
+        const bool is_null = key_values_[key_index].type == SQLITE_NULL;
+        const std::string param = Utilities::MakeString() << '?' << first_key_param_index + key_index;
+
+        const std::string after = keyCondition(field, is_null, param, false);
+        if (key_index + 1 == key_fields_.size()) {
+            return after;
+        }
+        return Utilities::MakeString() << '(' << keyCondition(field, is_null, param, true)
+                                       << " AND (" << after << " OR " << afterLastEntryCondition(key_index + 1, first_key_param_index) << "))";
+    }
+
+    static std::string keyCondition(const PlaylistEntries::OrderField& field, bool is_null, const std::string& param, bool or_equal)
+    {
+        const std::string& name = field.name;
+        if (!field.descending) {
+            if (is_null) {
+                return or_equal ? "1" : name + " IS NOT NULL";
+            }
+            return name + (or_equal ? " >= " : " > ") + param;
+        }
+
+        if (is_null) {
+            return or_equal ? name + " IS NULL" : "0";
+        }
+        return '(' + name + (or_equal ? " <= " : " < ") + param + " OR " + name + " IS NULL)";
+    }
+
+    void saveKeyValues()
+    {
+        const int key_count = static_cast<int>( key_fields_.size() );
+        const int first_key_column = sqlite3_column_count(stmt_) - key_count;
+        key_values_.resize(key_count);
+        for (int i = 0; i != key_count; ++i) {
+            KeyValue& value = key_values_[i];
+            const int column = first_key_column + i;
+            value.type = sqlite3_column_type(stmt_, column);
+            switch (value.type) {
+            case SQLITE_INTEGER:
+                value.int_value = sqlite3_column_int64(stmt_, column);
+                break;
+            case SQLITE_FLOAT:
+                value.double_value = sqlite3_column_double(stmt_, column);
+                break;
+            case SQLITE_NULL:
+                break;
+            default:
+                value.type = SQLITE_TEXT; // blobs are not stored in entries table.
+                value.text_value.assign( reinterpret_cast<const char*>( sqlite3_column_text(stmt_, column) ),
+                                         sqlite3_column_bytes(stmt_, column)
+                                         );
+                break;
+            }
+        }
+    }
+
+    void bindKeyValue(int bind_index, const KeyValue& value) // throws std::runtime_error
+    {
+        int rc_db = SQLITE_OK;
+        switch (value.type) {
+        case SQLITE_INTEGER:
+            rc_db = sqlite3_bind_int64(stmt_, bind_index, value.int_value);
+            break;
+        case SQLITE_FLOAT:
+            rc_db = sqlite3_bind_double(stmt_, bind_index, value.double_value);
+            break;
+        case SQLITE_TEXT:
+            rc_db = sqlite3_bind_text(stmt_, bind_index, value.text_value.c_str(), static_cast<int>( value.text_value.size() ), SQLITE_TRANSIENT);
+            break;
+        default:
+            return; // NULL is not bound, see keyCondition().
+        }
+
+        if (SQLITE_OK != rc_db) {
+            throw std::runtime_error(Utilities::MakeString() << "Error sqlite3_bind of key value: " << rc_db);
+        }
+    }
+
+    const AIMPManager& aimp_manager_;
+    const PlaylistID playlist_id_;
+    const crc32_t playlist_crc32_;
+    sqlite3* playlists_db_;
+    const std::string columns_;
+    const std::string where_;
+    Utilities::QueryArgSetters where_arg_setters_;
+    PlaylistEntries::OrderFields key_fields_; //!< order fields and entry_id if they do not identify entry.
+    const int start_index_;
+    const int entries_count_;
+    int entries_read_;
+    KeyValues key_values_; //!< values of key_fields_ of the last read entry, empty if no entries were read.
+    sqlite3_stmt* stmt_;
+    std::string query_;
+    std::vector<RpcValueSetter> setters_;
+    std::string format_string_;
+};
+
 GetPlaylistEntries::GetPlaylistEntries(AIMPManager& aimp_manager,
                                        Rpc::RequestHandler& rpc_request_handler
                                        )
@@ -418,6 +723,7 @@ GetPlaylistEntries::GetPlaylistEntries(AIMPManager& aimp_manager,
     kRQST_KEY_ORDER_DIRECTION("dir"),
     kRQST_KEY_ORDER_FIELDS("order_fields"),
     kRQST_KEY_SEARCH_STRING("search_string"),
+    kRQST_KEY_SEARCH_BY_WORD_PREFIX("search_by_word_prefix"),
     kRSLT_KEY_TOTAL_ENTRIES_COUNT("total_entries_count"),
     kRSLT_KEY_ENTRIES("entries"),
     kRSLT_KEY_COUNT_OF_FOUND_ENTRIES("count_of_found_entries"),
@@ -538,9 +844,9 @@ void GetPlaylistEntries::initEntriesFiller(const Rpc::Value& params)
     }
 }
 
-std::string GetPlaylistEntries::getOrderString(const Rpc::Value& params) const
+PlaylistEntries::OrderFields GetPlaylistEntries::getOrderFields(const Rpc::Value& params) const
 {
-    std::string result;
+    PlaylistEntries::OrderFields result;
     if (!queuedEntriesMode()) {
 	    if ( params.isMember(kRQST_KEY_ORDER_FIELDS) ) {        
             const Rpc::Value& entry_fields_to_order = params[kRQST_KEY_ORDER_FIELDS];
@@ -551,37 +857,91 @@ std::string GetPlaylistEntries::getOrderString(const Rpc::Value& params) const
                 const auto supported_field_it = std::find(fields_to_order_.begin(), fields_to_order_.end(), field_to_order);
                 if ( supported_field_it != fields_to_order_.end() ) {
                     if ( result.empty() ) {
-                        result = "ORDER BY ";
+                        // index of the first field lets sqlite read requested page without sorting of whole playlist.
+                        try {
+                            AIMPPlayer::preparePlaylistsEntriesOrderIndex(AIMPPlayer::getPlaylistsDB(aimp_manager_), field_to_order);
+                        } catch (std::exception& e) {
+                            // query works without index, just slower.
+                            BOOST_LOG_SEV(logger(), error) << "Order index creation failed in " __FUNCTION__ << ". Reason: " << e.what();
+                        }
                     }
-                    result += field_to_order;
-                    result += (field_desc[kRQST_KEY_ORDER_DIRECTION] == kDESCENDING_ORDER_STRING) ? " DESC," 
-                                                                                                  : " ASC,";
+                    result.push_back( PlaylistEntries::OrderField(field_to_order,
+                                                                  field_desc[kRQST_KEY_ORDER_DIRECTION] == kDESCENDING_ORDER_STRING
+                                                                  )
+                                     );
                 }
             }
-
-            if (!result.empty() && result.back() == ',') {
-                result.pop_back();
-            }
         }
 
         // by default order by index to have AIMP playlist's order.
         if (result.empty()) {
-            result = "ORDER BY entry_index ASC";
+            result.push_back( PlaylistEntries::OrderField("entry_index", false) );
         }
     } else {
-        result = "ORDER BY queue_index ASC";
+        result.push_back( PlaylistEntries::OrderField("queue_index", false) );
     }
     return result;
 }
 
-std::string GetPlaylistEntries::getLimitString(const Rpc::Value& params) const
+std::string GetPlaylistEntries::getOrderString(const PlaylistEntries::OrderFields& order_fields)
+{
+    std::string result;
+    BOOST_FOREACH(const auto& field, order_fields) {
+        result += result.empty() ? "ORDER BY " : ",";
+        result += field.name;
+        result += field.descending ? " DESC" : " ASC";
+    }
+    return result;
+}
+
+namespace {
+
+//! Binds integer argument: ids and limits are passed as parameters, so query text does not depend on them and compiled statement is reused.
+struct IntArgSetter : public std::binary_function<sqlite3_stmt*, int, void>
+{
+    int int_arg_;
+    IntArgSetter(int int_arg) : int_arg_(int_arg) {}
+    void operator()(sqlite3_stmt* stmt, int bind_index) const {
+        const int rc_db = sqlite3_bind_int(stmt, bind_index, int_arg_);
+        if (SQLITE_OK != rc_db) {
+            const std::string msg = Utilities::MakeString() << "Error sqlite3_bind_int: " << rc_db;
+            throw std::runtime_error(msg);
+        }
+    }
+};
+
+//! Binds text argument of LIKE or MATCH operator.
+struct TextArgSetter : public std::binary_function<sqlite3_stmt*, int, void>
+{
+    typedef std::string StringT;
+    StringT text_arg_;
+    TextArgSetter(const StringT& text_arg) : text_arg_(text_arg) {}
+    void operator()(sqlite3_stmt* stmt, int bind_index) const {
+        const int rc_db = sqlite3_bind_text(stmt, bind_index,
+                                            text_arg_.c_str(),
+                                            text_arg_.size() * sizeof(StringT::value_type),
+                                            SQLITE_TRANSIENT);
+        if (SQLITE_OK != rc_db) {
+            const std::string msg = Utilities::MakeString() << "Error sqlite3_bind_text: " << rc_db;
+            throw std::runtime_error(msg);
+        }
+    }
+};
+
+const char * const kSEARCH_INDEX_CONDITION = "entry_id IN (SELECT docid FROM PlaylistsEntriesSearch WHERE PlaylistsEntriesSearch MATCH ?)";
+
+} // namespace
+
+std::string GetPlaylistEntries::getLimitString(const Rpc::Value& params, Utilities::QueryArgSetters* limit_arg_setters) const
 {
     std::ostringstream os;
 	if ( params.isMember(kRQST_KEY_START_INDEX) && params.isMember(kRQST_KEY_ENTRIES_COUNT) ) {
         const int entries_count = params[kRQST_KEY_ENTRIES_COUNT];
         if (entries_count != -1) { // -1 is special value which means "all available items". Included to support jQuery Datatables 1.7.6.
             const int start_entry_index = params[kRQST_KEY_START_INDEX];
-	        os << "LIMIT " << start_entry_index << ',' << entries_count;
+	        os << "LIMIT ?,?";
+            limit_arg_setters->push_back( boost::bind<void>(IntArgSetter(start_entry_index), _1, _2) );
+            limit_arg_setters->push_back( boost::bind<void>(IntArgSetter(entries_count), _1, _2) );
         }
 
         if ( entryLocationDeterminationMode() ) {
@@ -591,56 +951,72 @@ std::string GetPlaylistEntries::getLimitString(const Rpc::Value& params) const
     return os.str();
 }
 
-std::string GetPlaylistEntries::getWhereString(const Rpc::Value& params, const int playlist_id) const
+std::string GetPlaylistEntries::getSearchMatchQuery(const std::string& search_string) const
 {
-    using namespace Utilities;
+    const std::string match_query = AIMPPlayer::makePlaylistsEntriesSearchMatchQuery(search_string);
+    if ( match_query.empty() ) {
+        return match_query;
+    }
 
-    struct LikeArgSetter : public std::binary_function<sqlite3_stmt*, int, void>
-    {
-        typedef std::string StringT;
-        StringT like_arg_;
-        LikeArgSetter(const StringT& like_arg) : like_arg_(like_arg) {}
-        void operator()(sqlite3_stmt* stmt, int bind_index) const {
-            const int rc_db = sqlite3_bind_text(stmt, bind_index,
-                                                like_arg_.c_str(),
-                                                like_arg_.size() * sizeof(StringT::value_type),
-                                                SQLITE_TRANSIENT);
-            if (SQLITE_OK != rc_db) {
-                const std::string msg = MakeString() << "Error sqlite3_bind_text: " << rc_db;
-                throw std::runtime_error(msg);
-            }
+    sqlite3* playlists_db = AIMPPlayer::getPlaylistsDB(aimp_manager_);
+    try {
+        if ( !AIMPPlayer::preparePlaylistsEntriesSearchIndex(playlists_db) ) {
+            return std::string();
         }
-    };
+    } catch (std::exception& e) {
+        BOOST_LOG_SEV(logger(), error) << "Search index creation failed in " __FUNCTION__ << ". Reason: " << e.what();
+        return std::string(); // LIKE search works without index.
+    }
+    return match_query;
+}
+
+std::string GetPlaylistEntries::getWhereString(const Rpc::Value& params, const int playlist_id) const
+{
+    using namespace Utilities;
 
     std::ostringstream os;
     
     if (!queuedEntriesMode()) {
-        os << "WHERE playlist_id=" << playlist_id;
+        os << "WHERE playlist_id=?";
+        query_arg_setters_.push_back( boost::bind<void>(IntArgSetter(playlist_id), _1, _2) );
     }
 
 	if ( params.isMember(kRQST_KEY_SEARCH_STRING) ) {
         const std::string& search_string = params[kRQST_KEY_SEARCH_STRING];
         if ( !search_string.empty() && !fields_to_filter_.empty() ) { ///??? search in all fields or only in requested ones.
-            const std::string like_arg = '%' + search_string + '%';
-            const QueryArgSetter& setter = boost::bind<void>(LikeArgSetter(like_arg), _1, _2);
-            
             if (!queuedEntriesMode()) {
                 os << " AND (";
             } else {
                 os << " WHERE (";
             }
-            FieldNames::const_iterator begin = fields_to_filter_.begin(),
-                                       end   = fields_to_filter_.end();
-            for (FieldNames::const_iterator fieldname_it = begin;
-                                            fieldname_it != end;
-                                            ++fieldname_it
-                 )
-            {
-                query_arg_setters_.push_back(setter);
-
-                os << *fieldname_it << " LIKE ?";
-                if (fieldname_it + 1 != end) {
-                    os << " OR ";
+
+            // index finds words by prefix only, so it is used on explicit request: default search finds substrings in the middle of words too.
+            const bool search_by_word_prefix =    params.isMember(kRQST_KEY_SEARCH_BY_WORD_PREFIX)
+                                               && params[kRQST_KEY_SEARCH_BY_WORD_PREFIX].type() == Rpc::Value::TYPE_BOOL
+                                               && static_cast<bool>(params[kRQST_KEY_SEARCH_BY_WORD_PREFIX]);
+            // full-text index contains all fields_to_filter_.
+            const std::string match_query = search_by_word_prefix ? getSearchMatchQuery(search_string)
+                                                                  : std::string();
+            if ( !match_query.empty() ) {
+                query_arg_setters_.push_back( boost::bind<void>(TextArgSetter(match_query), _1, _2) );
+                os << kSEARCH_INDEX_CONDITION;
+            } else {
+                const std::string like_arg = '%' + search_string + '%';
+                const QueryArgSetter& setter = boost::bind<void>(TextArgSetter(like_arg), _1, _2);
+
+                FieldNames::const_iterator begin = fields_to_filter_.begin(),
+                                           end   = fields_to_filter_.end();
+                for (FieldNames::const_iterator fieldname_it = begin;
+                                                fieldname_it != end;
+                                                ++fieldname_it
+                     )
+                {
+                    query_arg_setters_.push_back(setter);
+
+                    os << *fieldname_it << " LIKE ?";
+                    if (fieldname_it + 1 != end) {
+                        os << " OR ";
+                    }
                 }
             }
             os << ")";
@@ -677,18 +1053,12 @@ size_t GetPlaylistEntries::getTotalEntriesCount(sqlite3* playlists_db, const int
 {
     using namespace Utilities;
 
-    std::ostringstream query;
-    query << "SELECT COUNT(*) FROM ";
     if (!queuedEntriesMode()) {
-        query << "PlaylistsEntries WHERE playlist_id=" << playlist_id;
-    } else {
-        query << "QueuedEntries";
+        return AIMPPlayer::getEntriesCountDB( playlist_id, AIMPPlayer::getPlaylistsStmtCache(aimp_manager_) );
     }
 
-    sqlite3_stmt* stmt = createStmt( playlists_db,
-                                     query.str()
-                                    );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    const char * const query = "SELECT COUNT(*) FROM QueuedEntries";
+    StmtCache::Lease stmt(AIMPPlayer::getPlaylistsStmtCache(aimp_manager_), query);
 
     size_t total_entries_count = 0;
 
@@ -699,13 +1069,37 @@ size_t GetPlaylistEntries::getTotalEntriesCount(sqlite3* playlists_db, const int
     } else {
         const std::string msg = MakeString() << "sqlite3_step() error "
                                              << rc_db << ": " << sqlite3_errmsg(playlists_db)
-                                             << ". Query: " << query.str();
+                                             << ". Query: " << query;
         throw std::runtime_error(msg);
     }
 
     return total_entries_count;
 }
 
+bool GetPlaylistEntries::getCacheTags(const Rpc::Value& root_request, Rpc::CacheTags* tags) const
+{
+    return addPlaylistCacheTag(aimp_manager_, root_request["params"], tags);
+}
+
+bool GetPlaylistEntries::streamingRequired(const Rpc::Value& params, size_t count_of_found_entries) const
+{
+    if (   queuedEntriesMode() // queue is short.
+        || count_of_found_entries < kMIN_ENTRIES_COUNT_TO_STREAM
+        || !rpc_request_handler_.resultStreamingAllowed()
+        )
+    {
+        return false;
+    }
+
+    if ( params.isMember(kRQST_KEY_START_INDEX) && params.isMember(kRQST_KEY_ENTRIES_COUNT) ) {
+        const int entries_count = params[kRQST_KEY_ENTRIES_COUNT];
+        if ( entries_count != -1 && static_cast<size_t>(entries_count) < kMIN_ENTRIES_COUNT_TO_STREAM ) {
+            return false; // page of entries is requested.
+        }
+    }
+    return true;
+}
+
 Rpc::ResponseType GetPlaylistEntries::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
     using namespace Utilities;
@@ -737,27 +1131,36 @@ Rpc::ResponseType GetPlaylistEntries::execute(const Rpc::Value& root_request, Rp
 
     query_arg_setters_.clear();
 
+    const std::string where_string = getWhereString(params, playlist_id);
+    const PlaylistEntries::OrderFields order_fields = getOrderFields(params);
+
     std::ostringstream query_without_limit,
                        query_with_limit;
     query_without_limit << "SELECT " << getColumnsString() << " FROM "
                         << (!queuedEntriesMode() ? "PlaylistsEntries" : "QueuedEntries")
                         << ' '   
-                        << getWhereString(params, playlist_id) << ' ' 
-                        << getOrderString(params);
+                        << where_string << ' ' 
+                        << getOrderString(order_fields);
+    QueryArgSetters limit_arg_setters;
     query_with_limit << query_without_limit.str() << ' '
-                     << getLimitString(params);
+                     << getLimitString(params, &limit_arg_setters);
 
     const std::string query = !entryLocationDeterminationMode() ? query_with_limit.str() : query_without_limit.str();
 
     sqlite3* playlists_db = AIMPPlayer::getPlaylistsDB(aimp_manager_);
-    sqlite3_stmt* stmt = createStmt( playlists_db, query.c_str() );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    // query text depends only on requested columns, order and presence of search and limit, so compiled statement is reused.
+    StmtCache::Lease stmt(AIMPPlayer::getPlaylistsStmtCache(aimp_manager_), query);
 
     // bind all query args.
     size_t bind_index = 1;
     BOOST_FOREACH(auto& setter, query_arg_setters_) {
         setter(stmt, bind_index++);
     }
+    if ( !entryLocationDeterminationMode() ) {
+        BOOST_FOREACH(auto& setter, limit_arg_setters) {
+            setter(stmt, bind_index++);
+        }
+    }
 
 #ifdef _DEBUG
     const auto& setters = entry_fields_filler_.setters_required_;
@@ -772,6 +1175,39 @@ Rpc::ResponseType GetPlaylistEntries::execute(const Rpc::Value& root_request, Rp
 
     if ( !entryLocationDeterminationMode() ) {
         Rpc::Value& rpc_result = root_response["result"];
+        const size_t count_of_found_entries = getRowsCount(playlists_db, query_without_limit.str(), &query_arg_setters_);
+        rpc_result[kRSLT_KEY_TOTAL_ENTRIES_COUNT]    = getTotalEntriesCount(playlists_db, playlist_id);
+        rpc_result[kRSLT_KEY_COUNT_OF_FOUND_ENTRIES] = count_of_found_entries;
+
+        if ( streamingRequired(params, count_of_found_entries) ) {
+            // entries are read while response is being sent, so whole list is never kept in memory.
+            int start_index = 0,
+                entries_count = -1;
+            if ( params.isMember(kRQST_KEY_START_INDEX) && params.isMember(kRQST_KEY_ENTRIES_COUNT) ) { // see getLimitString().
+                entries_count = params[kRQST_KEY_ENTRIES_COUNT];
+                if (entries_count != -1) {
+                    start_index = params[kRQST_KEY_START_INDEX];
+                }
+            }
+            boost::shared_ptr<PlaylistEntriesSource> entries_source( new PlaylistEntriesSource(aimp_manager_, playlist_id, playlists_db,
+                                                                                               getColumnsString(), where_string, query_arg_setters_,
+                                                                                               order_fields, start_index, entries_count
+                                                                                               )
+                                                                    );
+
+            const auto& setters = entry_fields_filler_.setters_required_;
+            if ( !setters.empty() && setters.front()->first == kRQST_KEY_FORMAT_STRING ) {
+                entries_source->setFormatString(params[kRQST_KEY_FORMAT_STRING]);
+            } else {
+                BOOST_FOREACH(auto& setter_it, setters) {
+                    entries_source->addSetter(setter_it->second);
+                }
+            }
+
+            rpc_request_handler_.streamResult(kRSLT_KEY_ENTRIES, entries_source);
+            return RESPONSE_IMMEDIATE;
+        }
+
         Rpc::Value& rpcvalue_entries  = rpc_result[kRSLT_KEY_ENTRIES];
         rpcvalue_entries.setSize(0); // return zero-length array, not null if no entires found.
 
@@ -793,9 +1229,6 @@ Rpc::ResponseType GetPlaylistEntries::execute(const Rpc::Value& root_request, Rp
                 throw std::runtime_error(msg);
 		    }
         }
-
-        rpc_result[kRSLT_KEY_TOTAL_ENTRIES_COUNT]    = getTotalEntriesCount(playlists_db, playlist_id);
-        rpc_result[kRSLT_KEY_COUNT_OF_FOUND_ENTRIES] = getRowsCount(playlists_db, query_without_limit.str(), &query_arg_setters_);
     } else {
         size_t entry_index = 0;
         for(;;) {
@@ -873,6 +1306,14 @@ Rpc::ResponseType GetEntryPositionInDataTable::execute(const Rpc::Value& root_re
     return RESPONSE_IMMEDIATE;
 }
 
+bool GetEntryPositionInDataTable::getCacheTags(const Rpc::Value& root_request, Rpc::CacheTags* tags) const
+{
+    const Rpc::Value& params = root_request["params"];
+    int track_id;
+    return getExplicitIdParam(params, "track_id", &track_id)
+           && addPlaylistCacheTag(aimp_manager_, params, tags);
+}
+
 GetQueuedEntries::GetQueuedEntries(AIMPManager& aimp_manager,
                                    Rpc::RequestHandler& rpc_request_handler,
                                    GetPlaylistEntries& getplaylistentries_method
@@ -900,11 +1341,118 @@ ResponseType GetPlaylistEntriesCount::execute(const Rpc::Value& root_request, Rp
         throw Rpc::Exception("Wrong arguments count. Wait one integer value: playlist_id.", WRONG_ARGUMENT);
     }
 
-    const size_t entries_count = AIMPPlayer::getEntriesCountDB(params["playlist_id"], AIMPPlayer::getPlaylistsDB(aimp_manager_));
+    const size_t entries_count = AIMPPlayer::getEntriesCountDB(params["playlist_id"], AIMPPlayer::getPlaylistsStmtCache(aimp_manager_));
     root_response["result"] = static_cast<int>(entries_count); // max int value overflow is possible, but I doubt that we will work with such huge playlists.
     return RESPONSE_IMMEDIATE;
 }
 
+bool GetPlaylistEntriesCount::getCacheTags(const Rpc::Value& root_request, Rpc::CacheTags* tags) const
+{
+    return addPlaylistCacheTag(aimp_manager_, root_request["params"], tags);
+}
+
+void appendEntryLocation(PlaylistEntryID entry_id, int entry_index, Rpc::Value& entries)
+{
+    const size_t size = entries.size();
+    entries.setSize(size + 1);
+    Rpc::Value& entry = entries[size];
+    entry.setSize(2);
+    entry[0] = entry_id;
+    entry[1] = entry_index;
+}
+
+ResponseType GetPlaylistEntriesDelta::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
+{
+    Args args;
+    std::string error;
+    if ( !params_schema_.bind(root_request["params"], &args, &error) ) {
+        throw Rpc::Exception(error, WRONG_ARGUMENT);
+    }
+
+    PlaylistID playlist_id;
+    crc32_t crc32;
+    try {
+        playlist_id = aimp_manager_.getAbsolutePlaylistID(args.playlist_id);
+        crc32 = aimp_manager_.getPlaylistCRC32(playlist_id);
+    } catch (std::runtime_error&) {
+        throw Rpc::Exception("Playlist is not found", PLAYLIST_NOT_FOUND);
+    }
+
+    PlaylistEntriesDelta delta;
+    const PlaylistChangeLog* change_log = getPlaylistChangeLog(aimp_manager_);
+    const bool full_snapshot = !change_log || !change_log->getDelta(playlist_id, static_cast<crc32_t>(args.crc32), &delta);
+
+    Rpc::Value& result = root_response["result"];
+    result["crc32"] = static_cast<int>(crc32);
+    result["full_snapshot"] = full_snapshot;
+
+    // return zero-length arrays, not null if there are no changes.
+    if (full_snapshot) {
+        result["entries"].setSize(0);
+    } else {
+        result["inserted"].setSize(0);
+        result["moved"].setSize(0);
+        result["updated"].setSize(0);
+
+        Rpc::Value& removed = result["removed"];
+        removed.setSize( delta.removed.size() );
+        size_t removed_index = 0;
+        BOOST_FOREACH(PlaylistEntryID entry_id, delta.removed) {
+            removed[removed_index++] = entry_id;
+        }
+    }
+
+    // take references when all members are added since adding of member invalidates references to others.
+    Rpc::Value& entries = result[full_snapshot ? "entries" : "inserted"];
+    Rpc::Value* moved   = full_snapshot ? nullptr : &result["moved"];
+    Rpc::Value* updated = full_snapshot ? nullptr : &result["updated"];
+
+    using namespace Utilities;
+
+    const char * const query = "SELECT entry_id, entry_index FROM PlaylistsEntries WHERE playlist_id=? ORDER BY entry_index";
+
+    sqlite3* db = getPlaylistsDB(aimp_manager_);
+    StmtCache::Lease stmt(getPlaylistsStmtCache(aimp_manager_), query);
+    const int rc_bind = sqlite3_bind_int(stmt, 1, playlist_id);
+    if (SQLITE_OK != rc_bind) {
+        throw std::runtime_error(MakeString() << "Error sqlite3_bind_int: " << rc_bind << ". Query: " << query);
+    }
+
+    for(;;) {
+        const int rc_db = sqlite3_step(stmt);
+        if (SQLITE_ROW == rc_db) {
+            const PlaylistEntryID entry_id = sqlite3_column_int(stmt, 0);
+            if (full_snapshot) {
+                const size_t size = entries.size();
+                entries.setSize(size + 1);
+                entries[size] = entry_id;
+                continue;
+            }
+
+            // only few entries are changed usually, so it is cheaper to look them up than to query them by ids.
+            const int entry_index = sqlite3_column_int(stmt, 1);
+            if ( delta.inserted.find(entry_id) != delta.inserted.end() ) {
+                appendEntryLocation(entry_id, entry_index, entries);
+            }
+            if ( delta.moved.find(entry_id) != delta.moved.end() ) {
+                appendEntryLocation(entry_id, entry_index, *moved);
+            }
+            if ( delta.updated.find(entry_id) != delta.updated.end() ) {
+                appendEntryLocation(entry_id, entry_index, *updated);
+            }
+        } else if (SQLITE_DONE == rc_db) {
+            break;
+        } else {
+            const std::string msg = MakeString() << "sqlite3_step() error "
+                                                 << rc_db << ": " << sqlite3_errmsg(db)
+                                                 << ". Query: " << query;
+            throw std::runtime_error(msg);
+        }
+    }
+
+    return RESPONSE_IMMEDIATE;
+}
+
 std::string text16_to_utf8(const void* text16) 
 {
     const WCHAR* text = static_cast<const WCHAR*>(text16);
@@ -922,14 +1470,21 @@ ResponseType GetPlaylistEntryInfo::execute(const Rpc::Value& root_request, Rpc::
     std::ostringstream query;
     query << "SELECT "
           << "playlist_id, entry_id, album, artist, date, genre, title, bitrate, channels_count, duration, filesize, rating, samplerate"
-          << " FROM PlaylistsEntries WHERE entry_id=" << track_desc.track_id;
-    if (track_desc.playlist_id != kPlaylistIdNotUsed) {
-        query << " AND playlist_id=" << track_desc.playlist_id;
+          << " FROM PlaylistsEntries WHERE entry_id=?";
+    const bool playlist_id_used = track_desc.playlist_id != kPlaylistIdNotUsed;
+    if (playlist_id_used) {
+        query << " AND playlist_id=?";
     }
 
     sqlite3* db = getPlaylistsDB(aimp_manager_);
-    sqlite3_stmt* stmt = createStmt( db, query.str() );
-    ON_BLOCK_EXIT(&sqlite3_finalize, stmt);
+    StmtCache::Lease stmt(getPlaylistsStmtCache(aimp_manager_), query.str());
+    int rc_bind = sqlite3_bind_int(stmt, 1, track_desc.track_id);
+    if (SQLITE_OK == rc_bind && playlist_id_used) {
+        rc_bind = sqlite3_bind_int(stmt, 2, track_desc.playlist_id);
+    }
+    if (SQLITE_OK != rc_bind) {
+        throw std::runtime_error(MakeString() << "Error sqlite3_bind_int: " << rc_bind << ". Query: " << query.str());
+    }
 
     for(;;) {
 		int rc_db = sqlite3_step(stmt);
@@ -982,28 +1537,49 @@ const wchar_t* getExtensionByFormatId(int format_id)
 
 void remove_read_only_attribute(const fs::wpath& path);
 
-ResponseType GetCover::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
+GetCover::Args::Args()
+    :
+    playlist_id(kPlaylistIdNotUsed),
+    cover_width(0),
+    cover_height(0),
+    cover_width_passed(false),
+    cover_height_passed(false)
+{}
+
+void GetCover::initParamsSchema()
 {
-    const Rpc::Value& params = root_request["params"];
+    const bool require_playlist_id = dynamic_cast<AIMPManager26*>(&aimp_manager_) != nullptr;
+    params_schema_.required("track_id", &Args::track_id)
+                  // cover of original size is returned if size is omitted or is not integer.
+                  .optionalLenient("cover_width", &Args::cover_width, &Args::cover_width_passed)
+                  .optionalLenient("cover_height", &Args::cover_height, &Args::cover_height_passed);
+    if (require_playlist_id) {
+        params_schema_.required("playlist_id", &Args::playlist_id);
+    } else {
+        params_schema_.optional("playlist_id", &Args::playlist_id);
+    }
+}
 
-    const TrackDescription track_desc( aimp_manager_.getAbsoluteTrackDesc( getTrackDesc(params) ) );
+ResponseType GetCover::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
+{
+    Args args;
+    std::string error;
+    if ( !params_schema_.bind(root_request["params"], &args, &error) ) {
+        throw Rpc::Exception(error, WRONG_ARGUMENT);
+    }
 
-    int cover_width;
-    int cover_height;
-    try {
-        cover_width = params["cover_width"];
-        cover_height = params["cover_height"];
+    const TrackDescription track_desc( aimp_manager_.getAbsoluteTrackDesc( TrackDescription(args.playlist_id, args.track_id) ) );
 
-        const int kMAX_ALBUMCOVER_SIZE = 2000; // 2000x2000 is max size of cover.
+    int cover_width = args.cover_width;
+    int cover_height = args.cover_height;
 
-        if  ( (cover_width < 0 || cover_width > kMAX_ALBUMCOVER_SIZE)
-              || (cover_height < 0 || cover_height > kMAX_ALBUMCOVER_SIZE)
-            )
-        {
-            throw Rpc::Exception(""); // limit cover size [0, kMAX_ALBUMCOVER_SIZE], use original size if any.
-        }
-    } catch (Rpc::Exception&) {
-        cover_width = cover_height = 0; // by default request full size cover.
+    const int kMAX_ALBUMCOVER_SIZE = 2000; // 2000x2000 is max size of cover.
+    if (   !args.cover_width_passed || !args.cover_height_passed
+        || (cover_width < 0 || cover_width > kMAX_ALBUMCOVER_SIZE)
+        || (cover_height < 0 || cover_height > kMAX_ALBUMCOVER_SIZE)
+        )
+    {
+        cover_width = cover_height = 0; // by default request full size cover. Limit cover size [0, kMAX_ALBUMCOVER_SIZE], use original size if any.
     }
 
     Cache::SearchResult cache_search_result;
@@ -1290,12 +1866,90 @@ SubscribeOnAIMPStateUpdateEvent::EVENTS SubscribeOnAIMPStateUpdateEvent::getEven
     throw Rpc::Exception("Event does not supported", WRONG_ARGUMENT);
 }
 
-ResponseType SubscribeOnAIMPStateUpdateEvent::execute(const Rpc::Value& root_request, Rpc::Value& /*result*/)
+bool SubscribeOnAIMPStateUpdateEvent::mustReplyAtOnce(EVENTS event_id, const Rpc::Value& params) const
 {
-    EVENTS event_id = getEventFromRpcParams(root_request["params"]);
+    if ( params.type() != Rpc::Value::TYPE_OBJECT || !params.isMember("since") ) {
+        return false;
+    }
+
+    const Rpc::Value& since_value = params["since"];
+    if (   (since_value.type() == Rpc::Value::TYPE_INT  && static_cast<int>(since_value) == 0)
+        || (since_value.type() == Rpc::Value::TYPE_UINT && static_cast<unsigned int>(since_value) == 0)
+        )
+    {
+        return true; // client has no state yet.
+    }
+
+    unsigned int session_id,
+                 since;
+    char tail;
+    if (   since_value.type() != Rpc::Value::TYPE_STRING
+        || sscanf_s(static_cast<const std::string&>(since_value).c_str(), "%u-%u%c", &session_id, &since, &tail, 1) != 2
+        )
+    {
+        throw Rpc::Exception("Wrong argument: 'since' must be 0 or 'event_seq' value of previous response.", WRONG_ARGUMENT);
+    }
+
+    if (session_id != session_id_) {
+        return true; // client knows events of previous AIMP session, sequence has been restarted.
+    }
+    return eventOccurredSince(event_id, since);
+}
+
+std::string SubscribeOnAIMPStateUpdateEvent::lastEventSeq() const
+{
+    return MakeString() << session_id_ << '-' << last_event_seq_;
+}
+
+void SubscribeOnAIMPStateUpdateEvent::addEventToJournal(EVENTS event_id)
+{
+    if (event_journal_.size() == kEVENT_JOURNAL_MAX_SIZE) {
+        event_journal_.pop_front();
+    }
+    event_journal_.push_back( std::make_pair(++last_event_seq_, event_id) );
+}
+
+bool SubscribeOnAIMPStateUpdateEvent::eventOccurredSince(EVENTS event_id, unsigned int since) const
+{
+    if (since > last_event_seq_) {
+        return true; // sequence number was never given out, state of client is unknown.
+    }
+
+    if ( !event_journal_.empty() && since + 1 < event_journal_.front().first ) {
+        return true; // events after 'since' have been dropped from journal.
+    }
+
+    // journal is ordered by sequence number, so walk from the newest event.
+    for (EventJournal::const_reverse_iterator it = event_journal_.rbegin(), end = event_journal_.rend();
+         it != end && it->first > since;
+         ++it
+         )
+    {
+        if (it->second == event_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ResponseType SubscribeOnAIMPStateUpdateEvent::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
+{
+    const Rpc::Value& params = root_request["params"];
+    EVENTS event_id = getEventFromRpcParams(params);
 
     DelayedResponseSender_ptr comet_delayed_response_sender = rpc_request_handler_.getDelayedResponseSender();
     assert(comet_delayed_response_sender != nullptr);
+
+    if ( mustReplyAtOnce(event_id, params) ) {
+        // client has missed event or has no state: return current state right now.
+        prepareResponse(event_id, root_response["result"]);
+        if ( !comet_delayed_response_sender->persistent() ) {
+            return RESPONSE_IMMEDIATE;
+        }
+        // WebSocket subscription stays active for next events.
+        comet_delayed_response_sender->sendResponseSuccess(root_response);
+    }
+
     delayed_response_sender_descriptors_.insert( std::make_pair(event_id,
                                                                 ResponseSenderDescriptor(root_request, comet_delayed_response_sender)
                                                                 )
@@ -1329,6 +1983,8 @@ void SubscribeOnAIMPStateUpdateEvent::prepareResponse(EVENTS event_id, Rpc::Valu
         assert(!"Unsupported event ID in " __FUNCTION__);
         BOOST_LOG_SEV(logger(), error) << "Unsupported event ID " << event_id << " in " __FUNCTION__;
     }
+
+    result["event_seq"] = lastEventSeq();
 }
 
 void SubscribeOnAIMPStateUpdateEvent::aimpEventHandler(AIMPManager::EVENTS event)
@@ -1377,27 +2033,57 @@ void SubscribeOnAIMPStateUpdateEvent::aimpEventHandler(AIMPManager::EVENTS event
 
 void SubscribeOnAIMPStateUpdateEvent::sendNotifications(EVENTS event_id)
 {
+    addEventToJournal(event_id);
+
+    // player is queried and response is serialized once per event, not per subscriber.
+    boost::scoped_ptr<Rpc::SharedResponse> response;
+    std::string error_msg; // reason why player state can't be got, all subscribers get fault then.
+
     std::pair<DelayedResponseSenderDescriptors::iterator, DelayedResponseSenderDescriptors::iterator> it_pair = delayed_response_sender_descriptors_.equal_range(event_id);
-    //auto it_pair = delayed_response_sender_descriptors_.equal_range(event_id);
     for (DelayedResponseSenderDescriptors::iterator sender_it = it_pair.first,
                                                     end       = it_pair.second;
                                                     sender_it != end;
-                                                    ++sender_it
          )
     {
         ResponseSenderDescriptor& sender_descriptor = sender_it->second;
-        sendEventNotificationToSubscriber(event_id, sender_descriptor);
-    }
+        if ( sender_descriptor.sender->closed() ) {
+            sender_it = delayed_response_sender_descriptors_.erase(sender_it); // WebSocket client has gone.
+            continue;
+        }
 
-    delayed_response_sender_descriptors_.erase(it_pair.first, it_pair.second);
-}
+        if ( !response && error_msg.empty() ) {
+            try {
+                Rpc::Value result;
+                prepareResponse(event_id, result);
+                response.reset( new Rpc::SharedResponse(result) );
+            } catch (std::exception& e) {
+                error_msg = MakeString() << "Notification about event " << event_id << " failed. Reason: " << e.what();
+                BOOST_LOG_SEV(logger(), error) << error_msg;
+            }
+        }
 
-void SubscribeOnAIMPStateUpdateEvent::sendEventNotificationToSubscriber(EVENTS event_id, ResponseSenderDescriptor& response_sender_descriptor)
-{
-    Rpc::Value response;
-    prepareResponse(event_id, response["result"]); // TODO: catch errors here.
-    response["id"] = response_sender_descriptor.root_request["id"];
-    response_sender_descriptor.sender->sendResponseSuccess(response);
+        // Every subscriber gets response: error of one of them must not leave the rest without reply.
+        try {
+            if (response) {
+                sender_descriptor.sender->sendResponseSuccess(*response, sender_descriptor.root_request["id"]);
+            } else {
+                sender_descriptor.sender->sendResponseFault(sender_descriptor.root_request, error_msg, EVENT_NOTIFICATION_FAILED);
+            }
+        } catch (std::exception& e) {
+            BOOST_LOG_SEV(logger(), error) << "Sending of notification about event " << event_id << " failed. Reason: " << e.what();
+            try {
+                sender_descriptor.sender->sendResponseFault(sender_descriptor.root_request, e.what(), EVENT_NOTIFICATION_FAILED);
+            } catch (std::exception& fault_error) {
+                BOOST_LOG_SEV(logger(), error) << "Sending of fault response about event " << event_id << " failed. Reason: " << fault_error.what();
+            }
+        }
+
+        if ( sender_descriptor.sender->persistent() ) {
+            ++sender_it; // WebSocket subscriber receives all next events without resubscription.
+        } else {
+            sender_it = delayed_response_sender_descriptors_.erase(sender_it); // comet subscriber must resubscribe.
+        }
+    }
 }
 
 ResponseType GetPlayerControlPanelState::execute(const Rpc::Value& /*root_request*/, Rpc::Value& root_response)
@@ -1488,6 +2174,91 @@ ResponseType PluginCapabilities::execute(const Rpc::Value& /*root_request*/, Rpc
     return RESPONSE_IMMEDIATE;
 }
 
+ResponseType GetResponseCacheStats::execute(const Rpc::Value& /*root_request*/, Rpc::Value& root_response)
+{
+    const Rpc::ResponseCache& cache = rpc_request_handler_.responseCache();
+    const Rpc::ResponseCache::Stats& stats = cache.stats();
+    const std::size_t lookups = stats.hits + stats.misses;
+
+    Rpc::Value& result = root_response["result"];
+    result["hits"]          = stats.hits;
+    result["misses"]        = stats.misses;
+    result["hit_ratio"]     = lookups != 0 ? static_cast<double>(stats.hits) / lookups : 0.0;
+    result["evictions"]     = stats.evictions;
+    result["invalidations"] = stats.invalidations;
+    result["entries_count"] = stats.entries_count;
+    result["size"]          = stats.size;
+    result["max_size"]      = cache.maxSize();
+    return RESPONSE_IMMEDIATE;
+}
+
+ResponseType GetStaticFileCacheStats::execute(const Rpc::Value& /*root_request*/, Rpc::Value& root_response)
+{
+    const Http::StaticFileCache::Stats& stats = static_file_cache_.stats();
+    const std::size_t lookups = stats.hits + stats.misses;
+
+    Rpc::Value& result = root_response["result"];
+    result["hits"]          = stats.hits;
+    result["misses"]        = stats.misses;
+    result["hit_ratio"]     = lookups != 0 ? static_cast<double>(stats.hits) / lookups : 0.0;
+    result["evictions"]     = stats.evictions;
+    result["entries_count"] = stats.entries_count;
+    result["size"]          = stats.size;
+    result["max_size"]      = static_file_cache_.maxSize();
+    return RESPONSE_IMMEDIATE;
+}
+
+ResponseType GetStmtCacheStats::execute(const Rpc::Value& /*root_request*/, Rpc::Value& root_response)
+{
+    const Utilities::StmtCacheStats stats = AIMPPlayer::getPlaylistsStmtCache(aimp_manager_).stats();
+    const std::size_t lookups = stats.hits + stats.misses;
+
+    Rpc::Value& result = root_response["result"];
+    result["hits"]           = stats.hits;
+    result["misses"]         = stats.misses;
+    result["hit_ratio"]      = lookups != 0 ? static_cast<double>(stats.hits) / lookups : 0.0;
+    result["uncached"]       = stats.uncached;
+    result["cached_queries"] = stats.cached_queries;
+    return RESPONSE_IMMEDIATE;
+}
+
+ResponseCacheInvalidator::ResponseCacheInvalidator(AIMPManager& aimp_manager, Rpc::ResponseCache& response_cache)
+    :
+    aimp_manager_(aimp_manager),
+    response_cache_(response_cache)
+{
+    aimp_events_listener_id_ = aimp_manager_.registerListener( boost::bind(&ResponseCacheInvalidator::aimpEventHandler,
+                                                                           this,
+                                                                           _1
+                                                                           )
+                                                              );
+}
+
+ResponseCacheInvalidator::~ResponseCacheInvalidator()
+{
+    aimp_manager_.unRegisterListener(aimp_events_listener_id_);
+}
+
+void ResponseCacheInvalidator::aimpEventHandler(AIMPManager::EVENTS event)
+{
+    if (event == AIMPManager::EVENT_PLAYLISTS_CONTENT_CHANGE) {
+        response_cache_.invalidate( boost::bind(&ResponseCacheInvalidator::isCacheTagActual, this, _1) );
+    }
+}
+
+bool ResponseCacheInvalidator::isCacheTagActual(const Rpc::CacheTag& tag) const
+{
+    if (tag.id == kPlaylistsListCacheTagID) {
+        return false; // any change of playlists content is visible in list of playlists.
+    }
+
+    try {
+        return aimp_manager_.getPlaylistCRC32(tag.id) == tag.version;
+    } catch (std::runtime_error&) {
+        return false; // playlist has been removed.
+    }
+}
+
 ResponseType AddURLToPlaylist::execute(const Rpc::Value& root_request, Rpc::Value& root_response)
 {
     const Rpc::Value& params = root_request["params"];
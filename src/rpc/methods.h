@@ -8,9 +8,12 @@
 #include "aimp/manager.h"
 #include "method.h"
 #include "value.h"
+#include "params_schema.h"
 #include "utils.h"
 #include "utils/sqlite_util.h"
 
+#include <ctime>
+#include <deque>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int.hpp>
 #include <boost/random/variate_generator.hpp>
@@ -24,6 +27,8 @@ namespace MultiUserMode { class MultiUserModeManager; }
 
 namespace Rpc { class DelayedResponseSender; }
 
+namespace Http { class StaticFileCache; }
+
 /*! contains RPC methods definitions.
 
     #ERROR_CODES \internal This must be mentioned to proper generation links to values of this enum \endinternal
@@ -76,7 +81,8 @@ enum ERROR_CODES {
                    REMOVE_TRACK_PHYSICAL_DELETION_DISABLED = 29, /*!< can't remove track physically. Reason: user has disabled it in plugin settings. */
                    SCHEDULER_DISABLED = 30, /*!< can't shutdown/hibernate machine or stop playback by timer. Reason: user has disabled it in plugin settings. */
                    SCHEDULER_UNSUPPORTED_ACTION = 31, /*!< can't schedule specified action. Reason: machine does not support action. For example, hibernation/shutdown/sleep can be disabled. */
-				   PLAYLIST_CREATION_FAILED = 32 /*!< can't create playlist. */
+				   PLAYLIST_CREATION_FAILED = 32, /*!< can't create playlist. */
+                   EVENT_NOTIFICATION_FAILED = 33 /*!< can't get player state to notify subscriber about event. Subscriber of SubscribeOnAIMPStateUpdateEvent gets it instead of event notification. */
 };
 
 using namespace AIMPPlayer;
@@ -633,6 +639,9 @@ public:
 
     Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
 
+    //! Result depends on list of playlists and their properties, so it is cached until any playlist change.
+    bool getCacheTags(const Rpc::Value& root_request, Rpc::CacheTags* tags) const;
+
 private:
 
     std::string getColumnsString() const;
@@ -644,6 +653,19 @@ private:
 namespace PlaylistEntries {
 typedef std::set<std::string> SupportedFieldNames;
 typedef std::vector<SupportedFieldNames::const_iterator> RequiredFieldNames;
+
+//! Database field of ORDER BY clause of entries query.
+struct OrderField
+{
+    OrderField(const std::string& name, bool descending)
+        : name(name), descending(descending)
+    {}
+
+    std::string name;
+    bool descending;
+};
+
+typedef std::vector<OrderField> OrderFields;
 }
 
 struct PaginationInfo : boost::noncopyable {
@@ -692,10 +714,16 @@ struct PaginationInfo : boost::noncopyable {
                                                 - album
                                                 - data
                                                 - genre
+    \param search_by_word_prefix - bool, optional(Default is false). If true, entry matches if each word of 'search_string'
+                                             is beginning of some word of its string fields. Full-text index is used, so search is faster,
+                                             but substrings in the middle of words are not found. Words shorter than 3 characters
+                                             and absence of full-text support in player's sqlite library make search use substrings anyway.
 
     \return object which describes playlist entries.
             Example:\code{"count_of_found_entries":1,"entries":[[1,"Looks Like Chaplin"]],"total_entries_count":3}\endcode
             If params were \code{"playlist_id": 2136855360, "search_string":"Like"}}\endcode
+    \remark Large list of entries is sent to HTTP/1.1 JSON-RPC clients with chunked transfer coding while entries are read from database.
+            Sending is aborted(connection is closed before the last chunk) if playlist is changed meanwhile.
 */
 class GetPlaylistEntries : public AIMPRPCMethod
 {
@@ -706,7 +734,7 @@ public:
 
     std::string help()
     {
-        return "get_playlist_entries(int playlist_id, string fields[], int start_index, int entries_count, struct order_fields[], string search_string, string format_string) "
+        return "get_playlist_entries(int playlist_id, string fields[], int start_index, int entries_count, struct order_fields[], string search_string, bool search_by_word_prefix, string format_string) "
                "returns struct with following members: "
                "    'count_of_found_entries' - (optional value. Defined if params.search_string is not empty) - count of entries "
                                                "which match params.search_string. See params.search_string param description for details. "
@@ -716,11 +744,17 @@ public:
 
     Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
 
+    //! Result is cached while CRC32 of requested playlist is not changed.
+    bool getCacheTags(const Rpc::Value& root_request, Rpc::CacheTags* tags) const;
+
     void activateEntryLocationDeterminationMode(PaginationInfo* pagination_info)
         { pagination_info_ = pagination_info; }
     void activateQueuedEntriesMode()
         { queued_entries_mode_ = true; }
 
+    //! Returns ORDER BY clause. Used by source of streamed entries too.
+    static std::string getOrderString(const PlaylistEntries::OrderFields& order_fields);
+
 private:
 
     void deactivateEntryLocationDeterminationMode()
@@ -743,7 +777,8 @@ private:
     typedef std::vector<std::string> FieldNames;
 
     FieldNames fields_to_order_;
-    std::string getOrderString(const Rpc::Value& params) const;
+    //! Returns fields to order entries by, default order is order of playlist.
+    PlaylistEntries::OrderFields getOrderFields(const Rpc::Value& params) const;
 
     FieldNames fields_to_filter_;
 
@@ -752,11 +787,24 @@ private:
 
     mutable Utilities::QueryArgSetters query_arg_setters_;
 
-    std::string getLimitString(const Rpc::Value& params) const;
+    //! Limit values are added to limit_arg_setters, they are bound after query_arg_setters_.
+    std::string getLimitString(const Rpc::Value& params, Utilities::QueryArgSetters* limit_arg_setters) const;
     std::string getWhereString(const Rpc::Value& params, const int playlist_id) const;
+
+    /*!
+        \brief Returns MATCH argument for search by word prefixes in full-text index PlaylistsEntriesSearch.
+        \return empty string if index is not available: search falls back to LIKE operator then.
+    */
+    std::string getSearchMatchQuery(const std::string& search_string) const;
     std::string getColumnsString() const;
     size_t getTotalEntriesCount(sqlite3* playlists_db, const int playlist_id) const; // throws std::runtime_error
 
+    //! Returns true if entries should be sent while they are read from database, see Rpc::StreamedResponse.
+    bool streamingRequired(const Rpc::Value& params, size_t count_of_found_entries) const;
+
+    //! Smaller results are serialized at once: whole response fits in a few parts of streamed response anyway.
+    static const size_t kMIN_ENTRIES_COUNT_TO_STREAM = 1000;
+
     const std::string kRQST_KEY_FORMAT_STRING,
                       kRQST_KEY_FIELDS;
 
@@ -768,7 +816,8 @@ private:
                       kRQST_KEY_ORDER_DIRECTION,
                       kRQST_KEY_ORDER_FIELDS;
 
-    const std::string kRQST_KEY_SEARCH_STRING;
+    const std::string kRQST_KEY_SEARCH_STRING,
+                      kRQST_KEY_SEARCH_BY_WORD_PREFIX;
 
     const std::string kRSLT_KEY_ENTRIES,
                       kRSLT_KEY_TOTAL_ENTRIES_COUNT,
@@ -816,6 +865,9 @@ public:
 
     Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
 
+    //! Result is cached while CRC32 of requested playlist is not changed.
+    bool getCacheTags(const Rpc::Value& root_request, Rpc::CacheTags* tags) const;
+
 private:
 
     GetPlaylistEntries& getplaylistentries_method_;
@@ -841,6 +893,57 @@ public:
     }
 
     Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
+
+    //! Result is cached while CRC32 of requested playlist is not changed.
+    bool getCacheTags(const Rpc::Value& root_request, Rpc::CacheTags* tags) const;
+};
+
+/*! 
+    \brief Returns changes of playlist entries since playlist had specified crc32.
+           It allows client to keep large playlist in sync without reloading all entries after each change.
+    \param playlist_id - int. \ref special_ids_sec "More"
+    \param crc32 - int, crc32 of playlist known by client(see GetPlaylists).
+    \return object with members:
+                - 'crc32' - current crc32 of playlist.
+                - 'full_snapshot' - bool. True if changes since requested crc32 are unknown: crc32 is too old or was never reported.
+                                    Client should reload whole playlist in this case.
+                - 'entries' - array of ids of all entries in playlist order. Defined if 'full_snapshot' is true.
+                - 'removed' - array of ids of removed entries.
+                - 'inserted', 'moved', 'updated' - arrays of [id, index] pairs of entries which were inserted, moved or whose fields were changed.
+                                                   Index is current index of entry in playlist.
+            Client applies changes this way: drops removed and moved entries, puts inserted and moved entries at their indices
+            and refreshes updated entries(see GetPlaylistEntryInfo). Other entries keep their relative order.
+            Example:\code{"crc32":358339139,"full_snapshot":false,"inserted":[[38609872,0]],"moved":[],"removed":[38609520],"updated":[]}\endcode
+    \remark AIMP 2.6 is not supported: 'full_snapshot' is always true.
+*/
+class GetPlaylistEntriesDelta : public AIMPRPCMethod
+{
+public:
+    GetPlaylistEntriesDelta(AIMPManager& aimp_manager, Rpc::RequestHandler& rpc_request_handler)
+        : AIMPRPCMethod("GetPlaylistEntriesDelta", aimp_manager, rpc_request_handler)
+    {
+        params_schema_.required("playlist_id", &Args::playlist_id)
+                      .required("crc32", &Args::crc32);
+    }
+
+    std::string help()
+    {
+        return "GetPlaylistEntriesDelta(int playlist_id, int crc32) returns changes of playlist entries since playlist had specified crc32: "
+               "arrays 'removed'(ids), 'inserted', 'moved', 'updated'([id, index] pairs) and current 'crc32'. "
+               "If changes are unknown 'full_snapshot' is true and 'entries' contains ids of all entries in playlist order.";
+    }
+
+    Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
+
+private:
+
+    struct Args
+    {
+        int playlist_id;
+        int crc32; // client gets crc32 as signed int.
+    };
+
+    Rpc::ParamsSchema<Args> params_schema_;
 };
 
 /*! 
@@ -924,6 +1027,7 @@ public:
         random_file_part_.resize(kRANDOM_FILENAME_PART_LENGTH);
         cover_directory_relative_ = cover_directory;
         prepare_cover_directory();
+        initParamsSchema();
     }
 
     std::string help()
@@ -937,6 +1041,22 @@ public:
 
 private:
 
+    struct Args
+    {
+        Args();
+
+        int track_id;
+        int playlist_id;
+        int cover_width;
+        int cover_height;
+        bool cover_width_passed;
+        bool cover_height_passed;
+    };
+
+    void initParamsSchema();
+
+    Rpc::ParamsSchema<Args> params_schema_;
+
     /*
         Generate filename in format cover_playlistID_trackID_widthxheight_random. Ex: cover_2222222_01_100x100_45730.
     */
@@ -1050,12 +1170,20 @@ public:
                     - playlist count
                   Response example:\code{"playlists_changed":true, "playlists":[{"crc32":-1169477297,"id":38609376},{"crc32":358339139,"id":38609520},{"crc32":-1895027311,"id":38609664}]}\endcode
                   Note: 'playlists' array contains all playlists.
+    \param since - string or 0, optional. The last event client knows about: value of 'event_seq' member of previous response.
+            If specified event has occurred after that event, response is returned immediately, so no event is lost between
+            response and resubscription. Otherwise request waits for event as usual.
+            0 means that client knows nothing: current state is returned at once. 'event_seq' of previous AIMP session is treated the same way.
+            Changes are coalesced: response always describes current state.
+    Each response contains string member 'event_seq' - opaque identifier of the last event in format "<session>-<sequence number>".
 */
 class SubscribeOnAIMPStateUpdateEvent : public AIMPRPCMethod
 {
 public:
     SubscribeOnAIMPStateUpdateEvent(AIMPManager& aimp_manager, Rpc::RequestHandler& rpc_request_handler)
         : AIMPRPCMethod("SubscribeOnAIMPStateUpdateEvent", aimp_manager, rpc_request_handler),
+          session_id_( static_cast<unsigned int>( std::time(nullptr) ) ),
+          last_event_seq_(0),
           aimp_app_is_exiting_(false)
     {
         using namespace boost::assign;
@@ -1095,6 +1223,10 @@ public:
                        "Response is the same as get_control_panel_state() function."
                        "On aimp exit response also contains boolean field 'aimp_app_is_exiting'."
                    "4) 'playlists_content_change' - playlists content change"
+               "If method is called through WebSocket channel(/websocket) subscription is persistent: "
+               "every next event is sent in separate message with id of subscription request, so client does not need to resubscribe."
+               "Optional 'since' param is 'event_seq' member of previous response: "
+               "if event has occurred after it, current state is returned immediately. Pass 0 to get current state at once."
         ;
     }
 
@@ -1118,10 +1250,24 @@ private:
     //! Formats result Rpc value according to specified event.
     void prepareResponse(EVENTS event_id, Rpc::Value& result) const;
 
-    struct ResponseSenderDescriptor;
-    //! Sends notification to concrete subscriber(delayed_response_sender) for specified event.
-    void sendEventNotificationToSubscriber(EVENTS event_id,
-                                           ResponseSenderDescriptor& response_sender_descriptor);
+    //! Appends event to journal, old events are dropped to keep it bounded.
+    void addEventToJournal(EVENTS event_id);
+
+    /*!
+        \brief Returns true if event has occurred after event of current session with sequence number 'since'.
+               Also returns true if it is unknown: journal does not contain so old events.
+    */
+    bool eventOccurredSince(EVENTS event_id, unsigned int since) const;
+
+    /*!
+        \brief Returns true if current state must be sent at once according to 'since' param:
+               it is 0, belongs to previous AIMP session or event has occurred after it.
+               Returns false if request does not contain 'since' param.
+    */
+    bool mustReplyAtOnce(EVENTS event_id, const Rpc::Value& params) const; // throws Rpc::Exception
+
+    //! Returns 'event_seq' value of the last event.
+    std::string lastEventSeq() const;
 
     /* Gets event from Rpc argument(string) in format of EVENTS. */
     EVENTS getEventFromRpcParams(const Rpc::Value& params) const;
@@ -1144,6 +1290,12 @@ private:
     typedef std::multimap<EVENTS, ResponseSenderDescriptor> DelayedResponseSenderDescriptors;
     DelayedResponseSenderDescriptors delayed_response_sender_descriptors_;
 
+    typedef std::deque< std::pair<unsigned int, EVENTS> > EventJournal; // sequence number and event.
+    EventJournal event_journal_; // last events, the oldest one is at front.
+    const unsigned int session_id_; // distinguishes sequence numbers of AIMP sessions since they start from 0 in each one.
+    unsigned int last_event_seq_; // sequence number of the last event, 0 if there were no events yet.
+    static const size_t kEVENT_JOURNAL_MAX_SIZE = 256;
+
     bool aimp_app_is_exiting_;
 };
 
@@ -1221,6 +1373,100 @@ public:
     Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
 };
 
+/*! 
+    \brief Returns statistics of response cache.
+           GetPlaylists, GetPlaylistEntries, GetPlaylistEntriesCount and GetEntryPositionInDataTable responses are cached
+           until content of playlists they depend on is changed(see ResponseCacheInvalidator).
+    \return object which describes cache state:
+         Example: \code {"entries_count":12,"evictions":0,"hit_ratio":0.8,"hits":48,"invalidations":3,"max_size":8388608,"misses":12,"size":40960} \endcode
+*/
+class GetResponseCacheStats : public AIMPRPCMethod
+{
+public:
+    GetResponseCacheStats(AIMPManager& aimp_manager, Rpc::RequestHandler& rpc_request_handler)
+        : AIMPRPCMethod("GetResponseCacheStats", aimp_manager, rpc_request_handler)
+    {}
+
+    std::string help()
+    {
+        return "GetResponseCacheStats() returns struct with counters of response cache: "
+               "'hits', 'misses', 'hit_ratio', 'evictions', 'invalidations', 'entries_count', 'size' and 'max_size' in bytes.";
+    }
+
+    Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
+};
+
+/*! 
+    \brief Returns statistics of in-memory cache of static files of web interface.
+    \return object which describes cache state:
+         Example: \code {"entries_count":25,"evictions":0,"hit_ratio":0.95,"hits":475,"max_size":16777216,"misses":25,"size":1048576} \endcode
+*/
+class GetStaticFileCacheStats : public AIMPRPCMethod
+{
+public:
+    GetStaticFileCacheStats(AIMPManager& aimp_manager, Rpc::RequestHandler& rpc_request_handler, const Http::StaticFileCache& static_file_cache)
+        :
+        AIMPRPCMethod("GetStaticFileCacheStats", aimp_manager, rpc_request_handler),
+        static_file_cache_(static_file_cache)
+    {}
+
+    std::string help()
+    {
+        return "GetStaticFileCacheStats() returns struct with counters of static file cache: "
+               "'hits', 'misses', 'hit_ratio', 'evictions', 'entries_count', 'size' and 'max_size' in bytes.";
+    }
+
+    Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
+
+private:
+
+    const Http::StaticFileCache& static_file_cache_;
+};
+
+/*!
+    \brief Returns statistics of cache of compiled statements of playlists database.
+    \return object which describes cache state:
+         Example: \code {"cached_queries":9,"hit_ratio":0.97,"hits":970,"misses":30,"uncached":0} \endcode
+*/
+class GetStmtCacheStats : public AIMPRPCMethod
+{
+public:
+    GetStmtCacheStats(AIMPManager& aimp_manager, Rpc::RequestHandler& rpc_request_handler)
+        : AIMPRPCMethod("GetStmtCacheStats", aimp_manager, rpc_request_handler)
+    {}
+
+    std::string help()
+    {
+        return "GetStmtCacheStats() returns struct with counters of compiled statements cache of playlists database: "
+               "'hits', 'misses', 'hit_ratio', 'uncached' (statements finalized since cache is full) and 'cached_queries'.";
+    }
+
+    Rpc::ResponseType execute(const Rpc::Value& root_request, Rpc::Value& root_response);
+};
+
+/*!
+    \brief Keeps response cache of RPC request handler consistent: drops responses which depend on changed playlists.
+           Created by plugin together with RPC request handler, so cache is invalidated regardless of set of registered methods.
+*/
+class ResponseCacheInvalidator : boost::noncopyable
+{
+public:
+    ResponseCacheInvalidator(AIMPManager& aimp_manager, Rpc::ResponseCache& response_cache);
+    ~ResponseCacheInvalidator();
+
+private:
+
+    //! Invalidates cached responses on EVENT_PLAYLISTS_CONTENT_CHANGE.
+    void aimpEventHandler(AIMPManager::EVENTS event);
+
+    //! Returns false if tagged playlist has been changed or removed.
+    bool isCacheTagActual(const Rpc::CacheTag& tag) const;
+
+    AIMPManager& aimp_manager_;
+    Rpc::ResponseCache& response_cache_;
+    AIMPManager::EventsListenerID aimp_events_listener_id_;
+};
+
 /*! 
     \brief Adds URL to specified playlist.
     \param playlist_id - int. \ref special_ids_sec "More"
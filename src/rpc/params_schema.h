@@ -0,0 +1,226 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include "rpc/value.h"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <string>
+#include <vector>
+
+namespace Rpc
+{
+
+/*!
+    \brief Declarative description of RPC method params: name, type and presence of each param and field of arguments struct it is bound to.
+           Schema is built once when method is created, bind() validates params object and extracts all arguments in one pass over its members.
+           Missing optional params leave fields with values set by ArgsT constructor, so no exceptions are involved in optional params handling.
+           Supported field types are int, bool, double and std::string, value type must match exactly as Rpc::Value conversions require.
+           The only exception is unsigned value which fits int: readers produce it for integers above INT_MAX only, so it is accepted by int field.
+
+    Usage example:
+        struct Args {
+            Args() : width(0) {}
+            int track_id;
+            int width;
+        };
+
+        ParamsSchema<Args> schema;
+        schema.required("track_id", &Args::track_id)
+              .optional("width", &Args::width);
+
+        Args args;
+        std::string error;
+        if ( !schema.bind(params, &args, &error) ) {
+            throw Rpc::Exception(error, WRONG_ARGUMENT);
+        }
+*/
+template<typename ArgsT>
+class ParamsSchema
+{
+public:
+
+    //! Adds param which must present in params object.
+    template<typename FieldT>
+    ParamsSchema& required(const char* name, FieldT ArgsT::* field)
+        { return add(name, field, true, nullptr, false); }
+
+    /*!
+        \brief Adds param which can be omitted. Null value is treated as omitted param.
+        \param passed - optional flag which is set to true if param is present.
+    */
+    template<typename FieldT>
+    ParamsSchema& optional(const char* name, FieldT ArgsT::* field, bool ArgsT::* passed = nullptr)
+        { return add(name, field, false, passed, false); }
+
+    /*!
+        \brief Adds optional param whose value of wrong type is treated as omitted param instead of error.
+               Used where method historically fell back to default value on any bad argument.
+    */
+    template<typename FieldT>
+    ParamsSchema& optionalLenient(const char* name, FieldT ArgsT::* field, bool ArgsT::* passed = nullptr)
+        { return add(name, field, false, passed, true); }
+
+    /*!
+        \brief Fills args from params object. Members of params which are not described in schema are ignored.
+        \return false if params do not match schema, error contains description of the first mismatch.
+    */
+    bool bind(const Value& params, ArgsT* args, std::string* error) const
+    {
+        assert(args);
+        assert(error);
+
+        static const Value::Object kNO_MEMBERS;
+        Value::Object::const_iterator member_it = kNO_MEMBERS.begin(),
+                                      members_end = kNO_MEMBERS.end();
+        if (params.type() == Value::TYPE_OBJECT) {
+            member_it = params.getObjectMembersBegin();
+            members_end = params.getObjectMembersEnd();
+        } else if (params.type() != Value::TYPE_NONE) {
+            *error = "Wrong arguments: params must be object.";
+            return false;
+        }
+
+        // both members of params object and schema params are sorted by name.
+        for (auto param_it = params_.begin(), end = params_.end(); param_it != end; ++param_it) {
+            const Param& param = *param_it;
+            while (member_it != members_end && member_it->first < param.name) {
+                ++member_it;
+            }
+
+            const bool present =    member_it != members_end
+                                 && member_it->first == param.name
+                                 && member_it->second.type() != Value::TYPE_NULL;
+            if (!present) {
+                if (param.required) {
+                    *error = "Wrong arguments: missing required argument '" + param.name + "'.";
+                    return false;
+                }
+                continue;
+            }
+
+            if ( !assign(param, member_it->second, args) ) {
+                if (param.lenient) {
+                    continue;
+                }
+                *error = "Wrong arguments: argument '" + param.name + "' must be " + typeName(param.type) + ".";
+                return false;
+            }
+            if (param.passed) {
+                args->*param.passed = true;
+            }
+        }
+        return true;
+    }
+
+private:
+
+    struct Param
+    {
+        Param()
+            :
+            type(Value::TYPE_NONE),
+            required(false),
+            lenient(false),
+            passed(nullptr),
+            int_field(nullptr),
+            bool_field(nullptr),
+            double_field(nullptr),
+            string_field(nullptr)
+        {}
+
+        std::string name;
+        Value::TYPE type;
+        bool required;
+        bool lenient;
+        bool ArgsT::* passed;
+
+        // only field of param's type is set.
+        int ArgsT::* int_field;
+        bool ArgsT::* bool_field;
+        double ArgsT::* double_field;
+        std::string ArgsT::* string_field;
+    };
+
+    typedef std::vector<Param> Params;
+
+    static bool nameLess(const Param& param, const std::string& name)
+        { return param.name < name; }
+
+    static void setField(Param* param, int ArgsT::* field)
+        { param->type = Value::TYPE_INT; param->int_field = field; }
+    static void setField(Param* param, bool ArgsT::* field)
+        { param->type = Value::TYPE_BOOL; param->bool_field = field; }
+    static void setField(Param* param, double ArgsT::* field)
+        { param->type = Value::TYPE_DOUBLE; param->double_field = field; }
+    static void setField(Param* param, std::string ArgsT::* field)
+        { param->type = Value::TYPE_STRING; param->string_field = field; }
+
+    template<typename FieldT>
+    ParamsSchema& add(const char* name, FieldT ArgsT::* field, bool required, bool ArgsT::* passed, bool lenient)
+    {
+        Param param;
+        param.name = name;
+        param.required = required;
+        param.lenient = lenient;
+        param.passed = passed;
+        setField(&param, field);
+
+        const auto it = std::lower_bound(params_.begin(), params_.end(), param.name, &nameLess);
+        assert( (it == params_.end() || it->name != param.name) && "param is described twice" );
+        params_.insert(it, param);
+        return *this;
+    }
+
+    //! Returns false if value type does not match param type. Type is checked before access, so Value never throws here.
+    static bool assign(const Param& param, const Value& value, ArgsT* args)
+    {
+        if (   param.type == Value::TYPE_INT
+            && value.type() == Value::TYPE_UINT
+            && static_cast<unsigned int>(value) <= static_cast<unsigned int>(INT_MAX)
+            )
+        {
+            args->*param.int_field = static_cast<int>( static_cast<unsigned int>(value) );
+            return true;
+        }
+
+        if (value.type() != param.type) {
+            return false;
+        }
+
+        switch (param.type) {
+        case Value::TYPE_INT:
+            args->*param.int_field = static_cast<int>(value);
+            break;
+        case Value::TYPE_BOOL:
+            args->*param.bool_field = static_cast<bool>(value);
+            break;
+        case Value::TYPE_DOUBLE:
+            args->*param.double_field = static_cast<double>(value);
+            break;
+        case Value::TYPE_STRING:
+            args->*param.string_field = static_cast<const std::string&>(value);
+            break;
+        default:
+            assert(!"unsupported param type");
+            return false;
+        }
+        return true;
+    }
+
+    static const char* typeName(Value::TYPE type)
+    {
+        switch (type) {
+        case Value::TYPE_INT:    return "integer";
+        case Value::TYPE_BOOL:   return "boolean";
+        case Value::TYPE_DOUBLE: return "double";
+        case Value::TYPE_STRING: return "string";
+        default:                 return "unknown";
+        }
+    }
+
+    Params params_; //!< sorted by name.
+};
+
+} // namespace Rpc
@@ -2,6 +2,12 @@
 
 #pragma once
 
+#include "rpc/method.h"
+#include "rpc/response_cache.h"
+#include "rpc/streamed_response.h"
+#include "rpc/value.h"
+#include <map>
+#include <vector>
 #include <boost/logic/tribool.hpp>
 #include <boost/ptr_container/ptr_map.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
@@ -21,6 +27,7 @@ class Value;
 class RpcCallerDescription;
 class Frontend;
 class ResponseSerializer;
+class BatchResponse;
 
 class RequestHandler : boost::noncopyable
 {
@@ -28,6 +35,8 @@ class RequestHandler : boost::noncopyable
 
 public:
 
+    RequestHandler();
+
     void addFrontend(std::auto_ptr<Frontend> frontend);
 
     /*!
@@ -40,12 +49,40 @@ public:
 
     Frontend* getFrontEnd(const std::string& uri);
 
+    //! Cache of responses of idempotent methods. Owner of cached data invalidates it on data change.
+    ResponseCache& responseCache()
+        { return response_cache_; }
+
+    /*!
+        \brief Returns true if response of executed method can be streamed(see streamResult()):
+               it is single call, frontend supports streaming and caller of handleRequest() can send response of unknown length.
+    */
+    bool resultStreamingAllowed() const;
+
+    /*!
+        \brief Makes response of executed method streamed: items of result member array_name are taken from items_source
+               while response is being sent. Other members of result are set by method as usual.
+               Must be called only if resultStreamingAllowed() returns true.
+    */
+    void streamResult(const std::string& array_name, boost::shared_ptr<ResultItemsSource> items_source);
+
+    /*!
+        \brief Handles single request or batch of requests.
+               Batch is an array of requests(JSON-RPC 2.0 batch or XML-RPC system.multicall), all calls are executed in one pass
+               and single response with array of results is produced. Calls without id(notifications) have no results in array.
+               If batch contains delayed calls response is sent when the last of them is complete.
+               Responses of single calls of cacheable methods are taken from response cache when possible.
+        \param streamed_response - if not null, method can produce large result part by part while response is being sent.
+                                   In this case streamed_response is set and response is empty.
+        \return true if response is ready, false if request has failed, indeterminate if response will be sent later by delayed sender.
+    */
     boost::tribool handleRequest(const std::string& request_uri,
                                  const std::string& request_content,
                                  boost::shared_ptr<Http::DelayedResponseSender> delayed_response_sender,
                                  Frontend& frontend,
                                  std::string* response,
-                                 std::string* response_content_type
+                                 std::string* response_content_type,
+                                 StreamedResponse_ptr* streamed_response = nullptr
                                  );
 
 private:
@@ -53,12 +90,28 @@ private:
     boost::tribool callMethod(const Value& root,
                               boost::shared_ptr<Http::DelayedResponseSender> delayed_response_sender,
                               ResponseSerializer& response_serializer,
-                              std::string* response
+                              std::string* response,
+                              StreamedResponse_ptr* streamed_response
                               );
 
+    boost::tribool callBatch(Value& root,
+                             boost::shared_ptr<Http::DelayedResponseSender> delayed_response_sender,
+                             ResponseSerializer& response_serializer,
+                             std::string* response
+                             );
+
+    /*!
+        \brief Executes method. Response gets "result" member on success or "error" member with "message" and "code" on fault.
+        \return RESPONSE_DELAYED if method will send response later by delayed sender.
+    */
+    ResponseType invokeMethod(const Value& root_request, Value* root_response);
+
     // Get method object by name from registered methods.
     Rpc::Method* getMethodByName(const std::string& name);
 
+    //! \return false if response of request must not be cached. See Method::getCacheTags().
+    bool getCacheTags(const Value& root_request, CacheTags* tags);
+
     typedef boost::ptr_vector<Frontend> Frontends;
     Frontends frontends_;
 
@@ -67,6 +120,92 @@ private:
 
     boost::weak_ptr<Http::DelayedResponseSender> active_delayed_response_sender_; // stores response sender while Rpc method is executed. Allows not to pass this handler in Method::execute() as argument since only comet method needs it.
     ResponseSerializer* active_response_serializer_; // work in pair with active_delayed_response_sender_ member.
+    boost::shared_ptr<BatchResponse> active_batch_; // batch which contains executed method. Null for single request.
+    std::size_t active_batch_index_; // index of executed call in active_batch_.
+    bool active_streaming_allowed_; // caller of handleRequest() accepts streamed response.
+    std::string streamed_array_name_; // set by streamResult() during method execution.
+    boost::shared_ptr<ResultItemsSource> streamed_items_source_;
+
+    ResponseCache response_cache_;
+};
+
+
+/*!
+    \brief Collects results of batch calls and sends them as single response.
+           Delayed calls put their results later, response is sent when the last pending result is received.
+*/
+class BatchResponse : boost::noncopyable
+{
+public:
+
+    BatchResponse(boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender,
+                  const ResponseSerializer& response_serializer,
+                  std::size_t calls_count);
+
+    //! Marks call as notification: its result is not included in response.
+    void setNotification(std::size_t index);
+
+    //! Marks call as delayed: response is not sent until call result is received.
+    void setPending(std::size_t index);
+
+    /*!
+        \brief Stores result of call.
+        \return false if batch response has been already sent and result must be sent separately.
+    */
+    bool setResult(std::size_t index, const Value& root_response);
+
+    /*!
+        \brief Called when all calls of batch have been executed.
+        \return true if response is ready, false if response will be sent when pending calls are complete.
+    */
+    bool finish(std::string* response);
+
+private:
+
+    void serialize(std::string* response) const;
+
+    enum CALL_STATE { CALL_EXECUTING, CALL_PENDING, CALL_COMPLETE, CALL_NOTIFICATION };
+
+    boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender_;
+    const ResponseSerializer& response_serializer_;
+    std::vector<Value> results_;
+    std::vector<CALL_STATE> states_;
+    std::size_t pending_count_;
+    bool finished_; // all calls are executed.
+};
+
+
+/*!
+    \brief Successful response which is sent to many subscribers with different request ids(notification about player event).
+           Response is serialized only once per frontend as template(see ResponseSerializer::serializeSuccessTemplate()),
+           each subscriber only inserts id of its request.
+*/
+class SharedResponse : boost::noncopyable
+{
+public:
+
+    //! \param result - result member of response.
+    explicit SharedResponse(const Value& result);
+
+    //! Returns root response(id and result) for request with given id.
+    Value rootResponse(const Value& id) const;
+
+    //! Serializes response for request with given id.
+    void serialize(const ResponseSerializer& response_serializer, const Value& id, std::string* response);
+
+private:
+
+    struct Template
+    {
+        std::string response; //!< serialized response without id.
+        std::size_t id_offset; //!< position of id in response, std::string::npos if frontend does not send id.
+        bool valid; //!< false if frontend can't produce template, response is serialized for each request in this case.
+    };
+
+    typedef std::map<const ResponseSerializer*, Template> Templates;
+
+    Value result_;
+    Templates templates_;
 };
 
 
@@ -80,17 +219,42 @@ public:
                           )
         :
         comet_http_response_sender_(comet_http_response_sender),
-        response_serializer_(response_serializer)
+        response_serializer_(response_serializer),
+        batch_index_(0)
+    {}
+
+    //! Creates sender for delayed call in batch: result goes to batch response if it has not been sent yet.
+    DelayedResponseSender(boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender,
+                          const ResponseSerializer& response_serializer,
+                          boost::shared_ptr<BatchResponse> batch,
+                          std::size_t batch_index
+                          )
+        :
+        comet_http_response_sender_(comet_http_response_sender),
+        response_serializer_(response_serializer),
+        batch_(batch),
+        batch_index_(batch_index)
     {}
 
     void sendResponseSuccess(const Value& root_response);
 
+    //! Sends response shared by many senders: serialization is done once per frontend.
+    void sendResponseSuccess(SharedResponse& shared_response, const Value& id);
+
     void sendResponseFault(const Value& root_request, const std::string& error_msg, int error_code);
 
+    //! Returns true if sender can be used for many responses(WebSocket channel).
+    bool persistent() const;
+
+    //! Returns true if client has gone and responses can't be delivered.
+    bool closed() const;
+
 private:
 
     boost::shared_ptr<Http::DelayedResponseSender> comet_http_response_sender_;
     const ResponseSerializer& response_serializer_;
+    boost::shared_ptr<BatchResponse> batch_;
+    std::size_t batch_index_;
 };
 
 typedef boost::shared_ptr<DelayedResponseSender> DelayedResponseSender_ptr;
@@ -0,0 +1,124 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "rpc/response_cache.h"
+#include "rpc/response_serializer.h"
+#include "rpc/value.h"
+#include "jsonrpc/rpc_value_codec.h"
+#include <algorithm>
+
+namespace Rpc
+{
+
+ResponseCache::ResponseCache(std::size_t max_size)
+    :
+    max_size_(max_size)
+{
+    Stats empty_stats = { 0 };
+    stats_ = empty_stats;
+}
+
+std::string ResponseCache::makeKey(const Value& root_request)
+{
+    // compact JSON is canonical form of params since members of Rpc::Value object are always sorted.
+    std::string key = root_request["method"];
+    key.push_back('\n');
+    if ( root_request.isMember("params") ) {
+        JsonRpc::writeValue(root_request["params"], &key);
+    }
+    return key;
+}
+
+bool ResponseCache::get(const std::string& key, const ResponseSerializer& response_serializer, const Value& id, std::string* response)
+{
+    assert(response);
+
+    Items::iterator it = items_.find( Key(&response_serializer, key) );
+    if ( it == items_.end() ) {
+        ++stats_.misses;
+        return false;
+    }
+
+    ++stats_.hits;
+    Item& item = it->second;
+    lru_.splice(lru_.begin(), lru_, item.lru_position);
+    buildResponse(item, response_serializer, id, response);
+    return true;
+}
+
+void ResponseCache::put(const std::string& key,
+                        const ResponseSerializer& response_serializer,
+                        const CacheTags& tags,
+                        const Value& root_response,
+                        std::string* response)
+{
+    assert(response);
+
+    Item item;
+    if ( !response_serializer.serializeSuccessTemplate(root_response, &item.response, &item.id_offset) ) {
+        response_serializer.serializeSuccess(root_response, response);
+        return;
+    }
+    item.tags = tags;
+    buildResponse(item, response_serializer, root_response["id"], response);
+
+    const Key item_key(&response_serializer, key);
+    const std::size_t item_size = itemSize(item_key, item);
+    if (item_size > max_size_) {
+        return;
+    }
+
+    Items::iterator it = items_.find(item_key);
+    if ( it != items_.end() ) {
+        erase(it); // replace previous copy of response.
+    }
+
+    // free space for new response.
+    while ( !lru_.empty() && stats_.size + item_size > max_size_ ) {
+        ++stats_.evictions;
+        erase( items_.find( lru_.back() ) );
+    }
+
+    lru_.push_front(item_key);
+    item.lru_position = lru_.begin();
+    items_.insert( std::make_pair(item_key, item) );
+
+    stats_.size += item_size;
+    ++stats_.entries_count;
+}
+
+void ResponseCache::invalidate(const boost::function<bool (const CacheTag&)>& is_actual)
+{
+    for (Items::iterator it = items_.begin(), end = items_.end(); it != end; ) {
+        const CacheTags& tags = it->second.tags;
+        if ( std::all_of(tags.begin(), tags.end(), is_actual) ) {
+            ++it;
+        } else {
+            ++stats_.invalidations;
+            erase(it++);
+        }
+    }
+}
+
+void ResponseCache::buildResponse(const Item& item, const ResponseSerializer& response_serializer, const Value& id, std::string* response)
+{
+    if (item.id_offset == std::string::npos) {
+        *response = item.response;
+        return;
+    }
+
+    response->assign(item.response, 0, item.id_offset);
+    response_serializer.serializeId(id, response);
+    response->append(item.response, item.id_offset, std::string::npos);
+}
+
+void ResponseCache::erase(Items::iterator it)
+{
+    assert( it != items_.end() );
+    stats_.size -= itemSize(it->first, it->second);
+    --stats_.entries_count;
+    lru_.erase(it->second.lru_position);
+    items_.erase(it);
+}
+
+} // namespace Rpc
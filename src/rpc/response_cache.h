@@ -0,0 +1,118 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace Rpc
+{
+
+class Value;
+class ResponseSerializer;
+
+/*!
+    \brief Version of data which result of cacheable method depends on.
+           Meaning of id and version is defined by method which produces tag and by invalidation predicate.
+*/
+struct CacheTag
+{
+    CacheTag(int id, unsigned int version)
+        : id(id), version(version)
+    {}
+
+    int id;
+    unsigned int version;
+};
+
+typedef std::vector<CacheTag> CacheTags;
+
+/*!
+    \brief Cache of serialized successful responses of methods whose result depends only on params and on tagged data.
+           Key is method name, canonical form of params and frontend(response serializer).
+           Request id is not part of key: response is stored as template and id of concrete request is inserted on lookup.
+           Total size of cached responses is limited, least recently used responses are evicted first.
+           Not thread safe: it is used in player thread only as RPC methods are.
+*/
+class ResponseCache : boost::noncopyable
+{
+public:
+
+    struct Stats
+    {
+        std::size_t hits;
+        std::size_t misses;
+        std::size_t evictions; //!< responses removed to fit memory budget.
+        std::size_t invalidations; //!< responses removed since tagged data have been changed.
+        std::size_t size; //!< total size of cached responses in bytes.
+        std::size_t entries_count;
+    };
+
+    //! \param max_size - memory budget in bytes. Responses larger than budget are not cached.
+    explicit ResponseCache(std::size_t max_size);
+
+    //! Returns key of request: method name and params in canonical form(object members are sorted, no spaces).
+    static std::string makeKey(const Value& root_request);
+
+    /*!
+        \brief Looks up response for request with given key and id.
+        \return false if response is not cached.
+    */
+    bool get(const std::string& key, const ResponseSerializer& response_serializer, const Value& id, std::string* response);
+
+    /*!
+        \brief Serializes successful response and stores it in cache.
+        \param tags - versions of data response depends on.
+    */
+    void put(const std::string& key,
+             const ResponseSerializer& response_serializer,
+             const CacheTags& tags,
+             const Value& root_response,
+             std::string* response);
+
+    /*!
+        \brief Removes responses which depend on changed data.
+        \param is_actual - predicate, returns false if version of tagged data has been changed.
+    */
+    void invalidate(const boost::function<bool (const CacheTag&)>& is_actual);
+
+    std::size_t maxSize() const
+        { return max_size_; }
+
+    const Stats& stats() const
+        { return stats_; }
+
+private:
+
+    typedef std::pair<const ResponseSerializer*, std::string> Key;
+    typedef std::list<Key> LruList; //!< keys of cached responses, most recently used at front.
+
+    struct Item
+    {
+        std::string response; //!< serialized response without id.
+        std::size_t id_offset; //!< position of id in response, std::string::npos if frontend does not send id.
+        CacheTags tags;
+        LruList::iterator lru_position;
+    };
+
+    typedef std::map<Key, Item> Items;
+
+    static std::size_t itemSize(const Key& key, const Item& item)
+        { return key.second.size() + item.response.size() + item.tags.size() * sizeof(CacheTag); }
+
+    static void buildResponse(const Item& item, const ResponseSerializer& response_serializer, const Value& id, std::string* response);
+
+    void erase(Items::iterator it);
+
+    const std::size_t max_size_;
+
+    Items items_;
+    LruList lru_;
+    Stats stats_;
+};
+
+} // namespace Rpc
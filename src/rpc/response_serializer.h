@@ -18,6 +18,49 @@ public:
 
     virtual void serializeFault(const Rpc::Value& root_request, const std::string& error_msg, int error_code, std::string* response) const = 0;
 
+    /*!
+        Serializes results of batch calls as single response.
+        Each item of root_responses array contains id and result or error(object with message and code members).
+    */
+    virtual void serializeBatch(const Rpc::Value& root_responses, std::string* response) const = 0;
+
+    /*!
+        \brief Serializes successful response in form which can be sent in reply to requests with any id(see ResponseCache).
+               Id is not included in template, serializeId() inserts id of concrete request at id_offset position.
+               Default implementation is for protocols which do not send request id back.
+        \param id_offset - position of id in template, std::string::npos if id is not sent.
+        \return false if response can't be used as template.
+    */
+    virtual bool serializeSuccessTemplate(const Rpc::Value& root_response, std::string* response, std::size_t* id_offset) const
+    {
+        serializeSuccess(root_response, response);
+        *id_offset = std::string::npos;
+        return true;
+    }
+
+    //! Appends serialized request id to response. See serializeSuccessTemplate().
+    virtual void serializeId(const Rpc::Value& /*id*/, std::string* /*response*/) const
+        {}
+
+    //! Returns true if frontend can send successful response part by part(see StreamedResponse). Default implementation returns false.
+    virtual bool streamingSupported() const
+        { return false; }
+
+    /*!
+        \brief Serializes successful response whose result member array_name is array which is produced item by item later.
+               Result in root_response does not contain array_name member.
+               Used only if streamingSupported() returns true.
+        \param head - response before the first item of array.
+        \param tail - response after the last item of array.
+    */
+    virtual void serializeStreamedSuccess(const Rpc::Value& /*root_response*/, const std::string& /*array_name*/,
+                                          std::string* /*head*/, std::string* /*tail*/) const
+        {}
+
+    //! Appends item of streamed array. index is position of item in array. See serializeStreamedSuccess().
+    virtual void serializeStreamedItem(const Rpc::Value& /*item*/, std::size_t /*index*/, std::string* /*response*/) const
+        {}
+
     virtual const std::string& mimeType() const = 0;
 
 protected:
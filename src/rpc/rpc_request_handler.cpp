@@ -23,6 +23,30 @@ ModuleLoggerType& logger()
 }
 
 const int kGENERAL_ERROR_CODE = -1;
+const std::size_t kRESPONSE_CACHE_MAX_SIZE = 8 * 1024 * 1024; // enough for many pages of all playlists.
+
+namespace {
+
+Value makeFaultResponse(const Value& root_request, const std::string& error_msg, int error_code)
+{
+    Value root_response;
+    root_response["id"] = root_request.isMember("id") ? root_request["id"] : Value( Value::Null() );
+    Value& error = root_response["error"];
+    error["message"] = error_msg;
+    error["code"] = error_code;
+    return root_response;
+}
+
+} // namespace anonymous
+
+RequestHandler::RequestHandler()
+    :
+    active_response_serializer_(nullptr),
+    active_batch_index_(0),
+    active_streaming_allowed_(false),
+    response_cache_(kRESPONSE_CACHE_MAX_SIZE)
+{
+}
 
 void RequestHandler::addFrontend(std::auto_ptr<Frontend> frontend)
 {
@@ -50,6 +74,35 @@ Method* RequestHandler::getMethodByName(const std::string& name)
     return nullptr;
 }
 
+bool RequestHandler::resultStreamingAllowed() const
+{
+    return    active_streaming_allowed_
+           && !active_batch_
+           && active_response_serializer_ != nullptr
+           && active_response_serializer_->streamingSupported();
+}
+
+void RequestHandler::streamResult(const std::string& array_name, boost::shared_ptr<ResultItemsSource> items_source)
+{
+    assert( resultStreamingAllowed() );
+    assert(items_source);
+    streamed_array_name_ = array_name;
+    streamed_items_source_ = items_source;
+}
+
+bool RequestHandler::getCacheTags(const Value& root_request, CacheTags* tags)
+{
+    if (   !root_request.isMember("method")
+        || root_request["method"].type() != Value::TYPE_STRING
+        )
+    {
+        return false;
+    }
+
+    const Method* method = getMethodByName(root_request["method"]);
+    return method != nullptr && method->getCacheTags(root_request, tags);
+}
+
 void RequestHandler::addMethod(std::auto_ptr<Method> method)
 {
     std::string key( method->name() ); // boost::ptr_map::insert() needs reference to non-constant.
@@ -61,7 +114,8 @@ boost::tribool RequestHandler::handleRequest(const std::string& request_uri,
                                              Http::DelayedResponseSender_ptr delayed_response_sender,
                                              Frontend& frontend,
                                              std::string* response,
-                                             std::string* response_content_type
+                                             std::string* response_content_type,
+                                             StreamedResponse_ptr* streamed_response
                                              )
 {
     assert(response);
@@ -72,6 +126,18 @@ boost::tribool RequestHandler::handleRequest(const std::string& request_uri,
     Value root_request;
     if ( frontend.requestParser().parse(request_uri, request_content, &root_request) ) {
 
+        if (root_request.type() == Value::TYPE_ARRAY) {
+            if (root_request.size() == 0) {
+                frontend.responseSerializer().serializeFault(Value(), "Request parsing error: empty batch", Rpc::REQUEST_PARSING_ERROR, response);
+                return false;
+            }
+            return callBatch(root_request,
+                             delayed_response_sender,
+                             frontend.responseSerializer(),
+                             response
+                             );
+        }
+
         if ( !root_request.isMember("id") ) { // for example xmlrpc does not use request id, so add null value since Rpc methods rely on it.
             root_request["id"] = Value::Null();
         }
@@ -79,7 +145,8 @@ boost::tribool RequestHandler::handleRequest(const std::string& request_uri,
         return callMethod(root_request,
                           delayed_response_sender,
                           frontend.responseSerializer(),
-                          response
+                          response,
+                          streamed_response
                           );
     } else {
         frontend.responseSerializer().serializeFault(root_request, "Request parsing error", Rpc::REQUEST_PARSING_ERROR, response);
@@ -90,50 +157,146 @@ boost::tribool RequestHandler::handleRequest(const std::string& request_uri,
 boost::tribool RequestHandler::callMethod(const Value& root_request,
                                           Http::DelayedResponseSender_ptr delayed_response_sender,
                                           ResponseSerializer& response_serializer,
-                                          std::string* response
+                                          std::string* response,
+                                          StreamedResponse_ptr* streamed_response
                                           )
 {
     assert(response);
 
+    active_delayed_response_sender_ = delayed_response_sender; // save current http request handler ref in weak ptr to use in delayed response.
+    active_response_serializer_ = &response_serializer;
+    active_batch_.reset();
+    active_streaming_allowed_ = streamed_response != nullptr;
+    streamed_items_source_.reset();
+
+    std::string cache_key;
+    CacheTags cache_tags;
+    if ( getCacheTags(root_request, &cache_tags) ) {
+        cache_key = ResponseCache::makeKey(root_request);
+        if ( response_cache_.get(cache_key, response_serializer, root_request["id"], response) ) {
+            return true;
+        }
+    }
+
+    Value root_response;
+    const ResponseType response_type = invokeMethod(root_request, &root_response);
+    active_streaming_allowed_ = false;
+    boost::shared_ptr<ResultItemsSource> items_source;
+    items_source.swap(streamed_items_source_);
+
+    if (response_type == RESPONSE_DELAYED) {
+        return boost::indeterminate; // method execution is delayed, say to http response handler not to send answer immediately.
+    }
+
+    if ( root_response.isMember("error") ) {
+        const Value& error = root_response["error"];
+        response_serializer.serializeFault(root_request, error["message"], error["code"], response);
+        return false;
+    }
+
+    if (items_source) {
+        // result is too large to be kept in memory: caller sends it part by part, it is not cached for the same reason.
+        std::string head, tail;
+        response_serializer.serializeStreamedSuccess(root_response, streamed_array_name_, &head, &tail);
+        streamed_response->reset( new StreamedResponse(response_serializer, items_source, head, tail) );
+        response->clear();
+        return true;
+    }
+
+    try {
+        if ( !cache_key.empty() ) {
+            response_cache_.put(cache_key, response_serializer, cache_tags, root_response, response);
+        } else {
+            response_serializer.serializeSuccess(root_response, response);
+        }
+        return true;
+    } catch (const Exception& e) {
+        response_serializer.serializeFault(root_request, e.message(), e.code(), response);
+        return false;
+    }
+}
+
+boost::tribool RequestHandler::callBatch(Value& root_request,
+                                         Http::DelayedResponseSender_ptr delayed_response_sender,
+                                         ResponseSerializer& response_serializer,
+                                         std::string* response
+                                         )
+{
+    assert(response);
+    assert(root_request.type() == Value::TYPE_ARRAY);
+
+    const std::size_t calls_count = root_request.size();
+    boost::shared_ptr<BatchResponse> batch = boost::make_shared<BatchResponse>(delayed_response_sender, response_serializer, calls_count);
+
+    active_delayed_response_sender_ = delayed_response_sender;
+    active_response_serializer_ = &response_serializer;
+    active_batch_ = batch;
+
+    for (std::size_t i = 0; i != calls_count; ++i) {
+        Value& call_request = root_request[static_cast<int>(i)];
+        if ( call_request.type() == Value::TYPE_OBJECT && !call_request.isMember("id") ) { // notification: call is executed, but result is not returned.
+            batch->setNotification(i);
+            call_request["id"] = Value::Null();
+        }
+
+        active_batch_index_ = i;
+
+        Value root_response;
+        if (invokeMethod(call_request, &root_response) == RESPONSE_DELAYED) {
+            batch->setPending(i);
+        } else {
+            batch->setResult(i, root_response);
+        }
+    }
+
+    active_batch_.reset();
+
+    try {
+        if ( batch->finish(response) ) {
+            return true;
+        }
+        return boost::indeterminate; // batch response will be sent when all delayed calls are complete.
+    } catch (const Exception& e) {
+        response_serializer.serializeFault(Value(), e.message(), e.code(), response);
+        return false;
+    }
+}
+
+ResponseType RequestHandler::invokeMethod(const Value& root_request, Value* root_response)
+{
+    assert(root_response);
+
     try {
         const std::string& method_name = root_request["method"];
         Method* method = getMethodByName(method_name);
         if (method == nullptr) {
-            response_serializer.serializeFault(root_request, method_name + ": method not found", METHOD_NOT_FOUND_ERROR, response);
-            return false;
+            *root_response = makeFaultResponse(root_request, method_name + ": method not found", METHOD_NOT_FOUND_ERROR);
+            return RESPONSE_IMMEDIATE;
         }
         
         { // execute method
         //PROFILE_EXECUTION_TIME( method_name.c_str() );
 
-        active_delayed_response_sender_ = delayed_response_sender; // save current http request handler ref in weak ptr to use in delayed response.
-        active_response_serializer_ = &response_serializer;
-
-        Value root_response;
-        root_response["id"] = root_request["id"]; // currently all methods set id of response, so set it here. Method can set it to null if needed.
-        ResponseType response_type = method->execute(root_request, root_response);
-        if (RESPONSE_DELAYED == response_type) {
-            return boost::indeterminate; // method execution is delayed, say to http response handler not to send answer immediately.
-        } else {
-            assert( root_response.valid() ); ///??? Return empty string if execute() method did not set result.
-            if ( !root_response.valid() ) {
-                root_response = "";
+        (*root_response)["id"] = root_request["id"]; // currently all methods set id of response, so set it here. Method can set it to null if needed.
+        ResponseType response_type = method->execute(root_request, *root_response);
+        if (RESPONSE_IMMEDIATE == response_type) {
+            assert( root_response->valid() ); ///??? Return empty string if execute() method did not set result.
+            if ( !root_response->valid() ) {
+                *root_response = "";
             }
-
-            response_serializer.serializeSuccess(root_response, response);
-            return true;
         }
+        return response_type;
         }
     } catch (const Exception& e) {
-        response_serializer.serializeFault(root_request, e.message(), e.code(), response);
-        return false;
+        *root_response = makeFaultResponse(root_request, e.message(), e.code());
+        return RESPONSE_IMMEDIATE;
     } catch (const std::exception& e) {
         const char* method_name =    root_request.isMember("method") 
                                   && root_request["method"].type() == Rpc::Value::TYPE_STRING ? static_cast<const std::string&>(root_request["method"]).c_str()
                                                                                               : "unknown";
-        BOOST_LOG_SEV(logger(), error) << "RequestHandler::callMethod: call " << method_name << " method error. Reason: " << e.what();
-        response_serializer.serializeFault(root_request, "internal error", Rpc::INTERNAL_ERROR, response);
-        return false;
+        BOOST_LOG_SEV(logger(), error) << "RequestHandler::invokeMethod: call " << method_name << " method error. Reason: " << e.what();
+        *root_response = makeFaultResponse(root_request, "internal error", Rpc::INTERNAL_ERROR);
+        return RESPONSE_IMMEDIATE;
     }
 }
 
@@ -141,6 +304,9 @@ boost::shared_ptr<DelayedResponseSender> RequestHandler::getDelayedResponseSende
 {
     boost::shared_ptr<Http::DelayedResponseSender> ptr = active_delayed_response_sender_.lock();
     if (ptr) {
+        if (active_batch_) {
+            return boost::make_shared<DelayedResponseSender>(ptr, *active_response_serializer_, active_batch_, active_batch_index_);
+        }
         return boost::make_shared<DelayedResponseSender>(ptr, *active_response_serializer_);
     } else {
         return boost::shared_ptr<DelayedResponseSender>();
@@ -148,8 +314,148 @@ boost::shared_ptr<DelayedResponseSender> RequestHandler::getDelayedResponseSende
 }
 
 
+BatchResponse::BatchResponse(Http::DelayedResponseSender_ptr comet_http_response_sender,
+                             const ResponseSerializer& response_serializer,
+                             std::size_t calls_count)
+    :
+    comet_http_response_sender_(comet_http_response_sender),
+    response_serializer_(response_serializer),
+    results_(calls_count),
+    states_(calls_count, CALL_EXECUTING),
+    pending_count_(0),
+    finished_(false)
+{}
+
+void BatchResponse::setNotification(std::size_t index)
+{
+    states_.at(index) = CALL_NOTIFICATION;
+}
+
+void BatchResponse::setPending(std::size_t index)
+{
+    if (states_.at(index) == CALL_EXECUTING) { // result could be already received if method has used delayed sender synchronously.
+        states_[index] = CALL_PENDING;
+        ++pending_count_;
+    }
+}
+
+bool BatchResponse::setResult(std::size_t index, const Value& root_response)
+{
+    switch ( states_.at(index) ) {
+    case CALL_NOTIFICATION:
+        return true; // result of notification is not needed.
+    case CALL_EXECUTING:
+        results_[index] = root_response;
+        states_[index] = CALL_COMPLETE;
+        return true;
+    case CALL_PENDING:
+        results_[index] = root_response;
+        states_[index] = CALL_COMPLETE;
+        --pending_count_;
+        if (finished_ && pending_count_ == 0) {
+            std::string response;
+            serialize(&response);
+            comet_http_response_sender_->send(response, response_serializer_.mimeType());
+        }
+        return true;
+    case CALL_COMPLETE:
+    default:
+        return false; // batch has been sent or call sends many results(subscription through WebSocket), send it separately.
+    }
+}
+
+bool BatchResponse::finish(std::string* response)
+{
+    assert(response);
+    finished_ = true;
+    if (pending_count_ == 0) {
+        serialize(response);
+        return true;
+    }
+    return false;
+}
+
+void BatchResponse::serialize(std::string* response) const
+{
+    Value root_responses;
+    std::size_t results_count = 0;
+    for (std::size_t i = 0, size = states_.size(); i != size; ++i) {
+        if (states_[i] != CALL_NOTIFICATION) {
+            ++results_count;
+        }
+    }
+
+    if (results_count == 0) {
+        response->clear(); // batch of notifications has no response.
+        return;
+    }
+
+    root_responses.setSize(results_count);
+    for (std::size_t i = 0, result_index = 0, size = states_.size(); i != size; ++i) {
+        if (states_[i] != CALL_NOTIFICATION) {
+            root_responses[static_cast<int>(result_index++)] = results_[i];
+        }
+    }
+    response_serializer_.serializeBatch(root_responses, response);
+}
+
+
+SharedResponse::SharedResponse(const Value& result)
+    :
+    result_(result)
+{}
+
+Value SharedResponse::rootResponse(const Value& id) const
+{
+    Value root_response;
+    root_response["id"] = id;
+    root_response["result"] = result_;
+    return root_response;
+}
+
+void SharedResponse::serialize(const ResponseSerializer& response_serializer, const Value& id, std::string* response)
+{
+    assert(response);
+
+    Templates::iterator it = templates_.find(&response_serializer);
+    if ( it == templates_.end() ) {
+        it = templates_.insert( std::make_pair( &response_serializer, Template() ) ).first;
+        Template& item = it->second;
+        item.valid = response_serializer.serializeSuccessTemplate(rootResponse( Value( Value::Null() ) ), &item.response, &item.id_offset);
+    }
+
+    const Template& item = it->second;
+    if (!item.valid) {
+        response_serializer.serializeSuccess(rootResponse(id), response);
+    } else if (item.id_offset == std::string::npos) {
+        *response = item.response;
+    } else {
+        response->assign(item.response, 0, item.id_offset);
+        response_serializer.serializeId(id, response);
+        response->append(item.response, item.id_offset, std::string::npos);
+    }
+}
+
+
+void DelayedResponseSender::sendResponseSuccess(SharedResponse& shared_response, const Value& id)
+{
+    if ( batch_ && batch_->setResult( batch_index_, shared_response.rootResponse(id) ) ) {
+        return;
+    }
+
+    std::string response;
+    shared_response.serialize(response_serializer_, id, &response);
+    comet_http_response_sender_->send(response,
+                                      response_serializer_.mimeType()
+                                      );
+}
+
 void DelayedResponseSender::sendResponseSuccess(const Value& root_response)
 {
+    if ( batch_ && batch_->setResult(batch_index_, root_response) ) {
+        return;
+    }
+
     std::string response;
     response_serializer_.serializeSuccess(root_response, &response);
     comet_http_response_sender_->send(response,
@@ -159,6 +465,10 @@ void DelayedResponseSender::sendResponseSuccess(const Value& root_response)
 
 void DelayedResponseSender::sendResponseFault(const Value& root_request, const std::string& error_msg, int error_code)
 {
+    if ( batch_ && batch_->setResult( batch_index_, makeFaultResponse(root_request, error_msg, error_code) ) ) {
+        return;
+    }
+
     std::string response_string;
     response_serializer_.serializeFault(root_request, error_msg, error_code, &response_string);
     comet_http_response_sender_->send(response_string,
@@ -166,4 +476,14 @@ void DelayedResponseSender::sendResponseFault(const Value& root_request, const s
                                       );
 }
 
+bool DelayedResponseSender::persistent() const
+{
+    return comet_http_response_sender_->persistent();
+}
+
+bool DelayedResponseSender::closed() const
+{
+    return comet_http_response_sender_->closed();
+}
+
 } // namespace XmlRpc
@@ -3,6 +3,7 @@
 #include "stdafx.h"
 #include "rpc/value.h"
 #include "rpc/exception.h"
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 
@@ -69,6 +70,90 @@ void throwObjectAccessException(const char* member_name)
     throw Exception(os.str(), OBJECT_ACCESS_ERROR);
 }
 
+
+static_assert(sizeof(Value::Array) <= sizeof(Value::Object) && std::alignment_of<Value::Array>::value <= std::alignment_of<Value::String>::value
+              && std::alignment_of<Value::Object>::value <= std::alignment_of<Value::String>::value,
+              "Value storage can not hold array or object");
+
+Value::Object::iterator Value::Object::find(const String& name)
+{
+    const auto it = std::lower_bound(members_.begin(), members_.end(), name,
+                                     [](const value_type& member, const String& name) { return member.first < name; }
+                                     );
+    return it != members_.end() && it->first == name ? it : members_.end();
+}
+
+Value::Object::const_iterator Value::Object::find(const String& name) const
+{
+    const auto it = std::lower_bound(members_.begin(), members_.end(), name,
+                                     [](const value_type& member, const String& name) { return member.first < name; }
+                                     );
+    return it != members_.end() && it->first == name ? it : members_.end();
+}
+
+Value& Value::Object::operator[](const String& name)
+{
+    // members are usually added in sorted order, so check the end first.
+    if ( members_.empty() || members_.back().first < name ) {
+        members_.push_back( value_type(name, Value()) );
+        return members_.back().second;
+    }
+
+    const auto it = std::lower_bound(members_.begin(), members_.end(), name,
+                                     [](const value_type& member, const String& name) { return member.first < name; }
+                                     );
+    if (it->first == name) {
+        return it->second;
+    }
+    return members_.insert( it, value_type(name, Value()) )->second;
+}
+
+Value& Value::Object::operator[](String&& name)
+{
+    if ( members_.empty() || members_.back().first < name ) {
+        members_.push_back( value_type(std::move(name), Value()) );
+        return members_.back().second;
+    }
+
+    const auto it = std::lower_bound(members_.begin(), members_.end(), name,
+                                     [](const value_type& member, const String& name) { return member.first < name; }
+                                     );
+    if (it->first == name) {
+        return it->second;
+    }
+    return members_.insert( it, value_type(std::move(name), Value()) )->second;
+}
+
+Value::String& Value::string()
+{
+    return *reinterpret_cast<String*>(&value_.storage_);
+}
+
+const Value::String& Value::string() const
+{
+    return *reinterpret_cast<const String*>(&value_.storage_);
+}
+
+Value::Array& Value::array()
+{
+    return *reinterpret_cast<Array*>(&value_.storage_);
+}
+
+const Value::Array& Value::array() const
+{
+    return *reinterpret_cast<const Array*>(&value_.storage_);
+}
+
+Value::Object& Value::object()
+{
+    return *reinterpret_cast<Object*>(&value_.storage_);
+}
+
+const Value::Object& Value::object() const
+{
+    return *reinterpret_cast<const Object*>(&value_.storage_);
+}
+
 Value::Value()
     :
     type_(TYPE_NONE)
@@ -111,46 +196,49 @@ Value::Value(const char* value)
     :
     type_(TYPE_STRING)
 {
-    value_.string_ = new String(value);
+    new (&value_.storage_) String(value);
 }
 
 Value::Value(const String& value)
     :
     type_(TYPE_STRING)
 {
-    value_.string_ = new String(value);
+    new (&value_.storage_) String(value);
 }
 
 Value::Value(const Value::Array& value)
     :
     type_(TYPE_ARRAY)
 {
-    value_.array_ = new Array(value);
+    new (&value_.storage_) Array(value);
 }
 
 Value::Value(const Value::Object& value)
     :
     type_(TYPE_OBJECT)
 {
-    value_.object_ = new Object(value);
+    new (&value_.storage_) Object(value);
 }
 
-Value::String* copyString(const Value::String* rhs)
+Value::Value(Value::String&& value)
+    :
+    type_(TYPE_STRING)
 {
-    assert(rhs);
-    return new Value::String(*rhs);
+    new (&value_.storage_) String( std::move(value) );
 }
 
-Value::Array* copyArray(const Value::Array* rhs)
+Value::Value(Value::Array&& value)
+    :
+    type_(TYPE_ARRAY)
 {
-    assert(rhs);
-    return new Value::Array(*rhs);
+    new (&value_.storage_) Array( std::move(value) );
 }
 
-Value::Object* copyObject(const Value::Object* rhs)
+Value::Value(Value::Object&& value)
+    :
+    type_(TYPE_OBJECT)
 {
-    assert(rhs);
-    return new Value::Object(*rhs);
+    new (&value_.storage_) Object( std::move(value) );
 }
 
 Value::Value(const Value& rhs)
@@ -174,13 +262,13 @@ Value::Value(const Value& rhs)
         value_.double_ = rhs.value_.double_;
         break;
     case TYPE_STRING:
-        value_.string_ = copyString(rhs.value_.string_);
+        new (&value_.storage_) String( rhs.string() );
         break;
     case TYPE_ARRAY:
-        value_.array_ = copyArray(rhs.value_.array_);
+        new (&value_.storage_) Array( rhs.array() );
         break;
     case TYPE_OBJECT:
-        value_.object_ = copyObject(rhs.value_.object_);
+        new (&value_.storage_) Object( rhs.object() );
         break;
     default:
         handleUnknownType();
@@ -188,12 +276,11 @@ Value::Value(const Value& rhs)
     }
 }
 
-Value::Value(Value&& o) noexcept
+Value::Value(Value&& rhs) noexcept
     :
-    type_(o.type_),
-    value_(std::move(o.value_))
+    type_(TYPE_NONE)
 {
-    o.type_ = TYPE_NONE;
+    moveFrom(rhs);
 }
 
 Value::~Value()
@@ -201,6 +288,28 @@ Value::~Value()
     reset();
 }
 
+void Value::moveFrom(Value& rhs)
+{
+    assert(type_ == TYPE_NONE);
+
+    switch (rhs.type_) {
+    case TYPE_STRING:
+        new (&value_.storage_) String( std::move( rhs.string() ) );
+        break;
+    case TYPE_ARRAY:
+        new (&value_.storage_) Array( std::move( rhs.array() ) );
+        break;
+    case TYPE_OBJECT:
+        new (&value_.storage_) Object( std::move( rhs.object() ) );
+        break;
+    default:
+        value_ = rhs.value_;
+        break;
+    }
+    type_ = rhs.type_;
+    rhs.reset();
+}
+
 void Value::reset()
 {
     switch (type_) {
@@ -212,13 +321,13 @@ void Value::reset()
     case TYPE_DOUBLE:
         break;
     case TYPE_STRING:
-        delete value_.string_;
+        string().~String();
         break;
     case TYPE_ARRAY:
-        delete value_.array_;
+        array().~Array();
         break;
     case TYPE_OBJECT:
-        delete value_.object_;
+        object().~Object();
         break;
     default:
         handleUnknownType();
@@ -230,81 +339,116 @@ void Value::reset()
 
 void Value::swap(Value& rhs)
 {
-    using std::swap;
-    swap(type_, rhs.type_);
-    swap(value_, rhs.value_);
+    if (this != &rhs) {
+        Value tmp( std::move(rhs) );
+        rhs.moveFrom(*this);
+        moveFrom(tmp);
+    }
 }
 
 Value& Value::operator=(const Value& rhs)
 {
-    Value(rhs).swap(*this);
+    Value tmp(rhs);
+    reset();
+    moveFrom(tmp);
     return *this;
 }
 
 Value& Value::operator=(Value&& rhs)
 {
-    if (this != &rhs)
-    {
-        reset();
-        type_ = rhs.type_;
-        value_ = std::move(rhs.value_);
-        rhs.type_ = TYPE_NONE;
+    if (this != &rhs) {
+        if (type_ == TYPE_ARRAY || type_ == TYPE_OBJECT) {
+            Value tmp( std::move(rhs) ); // rhs can be part of this value, so move it out before destruction of current content.
+            reset();
+            moveFrom(tmp);
+        } else {
+            reset();
+            moveFrom(rhs);
+        }
     }
     return *this;
 }
 
-Value& Value::operator=(const Value::Null& value)
+Value& Value::operator=(const Value::Null&)
 {
-    Value(value).swap(*this);
+    reset();
+    type_ = TYPE_NULL;
     return *this;
 }
 
 Value& Value::operator=(bool value)
 {
-    Value(value).swap(*this);
+    reset();
+    value_.bool_ = value;
+    type_ = TYPE_BOOL;
     return *this;
 }
 
 Value& Value::operator=(int value)
 {
-    Value(value).swap(*this);
+    reset();
+    value_.int_ = value;
+    type_ = TYPE_INT;
     return *this;
 }
 
 Value& Value::operator=(unsigned int value)
 {
-    Value(value).swap(*this);
+    reset();
+    value_.uint_ = value;
+    type_ = TYPE_UINT;
     return *this;
 }
 
 Value& Value::operator=(double value)
 {
-    Value(value).swap(*this);
+    reset();
+    value_.double_ = value;
+    type_ = TYPE_DOUBLE;
     return *this;
 }
 
 Value& Value::operator=(const char* value)
 {
-    Value(value).swap(*this);
-    return *this;
+    if (type_ == TYPE_STRING) {
+        string() = value; // reuse string buffer.
+        return *this;
+    }
+    return *this = Value(value);
 }
 
 Value& Value::operator=(const Value::String& value)
 {
-    Value(value).swap(*this);
-    return *this;
+    if (type_ == TYPE_STRING) {
+        string() = value;
+        return *this;
+    }
+    return *this = Value(value);
 }
 
 Value& Value::operator=(const Value::Array& value)
 {
-    Value(value).swap(*this);
-    return *this;
+    return *this = Value(value);
 }
 
 Value& Value::operator=(const Value::Object& value)
 {
-    Value(value).swap(*this);
-    return *this;
+    return *this = Value(value);
+}
+
+Value& Value::operator=(Value::String&& value)
+{
+    return *this = Value( std::move(value) );
+}
+
+Value& Value::operator=(Value::Array&& value)
+{
+    return *this = Value( std::move(value) );
+}
+
+Value& Value::operator=(Value::Object&& value)
+{
+    return *this = Value( std::move(value) );
 }
 
 void Value::ensureTypeIsNoneOrEquals(TYPE type)
@@ -314,29 +458,34 @@ void Value::ensureTypeIsNoneOrEquals(TYPE type)
     } else if (type_ == TYPE_NONE) {
         switch (type) {
         case TYPE_NONE:
-            Value().swap(*this);
             break;
         case TYPE_NULL:
-            Value( Null() ).swap(*this);
+            type_ = TYPE_NULL;
             break;
         case TYPE_BOOL:
-            Value(false).swap(*this);
+            value_.bool_ = false;
+            type_ = TYPE_BOOL;
             break;
         case TYPE_INT:
         case TYPE_UINT:
-            Value(0).swap(*this);
+            value_.int_ = 0;
+            type_ = TYPE_INT;
             break;
         case TYPE_DOUBLE:
-            Value(0.0).swap(*this);
+            value_.double_ = 0.0;
+            type_ = TYPE_DOUBLE;
             break;
         case TYPE_STRING:
-            Value( String() ).swap(*this);
+            new (&value_.storage_) String();
+            type_ = TYPE_STRING;
             break;
         case TYPE_ARRAY:
-            Value( Array() ).swap(*this);
+            new (&value_.storage_) Array();
+            type_ = TYPE_ARRAY;
             break;
         case TYPE_OBJECT:
-            Value( Object() ).swap(*this);
+            new (&value_.storage_) Object();
+            type_ = TYPE_OBJECT;
             break;
         default:
             handleUnknownType();
@@ -405,22 +554,19 @@ Value::operator double() const
 Value::operator String&()
 {
     ensureTypeIsNoneOrEquals(TYPE_STRING);
-    assert(value_.string_);
-    return *value_.string_;
+    return string();
 }
 
 Value::operator String const&() const
 {
     assertTypeEquals(TYPE_STRING);
-    assert(value_.string_);
-    return *value_.string_;
+    return string();
 }
 
 bool Value::operator==(const char* value) const
 {
     if (type_ == TYPE_STRING) {
-        assert(value_.string_);
-        return *value_.string_ == value;
+        return string() == value;
     }
     return false;
 }
@@ -428,8 +574,7 @@ bool Value::operator==(const char* value) const
 bool Value::operator==(const String& value) const
 {
     if (type_ == TYPE_STRING) {
-        assert(value_.string_);
-        return *value_.string_ == value;
+        return string() == value;
     }
     return false;
 }
@@ -437,8 +582,7 @@ bool Value::operator==(const String& value) const
 void Value::assertIndexIsInRange(int index) const
 {
     assertTypeEquals(TYPE_ARRAY);
-    assert(value_.array_);
-    const Array& array = *value_.array_;
+    const Array& array = this->array();
     if (index < 0 || (size_t)index >= array.size() ) {
         std::ostringstream os;
         os << "array index out of bound: array size " << array.size() << ", index " << index;
@@ -454,22 +598,22 @@ Value& Value::operator[](int index)
         setSize(1);
     }
     assertIndexIsInRange(index);
-    return (*value_.array_)[index];
+    return array()[index];
 }
 
 const Value& Value::operator[](int index) const
 {
     assertIndexIsInRange(index);
-    return (*value_.array_)[index];
+    return array()[index];
 }
 
 const size_t Value::size() const
 {
     switch (type_) {
     case TYPE_ARRAY:
-        return value_.array_->size();
+        return array().size();
     case TYPE_OBJECT:
-        return value_.object_->size();
+        return object().size();
     default:
         break;
     }
@@ -482,16 +626,14 @@ const size_t Value::size() const
 void Value::setSize(size_t size)
 {
     ensureTypeIsNoneOrEquals(TYPE_ARRAY);
-    assert(value_.array_);
-    Array& array = *value_.array_;
-    array.resize(size);
+    array().resize(size);
 }
 
 const Value* Value::lookup(const Value::String& name) const
 {
     assert(type_ == TYPE_OBJECT);
 
-    const Object& object = *value_.object_;
+    const Object& object = this->object();
     const auto it = object.find(name);
     if ( it != object.end() ) {
         return &it->second;
@@ -502,8 +644,7 @@ const Value* Value::lookup(const Value::String& name) const
 Value& Value::operator[](const String& name)
 {
     ensureTypeIsNoneOrEquals(TYPE_OBJECT);
-    Object& object = *value_.object_;
-    return object[name];
+    return object()[name];
 }
 
 const Value& Value::operator[](const String& name) const
@@ -518,26 +659,38 @@ const Value& Value::operator[](const String& name) const
 
 Value& Value::operator[](const char* name)
 {
-    // till I will find how to perform efficient search by char* in map<std::string> this function will create temp string object.
+    // till I will find how to perform efficient search by char* in sorted members this function will create temp string object.
     return operator[]( String(name) );
 }
 
 const Value& Value::operator[](const char* name) const
 {
-    // till I will find how to perform efficient search by char* in map<std::string> this function will create temp string object.
+    // till I will find how to perform efficient search by char* in sorted members this function will create temp string object.
     return operator[]( String(name) );
 }
 
 Value::Object::const_iterator Value::getObjectMembersBegin() const
 {
     assertTypeEquals(TYPE_OBJECT);
-    return value_.object_->begin();
+    return object().begin();
 }
 
 Value::Object::const_iterator Value::getObjectMembersEnd() const
 {
     assertTypeEquals(TYPE_OBJECT);
-    return value_.object_->end();
+    return object().end();
+}
+
+Value::Array::const_iterator Value::getArrayItemsBegin() const
+{
+    assertTypeEquals(TYPE_ARRAY);
+    return array().begin();
+}
+
+Value::Array::const_iterator Value::getArrayItemsEnd() const
+{
+    assertTypeEquals(TYPE_ARRAY);
+    return array().end();
 }
 
 bool Value::isMember(const String& name) const
@@ -550,7 +703,7 @@ bool Value::isMember(const String& name) const
 
 bool Value::isMember(const char* name) const
 {
-    // till I will find how to perform efficient search by char* in map<std::string> this function will create temp string object.
+    // till I will find how to perform efficient search by char* in sorted members this function will create temp string object.
     return isMember( String(name) );
 }
 
@@ -577,12 +730,12 @@ std::ostream& Value::toStream(std::ostream& os) const
         os << value_.double_;
         break;
     case TYPE_STRING:
-        os << *value_.string_;
+        os << string();
         break;
     case TYPE_ARRAY:
         {
         os << '[';
-        const Array& array = *value_.array_;
+        const Array& array = this->array();
         for (auto begin = array.begin(), end = array.end(),
                   it = begin;
                   it != end;
@@ -600,7 +753,7 @@ std::ostream& Value::toStream(std::ostream& os) const
     case TYPE_OBJECT:
         {
         os << '{';
-        const Object& object = *value_.object_;
+        const Object& object = this->object();
         for (auto begin = object.begin(), end = object.end(),
                   it = begin;
                   it != end;
@@ -0,0 +1,59 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "rpc/streamed_response.h"
+#include "rpc/response_serializer.h"
+#include "rpc/value.h"
+
+namespace Rpc
+{
+
+StreamedResponse::StreamedResponse(const ResponseSerializer& response_serializer,
+                                   boost::shared_ptr<ResultItemsSource> items_source,
+                                   const std::string& head,
+                                   const std::string& tail)
+    :
+    response_serializer_(response_serializer),
+    items_source_(items_source),
+    head_(head),
+    tail_(tail),
+    items_count_(0),
+    head_sent_(false)
+{
+    assert(items_source_);
+}
+
+bool StreamedResponse::readPart(std::size_t max_size, std::string* part)
+{
+    assert(part);
+    assert(items_source_);
+
+    part->clear();
+    if (!head_sent_) {
+        part->swap(head_);
+        head_sent_ = true;
+    } else {
+        items_source_->resume();
+    }
+
+    Value item;
+    try {
+        while (part->size() < max_size) {
+            if ( !items_source_->nextItem(&item) ) {
+                part->append(tail_);
+                items_source_.reset(); // release source resources as soon as possible.
+                return false;
+            }
+            response_serializer_.serializeStreamedItem(item, items_count_, part);
+            ++items_count_;
+        }
+    } catch (...) {
+        items_source_->suspend();
+        throw;
+    }
+
+    items_source_->suspend(); // next part can be requested much later, or never if client disconnects.
+    return true;
+}
+
+} // namespace Rpc
@@ -0,0 +1,88 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace Rpc
+{
+
+class Value;
+class ResponseSerializer;
+
+/*!
+    \brief Source of items of large result array. Items are produced one by one while response is being sent,
+           so whole array is never kept in memory.
+           Used in player thread only as RPC methods are. The only exception is destruction: if client disconnects
+           before the last part is sent, source is destroyed in connection's thread, so it must not hold player's resources between parts.
+*/
+class ResultItemsSource : boost::noncopyable
+{
+public:
+
+    virtual ~ResultItemsSource() {}
+
+    /*!
+        \brief Fills next item of array.
+        \return false if there are no more items.
+        \throw std::exception if item can't be produced. Response is aborted in this case.
+    */
+    virtual bool nextItem(Value* item) = 0;
+
+    /*!
+        \brief Called before each part of response except the first one is produced.
+               Player could change data since previous part, source throws std::exception if it can't continue consistently.
+    */
+    virtual void resume()
+        {}
+
+    /*!
+        \brief Called after each part of response except the last one is produced.
+               Source releases resources which must not be held until next part(sqlite statements, etc.), see resume().
+    */
+    virtual void suspend()
+        {}
+};
+
+/*!
+    \brief Successful response whose result contains array produced by ResultItemsSource.
+           Response is serialized part by part: head(id and other result members), array items, tail.
+           Part size is bounded, so memory usage does not depend on count of items.
+*/
+class StreamedResponse : boost::noncopyable
+{
+public:
+
+    /*!
+        \param head - serialized response before the first item of array.
+        \param tail - serialized response after the last item of array.
+        See ResponseSerializer::serializeStreamedSuccess().
+    */
+    StreamedResponse(const ResponseSerializer& response_serializer,
+                     boost::shared_ptr<ResultItemsSource> items_source,
+                     const std::string& head,
+                     const std::string& tail);
+
+    /*!
+        \brief Replaces content of part with next part of response. Part is not smaller than max_size bytes except the last one,
+               it exceeds max_size by one item at most.
+        \return false if part is the last one.
+        \throw std::exception if items source fails.
+    */
+    bool readPart(std::size_t max_size, std::string* part);
+
+private:
+
+    const ResponseSerializer& response_serializer_;
+    boost::shared_ptr<ResultItemsSource> items_source_;
+    std::string head_;
+    std::string tail_;
+    std::size_t items_count_; //!< count of items which have been serialized already.
+    bool head_sent_;
+};
+
+typedef boost::shared_ptr<StreamedResponse> StreamedResponse_ptr;
+
+} // namespace Rpc
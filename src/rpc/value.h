@@ -4,7 +4,8 @@
 
 #include <iosfwd>
 #include <string>
-#include <map>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace Rpc
@@ -12,6 +13,9 @@ namespace Rpc
 
 /*  Represents "interception" of XmlRpc value and JsonRpc value.
     This means that we can not use Base64 and DateTime types from XmlRpc.
+
+    Strings, arrays and objects are stored inside value itself(short strings do not allocate memory at all),
+    so building of large results does not allocate node for each value.
 */
 class Value
 {
@@ -31,9 +35,54 @@ public:
 
     typedef std::string String;
     typedef std::vector<Value> Array;
-    typedef std::map<std::string, Value> Object;
     struct Null {};
 
+    /*!
+        \brief Object members are stored in vector sorted by name: lookup is binary search, iteration is sequential memory access.
+               Interface is subset of std::map one.
+               Note: unlike std::map references to members are invalidated when new member is added.
+    */
+    class Object
+    {
+    public:
+
+        typedef std::pair<String, Value> value_type;
+        typedef std::vector<value_type> Members;
+        typedef Members::iterator iterator;
+        typedef Members::const_iterator const_iterator;
+
+        iterator begin()
+            { return members_.begin(); }
+        iterator end()
+            { return members_.end(); }
+        const_iterator begin() const
+            { return members_.begin(); }
+        const_iterator end() const
+            { return members_.end(); }
+
+        size_t size() const
+            { return members_.size(); }
+        bool empty() const
+            { return members_.empty(); }
+
+        void reserve(size_t size)
+            { members_.reserve(size); }
+
+        iterator find(const String& name);
+        const_iterator find(const String& name) const;
+
+        //! Returns member with specified name, adds none value if there is no such member.
+        Value& operator[](const String& name);
+        Value& operator[](String&& name);
+
+        void swap(Object& rhs)
+            { members_.swap(rhs.members_); }
+
+    private:
+
+        Members members_;
+    };
+
     Value();
     Value(const Value& rhs);
     Value(Value&& rhs) noexcept;
@@ -46,6 +95,9 @@ public:
     explicit Value(const String& value);
     explicit Value(const Array& value);
     explicit Value(const Object& value);
+    explicit Value(String&& value);
+    explicit Value(Array&& value);
+    explicit Value(Object&& value);
     ~Value();
 
     Value& operator=(const Value& rhs);
@@ -59,6 +111,9 @@ public:
     Value& operator=(const String& value);
     Value& operator=(const Array& value);
     Value& operator=(const Object& value);
+    Value& operator=(String&& value);
+    Value& operator=(Array&& value);
+    Value& operator=(Object&& value);
 
     operator bool&();               // throws Exception
     operator bool() const;          // throws Exception
@@ -88,6 +143,9 @@ public:
     Object::const_iterator getObjectMembersBegin() const;
     Object::const_iterator getObjectMembersEnd() const;
 
+    Array::const_iterator getArrayItemsBegin() const;
+    Array::const_iterator getArrayItemsEnd() const;
+
     bool isMember(const String& name) const;
     bool isMember(const char* name) const;
 
@@ -112,6 +170,20 @@ private:
     // does not perform check that current type is Object, caller must check it otself.
     const Value* lookup(const String& name) const;
 
+    // move content of rhs to this value which must be empty, rhs becomes none.
+    void moveFrom(Value& rhs);
+
+    // access to content constructed in storage_. Caller must check type.
+    String& string();
+    const String& string() const;
+    Array& array();
+    const Array& array() const;
+    Object& object();
+    const Object& object() const;
+
+    static const size_t kStorageSize = sizeof(String) > sizeof(Object) ? sizeof(String) : sizeof(Object); // Array has the same size as Object.
+    typedef std::aligned_storage< kStorageSize, std::alignment_of<String>::value >::type Storage;
+
     TYPE type_;
 
     union Value_ {
@@ -119,9 +191,7 @@ private:
         int int_;
         unsigned int uint_;
         double double_;
-        String* string_;
-        Array* array_;
-        Object* object_;
+        Storage storage_; // String, Array or Object constructed in place.
     };
 
     Value_ value_;
@@ -11,6 +11,9 @@ namespace Http {
 namespace UploadTrack
 {
 
+//! Returns extensions of track files supported by player, like L".mp3". Uses player API, so must be called in player thread.
+std::vector<std::wstring> getSupportedTrackExtensions(AIMPPlayer::AIMPManager& aimp_manager);
+
 class RequestHandler : boost::noncopyable
 {
 public:
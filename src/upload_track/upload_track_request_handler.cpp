@@ -24,7 +24,6 @@ namespace fs = boost::filesystem;
 
 void fill_reply_disabled(Http::Reply& rep);
 PlaylistID getPlaylistID(const std::string& uri);
-bool fileTypeSupported(const std::wstring& ext_to_check, AIMPPlayer::AIMPManager& aimp_manager);
 
 const std::string kPlaylistIDTag("/playlist_id/");
 
@@ -50,20 +49,37 @@ bool RequestHandler::handle_request(const Http::Request& req, Http::Reply& rep)
         };
         ON_BLOCK_EXIT(unlock_playlist, playlist_id);
 
-        for (auto field_it : req.mpfd_parser->GetFieldsMap()) {
+        aimp_manager_.getPlaylistCRC32(playlist_id); // throws if playlist does not exist.
+
+        // Received files are kept under temporary names and are removed with parser, so rejected request leaves nothing in upload dir.
+        // Check all parts before the first file is moved to its final name.
+        const auto fields = req.mpfd_parser->GetFieldsMap();
+        for (auto field_it : fields) {
+            MPFD::Field& field = *field_it.second;
+            if (field.GetType() == MPFD::Field::FileType && !field.IsIgnored()) {
+                field.GetDestinationFileName(); // throws if name is invalid.
+            }
+        }
+
+        for (auto field_it : fields) {
             const MPFD::Field& field_const = *field_it.second;
             MPFD::Field& field = const_cast<MPFD::Field&>(field_const);
 
             switch (field.GetType()) {
             case MPFD::Field::FileType:
                 {
-                const std::wstring filename = StringEncoding::utf8_to_utf16( field.GetFileName() );
-                const fs::wpath path = fs::path(field.GetTempFileName()).parent_path() / filename;
-                if (!fileTypeSupported(path.extension().native(), aimp_manager_)) {
-                    continue;
+                if ( field.IsIgnored() ) {
+                    continue; // parser has skipped file of unsupported type.
+                }
+                field.MoveToDestinationFile();
+                const fs::wpath path = field.GetFilePath();
+                try {
+                    aimp_manager_.addFileToPlaylist(path, playlist_id);
+                } catch (...) {
+                    boost::system::error_code ignored_ec;
+                    fs::remove(path, ignored_ec); // file is not used by player.
+                    throw;
                 }
-                fs::copy_file(field.GetTempFileName(), path, fs::copy_option::overwrite_if_exists); // can't use rename here since parser will close file in Field's dtor.
-                aimp_manager_.addFileToPlaylist(path, playlist_id);
                 // we should not erase file since AIMP will use it.
                 //fs::remove(path);
                 break;
@@ -88,31 +104,28 @@ bool RequestHandler::handle_request(const Http::Request& req, Http::Reply& rep)
     return true;
 }
 
-bool fileTypeSupported(const std::wstring& ext_to_check, AIMPPlayer::AIMPManager& aimp_manager)
+std::vector<std::wstring> getSupportedTrackExtensions(AIMPPlayer::AIMPManager& aimp_manager)
 {
-    static std::vector<std::wstring> exts;
+    std::vector<std::wstring> exts;
 
-    if (exts.empty()) {
-    #pragma warning (push, 3)
-        std::wstring exts_str;
+#pragma warning (push, 3)
+    std::wstring exts_str;
 
-        if (IPlayerSupportedFormatsGetter* supported_formats_getter = dynamic_cast<IPlayerSupportedFormatsGetter*>(&aimp_manager)) {
-            exts_str = supported_formats_getter->supportedTrackExtentions();
-        } else {
-            exts_str = L"*.aiff;*.aif;*.mp3;*.mp2;*.mp1;*.ogg;*.oga;*.wav;*.umx;*.mod;*.mo3;*.it;*.s3m;*.mtm;*.xm;*.aac;*.m4a;*.m4b;*.mp4;*.ac3;*.ape;*.mac;*.flac;*.fla;*.midi;*.mid;*.rmi;*.kar;*.mpc;*.mp+;*.mpp;*.opus;*.spx;*.tta;*.wma;*.wv;*.ofr;*.ofs;*.tak;*.cda;"; // got from aimp3.
-        }
-        
-        boost::split(exts, exts_str,
-                     [](std::wstring::value_type c) { return c == L';'; }
-                     );
-    #pragma warning (pop)
-        for (auto& ext : exts) {
-            ext.erase(0, 1); // remove '*'
-        }
+    if (IPlayerSupportedFormatsGetter* supported_formats_getter = dynamic_cast<IPlayerSupportedFormatsGetter*>(&aimp_manager)) {
+        exts_str = supported_formats_getter->supportedTrackExtentions();
+    } else {
+        exts_str = L"*.aiff;*.aif;*.mp3;*.mp2;*.mp1;*.ogg;*.oga;*.wav;*.umx;*.mod;*.mo3;*.it;*.s3m;*.mtm;*.xm;*.aac;*.m4a;*.m4b;*.mp4;*.ac3;*.ape;*.mac;*.flac;*.fla;*.midi;*.mid;*.rmi;*.kar;*.mpc;*.mp+;*.mpp;*.opus;*.spx;*.tta;*.wma;*.wv;*.ofr;*.ofs;*.tak;*.cda;"; // got from aimp3.
+    }
+    
+    boost::split(exts, exts_str,
+                 [](std::wstring::value_type c) { return c == L';'; }
+                 );
+#pragma warning (pop)
+    for (auto& ext : exts) {
+        ext.erase(0, 1); // remove '*'
     }
-    return exts.end() != std::find_if(exts.begin(), exts.end(),
-                                      [ext_to_check](const std::wstring& ext) { return ext == ext_to_check; }
-                                      );
+    exts.erase(std::remove(exts.begin(), exts.end(), std::wstring()), exts.end()); // trailing ';' gives empty item.
+    return exts;
 }
 
 void fill_reply_disabled(Http::Reply& rep)
@@ -0,0 +1,86 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#include "stdafx.h"
+#include "utils/sqlite_stmt_cache.h"
+#include "utils/sqlite_util.h"
+
+namespace Utilities
+{
+
+StmtCache::StmtCache(sqlite3* db)
+    :
+    db_(db)
+{
+    assert(db_);
+}
+
+StmtCache::~StmtCache()
+{
+    for (auto& query_entry : entries_) {
+        for (sqlite3_stmt* stmt : query_entry.second.idle_stmts) {
+            sqlite3_finalize(stmt);
+        }
+    }
+}
+
+StmtCacheStats StmtCache::stats() const
+{
+    StmtCacheStats stats = stats_;
+    stats.cached_queries = entries_.size();
+    return stats;
+}
+
+sqlite3_stmt* StmtCache::acquire(const std::string& query, Entry** entry)
+{
+    assert(entry);
+
+    Entries::iterator it = entries_.find(query);
+    if ( it == entries_.end() && entries_.size() < kMAX_CACHED_QUERIES ) {
+        it = entries_.insert( std::make_pair( query, Entry() ) ).first;
+    }
+
+    if ( it == entries_.end() ) {
+        *entry = nullptr;
+        ++stats_.uncached;
+        return createStmt(db_, query);
+    }
+
+    *entry = &it->second;
+    std::vector<sqlite3_stmt*>& idle_stmts = it->second.idle_stmts;
+    if ( !idle_stmts.empty() ) {
+        sqlite3_stmt* stmt = idle_stmts.back();
+        idle_stmts.pop_back();
+        ++stats_.hits;
+        return stmt;
+    }
+
+    ++stats_.misses;
+    return createStmt(db_, query);
+}
+
+void StmtCache::release(Entry* entry, sqlite3_stmt* stmt)
+{
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    if (entry) {
+        entry->idle_stmts.push_back(stmt);
+    } else {
+        sqlite3_finalize(stmt);
+    }
+}
+
+StmtCache::Lease::Lease(StmtCache& cache, const std::string& query)
+    :
+    cache_(cache),
+    entry_(nullptr),
+    stmt_( cache.acquire(query, &entry_) )
+{
+}
+
+StmtCache::Lease::~Lease()
+{
+    cache_.release(entry_, stmt_);
+}
+
+} // namespace Utilities
@@ -0,0 +1,100 @@
+// Copyright (c) 2014, Alexey Ivanov
+
+#pragma once
+
+#include "sqlite/sqlite.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+namespace Utilities
+{
+
+//! Counters of StmtCache usage.
+struct StmtCacheStats
+{
+    StmtCacheStats()
+        : hits(0), misses(0), uncached(0), cached_queries(0)
+    {}
+
+    std::size_t hits;           //!< statements taken from cache.
+    std::size_t misses;         //!< statements compiled by cache.
+    std::size_t uncached;       //!< statements finalized on return since cache is full.
+    std::size_t cached_queries; //!< count of distinct queries in cache.
+};
+
+/*!
+    \brief Cache of prepared statements of single database keyed by query text.
+           Hot queries of playlist database are executed on each RPC call and on each playlist reload,
+           cache compiles them once and reuses compiled statements.
+           Statement is taken from cache by Lease object which returns it to cache on destruction
+           after reset and clearing of bindings, so next user gets statement in initial state.
+           Same query can be leased several times at once: each concurrent lease gets its own statement.
+           Queries must use parameters instead of values concatenated into text, otherwise each value gets its own cache entry.
+           Statements are compiled by sqlite3_prepare_v2, so they are recompiled by sqlite automatically after schema changes.
+           Not thread safe: it is used in player thread only like database itself.
+
+    Usage example:
+        StmtCache::Lease stmt(stmt_cache, "SELECT COUNT(*) FROM PlaylistsEntries WHERE playlist_id=?");
+        sqlite3_bind_int(stmt, 1, playlist_id);
+        sqlite3_step(stmt);
+*/
+class StmtCache : boost::noncopyable
+{
+    struct Entry;
+
+public:
+
+    explicit StmtCache(sqlite3* db);
+
+    //! Finalizes all cached statements. All leases must be returned before, database must be closed after.
+    ~StmtCache();
+
+    sqlite3* db() const
+        { return db_; }
+
+    StmtCacheStats stats() const;
+
+    //! Compiled statement of query taken from cache for scope of lease.
+    class Lease : boost::noncopyable
+    {
+    public:
+
+        Lease(StmtCache& cache, const std::string& query); // throws std::runtime_error
+        ~Lease();
+
+        sqlite3_stmt* get() const
+            { return stmt_; }
+
+        operator sqlite3_stmt*() const
+            { return stmt_; }
+
+    private:
+
+        StmtCache& cache_;
+        Entry* entry_; //!< nullptr if statement is not cached.
+        sqlite3_stmt* stmt_;
+    };
+
+private:
+
+    struct Entry
+    {
+        std::vector<sqlite3_stmt*> idle_stmts; //!< statements which are not leased at the moment.
+    };
+
+    typedef std::map<std::string, Entry> Entries;
+
+    //! Queries over limit are compiled on each lease: it protects from unlimited growth if query with inlined values is leased.
+    static const std::size_t kMAX_CACHED_QUERIES = 64;
+
+    sqlite3_stmt* acquire(const std::string& query, Entry** entry); // throws std::runtime_error
+    void release(Entry* entry, sqlite3_stmt* stmt);
+
+    sqlite3* const db_;
+    Entries entries_;
+    StmtCacheStats stats_;
+};
+
+} // namespace Utilities
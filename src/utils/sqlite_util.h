@@ -4,6 +4,7 @@
 #include "util.h"
 #include "scope_guard.h"
 #include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
 #include <list>
 
 namespace Utilities {
@@ -12,14 +13,14 @@ namespace Utilities {
 inline sqlite3_stmt* createStmt(sqlite3* db, const std::string& query) // throws std::runtime_error
 {
     sqlite3_stmt* stmt = nullptr;
-    int rc_db = sqlite3_prepare( db,
-                                 query.c_str(),
-                                 query.length() + 1, // If the caller knows that the supplied string is nul-terminated, then there is a small performance advantage to be gained by passing an nByte parameter that is equal to the number of bytes in the input string including the nul-terminator bytes as this saves SQLite from having to make a copy of the input string.
-                                 &stmt,
-                                 nullptr  // Pointer to unused portion of stmt
-                                );
+    int rc_db = sqlite3_prepare_v2( db,
+                                    query.c_str(),
+                                    query.length() + 1, // If the caller knows that the supplied string is nul-terminated, then there is a small performance advantage to be gained by passing an nByte parameter that is equal to the number of bytes in the input string including the nul-terminator bytes as this saves SQLite from having to make a copy of the input string.
+                                    &stmt,
+                                    nullptr  // Pointer to unused portion of stmt
+                                   );
     if (SQLITE_OK != rc_db) {
-        const std::string msg = MakeString() << "sqlite3_prepare() error "
+        const std::string msg = MakeString() << "sqlite3_prepare_v2() error "
                                              << rc_db << ": " << sqlite3_errmsg(db)
                                              << ". Query: " << query;
         throw std::runtime_error(msg);
@@ -60,4 +61,57 @@ inline size_t getRowsCount(sqlite3* db, const std::string& query, const QueryArg
     return entries_count;
 }
 
+/*!
+    \brief Scoped write transaction. Without it each modifying statement runs in its own implicit transaction,
+           so bulk writes of playlist entries pay transaction cost per row.
+           Implemented by savepoint, so transactions can be nested: loaders of single playlist start their own
+           transaction inside transaction of loading of all playlists.
+           Changes are rolled back in destructor if commit() has not been called, so readers never see partially written data.
+*/
+class Transaction : boost::noncopyable
+{
+public:
+
+    explicit Transaction(sqlite3* db) // throws std::runtime_error
+        :
+        db_(db),
+        active_(true)
+    {
+        exec("SAVEPOINT bulk_write");
+    }
+
+    ~Transaction()
+    {
+        if (active_) {
+            // rollback can't be reported from destructor, database keeps previous data anyway.
+            sqlite3_exec(db_, "ROLLBACK TO bulk_write; RELEASE bulk_write", nullptr, nullptr, nullptr);
+        }
+    }
+
+    void commit() // throws std::runtime_error
+    {
+        assert(active_);
+        exec("RELEASE bulk_write");
+        active_ = false;
+    }
+
+private:
+
+    void exec(const char* query)
+    {
+        char* errmsg = nullptr;
+        const int rc_db = sqlite3_exec(db_, query, nullptr, nullptr, &errmsg);
+        if (SQLITE_OK != rc_db) {
+            const std::string msg = MakeString() << "sqlite3_exec() error "
+                                                 << rc_db << ": " << (errmsg ? errmsg : sqlite3_errmsg(db_))
+                                                 << ". Query: " << query;
+            sqlite3_free(errmsg);
+            throw std::runtime_error(msg);
+        }
+    }
+
+    sqlite3* const db_;
+    bool active_;
+};
+
 } // namespace Utilities
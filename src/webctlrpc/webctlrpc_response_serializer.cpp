@@ -21,6 +21,12 @@ void ResponseSerializer::serializeFault(const Rpc::Value& /*root_request*/, cons
     *response = "";
 }
 
+void ResponseSerializer::serializeBatch(const Rpc::Value& /*root_responses*/, std::string* response) const
+{
+    // WebCtl requests are passed in URI query, so they are never batched.
+    *response = "";
+}
+
 const std::string& ResponseSerializer::mimeType() const
 {
     return kMIME_TYPE;
@@ -15,6 +15,8 @@ public:
 
     virtual void serializeFault(const Rpc::Value& root_request, const std::string& error_msg, int error_code, std::string* response) const;
 
+    virtual void serializeBatch(const Rpc::Value& root_responses, std::string* response) const;
+
     virtual const std::string& mimeType() const;
 
 private:
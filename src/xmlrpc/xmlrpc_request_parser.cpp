@@ -2,95 +2,388 @@
 
 #include "stdafx.h"
 #include "xmlrpc/request_parser.h"
-#include "xmlrpc/parse_util.h"
-#include "xmlrpc/value.h"
 #include "rpc/value.h"
 #include "rpc/exception.h"
+#include <cerrno>
+#include <climits>
 
 namespace XmlRpc
 {
 
-const char * const METHODNAME_TAG = "<methodName>";
-const char * const PARAMS_TAG     = "<params>";
-const char * const PARAMS_ETAG    = "</params>";
-const char * const PARAM_TAG      = "<param>";
-const char * const PARAM_ETAG     = "</param>";
+// tags are compared with buffer as is, so sizeof(tag) - 1 is tag length.
+static const char METHODNAME_TAG[]  = "<methodName>";
+static const char METHODNAME_ETAG[] = "</methodName>";
+static const char PARAMS_TAG[]      = "<params>";
+static const char PARAMS_ETAG[]     = "</params>";
+static const char PARAM_TAG[]       = "<param>";
+static const char PARAM_ETAG[]      = "</param>";
 
-//const std::string SYSTEM_MULTICALL = "system.multicall";
-//const std::string METHODNAME = "methodName";
-//const std::string PARAMS     = "params";
+static const char VALUE_TAG[]       = "<value>";
+static const char VALUE_ETAG[]      = "</value>";
+static const char VALUE_TAG_EMPTY[] = "<value/>";
 
-void convertXmlRpcValueToRpcValue(const Value& xml_rpc_value, Rpc::Value* rpc_value); // throws Rpc::Exception
+static const char NIL_TAG[]         = "<nil>";
+static const char NIL_ETAG[]        = "</nil>";
+static const char NIL_TAG_EMPTY[]   = "<nil/>";
+static const char BOOLEAN_TAG[]     = "<boolean>";
+static const char BOOLEAN_ETAG[]    = "</boolean>";
+static const char DOUBLE_TAG[]      = "<double>";
+static const char DOUBLE_ETAG[]     = "</double>";
+static const char INT_TAG[]         = "<int>";
+static const char INT_ETAG[]        = "</int>";
+static const char I4_TAG[]          = "<i4>";
+static const char I4_ETAG[]         = "</i4>";
+static const char STRING_TAG[]      = "<string>";
+static const char STRING_ETAG[]     = "</string>";
+static const char STRING_TAG_EMPTY[]= "<string/>";
+static const char DATETIME_TAG[]    = "<dateTime.iso8601>";
+static const char BASE64_TAG[]      = "<base64>";
 
-bool RequestParser::parse_(const std::string& /*request_uri*/,
-                           const std::string& request_content,
-                           Rpc::Value* root)
+static const char ARRAY_TAG[]       = "<array>";
+static const char ARRAY_ETAG[]      = "</array>";
+static const char DATA_TAG[]        = "<data>";
+static const char DATA_ETAG[]       = "</data>";
+static const char DATA_TAG_EMPTY[]  = "<data/>";
+
+static const char STRUCT_TAG[]      = "<struct>";
+static const char STRUCT_ETAG[]     = "</struct>";
+static const char MEMBER_TAG[]      = "<member>";
+static const char MEMBER_ETAG[]     = "</member>";
+static const char NAME_TAG[]        = "<name>";
+static const char NAME_ETAG[]       = "</name>";
+
+const std::string SYSTEM_MULTICALL = "system.multicall";
+const std::string METHODNAME = "methodName";
+const std::string PARAMS     = "params";
+
+namespace
+{
+
+/*!
+    Single pass XML-RPC request tokenizer. Request buffer is read once from left to right, values are built as Rpc::Value directly,
+    xml entities are decoded while text is copied to value.
+    Only XML subset which XML-RPC uses is supported: no comments, CDATA sections and attributes inside methodCall.
+*/
+class Tokenizer
 {
-    std::size_t offset = 0; // Number of chars parsed from the request
-    (*root)["method"] = Util::parseTag(METHODNAME_TAG, request_content, &offset);
-    const std::string& method_name = (*root)["method"];
-    if (  method_name.size() > 0 && Util::findTag(PARAMS_TAG, request_content, &offset) ) {
-        Value params;
-        std::size_t argc = 0;
-        while ( Util::nextTagIs(PARAM_TAG, request_content, &offset) ) {
-            params[argc++] = Value(request_content, &offset);
-            Util::nextTagIs(PARAM_ETAG, request_content, &offset);
-        }
-        if ( Util::nextTagIs(PARAMS_ETAG, request_content, &offset) ) {
-            convertXmlRpcValueToRpcValue(params, &(*root)["params"]);
+public:
+
+    Tokenizer(const char* begin, const char* end)
+        : pos_(begin), end_(end)
+    {}
+
+    //! Skips everything up to and including tag. Used to skip xml prolog and opening tags of methodCall.
+    template<std::size_t N>
+    bool skipTo(const char (&tag)[N])
+    {
+        const std::size_t length = N - 1;
+        for (; static_cast<std::size_t>(end_ - pos_) >= length; ++pos_) {
+            if (*pos_ == '<' && memcmp(pos_, tag, length) == 0) {
+                pos_ += length;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! Skips whitespace and tag if it goes next.
+    template<std::size_t N>
+    bool nextTagIs(const char (&tag)[N])
+    {
+        skipWhitespace();
+        const std::size_t length = N - 1;
+        if (static_cast<std::size_t>(end_ - pos_) >= length && memcmp(pos_, tag, length) == 0) {
+            pos_ += length;
             return true;
         }
+        return false;
+    }
+
+    //! Appends text up to next tag to string, xml entities are decoded.
+    void readText(std::string* text);
+
+    //! Parses <value> element.
+    bool parseValue(Rpc::Value* value); // throws Rpc::Exception
+
+private:
+
+    void skipWhitespace()
+    {
+        while ( pos_ != end_ && isspace( static_cast<unsigned char>(*pos_) ) ) {
+            ++pos_;
+        }
+    }
+
+    bool parseTypedValue(Rpc::Value* value); // throws Rpc::Exception
+    bool parseArray(Rpc::Value* value); // throws Rpc::Exception
+    bool parseStruct(Rpc::Value* value); // throws Rpc::Exception
+
+    bool parseInt(int* value);
+
+    void parseString(Rpc::Value* value)
+    {
+        *value = Rpc::Value::String();
+        readText( &static_cast<Rpc::Value::String&>(*value) );
+    }
+
+    const char* pos_;
+    const char* const end_;
+};
+
+// xml encodings (xml-encoded entities are preceded with '&')
+static const char  rawEntity[] = { '<',   '>',   '&',    '\'',    '\"' };
+static const char* xmlEntity[] = { "lt;", "gt;", "amp;", "apos;", "quot;" };
+static const int   xmlEntLen[] = { 3,     3,     4,      5,       5 };
+
+void Tokenizer::readText(std::string* text)
+{
+    const char* chunk_begin = pos_;
+    while (pos_ != end_ && *pos_ != '<') {
+        if (*pos_ != '&') {
+            ++pos_;
+            continue;
+        }
+
+        text->append(chunk_begin, pos_);
+        ++pos_;
+        std::size_t entity = 0;
+        for (; entity != sizeof(rawEntity); ++entity) {
+            if (   end_ - pos_ >= xmlEntLen[entity]
+                && memcmp(pos_, xmlEntity[entity], xmlEntLen[entity]) == 0
+                )
+            {
+                break;
+            }
+        }
+        if (entity != sizeof(rawEntity)) {
+            text->push_back(rawEntity[entity]);
+            pos_ += xmlEntLen[entity];
+        } else { // unrecognized sequence
+            text->push_back('&');
+        }
+        chunk_begin = pos_;
+    }
+    text->append(chunk_begin, pos_);
+}
+
+bool Tokenizer::parseValue(Rpc::Value* value) // throws Rpc::Exception
+{
+    if ( nextTagIs(VALUE_TAG_EMPTY) ) {
+        *value = Rpc::Value::String();
+        return true;
+    }
+
+    if ( !nextTagIs(VALUE_TAG) ) {
+        return false;
+    }
+
+    const char* const text_begin = pos_;
+    skipWhitespace();
+    if (pos_ == end_) {
+        return false;
+    }
+
+    if (*pos_ != '<' || pos_[1] == '/') { // buffer is null terminated, so pos_[1] is always readable.
+        // string without type tag, whitespace is part of it.
+        pos_ = text_begin;
+        parseString(value);
+    } else if ( !parseTypedValue(value) ) {
+        return false;
+    }
+
+    return nextTagIs(VALUE_ETAG);
+}
+
+bool Tokenizer::parseTypedValue(Rpc::Value* value) // throws Rpc::Exception
+{
+    int int_value;
+    if ( nextTagIs(STRING_TAG) ) {
+        parseString(value);
+        return nextTagIs(STRING_ETAG);
+    } else if ( nextTagIs(STRING_TAG_EMPTY) ) {
+        *value = Rpc::Value::String();
+        return true;
+    } else if ( nextTagIs(INT_TAG) ) {
+        if ( !parseInt(&int_value) ) {
+            return false;
+        }
+        *value = int_value;
+        return nextTagIs(INT_ETAG);
+    } else if ( nextTagIs(I4_TAG) ) {
+        if ( !parseInt(&int_value) ) {
+            return false;
+        }
+        *value = int_value;
+        return nextTagIs(I4_ETAG);
+    } else if ( nextTagIs(BOOLEAN_TAG) ) {
+        if ( !parseInt(&int_value) || (int_value != 0 && int_value != 1) ) {
+            return false;
+        }
+        *value = int_value == 1;
+        return nextTagIs(BOOLEAN_ETAG);
+    } else if ( nextTagIs(DOUBLE_TAG) ) {
+        char* value_end;
+        const double double_value = strtod(pos_, &value_end); // buffer is null terminated and value is followed by tag anyway.
+        if (value_end == pos_) {
+            return false;
+        }
+        pos_ = value_end;
+        *value = double_value;
+        return nextTagIs(DOUBLE_ETAG);
+    } else if ( nextTagIs(NIL_TAG_EMPTY) ) {
+        *value = Rpc::Value::Null();
+        return true;
+    } else if ( nextTagIs(NIL_TAG) ) {
+        *value = Rpc::Value::Null();
+        return nextTagIs(NIL_ETAG);
+    } else if ( nextTagIs(ARRAY_TAG) ) {
+        return parseArray(value);
+    } else if ( nextTagIs(STRUCT_TAG) ) {
+        return parseStruct(value);
+    } else if ( nextTagIs(DATETIME_TAG) || nextTagIs(BASE64_TAG) ) {
+        throw Rpc::Exception("Value's DateTime and Base64 types are not supported.", Rpc::TYPE_ERROR);
     }
     return false;
 }
 
-void convertXmlRpcValueToRpcValue(const Value& xml_rpc_value, Rpc::Value* rpc_value) // throws Rpc::Exception
+bool Tokenizer::parseInt(int* value)
+{
+    char* value_end;
+    errno = 0;
+    const long long_value = strtol(pos_, &value_end, 10); // buffer is null terminated and value is followed by tag anyway.
+    if (value_end == pos_) {
+        return false;
+    }
+    if (errno == ERANGE || long_value < INT_MIN || INT_MAX < long_value) { // XML-RPC int is 32-bit signed.
+        return false;
+    }
+    pos_ = value_end;
+    *value = static_cast<int>(long_value);
+    return true;
+}
+
+bool Tokenizer::parseArray(Rpc::Value* value) // throws Rpc::Exception
+{
+    if ( nextTagIs(DATA_TAG_EMPTY) ) {
+        *value = Rpc::Value::Array();
+        return nextTagIs(ARRAY_ETAG);
+    }
+
+    if ( !nextTagIs(DATA_TAG) ) {
+        return false;
+    }
+
+    Rpc::Value::Array items;
+    while ( !nextTagIs(DATA_ETAG) ) {
+        items.push_back( Rpc::Value() );
+        if ( !parseValue(&items.back()) ) {
+            return false;
+        }
+    }
+    *value = std::move(items);
+    return nextTagIs(ARRAY_ETAG);
+}
+
+bool Tokenizer::parseStruct(Rpc::Value* value) // throws Rpc::Exception
+{
+    Rpc::Value::Object object;
+    std::string name;
+    Rpc::Value member_value;
+    while ( nextTagIs(MEMBER_TAG) ) {
+        if ( !nextTagIs(NAME_TAG) ) {
+            return false;
+        }
+        name.clear();
+        readText(&name);
+        if ( !nextTagIs(NAME_ETAG) ) {
+            return false;
+        }
+
+        member_value.reset();
+        if ( !parseValue(&member_value) || !nextTagIs(MEMBER_ETAG) ) {
+            return false;
+        }
+
+        if ( object.find(name) == object.end() ) { // the first of duplicated members is used.
+            object[name] = std::move(member_value);
+        }
+    }
+    *value = std::move(object);
+    return nextTagIs(STRUCT_ETAG);
+}
+
+} // namespace
+
+/*!
+    Converts system.multicall request to batch: array of {method, params} requests.
+    Multicall has no notifications, so each call gets null id.
+    \return false if params are not single array of calls.
+*/
+bool convertMulticallToBatch(Rpc::Value* root)
 {
-    assert(rpc_value);
-
-    switch ( xml_rpc_value.getType() ) {
-    case Value::TypeInvalid:
-        Rpc::Value().swap(*rpc_value);
-        break;
-    case Value::TypeNil:
-        Rpc::Value( Rpc::Value::Null() ).swap(*rpc_value);
-        break;
-    case Value::TypeBoolean:
-        *rpc_value = bool(xml_rpc_value);
-        break;
-    case Value::TypeInt:
-        *rpc_value = int(xml_rpc_value);
-        break;
-    case Value::TypeDouble:
-        *rpc_value = double(xml_rpc_value);
-        break;
-    case Value::TypeString:
-        *rpc_value = static_cast<const std::string&>(xml_rpc_value);
-        break;
-    case Value::TypeArray:
-        rpc_value->setSize( xml_rpc_value.size() );
-        for (size_t i = 0, size = rpc_value->size(); i != size; ++i) {
-            convertXmlRpcValueToRpcValue(xml_rpc_value[i], &((*rpc_value)[i]));
-        }
-        break;
-    case Value::TypeStruct:
-        {
-        Rpc::Value::Object object;
-        auto member_it = xml_rpc_value.getStructMembersBegin(),
-             end       = xml_rpc_value.getStructMembersEnd();
-        for (; member_it != end; ++member_it) {
-            convertXmlRpcValueToRpcValue(member_it->second, &object[member_it->first]);
-        }
-
-        *rpc_value = object;
-        }
-        break;
-    case Value::TypeDateTime:
-    case Value::TypeBase64:
-        assert(!"Value's DateTime and Base64 types are not supported.");
-    default:
-        throw Rpc::Exception("unknown type", Rpc::TYPE_ERROR);
+    const Rpc::Value& params = (*root)["params"];
+    if (params.type() != Rpc::Value::TYPE_ARRAY || params.size() != 1 || params[0].type() != Rpc::Value::TYPE_ARRAY) {
+        return false;
+    }
+
+    const Rpc::Value& calls = params[0];
+    Rpc::Value batch;
+    batch.setSize( calls.size() );
+    for (size_t i = 0, size = calls.size(); i != size; ++i) {
+        const Rpc::Value& call = calls[i];
+        Rpc::Value& request = batch[i];
+        request["id"] = Rpc::Value::Null();
+        if (call.type() == Rpc::Value::TYPE_OBJECT) { // invalid call without method name gets fault in batch response.
+            if ( call.isMember(METHODNAME) ) {
+                request["method"] = call[METHODNAME];
+            }
+            if ( call.isMember(PARAMS) ) {
+                request["params"] = call[PARAMS];
+            }
+        }
     }
+
+    root->swap(batch);
+    return true;
+}
+
+bool RequestParser::parse_(const std::string& /*request_uri*/,
+                           const std::string& request_content,
+                           Rpc::Value* root) // throws Rpc::Exception
+{
+    Tokenizer tokenizer( request_content.c_str(), request_content.c_str() + request_content.size() );
+
+    std::string method_name;
+    if (   !tokenizer.skipTo(METHODNAME_TAG)
+        || (tokenizer.readText(&method_name), method_name.empty())
+        || !tokenizer.nextTagIs(METHODNAME_ETAG)
+        || !tokenizer.skipTo(PARAMS_TAG)
+        )
+    {
+        return false;
+    }
+
+    Rpc::Value::Array params;
+    while ( tokenizer.nextTagIs(PARAM_TAG) ) {
+        params.push_back( Rpc::Value() );
+        if ( !tokenizer.parseValue(&params.back()) ) {
+            return false;
+        }
+        tokenizer.nextTagIs(PARAM_ETAG);
+    }
+    if ( !tokenizer.nextTagIs(PARAMS_ETAG) ) {
+        return false;
+    }
+
+    const bool multicall = method_name == SYSTEM_MULTICALL;
+    (*root)["method"] = std::move(method_name);
+    Rpc::Value& root_params = (*root)["params"]; // stays none if request has no params.
+    if ( !params.empty() ) {
+        root_params = std::move(params);
+    }
+
+    return multicall ? convertMulticallToBatch(root)
+                     : true;
 }
 
 } // namespace XmlRpc
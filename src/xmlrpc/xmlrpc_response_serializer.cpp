@@ -114,6 +114,29 @@ void ResponseSerializer::serializeFault(const Rpc::Value& /*root_request*/, cons
     generateFaultResponse(error_msg, error_code, response);
 }
 
+void ResponseSerializer::serializeBatch(const Rpc::Value& root_responses, std::string* response) const
+{
+    // system.multicall result: array where each item is array of one result value or fault struct.
+    static const std::string FAULTCODE   = "faultCode";
+    static const std::string FAULTSTRING = "faultString";
+
+    Value results;
+    results.setSize( root_responses.size() );
+    for (size_t i = 0, size = root_responses.size(); i != size; ++i) {
+        const Rpc::Value& root_response = root_responses[i];
+        Value& result = results[i];
+        if ( root_response.isMember("error") ) {
+            const Rpc::Value& error = root_response["error"];
+            result[FAULTCODE] = int(error["code"]);
+            result[FAULTSTRING] = static_cast<const std::string&>(error["message"]);
+        } else {
+            result.setSize(1);
+            convertRpcValueToXmlRpcValue(root_response["result"], &result[0]);
+        }
+    }
+    generateResponse(results.toXml(), response);
+}
+
 const std::string& ResponseSerializer::mimeType() const
 {
     return kMIME_TYPE;